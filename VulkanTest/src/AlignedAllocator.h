@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+
+// std::vector allocator returning memory aligned for SIMD loads
+template<typename T, size_t Alignment>
+struct AlignedAllocator
+{
+	static_assert((Alignment & (Alignment - 1)) == 0, "alignment must be a power of two");
+
+	typedef T value_type;
+
+	template<typename U>
+	struct rebind
+	{
+		typedef AlignedAllocator<U, Alignment> other;
+	};
+
+	AlignedAllocator() {}
+
+	template<typename U>
+	AlignedAllocator(const AlignedAllocator<U, Alignment>&) {}
+
+	T* allocate(size_t count)
+	{
+		// the pointer returned by malloc is stored right before the aligned block
+		void* raw = std::malloc(count * sizeof(T) + Alignment + sizeof(void*));
+		if (raw == nullptr)
+			throw std::bad_alloc();
+
+		const uintptr_t aligned = (reinterpret_cast<uintptr_t>(raw) + sizeof(void*) + Alignment - 1) & ~static_cast<uintptr_t>(Alignment - 1);
+		reinterpret_cast<void**>(aligned)[-1] = raw;
+		return reinterpret_cast<T*>(aligned);
+	}
+
+	void deallocate(T* pointer, size_t)
+	{
+		std::free(reinterpret_cast<void**>(pointer)[-1]);
+	}
+
+	template<typename U>
+	bool operator==(const AlignedAllocator<U, Alignment>&) const
+	{
+		return true;
+	}
+
+	template<typename U>
+	bool operator!=(const AlignedAllocator<U, Alignment>&) const
+	{
+		return false;
+	}
+};
@@ -0,0 +1,860 @@
+#include "AnimationBlending.h"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define ANIMATION_BLENDING_SSE
+#include <emmintrin.h>
+#endif
+
+const uint32_t BlendGraph::NO_MASK;
+const uint32_t BlendGraph::MAX_INPUTS;
+
+namespace
+{
+	void getStreams(const AnimationPose& pose, const float* outStreams[AnimationPose::STREAM_COUNT])
+	{
+		for (uint32_t stream = 0; stream < AnimationPose::STREAM_COUNT; stream++)
+			outStreams[stream] = pose.getStream(static_cast<AnimationPose::Stream>(stream));
+	}
+
+	void getStreams(AnimationPose& pose, float* outStreams[AnimationPose::STREAM_COUNT])
+	{
+		for (uint32_t stream = 0; stream < AnimationPose::STREAM_COUNT; stream++)
+			outStreams[stream] = pose.getStream(static_cast<AnimationPose::Stream>(stream));
+	}
+
+	void checkPoses(const AnimationPose& a, const AnimationPose& b, AnimationPose& outPose)
+	{
+		if (a.getBoneCount() != b.getBoneCount())
+			throw std::runtime_error("blended poses must have the same bone count !");
+
+		// only allocates the first time
+		if (outPose.getBoneCount() != a.getBoneCount())
+			outPose.resize(a.getBoneCount());
+	}
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/////////// PoseBlending
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void PoseBlending::blendReference(const AnimationPose& from, const AnimationPose& to, float weight, const float* boneWeights, AnimationPose& outPose)
+{
+	checkPoses(from, to, outPose);
+
+	for (uint32_t boneIndex = 0; boneIndex < from.getBoneCount(); boneIndex++)
+	{
+		const float boneWeight = boneWeights != nullptr ? weight * boneWeights[boneIndex] : weight;
+		const BoneTransform fromTransform = from.getBoneTransform(boneIndex);
+		BoneTransform toTransform = to.getBoneTransform(boneIndex);
+
+		// shortest path
+		if (glm::dot(fromTransform.rotation, toTransform.rotation) < 0.f)
+			toTransform.rotation = -toTransform.rotation;
+
+		BoneTransform boneTransform;
+		boneTransform.rotation = glm::normalize(fromTransform.rotation * (1.f - boneWeight) + toTransform.rotation * boneWeight);
+		boneTransform.position = fromTransform.position * (1.f - boneWeight) + toTransform.position * boneWeight;
+		outPose.setBoneTransform(boneIndex, boneTransform);
+	}
+}
+
+void PoseBlending::addReference(const AnimationPose& base, const AnimationPose& pose, const AnimationPose& reference, float weight, const float* boneWeights, AnimationPose& outPose)
+{
+	checkPoses(base, pose, outPose);
+	checkPoses(base, reference, outPose);
+
+	for (uint32_t boneIndex = 0; boneIndex < base.getBoneCount(); boneIndex++)
+	{
+		const float boneWeight = boneWeights != nullptr ? weight * boneWeights[boneIndex] : weight;
+		const BoneTransform baseTransform = base.getBoneTransform(boneIndex);
+		const BoneTransform poseTransform = pose.getBoneTransform(boneIndex);
+		const BoneTransform referenceTransform = reference.getBoneTransform(boneIndex);
+
+		// difference to the reference, scaled from the identity by the weight
+		glm::quat delta = glm::conjugate(referenceTransform.rotation) * poseTransform.rotation;
+		if (delta.w < 0.f)
+			delta = -delta;
+		delta = glm::normalize(glm::quat(1.f, 0.f, 0.f, 0.f) * (1.f - boneWeight) + delta * boneWeight);
+
+		BoneTransform boneTransform;
+		boneTransform.rotation = baseTransform.rotation * delta;
+		boneTransform.position = baseTransform.position + (poseTransform.position - referenceTransform.position) * boneWeight;
+		outPose.setBoneTransform(boneIndex, boneTransform);
+	}
+}
+
+void PoseBlending::clearAccumulation(AnimationPose& outAccumulation)
+{
+	for (uint32_t stream = 0; stream < AnimationPose::STREAM_COUNT; stream++)
+	{
+		float* values = outAccumulation.getStream(static_cast<AnimationPose::Stream>(stream));
+		std::fill(values, values + outAccumulation.getPaddedBoneCount(), 0.f);
+	}
+}
+
+#if defined(ANIMATION_BLENDING_SSE)
+
+namespace
+{
+	// 4 bones, one register per pose stream
+	struct PoseBlock
+	{
+		__m128 streams[AnimationPose::STREAM_COUNT];
+	};
+
+	inline void loadBlock(const float* const streams[AnimationPose::STREAM_COUNT], uint32_t boneIndex, PoseBlock& outBlock)
+	{
+		for (uint32_t stream = 0; stream < AnimationPose::STREAM_COUNT; stream++)
+			outBlock.streams[stream] = _mm_load_ps(streams[stream] + boneIndex);
+	}
+
+	inline void storeBlock(const PoseBlock& block, float* const streams[AnimationPose::STREAM_COUNT], uint32_t boneIndex)
+	{
+		for (uint32_t stream = 0; stream < AnimationPose::STREAM_COUNT; stream++)
+			_mm_store_ps(streams[stream] + boneIndex, block.streams[stream]);
+	}
+
+	inline __m128 loadWeight(__m128 weight, const float* boneWeights, uint32_t boneIndex)
+	{
+		return boneWeights != nullptr ? _mm_mul_ps(weight, _mm_load_ps(boneWeights + boneIndex)) : weight;
+	}
+
+	inline __m128 dotRotations(const PoseBlock& a, const PoseBlock& b)
+	{
+		return _mm_add_ps(_mm_add_ps(_mm_mul_ps(a.streams[AnimationPose::STREAM_ROTATION_X], b.streams[AnimationPose::STREAM_ROTATION_X]), _mm_mul_ps(a.streams[AnimationPose::STREAM_ROTATION_Y], b.streams[AnimationPose::STREAM_ROTATION_Y]))
+			, _mm_add_ps(_mm_mul_ps(a.streams[AnimationPose::STREAM_ROTATION_Z], b.streams[AnimationPose::STREAM_ROTATION_Z]), _mm_mul_ps(a.streams[AnimationPose::STREAM_ROTATION_W], b.streams[AnimationPose::STREAM_ROTATION_W])));
+	}
+
+	inline void normalizeRotations(PoseBlock& inOutBlock)
+	{
+		const __m128 length = _mm_sqrt_ps(dotRotations(inOutBlock, inOutBlock));
+		for (uint32_t stream = AnimationPose::STREAM_ROTATION_X; stream <= AnimationPose::STREAM_ROTATION_W; stream++)
+			inOutBlock.streams[stream] = _mm_div_ps(inOutBlock.streams[stream], length);
+	}
+
+	// a + (b - a) * weight on every stream, b rotations flipped on the shortest path
+	inline void lerpBlock(const PoseBlock& a, PoseBlock& inOutB, __m128 weight)
+	{
+		const __m128 flip = _mm_and_ps(dotRotations(a, inOutB), _mm_set1_ps(-0.f));
+		for (uint32_t stream = AnimationPose::STREAM_ROTATION_X; stream <= AnimationPose::STREAM_ROTATION_W; stream++)
+			inOutB.streams[stream] = _mm_xor_ps(inOutB.streams[stream], flip);
+
+		for (uint32_t stream = 0; stream < AnimationPose::STREAM_COUNT; stream++)
+			inOutB.streams[stream] = _mm_add_ps(a.streams[stream], _mm_mul_ps(_mm_sub_ps(inOutB.streams[stream], a.streams[stream]), weight));
+	}
+}
+
+void PoseBlending::blend(const AnimationPose& from, const AnimationPose& to, float weight, const float* boneWeights, AnimationPose& outPose)
+{
+	checkPoses(from, to, outPose);
+
+	const float* fromStreams[AnimationPose::STREAM_COUNT];
+	const float* toStreams[AnimationPose::STREAM_COUNT];
+	float* outStreams[AnimationPose::STREAM_COUNT];
+	getStreams(from, fromStreams);
+	getStreams(to, toStreams);
+	getStreams(outPose, outStreams);
+
+	const __m128 blendWeight = _mm_set1_ps(weight);
+	PoseBlock fromBlock, block;
+	for (uint32_t boneIndex = 0; boneIndex < from.getPaddedBoneCount(); boneIndex += AnimationPose::BLOCK_SIZE)
+	{
+		loadBlock(fromStreams, boneIndex, fromBlock);
+		loadBlock(toStreams, boneIndex, block);
+		lerpBlock(fromBlock, block, loadWeight(blendWeight, boneWeights, boneIndex));
+		normalizeRotations(block);
+		storeBlock(block, outStreams, boneIndex);
+	}
+}
+
+void PoseBlending::add(const AnimationPose& base, const AnimationPose& pose, const AnimationPose& reference, float weight, const float* boneWeights, AnimationPose& outPose)
+{
+	checkPoses(base, pose, outPose);
+	checkPoses(base, reference, outPose);
+
+	const float* baseStreams[AnimationPose::STREAM_COUNT];
+	const float* poseStreams[AnimationPose::STREAM_COUNT];
+	const float* referenceStreams[AnimationPose::STREAM_COUNT];
+	float* outStreams[AnimationPose::STREAM_COUNT];
+	getStreams(base, baseStreams);
+	getStreams(pose, poseStreams);
+	getStreams(reference, referenceStreams);
+	getStreams(outPose, outStreams);
+
+	const __m128 one = _mm_set1_ps(1.f);
+	const __m128 signMask = _mm_set1_ps(-0.f);
+	const __m128 addWeight = _mm_set1_ps(weight);
+	PoseBlock baseBlock, poseBlock, referenceBlock;
+	for (uint32_t boneIndex = 0; boneIndex < base.getPaddedBoneCount(); boneIndex += AnimationPose::BLOCK_SIZE)
+	{
+		loadBlock(baseStreams, boneIndex, baseBlock);
+		loadBlock(poseStreams, boneIndex, poseBlock);
+		loadBlock(referenceStreams, boneIndex, referenceBlock);
+		const __m128 boneWeight = loadWeight(addWeight, boneWeights, boneIndex);
+
+		// delta = conjugate(reference) * pose
+		const __m128 rx = referenceBlock.streams[AnimationPose::STREAM_ROTATION_X];
+		const __m128 ry = referenceBlock.streams[AnimationPose::STREAM_ROTATION_Y];
+		const __m128 rz = referenceBlock.streams[AnimationPose::STREAM_ROTATION_Z];
+		const __m128 rw = referenceBlock.streams[AnimationPose::STREAM_ROTATION_W];
+		const __m128 px = poseBlock.streams[AnimationPose::STREAM_ROTATION_X];
+		const __m128 py = poseBlock.streams[AnimationPose::STREAM_ROTATION_Y];
+		const __m128 pz = poseBlock.streams[AnimationPose::STREAM_ROTATION_Z];
+		const __m128 pw = poseBlock.streams[AnimationPose::STREAM_ROTATION_W];
+		__m128 dx = _mm_sub_ps(_mm_add_ps(_mm_mul_ps(rw, px), _mm_mul_ps(rz, py)), _mm_add_ps(_mm_mul_ps(rx, pw), _mm_mul_ps(ry, pz)));
+		__m128 dy = _mm_sub_ps(_mm_add_ps(_mm_mul_ps(rw, py), _mm_mul_ps(rx, pz)), _mm_add_ps(_mm_mul_ps(ry, pw), _mm_mul_ps(rz, px)));
+		__m128 dz = _mm_sub_ps(_mm_add_ps(_mm_mul_ps(rw, pz), _mm_mul_ps(ry, px)), _mm_add_ps(_mm_mul_ps(rz, pw), _mm_mul_ps(rx, py)));
+		__m128 dw = _mm_add_ps(_mm_add_ps(_mm_mul_ps(rw, pw), _mm_mul_ps(rx, px)), _mm_add_ps(_mm_mul_ps(ry, py), _mm_mul_ps(rz, pz)));
+
+		// shortest path from the identity, then scaled by the weight
+		const __m128 flip = _mm_and_ps(dw, signMask);
+		dx = _mm_mul_ps(_mm_xor_ps(dx, flip), boneWeight);
+		dy = _mm_mul_ps(_mm_xor_ps(dy, flip), boneWeight);
+		dz = _mm_mul_ps(_mm_xor_ps(dz, flip), boneWeight);
+		dw = _mm_add_ps(one, _mm_mul_ps(_mm_sub_ps(_mm_xor_ps(dw, flip), one), boneWeight));
+		const __m128 length = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_add_ps(_mm_mul_ps(dz, dz), _mm_mul_ps(dw, dw))));
+		dx = _mm_div_ps(dx, length);
+		dy = _mm_div_ps(dy, length);
+		dz = _mm_div_ps(dz, length);
+		dw = _mm_div_ps(dw, length);
+
+		// base * delta
+		const __m128 bx = baseBlock.streams[AnimationPose::STREAM_ROTATION_X];
+		const __m128 by = baseBlock.streams[AnimationPose::STREAM_ROTATION_Y];
+		const __m128 bz = baseBlock.streams[AnimationPose::STREAM_ROTATION_Z];
+		const __m128 bw = baseBlock.streams[AnimationPose::STREAM_ROTATION_W];
+		PoseBlock outBlock;
+		outBlock.streams[AnimationPose::STREAM_ROTATION_X] = _mm_sub_ps(_mm_add_ps(_mm_mul_ps(bw, dx), _mm_mul_ps(bx, dw)), _mm_sub_ps(_mm_mul_ps(bz, dy), _mm_mul_ps(by, dz)));
+		outBlock.streams[AnimationPose::STREAM_ROTATION_Y] = _mm_sub_ps(_mm_add_ps(_mm_mul_ps(bw, dy), _mm_mul_ps(by, dw)), _mm_sub_ps(_mm_mul_ps(bx, dz), _mm_mul_ps(bz, dx)));
+		outBlock.streams[AnimationPose::STREAM_ROTATION_Z] = _mm_sub_ps(_mm_add_ps(_mm_mul_ps(bw, dz), _mm_mul_ps(bz, dw)), _mm_sub_ps(_mm_mul_ps(by, dx), _mm_mul_ps(bx, dy)));
+		outBlock.streams[AnimationPose::STREAM_ROTATION_W] = _mm_sub_ps(_mm_mul_ps(bw, dw), _mm_add_ps(_mm_add_ps(_mm_mul_ps(bx, dx), _mm_mul_ps(by, dy)), _mm_mul_ps(bz, dz)));
+
+		for (uint32_t stream = AnimationPose::STREAM_TRANSLATION_X; stream <= AnimationPose::STREAM_TRANSLATION_Z; stream++)
+			outBlock.streams[stream] = _mm_add_ps(baseBlock.streams[stream], _mm_mul_ps(_mm_sub_ps(poseBlock.streams[stream], referenceBlock.streams[stream]), boneWeight));
+
+		storeBlock(outBlock, outStreams, boneIndex);
+	}
+}
+
+void PoseBlending::accumulate(const AnimationPose& pose, float weight, AnimationPose& inOutAccumulation)
+{
+	const float* poseStreams[AnimationPose::STREAM_COUNT];
+	float* accumulationStreams[AnimationPose::STREAM_COUNT];
+	getStreams(pose, poseStreams);
+	getStreams(inOutAccumulation, accumulationStreams);
+
+	const __m128 signMask = _mm_set1_ps(-0.f);
+	const __m128 poseWeight = _mm_set1_ps(weight);
+	PoseBlock poseBlock, accumulationBlock;
+	for (uint32_t boneIndex = 0; boneIndex < pose.getPaddedBoneCount(); boneIndex += AnimationPose::BLOCK_SIZE)
+	{
+		loadBlock(poseStreams, boneIndex, poseBlock);
+		loadBlock(accumulationStreams, boneIndex, accumulationBlock);
+
+		// rotations on the side of the sum, compared to zero as the first pose gives a -0 dot product with the empty sum
+		const __m128 flip = _mm_and_ps(_mm_cmplt_ps(dotRotations(accumulationBlock, poseBlock), _mm_setzero_ps()), signMask);
+		const __m128 signedWeight = _mm_xor_ps(poseWeight, flip);
+		for (uint32_t stream = AnimationPose::STREAM_ROTATION_X; stream <= AnimationPose::STREAM_ROTATION_W; stream++)
+			accumulationBlock.streams[stream] = _mm_add_ps(accumulationBlock.streams[stream], _mm_mul_ps(poseBlock.streams[stream], signedWeight));
+		for (uint32_t stream = AnimationPose::STREAM_TRANSLATION_X; stream <= AnimationPose::STREAM_TRANSLATION_Z; stream++)
+			accumulationBlock.streams[stream] = _mm_add_ps(accumulationBlock.streams[stream], _mm_mul_ps(poseBlock.streams[stream], poseWeight));
+
+		storeBlock(accumulationBlock, accumulationStreams, boneIndex);
+	}
+}
+
+void PoseBlending::normalize(AnimationPose& inOutAccumulation)
+{
+	float* streams[AnimationPose::STREAM_COUNT];
+	getStreams(inOutAccumulation, streams);
+
+	PoseBlock block;
+	for (uint32_t boneIndex = 0; boneIndex < inOutAccumulation.getPaddedBoneCount(); boneIndex += AnimationPose::BLOCK_SIZE)
+	{
+		loadBlock(streams, boneIndex, block);
+		normalizeRotations(block);
+		storeBlock(block, streams, boneIndex);
+	}
+}
+
+const char* PoseBlending::getInstructionSetName()
+{
+	return "SSE";
+}
+
+#else
+
+void PoseBlending::blend(const AnimationPose& from, const AnimationPose& to, float weight, const float* boneWeights, AnimationPose& outPose)
+{
+	blendReference(from, to, weight, boneWeights, outPose);
+}
+
+void PoseBlending::add(const AnimationPose& base, const AnimationPose& pose, const AnimationPose& reference, float weight, const float* boneWeights, AnimationPose& outPose)
+{
+	addReference(base, pose, reference, weight, boneWeights, outPose);
+}
+
+void PoseBlending::accumulate(const AnimationPose& pose, float weight, AnimationPose& inOutAccumulation)
+{
+	for (uint32_t boneIndex = 0; boneIndex < pose.getPaddedBoneCount(); boneIndex++)
+	{
+		const BoneTransform poseTransform = pose.getBoneTransform(boneIndex);
+		BoneTransform accumulation = inOutAccumulation.getBoneTransform(boneIndex);
+
+		const float signedWeight = glm::dot(accumulation.rotation, poseTransform.rotation) < 0.f ? -weight : weight;
+		accumulation.rotation = accumulation.rotation + poseTransform.rotation * signedWeight;
+		accumulation.position += poseTransform.position * weight;
+		inOutAccumulation.setBoneTransform(boneIndex, accumulation);
+	}
+}
+
+void PoseBlending::normalize(AnimationPose& inOutAccumulation)
+{
+	for (uint32_t boneIndex = 0; boneIndex < inOutAccumulation.getPaddedBoneCount(); boneIndex++)
+	{
+		BoneTransform boneTransform = inOutAccumulation.getBoneTransform(boneIndex);
+		boneTransform.rotation = glm::normalize(boneTransform.rotation);
+		inOutAccumulation.setBoneTransform(boneIndex, boneTransform);
+	}
+}
+
+const char* PoseBlending::getInstructionSetName()
+{
+	return "Scalar";
+}
+
+#endif
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/////////// BlendGraph
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+BlendGraph::BlendGraph(uint32_t _boneCount)
+	: boneCount(_boneCount)
+	, paddedBoneCount(AnimationPose::computePaddedBoneCount(_boneCount))
+{}
+
+uint32_t BlendGraph::addNode(const Node& node)
+{
+	if (built)
+		throw std::runtime_error("a blend graph can't be modified once built !");
+
+	nodes.push_back(node);
+	return static_cast<uint32_t>(nodes.size() - 1);
+}
+
+void BlendGraph::checkClip(const SkeletalAnimation* clip) const
+{
+	if (clip == nullptr || clip->getBoneCount() != boneCount)
+		throw std::runtime_error("blend graph clips must have the bone count of the graph !");
+}
+
+void BlendGraph::checkInput(uint32_t nodeIndex) const
+{
+	if (nodeIndex >= nodes.size())
+		throw std::runtime_error("blend graph inputs must be added before their node !");
+}
+
+void BlendGraph::checkParameter(uint32_t parameterIndex) const
+{
+	if (parameterIndex >= parameterDefaults.size())
+		throw std::runtime_error("unknown blend graph parameter !");
+}
+
+uint32_t BlendGraph::addParameter(float defaultValue)
+{
+	parameterDefaults.push_back(defaultValue);
+	return static_cast<uint32_t>(parameterDefaults.size() - 1);
+}
+
+uint32_t BlendGraph::addBoneMask(const std::vector<float>& boneWeights)
+{
+	if (boneWeights.size() != boneCount)
+		throw std::runtime_error("a bone mask needs one weight per bone !");
+
+	// the padding bones keep the base pose
+	AnimationPose::StreamStorage mask(paddedBoneCount, 0.f);
+	std::copy(boneWeights.begin(), boneWeights.end(), mask.begin());
+	boneMasks.push_back(std::move(mask));
+	return static_cast<uint32_t>(boneMasks.size() - 1);
+}
+
+uint32_t BlendGraph::addBoneMask(const SkeletonData& skeleton, const std::string& rootBoneName, float weight)
+{
+	const auto bone = skeleton.boneMappingNameToIdx.find(rootBoneName);
+	if (bone == skeleton.boneMappingNameToIdx.end())
+		throw std::runtime_error("unknown bone for the bone mask !");
+
+	std::vector<float> boneWeights(skeleton.getBoneCount(), 0.f);
+	for (uint32_t boneIndex = 0; boneIndex < skeleton.getBoneCount(); boneIndex++)
+	{
+		const uint32_t parent = skeleton.boneParents[boneIndex];
+		if (parent != SkeletonData::NO_PARENT && parent >= boneIndex)
+			throw std::runtime_error("bone masks need a linearized skeleton !");
+
+		// parents come first, so their weight is already known
+		if (boneIndex == bone->second || (parent != SkeletonData::NO_PARENT && boneWeights[parent] > 0.f))
+			boneWeights[boneIndex] = weight;
+	}
+
+	return addBoneMask(boneWeights);
+}
+
+uint32_t BlendGraph::addClip(const SkeletalAnimation* clip, float playRate, bool loop)
+{
+	checkClip(clip);
+
+	Node node;
+	node.type = BLEND_NODE_CLIP;
+	node.clip = clip;
+	node.playRate = playRate;
+	node.loop = loop;
+	return addNode(node);
+}
+
+uint32_t BlendGraph::addBlend(uint32_t from, uint32_t to, uint32_t weightParameter)
+{
+	checkInput(from);
+	checkInput(to);
+	checkParameter(weightParameter);
+
+	Node node;
+	node.type = BLEND_NODE_BLEND;
+	node.inputs[0] = from;
+	node.inputs[1] = to;
+	node.inputCount = 2;
+	node.parameters[0] = weightParameter;
+	return addNode(node);
+}
+
+uint32_t BlendGraph::addBlendSpace1D(const std::vector<const SkeletalAnimation*>& clips, const std::vector<float>& positions, uint32_t parameter)
+{
+	if (clips.empty() || clips.size() != positions.size())
+		throw std::runtime_error("a blend space needs one position per clip !");
+	checkParameter(parameter);
+
+	Node node;
+	node.type = BLEND_NODE_BLEND_SPACE_1D;
+	node.parameters[0] = parameter;
+	node.firstSample = static_cast<uint32_t>(samples.size());
+	node.sampleCount = static_cast<uint32_t>(clips.size());
+	for (size_t i = 0; i < clips.size(); i++)
+	{
+		checkClip(clips[i]);
+		samples.push_back(BlendSpaceSample{ clips[i], glm::vec2(positions[i], 0.f) });
+	}
+
+	// sorted so the evaluation only looks for the segment around the parameter
+	std::sort(samples.begin() + node.firstSample, samples.end(), [](const BlendSpaceSample& a, const BlendSpaceSample& b) { return a.position.x < b.position.x; });
+
+	return addNode(node);
+}
+
+uint32_t BlendGraph::addBlendSpace2D(const std::vector<const SkeletalAnimation*>& clips, const std::vector<glm::vec2>& positions, uint32_t parameterX, uint32_t parameterY)
+{
+	if (clips.empty() || clips.size() != positions.size())
+		throw std::runtime_error("a blend space needs one position per clip !");
+	checkParameter(parameterX);
+	checkParameter(parameterY);
+
+	Node node;
+	node.type = BLEND_NODE_BLEND_SPACE_2D;
+	node.parameters[0] = parameterX;
+	node.parameters[1] = parameterY;
+	node.firstSample = static_cast<uint32_t>(samples.size());
+	node.sampleCount = static_cast<uint32_t>(clips.size());
+	for (size_t i = 0; i < clips.size(); i++)
+	{
+		checkClip(clips[i]);
+		samples.push_back(BlendSpaceSample{ clips[i], positions[i] });
+	}
+
+	return addNode(node);
+}
+
+uint32_t BlendGraph::addLayer(uint32_t base, uint32_t layer, uint32_t weightParameter, uint32_t boneMask)
+{
+	checkInput(base);
+	checkInput(layer);
+	checkParameter(weightParameter);
+	if (boneMask != NO_MASK && boneMask >= boneMasks.size())
+		throw std::runtime_error("unknown bone mask !");
+
+	Node node;
+	node.type = BLEND_NODE_LAYER;
+	node.inputs[0] = base;
+	node.inputs[1] = layer;
+	node.inputCount = 2;
+	node.parameters[0] = weightParameter;
+	node.boneMask = boneMask;
+	return addNode(node);
+}
+
+uint32_t BlendGraph::addAdditive(uint32_t base, uint32_t additive, uint32_t reference, uint32_t weightParameter, uint32_t boneMask)
+{
+	checkInput(base);
+	checkInput(additive);
+	checkInput(reference);
+	checkParameter(weightParameter);
+	if (boneMask != NO_MASK && boneMask >= boneMasks.size())
+		throw std::runtime_error("unknown bone mask !");
+
+	Node node;
+	node.type = BLEND_NODE_ADDITIVE;
+	node.inputs[0] = base;
+	node.inputs[1] = additive;
+	node.inputs[2] = reference;
+	node.inputCount = 3;
+	node.parameters[0] = weightParameter;
+	node.boneMask = boneMask;
+	return addNode(node);
+}
+
+void BlendGraph::assignPoseBuffers(uint32_t nodeIndex, std::vector<uint32_t>& freeBuffers)
+{
+	Node& node = nodes[nodeIndex];
+	for (uint32_t input = 0; input < node.inputCount; input++)
+		assignPoseBuffers(node.inputs[input], freeBuffers);
+
+	// the root writes in the pose given to the evaluation
+	// the others get a buffer while their inputs are still held, so it is never one of them
+	if (nodeIndex != getRootNode())
+	{
+		if (freeBuffers.empty())
+		{
+			node.poseBuffer = poseBufferCount++;
+		}
+		else
+		{
+			node.poseBuffer = freeBuffers.back();
+			freeBuffers.pop_back();
+		}
+	}
+
+	for (uint32_t input = 0; input < node.inputCount; input++)
+		freeBuffers.push_back(nodes[node.inputs[input]].poseBuffer);
+}
+
+void BlendGraph::build()
+{
+	if (nodes.empty())
+		throw std::runtime_error("a blend graph needs at least one node !");
+
+	// a tree : every node but the root is read by exactly one node
+	std::vector<uint32_t> readCounts(nodes.size(), 0);
+	for (const Node& node : nodes)
+	{
+		for (uint32_t input = 0; input < node.inputCount; input++)
+			readCounts[node.inputs[input]]++;
+	}
+	for (uint32_t nodeIndex = 0; nodeIndex < nodes.size(); nodeIndex++)
+	{
+		const uint32_t expectedCount = nodeIndex == getRootNode() ? 0 : 1;
+		if (readCounts[nodeIndex] != expectedCount)
+			throw std::runtime_error("blend graph nodes must be the input of exactly one node, except the root !");
+	}
+
+	poseBufferCount = 0;
+	std::vector<uint32_t> freeBuffers;
+	assignPoseBuffers(getRootNode(), freeBuffers);
+	built = true;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/////////// BlendGraphInstance
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void BlendGraphInstance::create(const BlendGraph& _graph)
+{
+	if (!_graph.isBuilt())
+		throw std::runtime_error("the blend graph must be built before its instances !");
+
+	graph = &_graph;
+
+	parameters.resize(graph->getParameterCount());
+	for (uint32_t parameterIndex = 0; parameterIndex < parameters.size(); parameterIndex++)
+	{
+		parameters[parameterIndex].value = graph->getParameterDefault(parameterIndex);
+		parameters[parameterIndex].target = parameters[parameterIndex].value;
+		parameters[parameterIndex].speed = 0.f;
+	}
+
+	nodeStates.assign(graph->getNodeCount(), NodeState());
+	sampleStates.assign(graph->getNodeCount() + graph->getSampleCount(), SampleState());
+
+	poses.resize(graph->getPoseBufferCount());
+	for (AnimationPose& pose : poses)
+		pose.resize(graph->getBoneCount());
+	samplePose.resize(graph->getBoneCount());
+
+	started = false;
+}
+
+void BlendGraphInstance::setParameter(uint32_t parameterIndex, float value)
+{
+	ParameterState& parameter = parameters[parameterIndex];
+	parameter.value = value;
+	parameter.target = value;
+	parameter.speed = 0.f;
+}
+
+void BlendGraphInstance::fadeParameter(uint32_t parameterIndex, float target, float duration)
+{
+	if (duration <= 0.f)
+	{
+		setParameter(parameterIndex, target);
+		return;
+	}
+
+	ParameterState& parameter = parameters[parameterIndex];
+	parameter.target = target;
+	parameter.speed = std::abs(target - parameter.value) / duration;
+}
+
+float BlendGraphInstance::getParameter(uint32_t parameterIndex) const
+{
+	return parameters[parameterIndex].value;
+}
+
+void BlendGraphInstance::setPhase(uint32_t nodeIndex, float phase)
+{
+	nodeStates[nodeIndex].phase = phase;
+}
+
+float BlendGraphInstance::getPhase(uint32_t nodeIndex) const
+{
+	return nodeStates[nodeIndex].phase;
+}
+
+float BlendGraphInstance::getWeight(uint32_t parameterIndex) const
+{
+	return glm::clamp(parameters[parameterIndex].value, 0.f, 1.f);
+}
+
+void BlendGraphInstance::computeBlendSpaceWeights(const BlendGraph::Node& node)
+{
+	SampleState* states = sampleStates.data() + graph->getNodeCount() + node.firstSample;
+	for (uint32_t i = 0; i < node.sampleCount; i++)
+		states[i].weight = 0.f;
+
+	if (node.sampleCount == 1)
+	{
+		states[0].weight = 1.f;
+		return;
+	}
+
+	if (node.type == BLEND_NODE_BLEND_SPACE_1D)
+	{
+		// samples are sorted, the parameter is clamped to their range
+		const float position = parameters[node.parameters[0]].value;
+		uint32_t segment = 0;
+		while (segment + 2 < node.sampleCount && graph->getSample(node.firstSample + segment + 1).position.x <= position)
+			segment++;
+
+		const float begin = graph->getSample(node.firstSample + segment).position.x;
+		const float end = graph->getSample(node.firstSample + segment + 1).position.x;
+		const float alpha = end > begin ? glm::clamp((position - begin) / (end - begin), 0.f, 1.f) : 0.f;
+		states[segment].weight = 1.f - alpha;
+		states[segment + 1].weight = alpha;
+		return;
+	}
+
+	// Gradient band interpolation : the influence of a sample decreases towards each other sample,
+	// it is 1 on the sample itself and 0 on the others whatever their layout.
+	const glm::vec2 position(parameters[node.parameters[0]].value, parameters[node.parameters[1]].value);
+	float weightSum = 0.f;
+	for (uint32_t i = 0; i < node.sampleCount; i++)
+	{
+		const glm::vec2 samplePosition = graph->getSample(node.firstSample + i).position;
+		float weight = 1.f;
+		for (uint32_t j = 0; j < node.sampleCount && weight > 0.f; j++)
+		{
+			if (j == i)
+				continue;
+
+			const glm::vec2 toOther = graph->getSample(node.firstSample + j).position - samplePosition;
+			const float lengthSquared = glm::dot(toOther, toOther);
+			if (lengthSquared > 0.f)
+				weight = std::min(weight, glm::clamp(1.f - glm::dot(position - samplePosition, toOther) / lengthSquared, 0.f, 1.f));
+		}
+		states[i].weight = weight;
+		weightSum += weight;
+	}
+
+	for (uint32_t i = 0; i < node.sampleCount; i++)
+		states[i].weight /= weightSum;
+}
+
+void BlendGraphInstance::advance(float deltaTime)
+{
+	for (ParameterState& parameter : parameters)
+	{
+		if (parameter.speed <= 0.f)
+			continue;
+
+		const float step = parameter.speed * deltaTime;
+		if (std::abs(parameter.target - parameter.value) <= step)
+		{
+			parameter.value = parameter.target;
+			parameter.speed = 0.f;
+		}
+		else
+		{
+			parameter.value += parameter.target > parameter.value ? step : -step;
+		}
+	}
+
+	for (uint32_t nodeIndex = 0; nodeIndex < graph->getNodeCount(); nodeIndex++)
+	{
+		const BlendGraph::Node& node = graph->getNode(nodeIndex);
+		NodeState& state = nodeStates[nodeIndex];
+
+		float duration = 0.f;
+		bool loop = true;
+		if (node.type == BLEND_NODE_CLIP)
+		{
+			duration = node.clip->getDuration() / (node.clip->getTickPerSecond() * node.playRate);
+			loop = node.loop;
+		}
+		else if (node.type == BLEND_NODE_BLEND_SPACE_1D || node.type == BLEND_NODE_BLEND_SPACE_2D)
+		{
+			// synchronized clips : the blend space lasts the weighted duration of its clips
+			computeBlendSpaceWeights(node);
+			const SampleState* states = sampleStates.data() + graph->getNodeCount() + node.firstSample;
+			for (uint32_t i = 0; i < node.sampleCount; i++)
+			{
+				const SkeletalAnimation* clip = graph->getSample(node.firstSample + i).clip;
+				duration += states[i].weight * clip->getDuration() / clip->getTickPerSecond();
+			}
+		}
+		else
+		{
+			continue;
+		}
+
+		if (!(duration > 0.f))
+			continue;
+
+		state.phase += deltaTime / duration;
+		state.phase = loop ? state.phase - std::floor(state.phase) : std::min(state.phase, 1.f);
+	}
+}
+
+void BlendGraphInstance::sampleClip(const SkeletalAnimation& clip, float phase, SampleState& sampleState, AnimationPose& outPose) const
+{
+	float keyAlpha = 0.f;
+	const uint32_t keyIndex = clip.findKeyIndex(phase * clip.getDuration(), sampleState.keyCursor, keyAlpha);
+	clip.samplePose(keyIndex, clip.getNextKeyIndex(keyIndex), keyAlpha, outPose);
+}
+
+void BlendGraphInstance::evaluateNode(uint32_t nodeIndex, AnimationPose& outPose)
+{
+	const BlendGraph::Node& node = graph->getNode(nodeIndex);
+	const float phase = nodeStates[nodeIndex].phase;
+
+	switch (node.type)
+	{
+	case BLEND_NODE_CLIP:
+		sampleClip(*node.clip, phase, sampleStates[nodeIndex], outPose);
+		break;
+
+	case BLEND_NODE_BLEND:
+	{
+		// a single branch is sampled at the ends of the blend
+		const float weight = getWeight(node.parameters[0]);
+		if (weight <= 0.f || weight >= 1.f)
+		{
+			AnimationPose& input = getInputPose(node, weight <= 0.f ? 0 : 1);
+			evaluateNode(node.inputs[weight <= 0.f ? 0 : 1], input);
+			outPose = input;
+		}
+		else
+		{
+			AnimationPose& from = getInputPose(node, 0);
+			AnimationPose& to = getInputPose(node, 1);
+			evaluateNode(node.inputs[0], from);
+			evaluateNode(node.inputs[1], to);
+			PoseBlending::blend(from, to, weight, nullptr, outPose);
+		}
+		break;
+	}
+
+	case BLEND_NODE_BLEND_SPACE_1D:
+	case BLEND_NODE_BLEND_SPACE_2D:
+	{
+		SampleState* states = sampleStates.data() + graph->getNodeCount() + node.firstSample;
+		uint32_t usedSampleCount = 0;
+		uint32_t lastUsedSample = 0;
+		for (uint32_t i = 0; i < node.sampleCount; i++)
+		{
+			if (states[i].weight > 0.f)
+			{
+				usedSampleCount++;
+				lastUsedSample = i;
+			}
+		}
+
+		if (usedSampleCount == 1)
+		{
+			sampleClip(*graph->getSample(node.firstSample + lastUsedSample).clip, phase, states[lastUsedSample], outPose);
+			break;
+		}
+
+		if (outPose.getBoneCount() != graph->getBoneCount())
+			outPose.resize(graph->getBoneCount());
+		PoseBlending::clearAccumulation(outPose);
+		for (uint32_t i = 0; i < node.sampleCount; i++)
+		{
+			if (states[i].weight <= 0.f)
+				continue;
+
+			sampleClip(*graph->getSample(node.firstSample + i).clip, phase, states[i], samplePose);
+			PoseBlending::accumulate(samplePose, states[i].weight, outPose);
+		}
+		PoseBlending::normalize(outPose);
+		break;
+	}
+
+	case BLEND_NODE_LAYER:
+	case BLEND_NODE_ADDITIVE:
+	{
+		AnimationPose& base = getInputPose(node, 0);
+		evaluateNode(node.inputs[0], base);
+
+		const float weight = getWeight(node.parameters[0]);
+		if (weight <= 0.f)
+		{
+			outPose = base;
+			break;
+		}
+
+		AnimationPose& layer = getInputPose(node, 1);
+		evaluateNode(node.inputs[1], layer);
+		if (node.type == BLEND_NODE_LAYER)
+		{
+			PoseBlending::blend(base, layer, weight, graph->getBoneMask(node.boneMask), outPose);
+		}
+		else
+		{
+			AnimationPose& reference = getInputPose(node, 2);
+			evaluateNode(node.inputs[2], reference);
+			PoseBlending::add(base, layer, reference, weight, graph->getBoneMask(node.boneMask), outPose);
+		}
+		break;
+	}
+	}
+}
+
+void BlendGraphInstance::evaluate(float time, AnimationPose& outPose)
+{
+	const float deltaTime = started ? std::max(time - lastTime, 0.f) : 0.f;
+	lastTime = time;
+	started = true;
+
+	advance(deltaTime);
+	evaluateNode(graph->getRootNode(), outPose);
+}
@@ -0,0 +1,260 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "AnimationPose.h"
+#include "SkeletalAnimation.h"
+#include "Skeleton.h"
+
+// Blending of whole poses in their structure of arrays layout, 4 bones per iteration with SSE.
+// Rotations are blended with a normalized lerp on the shortest path.
+// boneWeights are optional per bone factors of the weight (bone masks), padded like the pose streams.
+class PoseBlending
+{
+public:
+	// out = from blended towards to by weight, out can be from or to
+	static void blend(const AnimationPose& from, const AnimationPose& to, float weight, const float* boneWeights, AnimationPose& outPose);
+	// Apply the difference between pose and reference over base, in the bone local space :
+	// rotation = base * inverse(reference) * pose, translation = base + pose - reference. out can be base.
+	static void add(const AnimationPose& base, const AnimationPose& pose, const AnimationPose& reference, float weight, const float* boneWeights, AnimationPose& outPose);
+
+	// Weighted sum of any number of poses : clear, accumulate each pose, then normalize.
+	// The weights must sum to one.
+	static void clearAccumulation(AnimationPose& outAccumulation);
+	static void accumulate(const AnimationPose& pose, float weight, AnimationPose& inOutAccumulation);
+	static void normalize(AnimationPose& inOutAccumulation);
+
+	// reference versions, one bone at a time with the glm functions
+	static void blendReference(const AnimationPose& from, const AnimationPose& to, float weight, const float* boneWeights, AnimationPose& outPose);
+	static void addReference(const AnimationPose& base, const AnimationPose& pose, const AnimationPose& reference, float weight, const float* boneWeights, AnimationPose& outPose);
+
+	static const char* getInstructionSetName();
+};
+
+enum BlendNodeType
+{
+	// a clip played in loop or once
+	BLEND_NODE_CLIP,
+	// two inputs blended by a parameter, cross-fades fade this parameter
+	BLEND_NODE_BLEND,
+	// clips placed along one parameter, the two around the parameter are blended
+	BLEND_NODE_BLEND_SPACE_1D,
+	// clips placed on a plane of two parameters, weighted by gradient band interpolation
+	BLEND_NODE_BLEND_SPACE_2D,
+	// a second input over the base for the masked bones (ex : upper body)
+	BLEND_NODE_LAYER,
+	// the difference between an input and a reference input added over the base
+	BLEND_NODE_ADDITIVE
+};
+
+// Description of a blend tree for one skeleton, shared by all the instances playing it.
+// Nodes are added children first, each node is the input of a single other node and the root is the last node added.
+// build() assigns the pose buffers, the graph can't be modified afterwards.
+class BlendGraph
+{
+public:
+	static const uint32_t NO_MASK = ~0u;
+	static const uint32_t MAX_INPUTS = 3;
+
+	struct BlendSpaceSample
+	{
+		const SkeletalAnimation* clip;
+		glm::vec2 position;
+	};
+
+	struct Node
+	{
+		BlendNodeType type;
+		uint32_t inputs[MAX_INPUTS];
+		uint32_t inputCount = 0;
+		// weight parameter, or the blend space coordinates
+		uint32_t parameters[2];
+		uint32_t boneMask = NO_MASK;
+
+		// clip node
+		const SkeletalAnimation* clip = nullptr;
+		float playRate = 1.f;
+		bool loop = true;
+
+		// blend space nodes, range in the samples
+		uint32_t firstSample = 0;
+		uint32_t sampleCount = 0;
+
+		// pose written by the node, assigned by build()
+		uint32_t poseBuffer = 0;
+	};
+
+private:
+	uint32_t boneCount = 0;
+	uint32_t paddedBoneCount = 0;
+
+	std::vector<Node> nodes;
+	std::vector<BlendSpaceSample> samples;
+	std::vector<float> parameterDefaults;
+	// per bone weights of each mask, padded
+	std::vector<AnimationPose::StreamStorage> boneMasks;
+
+	uint32_t poseBufferCount = 0;
+	bool built = false;
+
+	uint32_t addNode(const Node& node);
+	void checkClip(const SkeletalAnimation* clip) const;
+	void checkInput(uint32_t nodeIndex) const;
+	void checkParameter(uint32_t parameterIndex) const;
+	void assignPoseBuffers(uint32_t nodeIndex, std::vector<uint32_t>& freeBuffers);
+
+public:
+	explicit BlendGraph(uint32_t _boneCount);
+
+	uint32_t addParameter(float defaultValue = 0.f);
+	// one weight per bone, from 0 (only the base) to 1
+	uint32_t addBoneMask(const std::vector<float>& boneWeights);
+	// the bone and all its children, the skeleton must be linearized (parents before their children)
+	uint32_t addBoneMask(const SkeletonData& skeleton, const std::string& rootBoneName, float weight = 1.f);
+
+	// playRate scales the clip speed, the clip is held on its last key when not looping
+	uint32_t addClip(const SkeletalAnimation* clip, float playRate = 1.f, bool loop = true);
+	uint32_t addBlend(uint32_t from, uint32_t to, uint32_t weightParameter);
+	// The clips of a blend space play in sync : they share a normalized time, advanced with the weighted clip durations.
+	// Samples can be given in any order.
+	uint32_t addBlendSpace1D(const std::vector<const SkeletalAnimation*>& clips, const std::vector<float>& positions, uint32_t parameter);
+	uint32_t addBlendSpace2D(const std::vector<const SkeletalAnimation*>& clips, const std::vector<glm::vec2>& positions, uint32_t parameterX, uint32_t parameterY);
+	uint32_t addLayer(uint32_t base, uint32_t layer, uint32_t weightParameter, uint32_t boneMask = NO_MASK);
+	// usually the additive input and its reference are the same clip, the reference sampled at a fixed phase
+	uint32_t addAdditive(uint32_t base, uint32_t additive, uint32_t reference, uint32_t weightParameter, uint32_t boneMask = NO_MASK);
+
+	// check the tree and assign the pose buffers, buffers are reused once their node has been read
+	void build();
+
+	// Getters
+	uint32_t getBoneCount() const
+	{
+		return boneCount;
+	}
+
+	uint32_t getNodeCount() const
+	{
+		return static_cast<uint32_t>(nodes.size());
+	}
+
+	uint32_t getRootNode() const
+	{
+		return static_cast<uint32_t>(nodes.size() - 1);
+	}
+
+	const Node& getNode(uint32_t nodeIndex) const
+	{
+		return nodes[nodeIndex];
+	}
+
+	uint32_t getSampleCount() const
+	{
+		return static_cast<uint32_t>(samples.size());
+	}
+
+	const BlendSpaceSample& getSample(uint32_t sampleIndex) const
+	{
+		return samples[sampleIndex];
+	}
+
+	uint32_t getParameterCount() const
+	{
+		return static_cast<uint32_t>(parameterDefaults.size());
+	}
+
+	float getParameterDefault(uint32_t parameterIndex) const
+	{
+		return parameterDefaults[parameterIndex];
+	}
+
+	const float* getBoneMask(uint32_t maskIndex) const
+	{
+		return maskIndex == NO_MASK ? nullptr : boneMasks[maskIndex].data();
+	}
+
+	uint32_t getPoseBufferCount() const
+	{
+		return poseBufferCount;
+	}
+
+	bool isBuilt() const
+	{
+		return built;
+	}
+};
+
+// State of a blend graph played by one skeleton instance : parameters, clip times and pose buffers.
+// Everything is allocated by create(), evaluate() never allocates.
+class BlendGraphInstance
+{
+private:
+	struct ParameterState
+	{
+		float value;
+		// the value moves towards the target at this speed per second, cross-fades are parameter fades
+		float target;
+		float speed = 0.f;
+	};
+
+	struct NodeState
+	{
+		// normalized time of clips and blend spaces
+		float phase = 0.f;
+	};
+
+	struct SampleState
+	{
+		float weight = 0.f;
+		uint32_t keyCursor = 0;
+	};
+
+	const BlendGraph* graph = nullptr;
+	std::vector<ParameterState> parameters;
+	std::vector<NodeState> nodeStates;
+	// clip nodes use the sample state of their index in the node array, then come the blend space samples
+	std::vector<SampleState> sampleStates;
+	std::vector<AnimationPose> poses;
+	// blend spaces sample their clips one after the other in it
+	AnimationPose samplePose;
+
+	float lastTime = 0.f;
+	bool started = false;
+
+	void advance(float deltaTime);
+	void computeBlendSpaceWeights(const BlendGraph::Node& node);
+	void sampleClip(const SkeletalAnimation& clip, float phase, SampleState& sampleState, AnimationPose& outPose) const;
+	// inputs are evaluated in their pose buffer, the node in outPose
+	void evaluateNode(uint32_t nodeIndex, AnimationPose& outPose);
+	float getWeight(uint32_t parameterIndex) const;
+
+	AnimationPose& getInputPose(const BlendGraph::Node& node, uint32_t input)
+	{
+		return poses[graph->getNode(node.inputs[input]).poseBuffer];
+	}
+
+public:
+	void create(const BlendGraph& _graph);
+
+	void setParameter(uint32_t parameterIndex, float value);
+	// Move the parameter to the target in duration seconds, over the next evaluations.
+	// A cross-fade is a fade of the weight of a blend node to 0 or 1.
+	void fadeParameter(uint32_t parameterIndex, float target, float duration);
+	float getParameter(uint32_t parameterIndex) const;
+
+	// restart a clip or a blend space from a normalized time
+	void setPhase(uint32_t nodeIndex, float phase);
+	float getPhase(uint32_t nodeIndex) const;
+
+	// Advance the clips and the fades to the time then write the pose of the root node.
+	// Branches with a zero weight are not sampled, their clips still advance.
+	void evaluate(float time, AnimationPose& outPose);
+
+	const BlendGraph* getGraph() const
+	{
+		return graph;
+	}
+};
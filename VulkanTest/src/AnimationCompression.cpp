@@ -0,0 +1,156 @@
+#include "AnimationCompression.h"
+
+#include <cfloat>
+#include <stdexcept>
+
+namespace
+{
+	// Distance between two bone transforms, the rotation error is the chord on a circle of radius virtualVertexDistance.
+	// The sine of the half angle is the length of the vector part of the relative rotation,
+	// unlike 1 - dot it stays accurate in float for small angles.
+	float computeBoneError(const glm::quat& rotation, const glm::vec3& translation, const glm::quat& referenceRotation, const glm::vec3& referenceTranslation, float virtualVertexDistance)
+	{
+		const glm::vec3 axis(rotation.x, rotation.y, rotation.z);
+		const glm::vec3 referenceAxis(referenceRotation.x, referenceRotation.y, referenceRotation.z);
+		const float sinHalfAngle = glm::length(referenceRotation.w * axis - rotation.w * referenceAxis - glm::cross(referenceAxis, axis));
+		const float rotationError = 2.f * virtualVertexDistance * sinHalfAngle;
+		return rotationError + glm::length(translation - referenceTranslation);
+	}
+
+	glm::quat interpolateRotation(const glm::quat& from, glm::quat to, float alpha, RotationInterpolation interpolation)
+	{
+		if (interpolation == ROTATION_INTERPOLATION_SLERP)
+			return glm::slerp(from, to, alpha);
+
+		if (glm::dot(from, to) < 0.f)
+			to = -to;
+		return glm::normalize(from * (1.f - alpha) + to * alpha);
+	}
+}
+
+void AnimationCompressor::compress(const SkeletalAnimation& source, const AnimationCompressionSettings& settings, SkeletalAnimation& outCompressed, AnimationCompressionReport* outReport)
+{
+	if (source.isCompressed())
+		throw std::runtime_error("the animation is already compressed !");
+
+	const uint32_t keyCount = source.getKeyCount();
+	const uint32_t boneCount = source.getBoneCount();
+	const uint32_t paddedBoneCount = source.paddedBoneCount;
+
+	// translation range of each bone over the clip
+	AnimationPose::StreamStorage translationRanges(SkeletalAnimation::TRANSLATION_RANGE_STREAM_COUNT * paddedBoneCount, 0.f);
+	for (uint32_t boneIndex = 0; boneIndex < boneCount; boneIndex++)
+	{
+		glm::vec3 rangeMin(FLT_MAX);
+		glm::vec3 rangeMax(-FLT_MAX);
+		for (uint32_t keyIndex = 0; keyIndex < keyCount; keyIndex++)
+		{
+			rangeMin = glm::min(rangeMin, source.getTranslation(boneIndex, keyIndex));
+			rangeMax = glm::max(rangeMax, source.getTranslation(boneIndex, keyIndex));
+		}
+
+		for (uint32_t axis = 0; axis < 3; axis++)
+		{
+			translationRanges[(SkeletalAnimation::TRANSLATION_RANGE_MIN_X + axis) * paddedBoneCount + boneIndex] = rangeMin[axis];
+			translationRanges[(SkeletalAnimation::TRANSLATION_RANGE_EXTENT_X + axis) * paddedBoneCount + boneIndex] = rangeMax[axis] - rangeMin[axis];
+		}
+	}
+
+	// quantize every key, the error is measured on what the runtime decompresses
+	std::vector<uint16_t> quantizedKeys(keyCount * SkeletalAnimation::COMPRESSED_STREAM_COUNT * paddedBoneCount, 0);
+	std::vector<glm::quat> decodedRotations(keyCount * boneCount);
+	std::vector<glm::vec3> decodedTranslations(keyCount * boneCount);
+	for (uint32_t keyIndex = 0; keyIndex < keyCount; keyIndex++)
+	{
+		uint16_t* keyData = quantizedKeys.data() + keyIndex * SkeletalAnimation::COMPRESSED_STREAM_COUNT * paddedBoneCount;
+		for (uint32_t boneIndex = 0; boneIndex < paddedBoneCount; boneIndex++)
+		{
+			// padding bones are identity rotations
+			const bool isPadding = boneIndex >= boneCount;
+
+			uint16_t words[3];
+			packSmallestThree(isPadding ? glm::quat(1.f, 0.f, 0.f, 0.f) : source.getRotation(boneIndex, keyIndex), words);
+			for (uint32_t i = 0; i < 3; i++)
+				keyData[(SkeletalAnimation::COMPRESSED_STREAM_ROTATION_0 + i) * paddedBoneCount + boneIndex] = words[i];
+			if (isPadding)
+				continue;
+
+			const glm::vec3 translation = source.getTranslation(boneIndex, keyIndex);
+			glm::vec3 decodedTranslation;
+			for (uint32_t axis = 0; axis < 3; axis++)
+			{
+				const float rangeMin = translationRanges[(SkeletalAnimation::TRANSLATION_RANGE_MIN_X + axis) * paddedBoneCount + boneIndex];
+				const float rangeExtent = translationRanges[(SkeletalAnimation::TRANSLATION_RANGE_EXTENT_X + axis) * paddedBoneCount + boneIndex];
+				const uint16_t word = quantizeRangeNormalized(translation[axis], rangeMin, rangeExtent);
+				keyData[(SkeletalAnimation::COMPRESSED_STREAM_TRANSLATION_X + axis) * paddedBoneCount + boneIndex] = word;
+				decodedTranslation[axis] = dequantizeRangeNormalized(word, rangeMin, rangeExtent);
+			}
+
+			decodedRotations[keyIndex * boneCount + boneIndex] = unpackSmallestThree(words);
+			decodedTranslations[keyIndex * boneCount + boneIndex] = decodedTranslation;
+		}
+	}
+
+	const std::vector<float>& keysTime = source.getKeysTime();
+
+	// largest error of the original keys between two kept keys, when rebuilt by interpolation
+	// stops as soon as the error is above stopAbove
+	auto computeSegmentError = [&](uint32_t firstKeyIndex, uint32_t lastKeyIndex, float stopAbove)
+	{
+		float segmentError = 0.f;
+		for (uint32_t keyIndex = firstKeyIndex; keyIndex <= lastKeyIndex; keyIndex++)
+		{
+			const float keyDuration = keysTime[lastKeyIndex] - keysTime[firstKeyIndex];
+			const float alpha = keyDuration > 0.f ? (keysTime[keyIndex] - keysTime[firstKeyIndex]) / keyDuration : 0.f;
+			for (uint32_t boneIndex = 0; boneIndex < boneCount; boneIndex++)
+			{
+				const glm::quat rotation = interpolateRotation(decodedRotations[firstKeyIndex * boneCount + boneIndex], decodedRotations[lastKeyIndex * boneCount + boneIndex], alpha, settings.interpolation);
+				const glm::vec3 translation = glm::mix(decodedTranslations[firstKeyIndex * boneCount + boneIndex], decodedTranslations[lastKeyIndex * boneCount + boneIndex], alpha);
+				segmentError = std::max(segmentError, computeBoneError(rotation, translation, source.getRotation(boneIndex, keyIndex), source.getTranslation(boneIndex, keyIndex), settings.virtualVertexDistance));
+				if (segmentError > stopAbove)
+					return segmentError;
+			}
+		}
+		return segmentError;
+	};
+
+	// greedy key reduction : a key is removed while its neighbours still rebuild every skipped key within the tolerance
+	std::vector<uint32_t> keptKeys;
+	keptKeys.push_back(0);
+	for (uint32_t keyIndex = 1; keyIndex + 1 < keyCount; keyIndex++)
+	{
+		if (computeSegmentError(keptKeys.back(), keyIndex + 1, settings.maxError) > settings.maxError)
+			keptKeys.push_back(keyIndex);
+	}
+	if (keyCount > 1)
+		keptKeys.push_back(keyCount - 1);
+
+	outCompressed.duration = source.duration;
+	outCompressed.ticksPerSecond = source.ticksPerSecond;
+	outCompressed.boneCount = boneCount;
+	outCompressed.paddedBoneCount = paddedBoneCount;
+	outCompressed.compressed = true;
+	outCompressed.keyStreams.clear();
+	outCompressed.keyStreams.shrink_to_fit();
+	outCompressed.translationRanges = std::move(translationRanges);
+
+	const size_t keySize = SkeletalAnimation::COMPRESSED_STREAM_COUNT * paddedBoneCount;
+	outCompressed.keysTime.resize(keptKeys.size());
+	outCompressed.compressedKeyStreams.resize(keptKeys.size() * keySize);
+	for (size_t i = 0; i < keptKeys.size(); i++)
+	{
+		outCompressed.keysTime[i] = keysTime[keptKeys[i]];
+		std::copy(quantizedKeys.begin() + keptKeys[i] * keySize, quantizedKeys.begin() + (keptKeys[i] + 1) * keySize, outCompressed.compressedKeyStreams.begin() + i * keySize);
+	}
+
+	if (outReport)
+	{
+		outReport->keyCount = keyCount;
+		outReport->compressedKeyCount = static_cast<uint32_t>(keptKeys.size());
+		outReport->memorySize = source.getMemorySize();
+		outReport->compressedMemorySize = outCompressed.getMemorySize();
+		outReport->maxError = keyCount == 1 ? computeSegmentError(0, 0, FLT_MAX) : 0.f;
+		for (size_t i = 0; i + 1 < keptKeys.size(); i++)
+			outReport->maxError = std::max(outReport->maxError, computeSegmentError(keptKeys[i], keptKeys[i + 1], FLT_MAX));
+	}
+}
@@ -0,0 +1,122 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+#include "SkeletalAnimation.h"
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/////////// Quantization
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Smallest three rotation on 48 bits : the largest component is dropped and rebuilt from the unit length,
+// the three others are in [-1/sqrt(2), 1/sqrt(2)] and stored on 15 bits each.
+// The 2 bits index of the dropped component are the high bits of the first two words.
+const float SMALLEST_THREE_RANGE = 0.70710678118654752f;
+const uint32_t SMALLEST_THREE_MAX_VALUE = 0x7FFF;
+
+inline uint16_t quantizeSmallestThreeComponent(float value)
+{
+	const float normalized = glm::clamp((value + SMALLEST_THREE_RANGE) / (2.f * SMALLEST_THREE_RANGE), 0.f, 1.f);
+	return static_cast<uint16_t>(normalized * SMALLEST_THREE_MAX_VALUE + 0.5f);
+}
+
+inline float dequantizeSmallestThreeComponent(uint16_t value)
+{
+	return (value & SMALLEST_THREE_MAX_VALUE) * (2.f * SMALLEST_THREE_RANGE / SMALLEST_THREE_MAX_VALUE) - SMALLEST_THREE_RANGE;
+}
+
+inline void packSmallestThree(const glm::quat& rotation, uint16_t outWords[3])
+{
+	const float components[4] = { rotation.x, rotation.y, rotation.z, rotation.w };
+
+	uint32_t largestIndex = 0;
+	for (uint32_t i = 1; i < 4; i++)
+	{
+		if (std::fabs(components[i]) > std::fabs(components[largestIndex]))
+			largestIndex = i;
+	}
+
+	// q and -q are the same rotation, the dropped component is always positive
+	const float sign = components[largestIndex] < 0.f ? -1.f : 1.f;
+	uint32_t wordIndex = 0;
+	for (uint32_t i = 0; i < 4; i++)
+	{
+		if (i != largestIndex)
+			outWords[wordIndex++] = quantizeSmallestThreeComponent(components[i] * sign);
+	}
+
+	outWords[0] |= static_cast<uint16_t>((largestIndex & 1) << 15);
+	outWords[1] |= static_cast<uint16_t>((largestIndex >> 1) << 15);
+}
+
+inline glm::quat unpackSmallestThree(const uint16_t words[3])
+{
+	const uint32_t largestIndex = (words[0] >> 15) | ((words[1] >> 15) << 1);
+	const float a = dequantizeSmallestThreeComponent(words[0]);
+	const float b = dequantizeSmallestThreeComponent(words[1]);
+	const float c = dequantizeSmallestThreeComponent(words[2]);
+	const float largest = std::sqrt(std::max(0.f, 1.f - a * a - b * b - c * c));
+
+	switch (largestIndex)
+	{
+	case 0:
+		return glm::quat(c, largest, a, b);
+	case 1:
+		return glm::quat(c, a, largest, b);
+	case 2:
+		return glm::quat(c, a, b, largest);
+	default:
+		return glm::quat(largest, a, b, c);
+	}
+}
+
+// translations are stored relative to the range of each bone
+inline uint16_t quantizeRangeNormalized(float value, float rangeMin, float rangeExtent)
+{
+	if (rangeExtent <= 0.f)
+		return 0;
+	return static_cast<uint16_t>(glm::clamp((value - rangeMin) / rangeExtent, 0.f, 1.f) * 65535.f + 0.5f);
+}
+
+inline float dequantizeRangeNormalized(uint16_t value, float rangeMin, float rangeExtent)
+{
+	return rangeMin + value * (rangeExtent / 65535.f);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/////////// AnimationCompressor
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+struct AnimationCompressionSettings
+{
+	// maximum distance between a compressed and an original bone, in bone space and model units
+	float maxError = 0.001f;
+	// rotation errors are measured on a point at this distance from the bone, usually the radius of the skinned mesh
+	float virtualVertexDistance = 1.f;
+	// error estimated with the interpolation used at runtime
+	RotationInterpolation interpolation = ROTATION_INTERPOLATION_NLERP;
+};
+
+struct AnimationCompressionReport
+{
+	uint32_t keyCount = 0;
+	uint32_t compressedKeyCount = 0;
+	size_t memorySize = 0;
+	size_t compressedMemorySize = 0;
+	// largest error over all the original keys, measured as in the settings
+	float maxError = 0.f;
+};
+
+// Offline compression of a clip :
+// keys are quantized, then the keys the interpolation of their neighbours rebuilds within the tolerance are removed.
+// The clip is then 12 bytes per bone and per remaining key, instead of 28.
+class AnimationCompressor
+{
+public:
+	static void compress(const SkeletalAnimation& source, const AnimationCompressionSettings& settings, SkeletalAnimation& outCompressed, AnimationCompressionReport* outReport = nullptr);
+};
@@ -0,0 +1,168 @@
+#include "AnimationFile.h"
+#include "MappedFile.h"
+#include "SkeletalAnimation.h"
+
+#include <algorithm>
+#include <fstream>
+#include <stdexcept>
+
+namespace
+{
+	uint64_t alignOffset(uint64_t offset)
+	{
+		return (offset + ANIMATION_FILE_BLOB_ALIGNMENT - 1) / ANIMATION_FILE_BLOB_ALIGNMENT * ANIMATION_FILE_BLOB_ALIGNMENT;
+	}
+
+	bool isRangeInside(uint64_t offset, uint64_t size, size_t fileSize)
+	{
+		return offset <= fileSize && size <= fileSize - offset;
+	}
+
+	uint64_t getTranslationRangesSize(uint32_t paddedBoneCount)
+	{
+		return uint64_t(SkeletalAnimation::TRANSLATION_RANGE_STREAM_COUNT) * paddedBoneCount * sizeof(float);
+	}
+
+	uint64_t getKeyStreamsSize(uint32_t keyCount, uint32_t paddedBoneCount)
+	{
+		return uint64_t(keyCount) * SkeletalAnimation::COMPRESSED_STREAM_COUNT * paddedBoneCount * sizeof(uint16_t);
+	}
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/////////// AnimationFileView
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void AnimationFileView::open(const char* fileData, size_t fileSize)
+{
+	data = nullptr;
+	header = nullptr;
+
+	if (fileSize < sizeof(AnimationFileHeader))
+		throw std::runtime_error("animation file is too small !");
+
+	const AnimationFileHeader* fileHeader = reinterpret_cast<const AnimationFileHeader*>(fileData);
+	if (fileHeader->magic != ANIMATION_FILE_MAGIC)
+		throw std::runtime_error("not a compressed animation file !");
+	if (fileHeader->version != ANIMATION_FILE_VERSION)
+		throw std::runtime_error("animation file version not supported, the clip must be compressed again !");
+	if (fileHeader->keyCount == 0)
+		throw std::runtime_error("animation file without key !");
+	if (fileHeader->paddedBoneCount != AnimationPose::computePaddedBoneCount(fileHeader->boneCount))
+		throw std::runtime_error("invalid bone count in animation file !");
+	if (fileHeader->keyStreamsSize != getKeyStreamsSize(fileHeader->keyCount, fileHeader->paddedBoneCount))
+		throw std::runtime_error("inconsistent key streams size in animation file !");
+
+	if (!isRangeInside(fileHeader->keysTimeOffset, uint64_t(fileHeader->keyCount) * sizeof(float), fileSize)
+		|| !isRangeInside(fileHeader->translationRangesOffset, getTranslationRangesSize(fileHeader->paddedBoneCount), fileSize)
+		|| !isRangeInside(fileHeader->keyStreamsOffset, fileHeader->keyStreamsSize, fileSize))
+		throw std::runtime_error("truncated animation file !");
+
+	// the tables are read in place
+	if (fileHeader->keysTimeOffset % alignof(float) != 0 || fileHeader->translationRangesOffset % alignof(float) != 0
+		|| fileHeader->keyStreamsOffset % ANIMATION_FILE_BLOB_ALIGNMENT != 0)
+		throw std::runtime_error("misaligned tables in animation file !");
+
+	// the key search relies on sorted times
+	const float* keysTime = reinterpret_cast<const float*>(fileData + fileHeader->keysTimeOffset);
+	if (!std::is_sorted(keysTime, keysTime + fileHeader->keyCount))
+		throw std::runtime_error("animation keys must be sorted by time !");
+
+	data = fileData;
+	header = fileHeader;
+}
+
+void AnimationFileView::open(const MappedFile& file)
+{
+	open(file.getData(), file.getSize());
+}
+
+const AnimationFileHeader& AnimationFileView::getHeader() const
+{
+	return *header;
+}
+
+uint32_t AnimationFileView::getBoneCount() const
+{
+	return header->boneCount;
+}
+
+uint32_t AnimationFileView::getPaddedBoneCount() const
+{
+	return header->paddedBoneCount;
+}
+
+uint32_t AnimationFileView::getKeyCount() const
+{
+	return header->keyCount;
+}
+
+float AnimationFileView::getDuration() const
+{
+	return header->duration;
+}
+
+float AnimationFileView::getTicksPerSecond() const
+{
+	return header->ticksPerSecond;
+}
+
+const float* AnimationFileView::getKeysTime() const
+{
+	return reinterpret_cast<const float*>(data + header->keysTimeOffset);
+}
+
+const float* AnimationFileView::getTranslationRanges() const
+{
+	return reinterpret_cast<const float*>(data + header->translationRangesOffset);
+}
+
+const uint16_t* AnimationFileView::getKeyStreams() const
+{
+	return reinterpret_cast<const uint16_t*>(data + header->keyStreamsOffset);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/////////// AnimationFileWriter
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void AnimationFileWriter::write(const std::string& path, const SkeletalAnimation& clip)
+{
+	if (!clip.compressed)
+		throw std::runtime_error("only compressed animations can be written to a file !");
+
+	AnimationFileHeader header = {};
+	header.magic = ANIMATION_FILE_MAGIC;
+	header.version = ANIMATION_FILE_VERSION;
+	header.boneCount = clip.boneCount;
+	header.paddedBoneCount = clip.paddedBoneCount;
+	header.keyCount = static_cast<uint32_t>(clip.keysTime.size());
+	header.duration = clip.duration;
+	header.ticksPerSecond = clip.ticksPerSecond;
+
+	header.keysTimeOffset = sizeof(AnimationFileHeader);
+	header.translationRangesOffset = header.keysTimeOffset + clip.keysTime.size() * sizeof(float);
+	header.keyStreamsOffset = alignOffset(header.translationRangesOffset + getTranslationRangesSize(clip.paddedBoneCount));
+	header.keyStreamsSize = getKeyStreamsSize(header.keyCount, clip.paddedBoneCount);
+
+	std::ofstream file(path, std::ios::binary | std::ios::trunc);
+	if (!file.is_open())
+		throw std::runtime_error("failed to create animation file " + path + " !");
+
+	const char padding[ANIMATION_FILE_BLOB_ALIGNMENT] = {};
+	auto padTo = [&](uint64_t offset)
+	{
+		const uint64_t current = static_cast<uint64_t>(file.tellp());
+		file.write(padding, static_cast<std::streamsize>(offset - current));
+	};
+
+	file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	file.write(reinterpret_cast<const char*>(clip.keysTime.data()), clip.keysTime.size() * sizeof(float));
+	file.write(reinterpret_cast<const char*>(clip.translationRanges.data()), getTranslationRangesSize(clip.paddedBoneCount));
+
+	padTo(header.keyStreamsOffset);
+	file.write(reinterpret_cast<const char*>(clip.compressedKeyStreams.data()), header.keyStreamsSize);
+
+	if (!file.good())
+		throw std::runtime_error("failed to write animation file " + path + " !");
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+class MappedFile;
+class SkeletalAnimation;
+
+// Compressed animation clip file, all offsets are given from the start of the file :
+//	AnimationFileHeader
+//	float keysTime[keyCount]
+//	float translation ranges[TRANSLATION_RANGE_STREAM_COUNT * paddedBoneCount]
+//	quantized key streams, aligned on ANIMATION_FILE_BLOB_ALIGNMENT
+// The tables have the exact layout of the SkeletalAnimation storage so they are copied as is.
+// Values are stored with the endianness of the writing platform.
+
+#define ANIMATION_FILE_MAGIC 0x4D494E41u // "ANIM"
+#define ANIMATION_FILE_VERSION 1
+#define ANIMATION_FILE_BLOB_ALIGNMENT 16
+
+struct AnimationFileHeader
+{
+	uint32_t magic;
+	uint32_t version;
+	uint32_t boneCount;
+	uint32_t paddedBoneCount;
+	uint32_t keyCount;
+	uint32_t reserved;
+	float duration;
+	float ticksPerSecond;
+	uint64_t keysTimeOffset;
+	uint64_t translationRangesOffset;
+	uint64_t keyStreamsOffset;
+	uint64_t keyStreamsSize;
+};
+
+// the layout of the file must not depend on the compiler
+static_assert(sizeof(AnimationFileHeader) == 64, "unexpected AnimationFileHeader padding !");
+
+// Read access to a compressed clip, pointing directly inside the file memory : nothing is copied
+// and the view is only valid while the memory is.
+class AnimationFileView
+{
+private:
+	const char* data = nullptr;
+	const AnimationFileHeader* header = nullptr;
+
+public:
+	// check the header, the table ranges and the key times, throw if the data is not a valid compressed clip
+	void open(const char* fileData, size_t fileSize);
+	void open(const MappedFile& file);
+
+	const AnimationFileHeader& getHeader() const;
+	uint32_t getBoneCount() const;
+	uint32_t getPaddedBoneCount() const;
+	uint32_t getKeyCount() const;
+	float getDuration() const;
+	float getTicksPerSecond() const;
+
+	const float* getKeysTime() const;
+	const float* getTranslationRanges() const;
+	const uint16_t* getKeyStreams() const;
+};
+
+class AnimationFileWriter
+{
+public:
+	// only clips built by the AnimationCompressor can be written, throw otherwise or if the file can't be written
+	static void write(const std::string& path, const SkeletalAnimation& clip);
+};
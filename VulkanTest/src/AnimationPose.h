@@ -0,0 +1,103 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include <algorithm>
+#include <vector>
+
+#include "AlignedAllocator.h"
+
+struct BoneTransform
+{
+	glm::vec3 position;
+	glm::quat rotation;
+};
+
+// Local transforms of all the bones of a skeleton, stored as structure of arrays :
+// one stream per rotation and translation component, so a block of bones is processed with a few SIMD instructions.
+// Streams are 16 bytes aligned and padded to a multiple of the block size with identity transforms.
+class AnimationPose
+{
+public:
+	static const uint32_t BLOCK_SIZE = 4;
+
+	enum Stream
+	{
+		STREAM_ROTATION_X,
+		STREAM_ROTATION_Y,
+		STREAM_ROTATION_Z,
+		STREAM_ROTATION_W,
+		STREAM_TRANSLATION_X,
+		STREAM_TRANSLATION_Y,
+		STREAM_TRANSLATION_Z,
+		STREAM_COUNT
+	};
+
+	typedef std::vector<float, AlignedAllocator<float, 16>> StreamStorage;
+
+private:
+	StreamStorage streams;
+	uint32_t boneCount = 0;
+	uint32_t paddedBoneCount = 0;
+
+public:
+	static uint32_t computePaddedBoneCount(uint32_t boneCount)
+	{
+		return (boneCount + BLOCK_SIZE - 1) / BLOCK_SIZE * BLOCK_SIZE;
+	}
+
+	// the pose is reset to identity
+	void resize(uint32_t _boneCount)
+	{
+		boneCount = _boneCount;
+		paddedBoneCount = computePaddedBoneCount(_boneCount);
+		streams.resize(STREAM_COUNT * paddedBoneCount);
+		setIdentity();
+	}
+
+	void setIdentity()
+	{
+		std::fill(streams.begin(), streams.end(), 0.f);
+		std::fill(streams.begin() + STREAM_ROTATION_W * paddedBoneCount, streams.begin() + (STREAM_ROTATION_W + 1) * paddedBoneCount, 1.f);
+	}
+
+	float* getStream(Stream stream)
+	{
+		return streams.data() + stream * paddedBoneCount;
+	}
+
+	const float* getStream(Stream stream) const
+	{
+		return streams.data() + stream * paddedBoneCount;
+	}
+
+	BoneTransform getBoneTransform(uint32_t boneIndex) const
+	{
+		BoneTransform boneTransform;
+		boneTransform.rotation = glm::quat(getStream(STREAM_ROTATION_W)[boneIndex], getStream(STREAM_ROTATION_X)[boneIndex], getStream(STREAM_ROTATION_Y)[boneIndex], getStream(STREAM_ROTATION_Z)[boneIndex]);
+		boneTransform.position = glm::vec3(getStream(STREAM_TRANSLATION_X)[boneIndex], getStream(STREAM_TRANSLATION_Y)[boneIndex], getStream(STREAM_TRANSLATION_Z)[boneIndex]);
+		return boneTransform;
+	}
+
+	void setBoneTransform(uint32_t boneIndex, const BoneTransform& boneTransform)
+	{
+		getStream(STREAM_ROTATION_X)[boneIndex] = boneTransform.rotation.x;
+		getStream(STREAM_ROTATION_Y)[boneIndex] = boneTransform.rotation.y;
+		getStream(STREAM_ROTATION_Z)[boneIndex] = boneTransform.rotation.z;
+		getStream(STREAM_ROTATION_W)[boneIndex] = boneTransform.rotation.w;
+		getStream(STREAM_TRANSLATION_X)[boneIndex] = boneTransform.position.x;
+		getStream(STREAM_TRANSLATION_Y)[boneIndex] = boneTransform.position.y;
+		getStream(STREAM_TRANSLATION_Z)[boneIndex] = boneTransform.position.z;
+	}
+
+	uint32_t getBoneCount() const
+	{
+		return boneCount;
+	}
+
+	uint32_t getPaddedBoneCount() const
+	{
+		return paddedBoneCount;
+	}
+};
@@ -0,0 +1,172 @@
+#include "AnimationSystem.h"
+
+#include <stdexcept>
+
+const uint32_t AnimationSystem::MAX_UPDATE_PERIOD;
+
+namespace
+{
+	// inOutTransforms += (targetTransforms - inOutTransforms) * alpha, row by row
+	void moveTowards(BoneMatrix* inOutTransforms, const BoneMatrix* targetTransforms, uint32_t boneCount, float alpha)
+	{
+		for (uint32_t boneIndex = 0; boneIndex < boneCount; boneIndex++)
+		{
+			BoneMatrix& transform = inOutTransforms[boneIndex];
+			const BoneMatrix& targetTransform = targetTransforms[boneIndex];
+			for (uint32_t row = 0; row < 3; row++)
+				transform.rows[row] += (targetTransform.rows[row] - transform.rows[row]) * alpha;
+		}
+	}
+}
+
+uint32_t AnimationSystem::addInstance(SkeletonInstanceData* skeletonInstance, const SkeletalAnimationInstance& animation)
+{
+	if (skeletonInstance == nullptr || skeletonInstance->skeletonData == nullptr || animation.getAnimation() == nullptr)
+		throw std::runtime_error("an animated instance needs a skeleton and an animation !");
+
+	const uint32_t boneCount = skeletonInstance->skeletonData->getBoneCount();
+	if (animation.getAnimation()->getBoneCount() != boneCount)
+		throw std::runtime_error("the animation and the skeleton have different bone counts !");
+
+	// all the storage is allocated here, the updates never allocate
+	skeletonInstance->localPose.resize(boneCount);
+	skeletonInstance->modelTransforms.resize(boneCount);
+
+	AnimatedInstance instance;
+	instance.skeletonInstance = skeletonInstance;
+	instance.animation = animation;
+	instance.targetModelTransforms.resize(boneCount);
+	instances.push_back(std::move(instance));
+
+	return static_cast<uint32_t>(instances.size() - 1);
+}
+
+uint32_t AnimationSystem::addInstance(SkeletonInstanceData* skeletonInstance, BlendGraphInstance* blendGraph)
+{
+	if (skeletonInstance == nullptr || skeletonInstance->skeletonData == nullptr || blendGraph == nullptr || blendGraph->getGraph() == nullptr)
+		throw std::runtime_error("an animated instance needs a skeleton and a created blend graph instance !");
+
+	const uint32_t boneCount = skeletonInstance->skeletonData->getBoneCount();
+	if (blendGraph->getGraph()->getBoneCount() != boneCount)
+		throw std::runtime_error("the blend graph and the skeleton have different bone counts !");
+
+	skeletonInstance->localPose.resize(boneCount);
+	skeletonInstance->modelTransforms.resize(boneCount);
+
+	AnimatedInstance instance;
+	instance.skeletonInstance = skeletonInstance;
+	instance.blendGraph = blendGraph;
+	instance.targetModelTransforms.resize(boneCount);
+	instances.push_back(std::move(instance));
+
+	return static_cast<uint32_t>(instances.size() - 1);
+}
+
+void AnimationSystem::clear()
+{
+	instances.clear();
+}
+
+uint32_t AnimationSystem::computeUpdatePeriod(const AnimatedInstance& instance) const
+{
+	const float distance = glm::length(instance.position - updateViewPosition);
+	if (distance < settings.fullRateDistance)
+		return 1;
+	if (distance < settings.halfRateDistance)
+		return 2;
+	return MAX_UPDATE_PERIOD;
+}
+
+void AnimationSystem::samplePose(AnimatedInstance& instance, AnimationPose& outPose) const
+{
+	if (instance.blendGraph != nullptr)
+		instance.blendGraph->evaluate(updateTime, outPose);
+	else
+		instance.animation.samplePose(updateTime, outPose);
+}
+
+void AnimationSystem::updateInstance(uint32_t instanceIndex, AnimationUpdateStats& outStats)
+{
+	AnimatedInstance& instance = instances[instanceIndex];
+	SkeletonInstanceData& skeletonInstance = *instance.skeletonInstance;
+	const SkeletonData& skeletonData = *skeletonInstance.skeletonData;
+
+	if (settings.skipInvisible && !instance.visible)
+	{
+		instance.hasPose = false;
+		outStats.skippedCount++;
+		return;
+	}
+
+	if (!instance.hasPose)
+	{
+		// nothing to interpolate from, evaluated directly in the displayed pose
+		samplePose(instance, skeletonInstance.localPose);
+		Skeleton::computeModelTransforms(skeletonData, skeletonInstance.localPose, skeletonInstance.modelTransforms.data());
+		// the first update is spread over the period so far instances don't all evaluate in the same frame
+		instance.framesUntilUpdate = 1 + instanceIndex % computeUpdatePeriod(instance);
+		instance.hasPose = true;
+		instance.interpolating = false;
+		outStats.evaluatedCount++;
+		return;
+	}
+
+	if (instance.framesUntilUpdate <= 1)
+	{
+		// the displayed pose reached the last evaluation, it moves to the new one over the period
+		instance.framesUntilUpdate = computeUpdatePeriod(instance);
+		instance.interpolating = instance.framesUntilUpdate > 1;
+		outStats.evaluatedCount++;
+
+		if (!instance.interpolating)
+		{
+			samplePose(instance, skeletonInstance.localPose);
+			Skeleton::computeModelTransforms(skeletonData, skeletonInstance.localPose, skeletonInstance.modelTransforms.data());
+			return;
+		}
+
+		samplePose(instance, skeletonInstance.localPose);
+		Skeleton::computeModelTransforms(skeletonData, skeletonInstance.localPose, instance.targetModelTransforms.data());
+	}
+	else
+	{
+		instance.framesUntilUpdate--;
+		if (instance.interpolating)
+			outStats.interpolatedCount++;
+	}
+
+	// Moving by 1 / framesUntilUpdate of what is left gives about the same steps as an interpolation from the previous evaluation,
+	// without keeping it. The last frame before the next update displays the evaluation exactly.
+	// The matrices are blended directly, a few multiply adds per bone instead of a sampling and a pass through the hierarchy :
+	// the bones may shrink a little when they turn fast, not visible at the distances using a lower rate.
+	if (instance.interpolating)
+	{
+		const float alpha = 1.f / instance.framesUntilUpdate;
+		moveTowards(skeletonInstance.modelTransforms.data(), instance.targetModelTransforms.data(), skeletonData.getBoneCount(), alpha);
+	}
+}
+
+void AnimationSystem::update(float time, const glm::vec3& viewPosition, WorkerThreadPool& workerThreadPool)
+{
+	updateTime = time;
+	updateViewPosition = viewPosition;
+
+	threadStats.resize(workerThreadPool.getThreadCount());
+	for (ThreadStats& threadStat : threadStats)
+		threadStat.stats = AnimationUpdateStats();
+
+	workerThreadPool.parallelFor(static_cast<uint32_t>(instances.size()), settings.batchSize, [this](uint32_t begin, uint32_t end, uint32_t threadIndex)
+	{
+		AnimationUpdateStats& batchStats = threadStats[threadIndex].stats;
+		for (uint32_t instanceIndex = begin; instanceIndex < end; instanceIndex++)
+			updateInstance(instanceIndex, batchStats);
+	});
+
+	stats = AnimationUpdateStats();
+	for (const ThreadStats& threadStat : threadStats)
+	{
+		stats.evaluatedCount += threadStat.stats.evaluatedCount;
+		stats.interpolatedCount += threadStat.stats.interpolatedCount;
+		stats.skippedCount += threadStat.stats.skippedCount;
+	}
+}
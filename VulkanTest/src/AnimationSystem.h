@@ -0,0 +1,131 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
+#include "AlignedAllocator.h"
+#include "AnimationBlending.h"
+#include "Skeleton.h"
+#include "WorkerThreadPool.h"
+
+struct AnimationUpdateSettings
+{
+	// instances closer than this to the view are evaluated every frame
+	float fullRateDistance = 15.f;
+	// then every 2 frames up to this distance, every 4 frames beyond
+	float halfRateDistance = 40.f;
+	// invisible instances keep their last pose and are evaluated again once visible
+	bool skipInvisible = true;
+	// instances per batch given to a thread
+	uint32_t batchSize = 8;
+};
+
+struct AnimationUpdateStats
+{
+	// instances sampled then evaluated through the hierarchy
+	uint32_t evaluatedCount = 0;
+	// instances interpolated between two evaluations
+	uint32_t interpolatedCount = 0;
+	uint32_t skippedCount = 0;
+};
+
+// Updates the model transforms of all the animated skeleton instances, in parallel batches.
+// Far instances are evaluated at a lower rate : between two evaluations their model transforms move towards those
+// of the last one without sampling nor going through the hierarchy, so they lag by up to 3 frames but move every frame.
+// Instances only touch their own data, a batch never waits for another one.
+class AnimationSystem
+{
+public:
+	static const uint32_t MAX_UPDATE_PERIOD = 4;
+
+private:
+	struct AnimatedInstance
+	{
+		SkeletonInstanceData* skeletonInstance;
+		SkeletalAnimationInstance animation;
+		// played instead of the animation when set
+		BlendGraphInstance* blendGraph = nullptr;
+		glm::vec3 position = glm::vec3(0.f);
+		bool visible = true;
+
+		// frames before the next evaluation
+		uint32_t framesUntilUpdate = 0;
+		// false until the first evaluation and after being skipped, the next evaluation is then not interpolated
+		bool hasPose = false;
+		bool interpolating = false;
+
+		// model transforms of the last evaluation, reached by the displayed ones the frame before the next evaluation
+		BoneMatrixStorage targetModelTransforms;
+	};
+
+	// padded to a cache line so the threads don't share one
+	struct ThreadStats
+	{
+		AnimationUpdateStats stats;
+		uint8_t padding[64 - sizeof(AnimationUpdateStats)];
+	};
+
+	std::vector<AnimatedInstance> instances;
+	std::vector<ThreadStats, AlignedAllocator<ThreadStats, 64>> threadStats;
+	AnimationUpdateSettings settings;
+	AnimationUpdateStats stats;
+
+	// parameters of the running update, read by the batches
+	float updateTime = 0.f;
+	glm::vec3 updateViewPosition;
+
+	uint32_t computeUpdatePeriod(const AnimatedInstance& instance) const;
+	void samplePose(AnimatedInstance& instance, AnimationPose& outPose) const;
+	void updateInstance(uint32_t instanceIndex, AnimationUpdateStats& outStats);
+
+public:
+	void setSettings(const AnimationUpdateSettings& _settings)
+	{
+		settings = _settings;
+	}
+
+	const AnimationUpdateSettings& getSettings() const
+	{
+		return settings;
+	}
+
+	// The instance is evaluated with the animation from the next update, return its index.
+	// The skeleton instance must stay alive and is written by the update only.
+	uint32_t addInstance(SkeletonInstanceData* skeletonInstance, const SkeletalAnimationInstance& animation);
+	// same for an instance driven by a blend graph, its parameters can be changed between the updates
+	uint32_t addInstance(SkeletonInstanceData* skeletonInstance, BlendGraphInstance* blendGraph);
+	void clear();
+
+	// world position, used to choose the update rate
+	void setPosition(uint32_t instanceIndex, const glm::vec3& position)
+	{
+		instances[instanceIndex].position = position;
+	}
+
+	void setVisible(uint32_t instanceIndex, bool visible)
+	{
+		instances[instanceIndex].visible = visible;
+	}
+
+	void setAnimation(uint32_t instanceIndex, const SkeletalAnimationInstance& animation)
+	{
+		instances[instanceIndex].animation = animation;
+	}
+
+	uint32_t getInstanceCount() const
+	{
+		return static_cast<uint32_t>(instances.size());
+	}
+
+	// Update every instance for the time, once per frame.
+	// The model transforms of each skeleton instance are ready when it returns.
+	void update(float time, const glm::vec3& viewPosition, WorkerThreadPool& workerThreadPool);
+
+	// counts of the last update
+	const AnimationUpdateStats& getStats() const
+	{
+		return stats;
+	}
+};
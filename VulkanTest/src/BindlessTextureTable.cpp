@@ -0,0 +1,260 @@
+#include "BindlessTextureTable.h"
+#include "VulkanUtils.h"
+
+#include <algorithm>
+
+BindlessTextureTable::BindlessTextureTable()
+	: owningDevice(VK_NULL_HANDLE)
+	, descriptorSetLayout(VK_NULL_HANDLE)
+	, descriptorPool(VK_NULL_HANDLE)
+	, descriptorSet(VK_NULL_HANDLE)
+	, capacity(0)
+	, usedSlotCount(0)
+	, currentFrame(0)
+{}
+
+BindlessTextureTable::~BindlessTextureTable()
+{
+	destroy();
+}
+
+bool BindlessTextureTable::isSupported(VkPhysicalDevice physicalDevice)
+{
+	std::vector<const char*> requiredExtensions;
+	appendRequiredDeviceExtensions(requiredExtensions);
+	if (!checkDeviceExtensionSupport(physicalDevice, requiredExtensions))
+		return false;
+
+	VkPhysicalDeviceDescriptorIndexingFeaturesEXT indexingFeatures = {};
+	indexingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT;
+
+	VkPhysicalDeviceFeatures2 features = {};
+	features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+	features.pNext = &indexingFeatures;
+	vkGetPhysicalDeviceFeatures2(physicalDevice, &features);
+
+	return indexingFeatures.shaderSampledImageArrayNonUniformIndexing
+		&& indexingFeatures.runtimeDescriptorArray
+		&& indexingFeatures.descriptorBindingPartiallyBound
+		&& indexingFeatures.descriptorBindingVariableDescriptorCount
+		&& indexingFeatures.descriptorBindingSampledImageUpdateAfterBind;
+}
+
+void BindlessTextureTable::appendRequiredDeviceExtensions(std::vector<const char*>& outExtensions)
+{
+	outExtensions.push_back(VK_KHR_MAINTENANCE3_EXTENSION_NAME);
+	outExtensions.push_back(VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME);
+}
+
+void BindlessTextureTable::create(VkPhysicalDevice physicalDevice, VkDevice device, uint32_t frameCount, uint32_t requestedCapacity)
+{
+	owningDevice = device;
+
+	// clamp the capacity to the device limits
+	VkPhysicalDeviceDescriptorIndexingPropertiesEXT indexingProperties = {};
+	indexingProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_PROPERTIES_EXT;
+
+	VkPhysicalDeviceProperties2 properties = {};
+	properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+	properties.pNext = &indexingProperties;
+	vkGetPhysicalDeviceProperties2(physicalDevice, &properties);
+
+	capacity = std::min(requestedCapacity, indexingProperties.maxDescriptorSetUpdateAfterBindSampledImages);
+	capacity = std::min(capacity, indexingProperties.maxPerStageDescriptorUpdateAfterBindSampledImages);
+	usedSlotCount = 0;
+	freeSlots.clear();
+	pendingFreeSlotsPerFrame.assign(frameCount, std::vector<uint32_t>());
+	currentFrame = 0;
+	freeSlots.clear();
+
+	// layout
+	{
+		VkDescriptorSetLayoutBinding binding = {};
+		binding.binding = 0;
+		binding.descriptorCount = capacity;
+		binding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		binding.pImmutableSamplers = nullptr;
+		binding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
+
+		VkDescriptorBindingFlagsEXT bindingFlags = VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT_EXT
+			| VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT_EXT
+			| VK_DESCRIPTOR_BINDING_VARIABLE_DESCRIPTOR_COUNT_BIT_EXT;
+
+		VkDescriptorSetLayoutBindingFlagsCreateInfoEXT bindingFlagsInfo = {};
+		bindingFlagsInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO_EXT;
+		bindingFlagsInfo.bindingCount = 1;
+		bindingFlagsInfo.pBindingFlags = &bindingFlags;
+
+		VkDescriptorSetLayoutCreateInfo layoutInfo = {};
+		layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+		layoutInfo.pNext = &bindingFlagsInfo;
+		layoutInfo.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT_EXT;
+		layoutInfo.bindingCount = 1;
+		layoutInfo.pBindings = &binding;
+
+		if (vkCreateDescriptorSetLayout(owningDevice, &layoutInfo, nullptr, &descriptorSetLayout) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create bindless descriptor set layout !");
+		}
+	}
+
+	// pool
+	{
+		VkDescriptorPoolSize poolSize = { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, capacity };
+
+		VkDescriptorPoolCreateInfo poolInfo = {};
+		poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+		poolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT_EXT;
+		poolInfo.poolSizeCount = 1;
+		poolInfo.pPoolSizes = &poolSize;
+		poolInfo.maxSets = 1;
+
+		if (vkCreateDescriptorPool(owningDevice, &poolInfo, nullptr, &descriptorPool) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create bindless descriptor pool !");
+		}
+	}
+
+	// set
+	{
+		VkDescriptorSetVariableDescriptorCountAllocateInfoEXT variableCountInfo = {};
+		variableCountInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_VARIABLE_DESCRIPTOR_COUNT_ALLOCATE_INFO_EXT;
+		variableCountInfo.descriptorSetCount = 1;
+		variableCountInfo.pDescriptorCounts = &capacity;
+
+		VkDescriptorSetAllocateInfo allocInfo = {};
+		allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+		allocInfo.pNext = &variableCountInfo;
+		allocInfo.descriptorPool = descriptorPool;
+		allocInfo.descriptorSetCount = 1;
+		allocInfo.pSetLayouts = &descriptorSetLayout;
+
+		if (vkAllocateDescriptorSets(owningDevice, &allocInfo, &descriptorSet) != VK_SUCCESS) {
+			throw std::runtime_error("failed to allocate bindless descriptor set !");
+		}
+	}
+}
+
+void BindlessTextureTable::destroy()
+{
+	if (owningDevice == VK_NULL_HANDLE)
+		return;
+
+	// destroying the pool free the set
+	vkDestroyDescriptorPool(owningDevice, descriptorPool, nullptr);
+	vkDestroyDescriptorSetLayout(owningDevice, descriptorSetLayout, nullptr);
+
+	descriptorPool = VK_NULL_HANDLE;
+	descriptorSetLayout = VK_NULL_HANDLE;
+	descriptorSet = VK_NULL_HANDLE;
+	owningDevice = VK_NULL_HANDLE;
+}
+
+uint32_t BindlessTextureTable::registerImage(const VkDescriptorImageInfo& imageInfo)
+{
+	uint32_t index;
+	if (!freeSlots.empty())
+	{
+		index = freeSlots.back();
+		freeSlots.pop_back();
+	}
+	else
+	{
+		CHECK_TRUE_THROW_ERROR(usedSlotCount < capacity, "bindless texture table is full !");
+		index = usedSlotCount;
+		usedSlotCount++;
+	}
+
+	updateImage(index, imageInfo);
+
+	return index;
+}
+
+void BindlessTextureTable::updateImage(uint32_t index, const VkDescriptorImageInfo& imageInfo)
+{
+	VkWriteDescriptorSet descriptorSetWrite = {};
+	descriptorSetWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	descriptorSetWrite.dstSet = descriptorSet;
+	descriptorSetWrite.dstBinding = 0;
+	descriptorSetWrite.dstArrayElement = index;
+	descriptorSetWrite.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	descriptorSetWrite.descriptorCount = 1;
+	descriptorSetWrite.pImageInfo = &imageInfo;
+
+	vkUpdateDescriptorSets(owningDevice, 1, &descriptorSetWrite, 0, nullptr);
+}
+
+void BindlessTextureTable::beginFrame(uint32_t frameIndex)
+{
+	currentFrame = frameIndex % pendingFreeSlotsPerFrame.size();
+
+	std::vector<uint32_t>& pendingFreeSlots = pendingFreeSlotsPerFrame[currentFrame];
+	freeSlots.insert(freeSlots.end(), pendingFreeSlots.begin(), pendingFreeSlots.end());
+	pendingFreeSlots.clear();
+}
+
+void BindlessTextureTable::unregisterImage(uint32_t index)
+{
+	// The slot is partially bound : its old descriptor stays until the slot is reused.
+	// It can't be rewritten before the frames which may sample it are done, the current one included,
+	// so it waits for the next time this frame slot begins.
+	pendingFreeSlotsPerFrame[currentFrame].push_back(index);
+}
+
+void BindlessTextureTable::cmdBind(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, uint32_t setIndex) const
+{
+	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, setIndex, 1, &descriptorSet, 0, nullptr);
+}
+
+VkDescriptorSetLayout BindlessTextureTable::getDescriptorSetLayout() const
+{
+	return descriptorSetLayout;
+}
+
+uint32_t BindlessTextureTable::getCapacity() const
+{
+	return capacity;
+}
+
+uint32_t BindlessTextureTable::getUsedSlotCount() const
+{
+	return usedSlotCount - static_cast<uint32_t>(freeSlots.size());
+}
+
+VkPushConstantRange BindlessTextureTable::getPushConstantRange()
+{
+	VkPushConstantRange range = {};
+	range.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+	range.offset = 0;
+	range.size = sizeof(BindlessTextureIndices);
+
+	return range;
+}
+
+void BindlessTextureTable::mergePushConstantRange(std::vector<VkPushConstantRange>& inOutRanges)
+{
+	const VkPushConstantRange indicesRange = getPushConstantRange();
+	for (auto& range : inOutRanges)
+	{
+		if ((range.stageFlags & indicesRange.stageFlags) == 0)
+			continue;
+
+		const uint32_t end = std::max(range.offset + range.size, indicesRange.offset + indicesRange.size);
+		range.offset = std::min(range.offset, indicesRange.offset);
+		range.size = end - range.offset;
+		return;
+	}
+
+	inOutRanges.push_back(indicesRange);
+}
+
+VkShaderStageFlags BindlessTextureTable::getPushConstantStages(const std::vector<VkPushConstantRange>& ranges)
+{
+	const VkPushConstantRange indicesRange = getPushConstantRange();
+	VkShaderStageFlags stages = indicesRange.stageFlags;
+	for (const auto& range : ranges)
+	{
+		if (range.offset < indicesRange.offset + indicesRange.size && indicesRange.offset < range.offset + range.size)
+			stages |= range.stageFlags;
+	}
+
+	return stages;
+}
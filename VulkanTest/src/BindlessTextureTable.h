@@ -0,0 +1,71 @@
+#pragma once
+
+#include <vulkan/vulkan.hpp>
+
+#include <vector>
+
+// Maximum textures a material instance can reference in bindless mode.
+// Their table indices are given to the fragment shader as push constants.
+#define BINDLESS_MAX_TEXTURES_PER_MATERIAL 8
+
+struct BindlessTextureIndices
+{
+	uint32_t indices[BINDLESS_MAX_TEXTURES_PER_MATERIAL];
+};
+
+// All sampled images live in one runtime sized array of combined image samplers (descriptor indexing).
+// The set is bound once per material, materials reference their textures by index.
+// Slots are updated after bind, so textures can be added while command buffers using the table are pending.
+class BindlessTextureTable
+{
+private:
+	VkDevice owningDevice;
+
+	VkDescriptorSetLayout descriptorSetLayout;
+	VkDescriptorPool descriptorPool;
+	VkDescriptorSet descriptorSet;
+
+	uint32_t capacity;
+	uint32_t usedSlotCount;
+	std::vector<uint32_t> freeSlots;
+	// slots unregistered during each frame slot, pending frames may still sample them
+	std::vector<std::vector<uint32_t>> pendingFreeSlotsPerFrame;
+	uint32_t currentFrame;
+
+public:
+	BindlessTextureTable();
+	~BindlessTextureTable();
+
+	// check the device exposes everything needed by the table
+	static bool isSupported(VkPhysicalDevice physicalDevice);
+	// device extensions to enable when the table is used
+	static void appendRequiredDeviceExtensions(std::vector<const char*>& outExtensions);
+
+	void create(VkPhysicalDevice physicalDevice, VkDevice device, uint32_t frameCount, uint32_t requestedCapacity = 4096);
+	void destroy();
+
+	// Called once the fence of the frame slot is signaled : the slots unregistered
+	// the last time this frame slot was used can be reused.
+	void beginFrame(uint32_t frameIndex);
+
+	// return the index of the image inside the table
+	uint32_t registerImage(const VkDescriptorImageInfo& imageInfo);
+	void updateImage(uint32_t index, const VkDescriptorImageInfo& imageInfo);
+	// the slot is reused once the frames submitted until now are done
+	void unregisterImage(uint32_t index);
+
+	void cmdBind(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, uint32_t setIndex) const;
+
+	// Getters
+	VkDescriptorSetLayout getDescriptorSetLayout() const;
+	uint32_t getCapacity() const;
+	uint32_t getUsedSlotCount() const;
+
+	static VkPushConstantRange getPushConstantRange();
+	// Make the ranges of a pipeline layout cover the indices for the fragment stage : the range
+	// of the fragment stage is grown over them, or the indices range is added if the stage has none.
+	// (a stage can only appear in one range of a layout)
+	static void mergePushConstantRange(std::vector<VkPushConstantRange>& inOutRanges);
+	// stages to push the indices with : the fragment stage and the stages of all the ranges overlapping them
+	static VkShaderStageFlags getPushConstantStages(const std::vector<VkPushConstantRange>& ranges);
+};
@@ -0,0 +1,90 @@
+#include "BonePalette.h"
+
+#include <stdexcept>
+
+BonePaletteBuffer::BonePaletteBuffer()
+	: boneCount(0)
+{}
+
+BonePaletteBuffer::~BonePaletteBuffer()
+{
+	destroy();
+}
+
+void BonePaletteBuffer::create(VkPhysicalDevice physicalDevice, VkDevice device, uint32_t frameCount, uint32_t _boneCapacity)
+{
+	owningDevice = device;
+	boneCapacity = _boneCapacity;
+
+	frames.resize(frameCount);
+	for (auto& frame : frames)
+	{
+		BufferCreateInfo createInfo = BufferCreateInfo::makeNotAligned(physicalDevice, device, boneCapacity, sizeof(BoneMatrix), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+		frame.buffer.create(createInfo, false);
+
+		// host coherent, stays mapped for the palette lifetime
+		frame.mappedBones = static_cast<BoneMatrix*>(frame.buffer.map());
+		if (frame.mappedBones == nullptr)
+			throw std::runtime_error("failed to map bone palette buffer !");
+	}
+
+	beginFrame(0);
+}
+
+void BonePaletteBuffer::destroy()
+{
+	if (owningDevice == VK_NULL_HANDLE)
+		return;
+
+	for (auto& frame : frames)
+	{
+		frame.buffer.destroy();
+	}
+	frames.clear();
+	owningDevice = VK_NULL_HANDLE;
+}
+
+void BonePaletteBuffer::beginFrame(uint32_t frameIndex)
+{
+	currentFrame = frameIndex % frames.size();
+	boneCount = 0;
+}
+
+uint32_t BonePaletteBuffer::allocate(uint32_t instanceBoneCount, BoneMatrix*& outBones)
+{
+	const uint32_t boneOffset = boneCount.fetch_add(instanceBoneCount);
+	if (boneOffset + instanceBoneCount > boneCapacity)
+		throw std::runtime_error("bone palette buffer is full !");
+
+	outBones = frames[currentFrame].mappedBones + boneOffset;
+	return boneOffset;
+}
+
+uint32_t BonePaletteBuffer::write(const SkeletonInstanceData& skeletonInstance)
+{
+	const SkeletonData& skeletonData = *skeletonInstance.skeletonData;
+
+	BoneMatrix* bones = nullptr;
+	const uint32_t boneOffset = allocate(skeletonData.getBoneCount(), bones);
+	Skeleton::computeSkinningTransforms(skeletonData, skeletonInstance.modelTransforms.data(), bones);
+	return boneOffset;
+}
+
+VkDescriptorBufferInfo BonePaletteBuffer::getDescriptorBufferInfo() const
+{
+	VkDescriptorBufferInfo bufferInfo = {};
+	bufferInfo.buffer = *frames[currentFrame].buffer.getBufferHandle();
+	bufferInfo.offset = 0;
+	bufferInfo.range = VK_WHOLE_SIZE;
+	return bufferInfo;
+}
+
+uint32_t BonePaletteBuffer::getWrittenSize() const
+{
+	return boneCount * static_cast<uint32_t>(sizeof(BoneMatrix));
+}
+
+uint32_t BonePaletteBuffer::getBoneCapacity() const
+{
+	return boneCapacity;
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <vulkan/vulkan.hpp>
+
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+#include "Buffer.h"
+#include "Skeleton.h"
+
+// Skinning matrices of all the skinned instances of a frame, packed in a single storage buffer.
+// Each instance writes its bones at a base offset and only passes this offset to its material input datas,
+// the vertex shader reads bones[boneOffset + vertexBoneIndex] :
+// layout(set = 2, binding = 1, std430) readonly buffer BonePalette { mat3x4 bones[]; }; position = vec4(p, 1) * bones[i];
+// Materials bind it in their skeletal mesh renderable set (MATERIAL_RENDERABLE_BINDING_BONE_PALETTE).
+// Each frame slot owns a persistently mapped buffer, recycled every frameCount frames like
+// the staging buffers of the MaterialParameterUploader.
+class BonePaletteBuffer
+{
+private:
+	struct FrameResources
+	{
+		Buffer buffer;
+		BoneMatrix* mappedBones = nullptr;
+	};
+
+	VkDevice owningDevice = VK_NULL_HANDLE;
+	uint32_t boneCapacity = 0;
+	std::vector<FrameResources> frames;
+
+	uint32_t currentFrame = 0;
+	// bones written in the current frame slot, instances can reserve their range from several threads
+	std::atomic<uint32_t> boneCount;
+
+public:
+	BonePaletteBuffer();
+	~BonePaletteBuffer();
+
+	void create(VkPhysicalDevice physicalDevice, VkDevice device, uint32_t frameCount, uint32_t _boneCapacity = 32 * 1024);
+	void destroy();
+
+	// The bones written from now go to this frame slot. Called by Renderer::beginFrame() once the fence
+	// of the slot is signaled, so the previous bones it contained are not used by the GPU anymore.
+	void beginFrame(uint32_t frameIndex);
+
+	// Reserve the bones of an instance in this frame, return the base offset and the mapped matrices to write.
+	// Thread safe.
+	uint32_t allocate(uint32_t instanceBoneCount, BoneMatrix*& outBones);
+	// write the skinning transforms of a skeleton instance, return the base offset
+	uint32_t write(const SkeletonInstanceData& skeletonInstance);
+
+	// buffer of the current frame slot, to bind in the descriptor set of this frame
+	VkDescriptorBufferInfo getDescriptorBufferInfo() const;
+
+	// bytes written in the current frame slot
+	uint32_t getWrittenSize() const;
+	uint32_t getBoneCapacity() const;
+};
@@ -0,0 +1,656 @@
+#include "BoundingVolumeHierarchy.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <stdexcept>
+
+const int32_t BoundingVolumeHierarchy::NULL_NODE;
+const int32_t BoundingVolumeHierarchy::FREE_NODE_HEIGHT;
+
+namespace
+{
+	const uint32_t SAH_BIN_COUNT = 16;
+
+	AABB mergeBoxes(const AABB& a, const AABB& b)
+	{
+		AABB box = a;
+		box.merge(b);
+		return box;
+	}
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/////////// Node allocation
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int32_t BoundingVolumeHierarchy::allocateNode()
+{
+	int32_t nodeIndex;
+	if (freeList != NULL_NODE)
+	{
+		nodeIndex = freeList;
+		freeList = nodes[nodeIndex].parent;
+	}
+	else
+	{
+		nodeIndex = static_cast<int32_t>(nodes.size());
+		nodes.push_back(Node());
+	}
+
+	nodes[nodeIndex] = Node();
+	return nodeIndex;
+}
+
+void BoundingVolumeHierarchy::freeNode(int32_t nodeIndex)
+{
+	// a free node looks like a leaf, the height tells them apart
+	nodes[nodeIndex] = Node();
+	nodes[nodeIndex].parent = freeList;
+	nodes[nodeIndex].height = FREE_NODE_HEIGHT;
+	freeList = nodeIndex;
+}
+
+void BoundingVolumeHierarchy::checkProxy(int32_t proxy) const
+{
+	if (proxy < 0 || proxy >= static_cast<int32_t>(nodes.size()) || nodes[proxy].isFree() || !nodes[proxy].isLeaf())
+		throw std::runtime_error("invalid bounding volume hierarchy proxy !");
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/////////// Build
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void BoundingVolumeHierarchy::build(const AABB* boxes, const uint32_t* userIndices, uint32_t count, std::vector<int32_t>& outProxies)
+{
+	clear();
+	nodes.reserve(2 * count);
+
+	outProxies.resize(count);
+	for (uint32_t i = 0; i < count; i++)
+	{
+		const int32_t leaf = allocateNode();
+		nodes[leaf].box = boxes[i];
+		nodes[leaf].userIndex = userIndices[i];
+		outProxies[i] = leaf;
+	}
+	leafCount = count;
+
+	if (count == 0)
+		return;
+
+	scratchNodes = outProxies;
+	prepareBuildCenters();
+	root = buildTopDown();
+}
+
+void BoundingVolumeHierarchy::rebuild()
+{
+	if (root == NULL_NODE)
+		return;
+
+	// keep the leaves, free the internal nodes
+	scratchNodes.clear();
+	traversalStack.clear();
+	traversalStack.push_back(root);
+	while (!traversalStack.empty())
+	{
+		const int32_t nodeIndex = traversalStack.back();
+		traversalStack.pop_back();
+
+		if (nodes[nodeIndex].isLeaf())
+		{
+			scratchNodes.push_back(nodeIndex);
+		}
+		else
+		{
+			traversalStack.push_back(nodes[nodeIndex].child1);
+			traversalStack.push_back(nodes[nodeIndex].child2);
+			freeNode(nodeIndex);
+		}
+	}
+
+	prepareBuildCenters();
+	root = buildTopDown();
+}
+
+void BoundingVolumeHierarchy::prepareBuildCenters()
+{
+	// the internal nodes allocated by the build can't go past twice the leaf count
+	buildCenters.resize(std::max(nodes.size(), 2 * scratchNodes.size()));
+	for (int32_t leaf : scratchNodes)
+		buildCenters[leaf] = nodes[leaf].box.getCenter();
+}
+
+// Top down build with an explicit stack of leaf ranges, so degenerate trees can't overflow the call stack.
+// Internal nodes are created before their children : their boxes and heights are computed afterwards, in reverse order.
+int32_t BoundingVolumeHierarchy::buildTopDown()
+{
+	buildInternalNodes.clear();
+	buildTasks.clear();
+	buildTasks.push_back(BuildTask{ 0, static_cast<uint32_t>(scratchNodes.size()), NULL_NODE });
+
+	int32_t buildRoot = NULL_NODE;
+	while (!buildTasks.empty())
+	{
+		const BuildTask task = buildTasks.back();
+		buildTasks.pop_back();
+
+		int32_t nodeIndex;
+		if (task.leafCount == 1)
+		{
+			nodeIndex = scratchNodes[task.firstLeaf];
+		}
+		else
+		{
+			int32_t* leaves = scratchNodes.data() + task.firstLeaf;
+			const uint32_t leftCount = splitLeaves(leaves, task.leafCount);
+
+			nodeIndex = allocateNode();
+			buildInternalNodes.push_back(nodeIndex);
+
+			// the second range is pushed first so the first one becomes child1
+			buildTasks.push_back(BuildTask{ task.firstLeaf + leftCount, task.leafCount - leftCount, nodeIndex });
+			buildTasks.push_back(BuildTask{ task.firstLeaf, leftCount, nodeIndex });
+		}
+
+		nodes[nodeIndex].parent = task.parent;
+		if (task.parent == NULL_NODE)
+			buildRoot = nodeIndex;
+		else if (nodes[task.parent].child1 == NULL_NODE)
+			nodes[task.parent].child1 = nodeIndex;
+		else
+			nodes[task.parent].child2 = nodeIndex;
+	}
+
+	for (auto it = buildInternalNodes.rbegin(); it != buildInternalNodes.rend(); ++it)
+	{
+		Node& node = nodes[*it];
+		node.box = mergeBoxes(nodes[node.child1].box, nodes[node.child2].box);
+		node.height = 1 + std::max(nodes[node.child1].height, nodes[node.child2].height);
+	}
+
+	return buildRoot;
+}
+
+// The leaves are split along the longest axis of their centers,
+// at the bin boundary minimizing area(left) * count(left) + area(right) * count(right).
+uint32_t BoundingVolumeHierarchy::splitLeaves(int32_t* leaves, uint32_t count)
+{
+	glm::vec3 centerMin = buildCenters[leaves[0]];
+	glm::vec3 centerMax = centerMin;
+	for (uint32_t i = 1; i < count; i++)
+	{
+		const glm::vec3& center = buildCenters[leaves[i]];
+		centerMin = glm::min(centerMin, center);
+		centerMax = glm::max(centerMax, center);
+	}
+
+	const glm::vec3 centerExtent = centerMax - centerMin;
+	int axis = 0;
+	if (centerExtent.y > centerExtent[axis])
+		axis = 1;
+	if (centerExtent.z > centerExtent[axis])
+		axis = 2;
+
+	uint32_t leftCount = 0;
+	if (centerExtent[axis] > 0.f)
+	{
+		AABB binBoxes[SAH_BIN_COUNT];
+		uint32_t binCounts[SAH_BIN_COUNT] = {};
+		const float binScale = SAH_BIN_COUNT / centerExtent[axis];
+		auto getBin = [&](int32_t leaf)
+		{
+			const float offset = buildCenters[leaf][axis] - centerMin[axis];
+			return std::min(SAH_BIN_COUNT - 1, static_cast<uint32_t>(offset * binScale));
+		};
+
+		for (uint32_t i = 0; i < count; i++)
+		{
+			const uint32_t bin = getBin(leaves[i]);
+			binBoxes[bin] = binCounts[bin] == 0 ? nodes[leaves[i]].box : mergeBoxes(binBoxes[bin], nodes[leaves[i]].box);
+			binCounts[bin]++;
+		}
+
+		// right side costs, then sweep from the left
+		float rightCosts[SAH_BIN_COUNT] = {};
+		AABB rightBox;
+		uint32_t rightCount = 0;
+		for (uint32_t bin = SAH_BIN_COUNT - 1; bin > 0; bin--)
+		{
+			if (binCounts[bin] > 0)
+			{
+				rightBox = rightCount == 0 ? binBoxes[bin] : mergeBoxes(rightBox, binBoxes[bin]);
+				rightCount += binCounts[bin];
+			}
+			rightCosts[bin] = rightCount == 0 ? 0.f : rightBox.getSurfaceArea() * rightCount;
+		}
+
+		float bestCost = FLT_MAX;
+		uint32_t bestSplit = 0;
+		AABB leftBox;
+		uint32_t sweptCount = 0;
+		for (uint32_t bin = 0; bin < SAH_BIN_COUNT - 1; bin++)
+		{
+			if (binCounts[bin] > 0)
+			{
+				leftBox = sweptCount == 0 ? binBoxes[bin] : mergeBoxes(leftBox, binBoxes[bin]);
+				sweptCount += binCounts[bin];
+			}
+
+			if (sweptCount == 0 || sweptCount == count)
+				continue;
+
+			const float cost = leftBox.getSurfaceArea() * sweptCount + rightCosts[bin + 1];
+			if (cost < bestCost)
+			{
+				bestCost = cost;
+				bestSplit = bin;
+			}
+		}
+
+		if (bestCost < FLT_MAX)
+		{
+			int32_t* middle = std::partition(leaves, leaves + count, [&](int32_t leaf) { return getBin(leaf) <= bestSplit; });
+			leftCount = static_cast<uint32_t>(middle - leaves);
+		}
+	}
+
+	// all the centers at the same place : split in the middle
+	if (leftCount == 0 || leftCount == count)
+		leftCount = count / 2;
+
+	return leftCount;
+}
+
+void BoundingVolumeHierarchy::clear()
+{
+	nodes.clear();
+	root = NULL_NODE;
+	freeList = NULL_NODE;
+	leafCount = 0;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/////////// Incremental updates
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int32_t BoundingVolumeHierarchy::insert(const AABB& box, uint32_t userIndex)
+{
+	const int32_t leaf = allocateNode();
+	nodes[leaf].box = box;
+	nodes[leaf].userIndex = userIndex;
+
+	insertLeaf(leaf);
+	leafCount++;
+
+	return leaf;
+}
+
+void BoundingVolumeHierarchy::remove(int32_t proxy)
+{
+	checkProxy(proxy);
+
+	removeLeaf(proxy);
+	freeNode(proxy);
+	leafCount--;
+}
+
+void BoundingVolumeHierarchy::update(int32_t proxy, const AABB& box)
+{
+	nodes[proxy].box = box;
+	refitAncestors(nodes[proxy].parent);
+}
+
+void BoundingVolumeHierarchy::setLeafBox(int32_t proxy, const AABB& box)
+{
+	nodes[proxy].box = box;
+}
+
+void BoundingVolumeHierarchy::refit()
+{
+	if (root == NULL_NODE)
+		return;
+
+	// pre order list of the internal nodes, refitted in reverse so children are done before their parent
+	scratchNodes.clear();
+	traversalStack.clear();
+	traversalStack.push_back(root);
+	while (!traversalStack.empty())
+	{
+		const int32_t nodeIndex = traversalStack.back();
+		traversalStack.pop_back();
+
+		if (!nodes[nodeIndex].isLeaf())
+		{
+			scratchNodes.push_back(nodeIndex);
+			traversalStack.push_back(nodes[nodeIndex].child1);
+			traversalStack.push_back(nodes[nodeIndex].child2);
+		}
+	}
+
+	for (auto it = scratchNodes.rbegin(); it != scratchNodes.rend(); ++it)
+	{
+		Node& node = nodes[*it];
+		node.box = mergeBoxes(nodes[node.child1].box, nodes[node.child2].box);
+	}
+}
+
+// Walk down the tree choosing at each level between making the leaf a sibling of the current node
+// or going to the child whose box grows the least, as in Box2D's dynamic tree.
+void BoundingVolumeHierarchy::insertLeaf(int32_t leaf)
+{
+	if (root == NULL_NODE)
+	{
+		root = leaf;
+		nodes[leaf].parent = NULL_NODE;
+		return;
+	}
+
+	const AABB leafBox = nodes[leaf].box;
+	int32_t sibling = root;
+	while (!nodes[sibling].isLeaf())
+	{
+		const Node& node = nodes[sibling];
+		const float area = node.box.getSurfaceArea();
+		const float combinedArea = mergeBoxes(node.box, leafBox).getSurfaceArea();
+
+		// cost of a new parent for this node and the leaf
+		const float cost = 2.f * combinedArea;
+		// growth of all the ancestors when going down
+		const float inheritanceCost = 2.f * (combinedArea - area);
+
+		auto getDescentCost = [&](int32_t child)
+		{
+			const float mergedArea = mergeBoxes(leafBox, nodes[child].box).getSurfaceArea();
+			if (nodes[child].isLeaf())
+				return mergedArea + inheritanceCost;
+			return mergedArea - nodes[child].box.getSurfaceArea() + inheritanceCost;
+		};
+
+		const float cost1 = getDescentCost(node.child1);
+		const float cost2 = getDescentCost(node.child2);
+		if (cost < cost1 && cost < cost2)
+			break;
+
+		sibling = cost1 < cost2 ? node.child1 : node.child2;
+	}
+
+	const int32_t oldParent = nodes[sibling].parent;
+	const int32_t newParent = allocateNode();
+	nodes[newParent].parent = oldParent;
+	nodes[newParent].box = mergeBoxes(leafBox, nodes[sibling].box);
+	nodes[newParent].child1 = sibling;
+	nodes[newParent].child2 = leaf;
+	nodes[newParent].height = nodes[sibling].height + 1;
+	nodes[sibling].parent = newParent;
+	nodes[leaf].parent = newParent;
+
+	if (oldParent == NULL_NODE)
+	{
+		root = newParent;
+	}
+	else
+	{
+		if (nodes[oldParent].child1 == sibling)
+			nodes[oldParent].child1 = newParent;
+		else
+			nodes[oldParent].child2 = newParent;
+
+		refitAncestors(oldParent);
+	}
+}
+
+void BoundingVolumeHierarchy::removeLeaf(int32_t leaf)
+{
+	if (leaf == root)
+	{
+		root = NULL_NODE;
+		return;
+	}
+
+	const int32_t parent = nodes[leaf].parent;
+	const int32_t grandParent = nodes[parent].parent;
+	const int32_t sibling = nodes[parent].child1 == leaf ? nodes[parent].child2 : nodes[parent].child1;
+
+	// the sibling takes the place of the parent
+	if (grandParent == NULL_NODE)
+	{
+		root = sibling;
+		nodes[sibling].parent = NULL_NODE;
+	}
+	else
+	{
+		if (nodes[grandParent].child1 == parent)
+			nodes[grandParent].child1 = sibling;
+		else
+			nodes[grandParent].child2 = sibling;
+		nodes[sibling].parent = grandParent;
+
+		refitAncestors(grandParent);
+	}
+
+	freeNode(parent);
+	nodes[leaf].parent = NULL_NODE;
+}
+
+void BoundingVolumeHierarchy::refitAncestors(int32_t nodeIndex)
+{
+	while (nodeIndex != NULL_NODE)
+	{
+		Node& node = nodes[nodeIndex];
+		node.box = mergeBoxes(nodes[node.child1].box, nodes[node.child2].box);
+		node.height = 1 + std::max(nodes[node.child1].height, nodes[node.child2].height);
+		nodeIndex = node.parent;
+	}
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/////////// Queries
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void BoundingVolumeHierarchy::addSubtree(int32_t nodeIndex, std::vector<uint32_t>& outUserIndices)
+{
+	const size_t stackBase = traversalStack.size();
+	traversalStack.push_back(nodeIndex);
+	while (traversalStack.size() > stackBase)
+	{
+		const Node& node = nodes[traversalStack.back()];
+		traversalStack.pop_back();
+
+		if (node.isLeaf())
+		{
+			outUserIndices.push_back(node.userIndex);
+		}
+		else
+		{
+			traversalStack.push_back(node.child1);
+			traversalStack.push_back(node.child2);
+		}
+	}
+}
+
+void BoundingVolumeHierarchy::queryFrustum(const Frustum& frustum, std::vector<uint32_t>& outUserIndices)
+{
+	if (root == NULL_NODE)
+		return;
+
+	const uint32_t allPlanesMask = (1u << Frustum::PLANE_COUNT) - 1;
+
+	// each entry is a node and the mask of the planes its box still crosses,
+	// subtrees fully inside a plane skip it and subtrees inside all planes are added without tests
+	traversalStack.clear();
+	traversalStack.push_back(root);
+	traversalStack.push_back(static_cast<int32_t>(allPlanesMask));
+	while (!traversalStack.empty())
+	{
+		uint32_t planeMask = static_cast<uint32_t>(traversalStack.back());
+		traversalStack.pop_back();
+		const int32_t nodeIndex = traversalStack.back();
+		traversalStack.pop_back();
+
+		const Node& node = nodes[nodeIndex];
+		const glm::vec3 center = node.box.getCenter();
+		const glm::vec3 extent = node.box.getExtent();
+
+		bool outside = false;
+		for (int planeIndex = 0; planeIndex < Frustum::PLANE_COUNT; planeIndex++)
+		{
+			if ((planeMask & (1u << planeIndex)) == 0)
+				continue;
+
+			const glm::vec4& plane = frustum.planes[planeIndex];
+			const float distance = glm::dot(glm::vec3(plane), center) + plane.w;
+			const float radius = glm::dot(glm::abs(glm::vec3(plane)), extent);
+			if (distance < -radius)
+			{
+				outside = true;
+				break;
+			}
+			if (distance >= radius)
+				planeMask &= ~(1u << planeIndex);
+		}
+
+		if (outside)
+			continue;
+
+		if (planeMask == 0)
+		{
+			addSubtree(nodeIndex, outUserIndices);
+		}
+		else if (node.isLeaf())
+		{
+			outUserIndices.push_back(node.userIndex);
+		}
+		else
+		{
+			traversalStack.push_back(node.child1);
+			traversalStack.push_back(static_cast<int32_t>(planeMask));
+			traversalStack.push_back(node.child2);
+			traversalStack.push_back(static_cast<int32_t>(planeMask));
+		}
+	}
+}
+
+void BoundingVolumeHierarchy::querySphere(const BoundingSphere& sphere, std::vector<uint32_t>& outUserIndices)
+{
+	if (root == NULL_NODE)
+		return;
+
+	const float squaredRadius = sphere.radius * sphere.radius;
+
+	traversalStack.clear();
+	traversalStack.push_back(root);
+	while (!traversalStack.empty())
+	{
+		const Node& node = nodes[traversalStack.back()];
+		traversalStack.pop_back();
+
+		const glm::vec3 closestPoint = glm::clamp(sphere.center, node.box.min, node.box.max);
+		const glm::vec3 offset = closestPoint - sphere.center;
+		if (glm::dot(offset, offset) > squaredRadius)
+			continue;
+
+		if (node.isLeaf())
+		{
+			outUserIndices.push_back(node.userIndex);
+		}
+		else
+		{
+			traversalStack.push_back(node.child1);
+			traversalStack.push_back(node.child2);
+		}
+	}
+}
+
+void BoundingVolumeHierarchy::queryRay(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, std::vector<uint32_t>& outUserIndices)
+{
+	if (root == NULL_NODE)
+		return;
+
+	// slab test, infinite inverse directions handle the axis aligned rays
+	const glm::vec3 inverseDirection(1.f / direction.x, 1.f / direction.y, 1.f / direction.z);
+
+	traversalStack.clear();
+	traversalStack.push_back(root);
+	while (!traversalStack.empty())
+	{
+		const Node& node = nodes[traversalStack.back()];
+		traversalStack.pop_back();
+
+		float entry = 0.f;
+		float exit = maxDistance;
+		for (int axis = 0; axis < 3; axis++)
+		{
+			float slabEntry = (node.box.min[axis] - origin[axis]) * inverseDirection[axis];
+			float slabExit = (node.box.max[axis] - origin[axis]) * inverseDirection[axis];
+			if (slabEntry > slabExit)
+				std::swap(slabEntry, slabExit);
+			// NaN when the origin is on a slab plane of an axis aligned ray : the slab is ignored
+			entry = slabEntry > entry ? slabEntry : entry;
+			exit = slabExit < exit ? slabExit : exit;
+		}
+
+		if (entry > exit)
+			continue;
+
+		if (node.isLeaf())
+		{
+			outUserIndices.push_back(node.userIndex);
+		}
+		else
+		{
+			traversalStack.push_back(node.child1);
+			traversalStack.push_back(node.child2);
+		}
+	}
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/////////// Getters
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+uint32_t BoundingVolumeHierarchy::getLeafCount() const
+{
+	return leafCount;
+}
+
+uint32_t BoundingVolumeHierarchy::getHeight() const
+{
+	if (root == NULL_NODE)
+		return 0;
+
+	return static_cast<uint32_t>(nodes[root].height) + 1;
+}
+
+float BoundingVolumeHierarchy::computeSurfaceAreaCost() const
+{
+	if (root == NULL_NODE || nodes[root].isLeaf())
+		return 0.f;
+
+	float internalArea = 0.f;
+	std::vector<int32_t> stack(1, root);
+	while (!stack.empty())
+	{
+		const Node& node = nodes[stack.back()];
+		stack.pop_back();
+
+		if (!node.isLeaf())
+		{
+			internalArea += node.box.getSurfaceArea();
+			stack.push_back(node.child1);
+			stack.push_back(node.child2);
+		}
+	}
+
+	return internalArea / nodes[root].box.getSurfaceArea();
+}
+
+const BoundingVolumeHierarchy::Node& BoundingVolumeHierarchy::getNode(int32_t nodeIndex) const
+{
+	return nodes[nodeIndex];
+}
+
+int32_t BoundingVolumeHierarchy::getRoot() const
+{
+	return root;
+}
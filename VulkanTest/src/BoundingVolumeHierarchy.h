@@ -0,0 +1,111 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <vector>
+
+#include "Bounds.h"
+
+// Dynamic bounding volume hierarchy over the instances of a scene.
+// Each leaf holds one instance, identified by a user index (the same index as in a CullingSet for example).
+// Leaves are referenced by proxies which stay valid until the leaf is removed.
+// Queries write the user indices of the intersected leaves, ready to be added to a RenderBatch.
+// The tree isn't thread safe, queries share a traversal stack.
+class BoundingVolumeHierarchy
+{
+public:
+	static const int32_t NULL_NODE = -1;
+
+	static const int32_t FREE_NODE_HEIGHT = -1;
+
+	struct Node
+	{
+		AABB box;
+		int32_t parent = NULL_NODE; // next free node when the node is in the free list
+		int32_t child1 = NULL_NODE;
+		int32_t child2 = NULL_NODE;
+		uint32_t userIndex = 0;
+		// 0 for the leaves, FREE_NODE_HEIGHT for the nodes in the free list
+		int32_t height = 0;
+
+		bool isLeaf() const
+		{
+			return child1 == NULL_NODE;
+		}
+
+		bool isFree() const
+		{
+			return height == FREE_NODE_HEIGHT;
+		}
+	};
+
+private:
+	std::vector<Node> nodes;
+	int32_t root = NULL_NODE;
+	int32_t freeList = NULL_NODE;
+	uint32_t leafCount = 0;
+
+	// scratch memory reused between calls
+	std::vector<int32_t> traversalStack;
+	std::vector<int32_t> scratchNodes;
+	// leaf box centers during a build, indexed by node
+	std::vector<glm::vec3> buildCenters;
+	// internal nodes in their creation order during a build, parents before their children
+	std::vector<int32_t> buildInternalNodes;
+
+	struct BuildTask
+	{
+		uint32_t firstLeaf;
+		uint32_t leafCount;
+		int32_t parent;
+	};
+	std::vector<BuildTask> buildTasks;
+
+	void prepareBuildCenters();
+
+	int32_t allocateNode();
+	void freeNode(int32_t nodeIndex);
+
+	void insertLeaf(int32_t leaf);
+	void removeLeaf(int32_t leaf);
+	void refitAncestors(int32_t nodeIndex);
+
+	// build the tree over the leaves in scratchNodes and return its root
+	int32_t buildTopDown();
+	// partition the leaves and return the count of the first part
+	uint32_t splitLeaves(int32_t* leaves, uint32_t count);
+	void checkProxy(int32_t proxy) const;
+	void addSubtree(int32_t nodeIndex, std::vector<uint32_t>& outUserIndices);
+
+public:
+	// Rebuild the whole tree from a list of instances with a binned surface area heuristic.
+	// outProxies receives the proxy of each instance, in the same order.
+	void build(const AABB* boxes, const uint32_t* userIndices, uint32_t count, std::vector<int32_t>& outProxies);
+	// Rebuild the tree from its current leaves, the proxies stay valid.
+	// Incremental insertions slowly degrade the tree, a rebuild brings it back to the build quality.
+	void rebuild();
+	void clear();
+
+	// incremental updates, the insertion looks for the sibling with the lowest surface area cost
+	int32_t insert(const AABB& box, uint32_t userIndex);
+	// throw if the proxy isn't a leaf of the tree, for example when it was already removed
+	void remove(int32_t proxy);
+	// move a single leaf and refit its ancestors
+	void update(int32_t proxy, const AABB& box);
+	// when many instances move in a frame : set the leaf boxes, then refit all the tree once
+	void setLeafBox(int32_t proxy, const AABB& box);
+	void refit();
+
+	// queries append the user indices of the intersected leaves to the output
+	void queryFrustum(const Frustum& frustum, std::vector<uint32_t>& outUserIndices);
+	void querySphere(const BoundingSphere& sphere, std::vector<uint32_t>& outUserIndices);
+	// leaves whose box is hit by the segment [origin, origin + direction * maxDistance]
+	void queryRay(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, std::vector<uint32_t>& outUserIndices);
+
+	uint32_t getLeafCount() const;
+	uint32_t getHeight() const;
+	// sum of the internal node areas relative to the root area, lower is better
+	float computeSurfaceAreaCost() const;
+	const Node& getNode(int32_t nodeIndex) const;
+	int32_t getRoot() const;
+};
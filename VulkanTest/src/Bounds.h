@@ -0,0 +1,175 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+
+struct AABB
+{
+	glm::vec3 min = glm::vec3(0.f);
+	glm::vec3 max = glm::vec3(0.f);
+
+	glm::vec3 getCenter() const
+	{
+		return (min + max) * 0.5f;
+	}
+
+	glm::vec3 getExtent() const
+	{
+		return (max - min) * 0.5f;
+	}
+
+	void merge(const AABB& other)
+	{
+		min = glm::min(min, other.min);
+		max = glm::max(max, other.max);
+	}
+
+	float getSurfaceArea() const
+	{
+		const glm::vec3 size = max - min;
+		return 2.f * (size.x * size.y + size.y * size.z + size.z * size.x);
+	}
+
+	static AABB fromCenterExtent(const glm::vec3& center, const glm::vec3& extent)
+	{
+		AABB box;
+		box.min = center - extent;
+		box.max = center + extent;
+		return box;
+	}
+};
+
+struct BoundingSphere
+{
+	glm::vec3 center = glm::vec3(0.f);
+	float radius = 0.f;
+};
+
+// Box and sphere of the same object, culling uses whichever is the tightest
+struct Bounds
+{
+	AABB box;
+	BoundingSphere sphere;
+
+	// sphere centered on the box, with the radius of the farthest point
+	static Bounds fromPoints(const glm::vec3* points, size_t count)
+	{
+		Bounds bounds;
+		if (count == 0)
+			return bounds;
+
+		bounds.box.min = points[0];
+		bounds.box.max = points[0];
+		for (size_t i = 1; i < count; i++)
+		{
+			bounds.box.min = glm::min(bounds.box.min, points[i]);
+			bounds.box.max = glm::max(bounds.box.max, points[i]);
+		}
+
+		bounds.sphere.center = bounds.box.getCenter();
+		float squaredRadius = 0.f;
+		for (size_t i = 0; i < count; i++)
+		{
+			const glm::vec3 offset = points[i] - bounds.sphere.center;
+			squaredRadius = std::max(squaredRadius, glm::dot(offset, offset));
+		}
+		bounds.sphere.radius = std::sqrt(squaredRadius);
+
+		return bounds;
+	}
+
+	static Bounds fromBox(const AABB& box)
+	{
+		Bounds bounds;
+		bounds.box = box;
+		bounds.sphere.center = box.getCenter();
+		bounds.sphere.radius = glm::length(box.getExtent());
+		return bounds;
+	}
+
+	// world bounds of an instance : the box stays axis aligned and encloses the transformed box
+	Bounds transform(const glm::mat4& transform) const
+	{
+		const glm::vec3 axisX(transform[0]);
+		const glm::vec3 axisY(transform[1]);
+		const glm::vec3 axisZ(transform[2]);
+		const glm::vec3 translation(transform[3]);
+
+		const glm::vec3 center = box.getCenter();
+		const glm::vec3 extent = box.getExtent();
+		const glm::vec3 worldCenter = axisX * center.x + axisY * center.y + axisZ * center.z + translation;
+		const glm::vec3 worldExtent = glm::abs(axisX) * extent.x + glm::abs(axisY) * extent.y + glm::abs(axisZ) * extent.z;
+
+		Bounds worldBounds;
+		worldBounds.box = AABB::fromCenterExtent(worldCenter, worldExtent);
+		worldBounds.sphere.center = axisX * sphere.center.x + axisY * sphere.center.y + axisZ * sphere.center.z + translation;
+		const float maxScale = std::max(glm::length(axisX), std::max(glm::length(axisY), glm::length(axisZ)));
+		worldBounds.sphere.radius = sphere.radius * maxScale;
+
+		return worldBounds;
+	}
+};
+
+// Planes point inside the frustum : a point p is inside when dot(plane.xyz, p) + plane.w >= 0 for all planes
+struct Frustum
+{
+	enum PlaneIndex
+	{
+		PLANE_LEFT,
+		PLANE_RIGHT,
+		PLANE_BOTTOM,
+		PLANE_TOP,
+		PLANE_NEAR,
+		PLANE_FAR,
+		PLANE_COUNT
+	};
+
+	glm::vec4 planes[PLANE_COUNT];
+
+	// Vulkan clip space : depth goes from 0 to 1
+	static Frustum fromViewProjection(const glm::mat4& viewProjection)
+	{
+		const glm::vec4 row0(viewProjection[0][0], viewProjection[1][0], viewProjection[2][0], viewProjection[3][0]);
+		const glm::vec4 row1(viewProjection[0][1], viewProjection[1][1], viewProjection[2][1], viewProjection[3][1]);
+		const glm::vec4 row2(viewProjection[0][2], viewProjection[1][2], viewProjection[2][2], viewProjection[3][2]);
+		const glm::vec4 row3(viewProjection[0][3], viewProjection[1][3], viewProjection[2][3], viewProjection[3][3]);
+
+		Frustum frustum;
+		frustum.planes[PLANE_LEFT] = row3 + row0;
+		frustum.planes[PLANE_RIGHT] = row3 - row0;
+		frustum.planes[PLANE_BOTTOM] = row3 + row1;
+		frustum.planes[PLANE_TOP] = row3 - row1;
+		frustum.planes[PLANE_NEAR] = row2;
+		frustum.planes[PLANE_FAR] = row3 - row2;
+
+		for (int i = 0; i < PLANE_COUNT; i++)
+			frustum.planes[i] = frustum.planes[i] / glm::length(glm::vec3(frustum.planes[i]));
+
+		return frustum;
+	}
+
+	bool intersects(const AABB& box) const
+	{
+		const glm::vec3 center = box.getCenter();
+		const glm::vec3 extent = box.getExtent();
+		for (int i = 0; i < PLANE_COUNT; i++)
+		{
+			const glm::vec3 normal(planes[i]);
+			if (glm::dot(normal, center) + planes[i].w < -glm::dot(glm::abs(normal), extent))
+				return false;
+		}
+		return true;
+	}
+
+	bool intersects(const BoundingSphere& sphere) const
+	{
+		for (int i = 0; i < PLANE_COUNT; i++)
+		{
+			if (glm::dot(glm::vec3(planes[i]), sphere.center) + planes[i].w < -sphere.radius)
+				return false;
+		}
+		return true;
+	}
+};
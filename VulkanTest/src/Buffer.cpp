@@ -49,16 +49,19 @@ void Buffer::pushDatasToBuffer(const void* datas, const BufferCopyInfo& mappingI
 		stagingCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
 		stagingCreateInfo.owningDevice = owningDevice;
 		stagingCreateInfo.physicalDevice = physicalDevice;
-		stagingCreateInfo.itemCount = mappingInfo.itemCount;
+		stagingCreateInfo.itemCount = static_cast<uint32_t>(mappingInfo.itemCount);
 		stagingCreateInfo.itemSizeNotAligned = itemSizeNotAligned;
 		stagingCreateInfo.useAlignment = useAlignment;
 		stagingBuffer.create(stagingCreateInfo, false);
 
+		// the staging buffer only holds the copied range
 		BufferCopyInfo stagingMapingInfo = mappingInfo;
-		stagingMapingInfo.srcItemCountOffset = 0;
+		stagingMapingInfo.dstItemCountOffset = 0;
 		stagingBuffer.pushDatasToBuffer(datas, stagingMapingInfo, false);
 
-		singleCmdCopyBufferToBuffer(owningDevice, commandPool, transferQueue, stagingBuffer, *this, &mappingInfo);
+		BufferCopyInfo copyInfo = mappingInfo;
+		copyInfo.srcItemCountOffset = 0;
+		singleCmdCopyBufferToBuffer(owningDevice, commandPool, transferQueue, stagingBuffer, *this, &copyInfo);
 	}
 	else
 	{
@@ -66,11 +69,35 @@ void Buffer::pushDatasToBuffer(const void* datas, const BufferCopyInfo& mappingI
 	}
 }
 
+void* Buffer::map()
+{
+	if (mappedData == nullptr)
+		vkMapMemory(owningDevice, vertexBufferMemory, 0, VK_WHOLE_SIZE, 0, &mappedData);
+
+	return mappedData;
+}
+
+void Buffer::unmap()
+{
+	if (mappedData == nullptr)
+		return;
+
+	vkUnmapMemory(owningDevice, vertexBufferMemory);
+	mappedData = nullptr;
+}
+
+void* Buffer::getMappedData() const
+{
+	return mappedData;
+}
+
 void Buffer::destroy()
 {
 	if (itemCount == 0)
 		return;
 
+	unmap();
+
 	vkDestroyBuffer(owningDevice, vertexBuffer, nullptr);
 	vkFreeMemory(owningDevice, vertexBufferMemory, nullptr);
 	itemCount = 0;
@@ -102,6 +129,11 @@ size_t Buffer::getItemSizeNotAligned() const
 	return itemSizeNotAligned;
 }
 
+size_t Buffer::getItemSize() const
+{
+	return useAlignment ? itemSizeAligned : itemSizeNotAligned;
+}
+
 void Buffer::createBufferHandle()
 {
 	VkBufferCreateInfo bufferInfo = {};
@@ -139,9 +171,15 @@ void Buffer::mapDatas(const void* datas, const BufferCopyInfo& mappingInfo)
 	//assert(mappingInfo.srcOffset + mappingInfo.size <= datas.size())// *sizeof(datas[0]));
 
 	const uint32_t usedItemSize = useAlignment ? itemSizeAligned : itemSizeNotAligned;
-	const char* fromPtr = reinterpret_cast<const char*>(datas) + (itemSizeAligned * mappingInfo.srcItemCountOffset);
-	const size_t size = mappingInfo.itemCount * itemSizeAligned;
-	const VkDeviceSize dstOffset = mappingInfo.dstItemCountOffset * itemSizeAligned;
+	const char* fromPtr = reinterpret_cast<const char*>(datas) + (usedItemSize * mappingInfo.srcItemCountOffset);
+	const size_t size = mappingInfo.itemCount * usedItemSize;
+	const VkDeviceSize dstOffset = mappingInfo.dstItemCountOffset * usedItemSize;
+
+	if (mappedData != nullptr)
+	{
+		memcpy(static_cast<char*>(mappedData) + dstOffset, (void*)fromPtr, (size_t)size);
+		return;
+	}
 
 	void* data;
 	vkMapMemory(owningDevice, vertexBufferMemory, dstOffset, size, 0, &data);
@@ -25,7 +25,6 @@ struct BufferCreateInfo
 		createInfo.owningDevice = device;
 		createInfo.physicalDevice = physicalDevice;
 		createInfo.itemCount = itemCount;
-		createInfo.itemSizeNotAligned = 0;
 		createInfo.itemSizeNotAligned = itemNotAlignedSize;
 		createInfo.useAlignment = true;
 
@@ -46,7 +45,6 @@ struct BufferCreateInfo
 		createInfo.physicalDevice = physicalDevice;
 		createInfo.itemCount = itemCount;
 		createInfo.itemSizeNotAligned = itemNotAlignedSize;
-		createInfo.itemSizeAligned = 0;
 		createInfo.useAlignment = false;
 
 		return createInfo;
@@ -100,6 +98,9 @@ private:
 	uint32_t sizeAligned = 0;
 	size_t itemSizeAligned = 0;
 
+	// persistent mapping of host visible buffers
+	void* mappedData = nullptr;
+
 public:
 
 	Buffer();
@@ -109,6 +110,11 @@ public:
 	void pushDatasToBuffer(const void* datas, const BufferCopyInfo& mappingInfo
 		, bool useSharing = false, VkPhysicalDevice physicalDevice = VK_NULL_HANDLE, VkCommandPool commandPool = VK_NULL_HANDLE, VkQueue transferQueue = VK_NULL_HANDLE);
 
+	// Keep the memory of a host visible buffer mapped until unmap() or destroy(), so it can be written directly.
+	void* map();
+	void unmap();
+	void* getMappedData() const;
+
 	void destroy();
 	const VkBuffer* getBufferHandle() const;
 	const VkDeviceMemory* getMemoryHandle() const;
@@ -116,6 +122,8 @@ public:
 	uint32_t getSize() const;
 	size_t getItemSizeNotAligned() const;
 	size_t getItemSizeAligned() const;
+	// stride of the items inside the buffer, aligned or not depending on the creation
+	size_t getItemSize() const;
 
 private:
 
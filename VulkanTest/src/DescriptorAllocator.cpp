@@ -0,0 +1,216 @@
+#include "DescriptorAllocator.h"
+#include "VulkanUtils.h"
+
+#include <algorithm>
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/////////// DescriptorPoolChain
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+DescriptorPoolChain::DescriptorPoolChain()
+	: owningDevice(VK_NULL_HANDLE)
+	, poolFlags(0)
+	, setsPerPool(0)
+	, currentPoolIndex(0)
+{}
+
+void DescriptorPoolChain::create(VkDevice device, const DescriptorAllocatorCreateInfo& createInfo, VkDescriptorPoolCreateFlags flags)
+{
+	owningDevice = device;
+	poolFlags = flags;
+	setsPerPool = createInfo.setsPerPool;
+	currentPoolIndex = 0;
+
+	poolSizes.clear();
+	for (const auto& sizeRatio : createInfo.poolSizeRatios)
+	{
+		uint32_t descriptorCount = std::max(1u, static_cast<uint32_t>(sizeRatio.ratio * setsPerPool));
+		poolSizes.push_back(VkDescriptorPoolSize{ sizeRatio.type, descriptorCount });
+	}
+}
+
+void DescriptorPoolChain::destroy()
+{
+	for (auto& pool : pools)
+		vkDestroyDescriptorPool(owningDevice, pool, nullptr);
+
+	pools.clear();
+	currentPoolIndex = 0;
+}
+
+bool DescriptorPoolChain::allocate(VkDescriptorSetLayout layout, DescriptorSetAllocation& outAllocation, DescriptorAllocatorStats& stats)
+{
+	if (pools.empty())
+		pools.push_back(createPool());
+
+	VkDescriptorSetAllocateInfo allocInfo = {};
+	allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	allocInfo.descriptorSetCount = 1;
+	allocInfo.pSetLayouts = &layout;
+
+	// try the current pool, then the next ones, then append a new pool
+	const bool canFreeSets = (poolFlags & VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT) != 0;
+	uint32_t triedPoolCount = 0;
+	bool usedNewPool = false;
+	while (true)
+	{
+		allocInfo.descriptorPool = pools[currentPoolIndex];
+
+		VkResult result = vkAllocateDescriptorSets(owningDevice, &allocInfo, &outAllocation.descriptorSet);
+		if (result == VK_SUCCESS)
+		{
+			outAllocation.pool = pools[currentPoolIndex];
+			return true;
+		}
+		else if (result != VK_ERROR_OUT_OF_POOL_MEMORY && result != VK_ERROR_FRAGMENTED_POOL)
+		{
+			throw std::runtime_error("failed to allocate descriptor set !");
+		}
+
+		// the layout doesn't fit even in an empty pool
+		if (usedNewPool)
+			return false;
+
+		stats.poolOverflowCount++;
+		triedPoolCount++;
+		currentPoolIndex++;
+		// sets freed in the previous pools left room there, try them before growing the chain
+		if (canFreeSets && currentPoolIndex >= pools.size() && triedPoolCount < pools.size())
+			currentPoolIndex = 0;
+
+		if (currentPoolIndex >= pools.size() || triedPoolCount >= pools.size())
+		{
+			currentPoolIndex = static_cast<uint32_t>(pools.size());
+			pools.push_back(createPool());
+			usedNewPool = true;
+		}
+	}
+}
+
+void DescriptorPoolChain::reset()
+{
+	for (auto& pool : pools)
+		vkResetDescriptorPool(owningDevice, pool, 0);
+
+	currentPoolIndex = 0;
+}
+
+uint32_t DescriptorPoolChain::getPoolCount() const
+{
+	return static_cast<uint32_t>(pools.size());
+}
+
+VkDescriptorPool DescriptorPoolChain::createPool()
+{
+	VkDescriptorPoolCreateInfo poolInfo = {};
+	poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	poolInfo.flags = poolFlags;
+	poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+	poolInfo.pPoolSizes = poolSizes.data();
+	poolInfo.maxSets = setsPerPool;
+
+	VkDescriptorPool pool;
+	if (vkCreateDescriptorPool(owningDevice, &poolInfo, nullptr, &pool) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create descriptor pool !");
+	}
+
+	return pool;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/////////// DescriptorAllocator
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+DescriptorAllocator::DescriptorAllocator()
+	: owningDevice(VK_NULL_HANDLE)
+	, currentFrameIndex(0)
+	, frameNumber(0)
+{}
+
+DescriptorAllocator::~DescriptorAllocator()
+{
+	destroy();
+}
+
+void DescriptorAllocator::create(const DescriptorAllocatorCreateInfo& createInfo)
+{
+	owningDevice = createInfo.device;
+	currentFrameIndex = 0;
+	frameNumber = 0;
+	stats = {};
+
+	// persistent sets can be freed one by one
+	persistentPools.create(owningDevice, createInfo, VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT);
+
+	// transient sets are only recycled by resetting the whole pools
+	transientPoolsPerFrame.resize(createInfo.frameCount);
+	for (auto& transientPools : transientPoolsPerFrame)
+		transientPools.create(owningDevice, createInfo, 0);
+}
+
+void DescriptorAllocator::destroy()
+{
+	if (owningDevice == VK_NULL_HANDLE)
+		return;
+
+	persistentPools.destroy();
+	for (auto& transientPools : transientPoolsPerFrame)
+		transientPools.destroy();
+	transientPoolsPerFrame.clear();
+
+	owningDevice = VK_NULL_HANDLE;
+}
+
+DescriptorSetAllocation DescriptorAllocator::allocate(VkDescriptorSetLayout layout)
+{
+	DescriptorSetAllocation allocation;
+	CHECK_TRUE_THROW_ERROR(persistentPools.allocate(layout, allocation, stats), "descriptor set layout too big for the descriptor allocator pools !");
+
+	stats.persistentSetCount++;
+	stats.persistentPoolCount = persistentPools.getPoolCount();
+
+	return allocation;
+}
+
+void DescriptorAllocator::free(const DescriptorSetAllocation& allocation)
+{
+	if (allocation.descriptorSet == VK_NULL_HANDLE)
+		return;
+
+	vkFreeDescriptorSets(owningDevice, allocation.pool, 1, &allocation.descriptorSet);
+	stats.persistentSetCount--;
+}
+
+void DescriptorAllocator::beginFrame(uint32_t frameIndex)
+{
+	currentFrameIndex = frameIndex % static_cast<uint32_t>(transientPoolsPerFrame.size());
+	transientPoolsPerFrame[currentFrameIndex].reset();
+	frameNumber++;
+
+	stats.transientSetCount = 0;
+}
+
+VkDescriptorSet DescriptorAllocator::allocateTransient(VkDescriptorSetLayout layout)
+{
+	DescriptorPoolChain& transientPools = transientPoolsPerFrame[currentFrameIndex];
+
+	DescriptorSetAllocation allocation;
+	CHECK_TRUE_THROW_ERROR(transientPools.allocate(layout, allocation, stats), "descriptor set layout too big for the descriptor allocator pools !");
+
+	stats.transientSetCount++;
+	stats.transientPoolCount = 0;
+	for (const auto& pools : transientPoolsPerFrame)
+		stats.transientPoolCount += pools.getPoolCount();
+
+	return allocation.descriptorSet;
+}
+
+const DescriptorAllocatorStats& DescriptorAllocator::getStats() const
+{
+	return stats;
+}
+
+uint64_t DescriptorAllocator::getFrameNumber() const
+{
+	return frameNumber;
+}
@@ -0,0 +1,127 @@
+#pragma once
+
+#include <vulkan/vulkan.hpp>
+
+#include <vector>
+
+// Relative amount of each descriptor type inside a pool.
+// The real descriptor count is ratio * setsPerPool.
+struct DescriptorPoolSizeRatio
+{
+	VkDescriptorType type;
+	float ratio;
+};
+
+struct DescriptorAllocatorCreateInfo
+{
+	VkDevice device;
+	// number of frames in flight, each one own its transient pools
+	uint32_t frameCount;
+	uint32_t setsPerPool;
+	std::vector<DescriptorPoolSizeRatio> poolSizeRatios;
+
+	static DescriptorAllocatorCreateInfo makeDefault(VkDevice device, uint32_t frameCount)
+	{
+		DescriptorAllocatorCreateInfo createInfo = {};
+		createInfo.device = device;
+		createInfo.frameCount = frameCount;
+		createInfo.setsPerPool = 1024;
+		createInfo.poolSizeRatios = {
+			{ VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 2.0f },
+			{ VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1.0f },
+			{ VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1.0f },
+			{ VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, 0.5f },
+			{ VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 4.0f },
+			{ VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, 4.0f },
+			{ VK_DESCRIPTOR_TYPE_SAMPLER, 1.0f }
+		};
+
+		return createInfo;
+	}
+};
+
+// A persistent set remember the pool it comes from, so it can be freed
+struct DescriptorSetAllocation
+{
+	VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+	VkDescriptorPool pool = VK_NULL_HANDLE;
+};
+
+struct DescriptorAllocatorStats
+{
+	uint32_t persistentPoolCount = 0;
+	uint32_t transientPoolCount = 0;
+	uint32_t persistentSetCount = 0;
+	// transient sets allocated for the current frame
+	uint32_t transientSetCount = 0;
+	// allocations which needed a new pool because the current one was full
+	uint32_t poolOverflowCount = 0;
+};
+
+// Chain of large descriptor pools. When the current pool is full, the next one is used
+// or a new pool is appended to the chain. Chains whose sets can be freed try all their pools,
+// from the first one, before appending a new pool.
+class DescriptorPoolChain
+{
+private:
+	VkDevice owningDevice;
+	VkDescriptorPoolCreateFlags poolFlags;
+	uint32_t setsPerPool;
+	std::vector<VkDescriptorPoolSize> poolSizes;
+
+	std::vector<VkDescriptorPool> pools;
+	uint32_t currentPoolIndex;
+
+public:
+	DescriptorPoolChain();
+
+	void create(VkDevice device, const DescriptorAllocatorCreateInfo& createInfo, VkDescriptorPoolCreateFlags flags);
+	void destroy();
+
+	// return false if the layout can't fit in an empty pool
+	bool allocate(VkDescriptorSetLayout layout, DescriptorSetAllocation& outAllocation, DescriptorAllocatorStats& stats);
+	// reset all pools, the sets allocated from this chain become invalid
+	void reset();
+
+	uint32_t getPoolCount() const;
+
+private:
+	VkDescriptorPool createPool();
+};
+
+// Allocate descriptor sets for any layout from shared pools.
+// Persistent sets live until free() is called, transient sets are only valid for the frame
+// they were allocated in and are recycled when beginFrame() is called again with the same frame index.
+class DescriptorAllocator
+{
+private:
+	VkDevice owningDevice;
+
+	DescriptorPoolChain persistentPools;
+	std::vector<DescriptorPoolChain> transientPoolsPerFrame;
+	uint32_t currentFrameIndex;
+	// incremented by each beginFrame()
+	uint64_t frameNumber;
+
+	DescriptorAllocatorStats stats;
+
+public:
+	DescriptorAllocator();
+	~DescriptorAllocator();
+
+	void create(const DescriptorAllocatorCreateInfo& createInfo);
+	void destroy();
+
+	// Persistent sets
+	DescriptorSetAllocation allocate(VkDescriptorSetLayout layout);
+	void free(const DescriptorSetAllocation& allocation);
+
+	// Transient sets
+	void beginFrame(uint32_t frameIndex);
+	VkDescriptorSet allocateTransient(VkDescriptorSetLayout layout);
+
+	// Getters
+	const DescriptorAllocatorStats& getStats() const;
+	// tells the transient sets of the current frame from the ones of the previous frames
+	uint64_t getFrameNumber() const;
+};
@@ -0,0 +1,153 @@
+#include "DescriptorSetLayoutCache.h"
+
+#include <algorithm>
+#include <functional>
+#include <numeric>
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/////////// DescriptorSetLayoutKey
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool DescriptorSetLayoutKey::operator==(const DescriptorSetLayoutKey& other) const
+{
+	if (bindings.size() != other.bindings.size())
+		return false;
+
+	for (size_t i = 0; i < bindings.size(); i++)
+	{
+		const VkDescriptorSetLayoutBinding& a = bindings[i];
+		const VkDescriptorSetLayoutBinding& b = other.bindings[i];
+		if (a.binding != b.binding
+			|| a.descriptorType != b.descriptorType
+			|| a.descriptorCount != b.descriptorCount
+			|| a.stageFlags != b.stageFlags
+			|| a.pImmutableSamplers != b.pImmutableSamplers)
+			return false;
+	}
+
+	return true;
+}
+
+size_t DescriptorSetLayoutKeyHash::operator()(const DescriptorSetLayoutKey& key) const
+{
+	size_t hash = key.bindings.size();
+	for (const auto& binding : key.bindings)
+	{
+		// pack the binding in a single integer, then combine
+		size_t packedBinding = binding.binding | (binding.descriptorType << 8) | (binding.descriptorCount << 16);
+		packedBinding ^= static_cast<size_t>(binding.stageFlags) << 24;
+		hash ^= std::hash<size_t>()(packedBinding) + 0x9e3779b9 + (hash << 6) + (hash >> 2);
+	}
+
+	return hash;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/////////// DescriptorSetLayoutCache
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+DescriptorSetLayoutCache::DescriptorSetLayoutCache()
+	: owningDevice(VK_NULL_HANDLE)
+{}
+
+DescriptorSetLayoutCache::~DescriptorSetLayoutCache()
+{
+	destroy();
+}
+
+void DescriptorSetLayoutCache::create(VkDevice device)
+{
+	owningDevice = device;
+}
+
+void DescriptorSetLayoutCache::destroy()
+{
+	if (owningDevice == VK_NULL_HANDLE)
+		return;
+
+	for (auto& pair_key_layout : layouts)
+	{
+		vkDestroyDescriptorUpdateTemplate(owningDevice, pair_key_layout.second.updateTemplate, nullptr);
+		vkDestroyDescriptorSetLayout(owningDevice, pair_key_layout.second.layout, nullptr);
+	}
+	layouts.clear();
+
+	owningDevice = VK_NULL_HANDLE;
+}
+
+const CachedDescriptorSetLayout& DescriptorSetLayoutCache::getOrCreate(const std::vector<VkDescriptorSetLayoutBinding>& bindings)
+{
+	DescriptorSetLayoutKey key;
+	key.bindings = bindings;
+	std::sort(key.bindings.begin(), key.bindings.end(), [](const VkDescriptorSetLayoutBinding& a, const VkDescriptorSetLayoutBinding& b) { return a.binding < b.binding; });
+
+	auto found = layouts.find(key);
+	if (found != layouts.end())
+		return found->second;
+
+	CachedDescriptorSetLayout newLayout = createLayout(key);
+	return layouts.emplace(std::move(key), newLayout).first->second;
+}
+
+size_t DescriptorSetLayoutCache::getLayoutCount() const
+{
+	return layouts.size();
+}
+
+uint32_t DescriptorSetLayoutCache::computeUpdateDataSlots(const std::vector<VkDescriptorSetLayoutBinding>& bindings, std::vector<uint32_t>& outSlots)
+{
+	std::vector<uint32_t> sortedIndices(bindings.size());
+	std::iota(sortedIndices.begin(), sortedIndices.end(), 0);
+	std::sort(sortedIndices.begin(), sortedIndices.end(), [&bindings](uint32_t a, uint32_t b) { return bindings[a].binding < bindings[b].binding; });
+
+	outSlots.resize(bindings.size());
+	uint32_t slot = 0;
+	for (uint32_t bindingIndex : sortedIndices)
+	{
+		outSlots[bindingIndex] = slot;
+		slot += bindings[bindingIndex].descriptorCount;
+	}
+	return slot;
+}
+
+CachedDescriptorSetLayout DescriptorSetLayoutCache::createLayout(const DescriptorSetLayoutKey& key)
+{
+	CachedDescriptorSetLayout cachedLayout = {};
+
+	VkDescriptorSetLayoutCreateInfo layoutInfo = {};
+	layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	layoutInfo.bindingCount = static_cast<uint32_t>(key.bindings.size());
+	layoutInfo.pBindings = key.bindings.data();
+
+	if (vkCreateDescriptorSetLayout(owningDevice, &layoutInfo, nullptr, &cachedLayout.layout) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create descriptor set layout !");
+	}
+
+	// one entry per binding, reading descriptorCount DescriptorUpdateData from the binding slot
+	// (the key bindings are sorted, like the slots of computeUpdateDataSlots)
+	std::vector<VkDescriptorUpdateTemplateEntry> entries(key.bindings.size());
+	uint32_t slot = 0;
+	for (size_t bindingIndex = 0; bindingIndex < key.bindings.size(); bindingIndex++)
+	{
+		entries[bindingIndex].dstBinding = key.bindings[bindingIndex].binding;
+		entries[bindingIndex].dstArrayElement = 0;
+		entries[bindingIndex].descriptorCount = key.bindings[bindingIndex].descriptorCount;
+		entries[bindingIndex].descriptorType = key.bindings[bindingIndex].descriptorType;
+		entries[bindingIndex].offset = slot * sizeof(DescriptorUpdateData);
+		entries[bindingIndex].stride = sizeof(DescriptorUpdateData);
+		slot += key.bindings[bindingIndex].descriptorCount;
+	}
+
+	VkDescriptorUpdateTemplateCreateInfo templateInfo = {};
+	templateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_UPDATE_TEMPLATE_CREATE_INFO;
+	templateInfo.descriptorUpdateEntryCount = static_cast<uint32_t>(entries.size());
+	templateInfo.pDescriptorUpdateEntries = entries.data();
+	templateInfo.templateType = VK_DESCRIPTOR_UPDATE_TEMPLATE_TYPE_DESCRIPTOR_SET;
+	templateInfo.descriptorSetLayout = cachedLayout.layout;
+
+	if (vkCreateDescriptorUpdateTemplate(owningDevice, &templateInfo, nullptr, &cachedLayout.updateTemplate) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create descriptor update template !");
+	}
+
+	return cachedLayout;
+}
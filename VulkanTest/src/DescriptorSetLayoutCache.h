@@ -0,0 +1,63 @@
+#pragma once
+
+#include <vulkan/vulkan.hpp>
+
+#include <unordered_map>
+#include <vector>
+
+// Packed descriptor info for one descriptor, read by a VkDescriptorUpdateTemplate.
+// A set is updated from a contiguous array of these, ordered by binding number then array element.
+union DescriptorUpdateData
+{
+	VkDescriptorBufferInfo bufferInfo;
+	VkDescriptorImageInfo imageInfo;
+	VkBufferView texelBufferView;
+};
+
+// Binding signature of a descriptor set layout, bindings are sorted by binding number
+struct DescriptorSetLayoutKey
+{
+	std::vector<VkDescriptorSetLayoutBinding> bindings;
+
+	bool operator==(const DescriptorSetLayoutKey& other) const;
+};
+
+struct DescriptorSetLayoutKeyHash
+{
+	size_t operator()(const DescriptorSetLayoutKey& key) const;
+};
+
+struct CachedDescriptorSetLayout
+{
+	VkDescriptorSetLayout layout;
+	// update the whole set from an array of DescriptorUpdateData ordered by binding number
+	VkDescriptorUpdateTemplate updateTemplate;
+};
+
+// Layouts are deduplicated by binding signature : identical sets share the same layout and update template.
+// The cache owns them, they are destroyed with the cache.
+class DescriptorSetLayoutCache
+{
+private:
+	VkDevice owningDevice;
+	std::unordered_map<DescriptorSetLayoutKey, CachedDescriptorSetLayout, DescriptorSetLayoutKeyHash> layouts;
+
+public:
+	DescriptorSetLayoutCache();
+	~DescriptorSetLayoutCache();
+
+	void create(VkDevice device);
+	void destroy();
+
+	// Bindings can be given in any order
+	const CachedDescriptorSetLayout& getOrCreate(const std::vector<VkDescriptorSetLayoutBinding>& bindings);
+
+	size_t getLayoutCount() const;
+
+	// Position of the first DescriptorUpdateData of each binding in the array expected by the update template,
+	// an array binding reads descriptorCount consecutive datas. Return the size of the array.
+	static uint32_t computeUpdateDataSlots(const std::vector<VkDescriptorSetLayoutBinding>& bindings, std::vector<uint32_t>& outSlots);
+
+private:
+	CachedDescriptorSetLayout createLayout(const DescriptorSetLayoutKey& key);
+};
@@ -0,0 +1,251 @@
+#include "FrustumCulling.h"
+
+#include <cfloat>
+
+#if defined(__AVX__)
+#define FRUSTUM_CULLING_AVX
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define FRUSTUM_CULLING_SSE
+#include <emmintrin.h>
+#endif
+
+const uint32_t CullingSet::BLOCK_SIZE;
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/////////// CullingSet
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void CullingSet::resize(uint32_t count)
+{
+	const uint32_t paddedCount = (count + BLOCK_SIZE - 1) / BLOCK_SIZE * BLOCK_SIZE;
+
+	// a negative radius fails every plane test
+	centerX.resize(paddedCount, 0.f);
+	centerY.resize(paddedCount, 0.f);
+	centerZ.resize(paddedCount, 0.f);
+	extentX.resize(paddedCount, 0.f);
+	extentY.resize(paddedCount, 0.f);
+	extentZ.resize(paddedCount, 0.f);
+	radius.resize(paddedCount, -FLT_MAX);
+
+	for (uint32_t i = count; i < instanceCount && i < paddedCount; i++)
+		radius[i] = -FLT_MAX;
+
+	instanceCount = count;
+}
+
+void CullingSet::clear()
+{
+	resize(0);
+}
+
+void CullingSet::setBounds(uint32_t index, const Bounds& worldBounds)
+{
+	const glm::vec3 center = worldBounds.box.getCenter();
+	const glm::vec3 extent = worldBounds.box.getExtent();
+
+	centerX[index] = center.x;
+	centerY[index] = center.y;
+	centerZ[index] = center.z;
+	extentX[index] = extent.x;
+	extentY[index] = extent.y;
+	extentZ[index] = extent.z;
+	// sphere moved to the box center
+	radius[index] = worldBounds.sphere.radius + glm::length(worldBounds.sphere.center - center);
+}
+
+void CullingSet::setBounds(uint32_t index, const Bounds& localBounds, const glm::mat4& transform)
+{
+	setBounds(index, localBounds.transform(transform));
+}
+
+AABB CullingSet::getBox(uint32_t index) const
+{
+	return AABB::fromCenterExtent(glm::vec3(centerX[index], centerY[index], centerZ[index]), glm::vec3(extentX[index], extentY[index], extentZ[index]));
+}
+
+uint32_t CullingSet::getCount() const
+{
+	return instanceCount;
+}
+
+uint32_t CullingSet::getPaddedCount() const
+{
+	return static_cast<uint32_t>(radius.size());
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/////////// FrustumCuller
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// An instance is outside when its center is farther than its projected radius behind one plane.
+// The projected radius of the box on the plane normal is |n.x| * e.x + |n.y| * e.y + |n.z| * e.z.
+
+uint32_t FrustumCuller::cullScalar(const Frustum& frustum, const CullingSet& cullingSet, std::vector<uint32_t>& outVisibleIndices)
+{
+	outVisibleIndices.resize(cullingSet.getCount());
+
+	uint32_t visibleCount = 0;
+	for (uint32_t i = 0; i < cullingSet.getCount(); i++)
+	{
+		bool inside = true;
+		for (int planeIndex = 0; planeIndex < Frustum::PLANE_COUNT && inside; planeIndex++)
+		{
+			const glm::vec4& plane = frustum.planes[planeIndex];
+			const float distance = plane.x * cullingSet.centerX[i] + plane.y * cullingSet.centerY[i] + plane.z * cullingSet.centerZ[i] + plane.w;
+			const float boxRadius = std::fabs(plane.x) * cullingSet.extentX[i] + std::fabs(plane.y) * cullingSet.extentY[i] + std::fabs(plane.z) * cullingSet.extentZ[i];
+			inside = distance >= -std::min(boxRadius, cullingSet.radius[i]);
+		}
+
+		outVisibleIndices[visibleCount] = i;
+		visibleCount += inside ? 1 : 0;
+	}
+
+	outVisibleIndices.resize(visibleCount);
+	return visibleCount;
+}
+
+#if defined(FRUSTUM_CULLING_AVX)
+
+uint32_t FrustumCuller::cull(const Frustum& frustum, const CullingSet& cullingSet, std::vector<uint32_t>& outVisibleIndices)
+{
+	outVisibleIndices.resize(cullingSet.getPaddedCount());
+	uint32_t* visibleIndices = outVisibleIndices.data();
+
+	__m256 planeX[Frustum::PLANE_COUNT], planeY[Frustum::PLANE_COUNT], planeZ[Frustum::PLANE_COUNT], planeW[Frustum::PLANE_COUNT];
+	__m256 absPlaneX[Frustum::PLANE_COUNT], absPlaneY[Frustum::PLANE_COUNT], absPlaneZ[Frustum::PLANE_COUNT];
+	for (int planeIndex = 0; planeIndex < Frustum::PLANE_COUNT; planeIndex++)
+	{
+		const glm::vec4& plane = frustum.planes[planeIndex];
+		planeX[planeIndex] = _mm256_set1_ps(plane.x);
+		planeY[planeIndex] = _mm256_set1_ps(plane.y);
+		planeZ[planeIndex] = _mm256_set1_ps(plane.z);
+		planeW[planeIndex] = _mm256_set1_ps(plane.w);
+		absPlaneX[planeIndex] = _mm256_set1_ps(std::fabs(plane.x));
+		absPlaneY[planeIndex] = _mm256_set1_ps(std::fabs(plane.y));
+		absPlaneZ[planeIndex] = _mm256_set1_ps(std::fabs(plane.z));
+	}
+
+	uint32_t visibleCount = 0;
+	for (uint32_t blockStart = 0; blockStart < cullingSet.getPaddedCount(); blockStart += 8)
+	{
+		const __m256 centerX = _mm256_loadu_ps(&cullingSet.centerX[blockStart]);
+		const __m256 centerY = _mm256_loadu_ps(&cullingSet.centerY[blockStart]);
+		const __m256 centerZ = _mm256_loadu_ps(&cullingSet.centerZ[blockStart]);
+		const __m256 extentX = _mm256_loadu_ps(&cullingSet.extentX[blockStart]);
+		const __m256 extentY = _mm256_loadu_ps(&cullingSet.extentY[blockStart]);
+		const __m256 extentZ = _mm256_loadu_ps(&cullingSet.extentZ[blockStart]);
+		const __m256 radius = _mm256_loadu_ps(&cullingSet.radius[blockStart]);
+
+		__m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+		for (int planeIndex = 0; planeIndex < Frustum::PLANE_COUNT; planeIndex++)
+		{
+			__m256 distance = _mm256_add_ps(_mm256_mul_ps(planeX[planeIndex], centerX), planeW[planeIndex]);
+			distance = _mm256_add_ps(distance, _mm256_mul_ps(planeY[planeIndex], centerY));
+			distance = _mm256_add_ps(distance, _mm256_mul_ps(planeZ[planeIndex], centerZ));
+
+			__m256 boxRadius = _mm256_mul_ps(absPlaneX[planeIndex], extentX);
+			boxRadius = _mm256_add_ps(boxRadius, _mm256_mul_ps(absPlaneY[planeIndex], extentY));
+			boxRadius = _mm256_add_ps(boxRadius, _mm256_mul_ps(absPlaneZ[planeIndex], extentZ));
+
+			// distance >= -radius <=> distance + radius >= 0
+			const __m256 signedDistance = _mm256_add_ps(distance, _mm256_min_ps(boxRadius, radius));
+			inside = _mm256_and_ps(inside, _mm256_cmp_ps(signedDistance, _mm256_setzero_ps(), _CMP_GE_OQ));
+		}
+
+		const int mask = _mm256_movemask_ps(inside);
+		for (uint32_t lane = 0; lane < 8; lane++)
+		{
+			visibleIndices[visibleCount] = blockStart + lane;
+			visibleCount += (mask >> lane) & 1;
+		}
+	}
+
+	outVisibleIndices.resize(visibleCount);
+	return visibleCount;
+}
+
+const char* FrustumCuller::getInstructionSetName()
+{
+	return "AVX";
+}
+
+#elif defined(FRUSTUM_CULLING_SSE)
+
+uint32_t FrustumCuller::cull(const Frustum& frustum, const CullingSet& cullingSet, std::vector<uint32_t>& outVisibleIndices)
+{
+	outVisibleIndices.resize(cullingSet.getPaddedCount());
+	uint32_t* visibleIndices = outVisibleIndices.data();
+
+	__m128 planeX[Frustum::PLANE_COUNT], planeY[Frustum::PLANE_COUNT], planeZ[Frustum::PLANE_COUNT], planeW[Frustum::PLANE_COUNT];
+	__m128 absPlaneX[Frustum::PLANE_COUNT], absPlaneY[Frustum::PLANE_COUNT], absPlaneZ[Frustum::PLANE_COUNT];
+	for (int planeIndex = 0; planeIndex < Frustum::PLANE_COUNT; planeIndex++)
+	{
+		const glm::vec4& plane = frustum.planes[planeIndex];
+		planeX[planeIndex] = _mm_set1_ps(plane.x);
+		planeY[planeIndex] = _mm_set1_ps(plane.y);
+		planeZ[planeIndex] = _mm_set1_ps(plane.z);
+		planeW[planeIndex] = _mm_set1_ps(plane.w);
+		absPlaneX[planeIndex] = _mm_set1_ps(std::fabs(plane.x));
+		absPlaneY[planeIndex] = _mm_set1_ps(std::fabs(plane.y));
+		absPlaneZ[planeIndex] = _mm_set1_ps(std::fabs(plane.z));
+	}
+
+	uint32_t visibleCount = 0;
+	for (uint32_t blockStart = 0; blockStart < cullingSet.getPaddedCount(); blockStart += 4)
+	{
+		const __m128 centerX = _mm_loadu_ps(&cullingSet.centerX[blockStart]);
+		const __m128 centerY = _mm_loadu_ps(&cullingSet.centerY[blockStart]);
+		const __m128 centerZ = _mm_loadu_ps(&cullingSet.centerZ[blockStart]);
+		const __m128 extentX = _mm_loadu_ps(&cullingSet.extentX[blockStart]);
+		const __m128 extentY = _mm_loadu_ps(&cullingSet.extentY[blockStart]);
+		const __m128 extentZ = _mm_loadu_ps(&cullingSet.extentZ[blockStart]);
+		const __m128 radius = _mm_loadu_ps(&cullingSet.radius[blockStart]);
+
+		__m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+		for (int planeIndex = 0; planeIndex < Frustum::PLANE_COUNT; planeIndex++)
+		{
+			__m128 distance = _mm_add_ps(_mm_mul_ps(planeX[planeIndex], centerX), planeW[planeIndex]);
+			distance = _mm_add_ps(distance, _mm_mul_ps(planeY[planeIndex], centerY));
+			distance = _mm_add_ps(distance, _mm_mul_ps(planeZ[planeIndex], centerZ));
+
+			__m128 boxRadius = _mm_mul_ps(absPlaneX[planeIndex], extentX);
+			boxRadius = _mm_add_ps(boxRadius, _mm_mul_ps(absPlaneY[planeIndex], extentY));
+			boxRadius = _mm_add_ps(boxRadius, _mm_mul_ps(absPlaneZ[planeIndex], extentZ));
+
+			// distance >= -radius <=> distance + radius >= 0
+			const __m128 signedDistance = _mm_add_ps(distance, _mm_min_ps(boxRadius, radius));
+			inside = _mm_and_ps(inside, _mm_cmpge_ps(signedDistance, _mm_setzero_ps()));
+		}
+
+		const int mask = _mm_movemask_ps(inside);
+		for (uint32_t lane = 0; lane < 4; lane++)
+		{
+			visibleIndices[visibleCount] = blockStart + lane;
+			visibleCount += (mask >> lane) & 1;
+		}
+	}
+
+	outVisibleIndices.resize(visibleCount);
+	return visibleCount;
+}
+
+const char* FrustumCuller::getInstructionSetName()
+{
+	return "SSE";
+}
+
+#else
+
+uint32_t FrustumCuller::cull(const Frustum& frustum, const CullingSet& cullingSet, std::vector<uint32_t>& outVisibleIndices)
+{
+	return cullScalar(frustum, cullingSet, outVisibleIndices);
+}
+
+const char* FrustumCuller::getInstructionSetName()
+{
+	return "scalar";
+}
+
+#endif
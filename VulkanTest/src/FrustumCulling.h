@@ -0,0 +1,57 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <vector>
+
+#include "Bounds.h"
+
+// World bounds of the culled instances stored as structure of arrays, so a block of instances
+// can be tested against a plane with a few SIMD instructions.
+// Each instance keeps its box and a radius around the box center : the culling uses whichever is the tightest.
+class CullingSet
+{
+private:
+	std::vector<float> centerX;
+	std::vector<float> centerY;
+	std::vector<float> centerZ;
+	std::vector<float> extentX;
+	std::vector<float> extentY;
+	std::vector<float> extentZ;
+	std::vector<float> radius;
+
+	uint32_t instanceCount = 0;
+
+public:
+	// arrays are padded to a multiple of the block size, the padding instances are never visible
+	static const uint32_t BLOCK_SIZE = 8;
+
+	// new instances are never visible until their bounds are set
+	void resize(uint32_t count);
+	void clear();
+
+	void setBounds(uint32_t index, const Bounds& worldBounds);
+	void setBounds(uint32_t index, const Bounds& localBounds, const glm::mat4& transform);
+
+	// box of an instance, as used by the culling
+	AABB getBox(uint32_t index) const;
+
+	uint32_t getCount() const;
+	// number of instances including the padding
+	uint32_t getPaddedCount() const;
+
+	friend class FrustumCuller;
+};
+
+class FrustumCuller
+{
+public:
+	// Write the indices of the instances intersecting the frustum to outVisibleIndices and return their count.
+	// outVisibleIndices keeps its capacity between calls so culling every frame doesn't allocate.
+	// Uses 8 instances per iteration with AVX, 4 with SSE, one otherwise.
+	static uint32_t cull(const Frustum& frustum, const CullingSet& cullingSet, std::vector<uint32_t>& outVisibleIndices);
+	// reference version, used when no SIMD instruction set is available
+	static uint32_t cullScalar(const Frustum& frustum, const CullingSet& cullingSet, std::vector<uint32_t>& outVisibleIndices);
+
+	static const char* getInstructionSetName();
+};
@@ -0,0 +1,281 @@
+#include "GeometryPool.h"
+
+#include <algorithm>
+#include <cassert>
+#include <stdexcept>
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/////////// RangeAllocator
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+const uint32_t RangeAllocator::INVALID_OFFSET;
+
+void RangeAllocator::reset(uint32_t _capacity)
+{
+	capacity = _capacity;
+	freeRanges.clear();
+	if (capacity > 0)
+		freeRanges.push_back(Range{ 0, capacity });
+}
+
+uint32_t RangeAllocator::allocate(uint32_t count)
+{
+	for (auto it = freeRanges.begin(); it != freeRanges.end(); ++it)
+	{
+		if (it->count < count)
+			continue;
+
+		const uint32_t offset = it->offset;
+		it->offset += count;
+		it->count -= count;
+		if (it->count == 0)
+			freeRanges.erase(it);
+
+		return offset;
+	}
+
+	return INVALID_OFFSET;
+}
+
+void RangeAllocator::free(uint32_t offset, uint32_t count)
+{
+	if (count == 0)
+		return;
+
+	assert(offset + count <= capacity);
+
+	auto next = std::lower_bound(freeRanges.begin(), freeRanges.end(), offset, [](const Range& range, uint32_t value)
+	{
+		return range.offset < value;
+	});
+	next = freeRanges.insert(next, Range{ offset, count });
+
+	// merge with the following range
+	auto following = next + 1;
+	if (following != freeRanges.end() && next->offset + next->count == following->offset)
+	{
+		next->count += following->count;
+		freeRanges.erase(following);
+	}
+
+	// merge with the previous range
+	if (next != freeRanges.begin())
+	{
+		auto previous = next - 1;
+		if (previous->offset + previous->count == next->offset)
+		{
+			previous->count += next->count;
+			freeRanges.erase(next);
+		}
+	}
+}
+
+uint32_t RangeAllocator::getCapacity() const
+{
+	return capacity;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/////////// GeometryPool
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void GeometryPool::create(VkPhysicalDevice _physicalDevice, VkDevice _device, VkCommandPool _commandPool, VkQueue _transferQueue, uint32_t frameCount, const GeometryPoolCreateInfo& _createInfo)
+{
+	physicalDevice = _physicalDevice;
+	device = _device;
+	commandPool = _commandPool;
+	transferQueue = _transferQueue;
+	createInfo = _createInfo;
+
+	pendingFreesPerFrame.assign(frameCount > 0 ? frameCount : 1, std::vector<GeometryAllocation>());
+	currentFrame = 0;
+}
+
+void GeometryPool::destroy()
+{
+	for (auto& block : blocks)
+	{
+		block->vertexBuffer.destroy();
+		block->indexBuffer.destroy();
+	}
+	blocks.clear();
+
+	for (auto& pendingFrees : pendingFreesPerFrame)
+		pendingFrees.clear();
+}
+
+void GeometryPool::beginFrame(uint32_t frameIndex)
+{
+	currentFrame = frameIndex % pendingFreesPerFrame.size();
+
+	std::vector<GeometryAllocation>& pendingFrees = pendingFreesPerFrame[currentFrame];
+	for (const GeometryAllocation& allocation : pendingFrees)
+		release(allocation);
+	pendingFrees.clear();
+}
+
+void GeometryPool::addBlock()
+{
+	std::unique_ptr<GeometryPoolBlock> block = std::make_unique<GeometryPoolBlock>();
+
+	{
+		BufferCreateInfo bufferCreateInfo = {};
+		bufferCreateInfo.itemCount = createInfo.verticesPerBlock;
+		bufferCreateInfo.itemSizeNotAligned = createInfo.vertexStride;
+		bufferCreateInfo.owningDevice = device;
+		bufferCreateInfo.physicalDevice = physicalDevice;
+		bufferCreateInfo.usage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT;
+
+		block->vertexBuffer.create(bufferCreateInfo, true);
+	}
+
+	{
+		BufferCreateInfo bufferCreateInfo = {};
+		bufferCreateInfo.itemCount = createInfo.indicesPerBlock;
+		bufferCreateInfo.itemSizeNotAligned = createInfo.indexType == VK_INDEX_TYPE_UINT16 ? sizeof(uint16_t) : sizeof(uint32_t);
+		bufferCreateInfo.owningDevice = device;
+		bufferCreateInfo.physicalDevice = physicalDevice;
+		bufferCreateInfo.usage = VK_BUFFER_USAGE_INDEX_BUFFER_BIT;
+
+		block->indexBuffer.create(bufferCreateInfo, true);
+	}
+
+	block->vertexRanges.reset(createInfo.verticesPerBlock);
+	block->indexRanges.reset(createInfo.indicesPerBlock);
+
+	blocks.push_back(std::move(block));
+}
+
+GeometryAllocation GeometryPool::allocate(const void* vertices, uint32_t vertexCount, const uint32_t* indices, uint32_t indexCount)
+{
+	return allocate(vertices, vertexCount, indices, VK_INDEX_TYPE_UINT32, indexCount);
+}
+
+GeometryAllocation GeometryPool::allocate(const void* vertices, uint32_t vertexCount, const void* indices, VkIndexType sourceIndexType, uint32_t indexCount)
+{
+	if (vertexCount > createInfo.verticesPerBlock || indexCount > createInfo.indicesPerBlock)
+		throw std::runtime_error("mesh too large for the geometry pool blocks !");
+
+	if (createInfo.indexType == VK_INDEX_TYPE_UINT16 && vertexCount > 0x10000)
+		throw std::runtime_error("mesh has too many vertices for a 16 bits geometry pool !");
+
+	GeometryAllocation allocation;
+	for (uint32_t blockIndex = 0; blockIndex <= blocks.size() && !allocation.isValid(); blockIndex++)
+	{
+		if (blockIndex == blocks.size())
+			addBlock();
+
+		GeometryPoolBlock& block = *blocks[blockIndex];
+		const uint32_t vertexOffset = block.vertexRanges.allocate(vertexCount);
+		if (vertexOffset == RangeAllocator::INVALID_OFFSET)
+			continue;
+
+		const uint32_t firstIndex = block.indexRanges.allocate(indexCount);
+		if (firstIndex == RangeAllocator::INVALID_OFFSET)
+		{
+			block.vertexRanges.free(vertexOffset, vertexCount);
+			continue;
+		}
+
+		allocation.blockIndex = blockIndex;
+		allocation.vertexOffset = vertexOffset;
+		allocation.vertexCount = vertexCount;
+		allocation.firstIndex = firstIndex;
+		allocation.indexCount = indexCount;
+	}
+
+	GeometryPoolBlock& block = *blocks[allocation.blockIndex];
+
+	block.vertexBuffer.pushDatasToBuffer(vertices, BufferCopyInfo::makeFromItem(vertexCount, 0, allocation.vertexOffset)
+		, true, physicalDevice, commandPool, transferQueue);
+
+	if (sourceIndexType == createInfo.indexType)
+	{
+		block.indexBuffer.pushDatasToBuffer(indices, BufferCopyInfo::makeFromItem(indexCount, 0, allocation.firstIndex)
+			, true, physicalDevice, commandPool, transferQueue);
+	}
+	else if (createInfo.indexType == VK_INDEX_TYPE_UINT16)
+	{
+		const uint32_t* sourceIndices = static_cast<const uint32_t*>(indices);
+		std::vector<uint16_t> narrowedIndices(sourceIndices, sourceIndices + indexCount);
+		block.indexBuffer.pushDatasToBuffer(narrowedIndices.data(), BufferCopyInfo::makeFromItem(indexCount, 0, allocation.firstIndex)
+			, true, physicalDevice, commandPool, transferQueue);
+	}
+	else
+	{
+		const uint16_t* sourceIndices = static_cast<const uint16_t*>(indices);
+		std::vector<uint32_t> widenedIndices(sourceIndices, sourceIndices + indexCount);
+		block.indexBuffer.pushDatasToBuffer(widenedIndices.data(), BufferCopyInfo::makeFromItem(indexCount, 0, allocation.firstIndex)
+			, true, physicalDevice, commandPool, transferQueue);
+	}
+
+	return allocation;
+}
+
+void GeometryPool::free(GeometryAllocation& allocation)
+{
+	if (!allocation.isValid())
+		return;
+
+	// command buffers of the frames in flight may still read the ranges
+	pendingFreesPerFrame[currentFrame].push_back(allocation);
+
+	allocation = GeometryAllocation();
+}
+
+void GeometryPool::release(const GeometryAllocation& allocation)
+{
+	GeometryPoolBlock& block = *blocks[allocation.blockIndex];
+	block.vertexRanges.free(allocation.vertexOffset, allocation.vertexCount);
+	block.indexRanges.free(allocation.firstIndex, allocation.indexCount);
+}
+
+void GeometryPool::cmdBindBuffers(VkCommandBuffer commandBuffer, uint32_t blockIndex) const
+{
+	const GeometryPoolBlock& block = *blocks[blockIndex];
+
+	VkDeviceSize offsets[] = { 0 };
+	vkCmdBindVertexBuffers(commandBuffer, 0, 1, block.vertexBuffer.getBufferHandle(), offsets);
+	vkCmdBindIndexBuffer(commandBuffer, *block.indexBuffer.getBufferHandle(), 0, createInfo.indexType);
+}
+
+const GeometryPoolBlock& GeometryPool::getBlock(uint32_t blockIndex) const
+{
+	return *blocks[blockIndex];
+}
+
+uint32_t GeometryPool::getBlockCount() const
+{
+	return static_cast<uint32_t>(blocks.size());
+}
+
+VkIndexType GeometryPool::getIndexType() const
+{
+	return createInfo.indexType;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/////////// GeometryPoolRegistry
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void GeometryPoolRegistry::create(VkPhysicalDevice _physicalDevice, VkDevice _device, VkCommandPool _commandPool, VkQueue _transferQueue, uint32_t _frameCount)
+{
+	physicalDevice = _physicalDevice;
+	device = _device;
+	commandPool = _commandPool;
+	transferQueue = _transferQueue;
+	frameCount = _frameCount;
+}
+
+void GeometryPoolRegistry::destroy()
+{
+	for (auto& pool : pools)
+		pool.second->destroy();
+	pools.clear();
+}
+
+void GeometryPoolRegistry::beginFrame(uint32_t frameIndex)
+{
+	for (auto& pool : pools)
+		pool.second->beginFrame(frameIndex);
+}
@@ -0,0 +1,156 @@
+#pragma once
+
+#include <vulkan/vulkan.hpp>
+
+#include <map>
+#include <memory>
+#include <typeindex>
+#include <utility>
+#include <vector>
+
+#include "Buffer.h"
+
+// First fit allocator of item ranges inside a fixed capacity.
+// Freed ranges are merged with their free neighbors.
+class RangeAllocator
+{
+private:
+	struct Range
+	{
+		uint32_t offset;
+		uint32_t count;
+	};
+
+	// sorted by offset
+	std::vector<Range> freeRanges;
+	uint32_t capacity = 0;
+
+public:
+	static const uint32_t INVALID_OFFSET = ~0u;
+
+	void reset(uint32_t _capacity);
+	// return INVALID_OFFSET if no free range is large enough
+	uint32_t allocate(uint32_t count);
+	void free(uint32_t offset, uint32_t count);
+
+	uint32_t getCapacity() const;
+};
+
+struct GeometryPoolCreateInfo
+{
+	uint32_t vertexStride;
+	VkIndexType indexType = VK_INDEX_TYPE_UINT32;
+	uint32_t verticesPerBlock = 1 << 20;
+	uint32_t indicesPerBlock = 3 << 20;
+};
+
+// Place of a mesh inside a pool : indices are relative to vertexOffset
+struct GeometryAllocation
+{
+	static const uint32_t INVALID_BLOCK = ~0u;
+
+	uint32_t blockIndex = INVALID_BLOCK;
+	uint32_t vertexOffset = 0;
+	uint32_t vertexCount = 0;
+	uint32_t firstIndex = 0;
+	uint32_t indexCount = 0;
+
+	bool isValid() const
+	{
+		return blockIndex != INVALID_BLOCK;
+	}
+};
+
+// A vertex and an index buffer shared by many meshes
+struct GeometryPoolBlock
+{
+	Buffer vertexBuffer;
+	Buffer indexBuffer;
+	RangeAllocator vertexRanges;
+	RangeAllocator indexRanges;
+};
+
+// Sub allocates the meshes of one vertex format inside a few large buffers,
+// so all the meshes of a block are drawn with a single vertex and index buffer bind.
+// A new block is created when the existing ones are full.
+// Freed ranges are reused once the frames in flight when they were freed are done, see beginFrame().
+class GeometryPool
+{
+private:
+	VkPhysicalDevice physicalDevice;
+	VkDevice device;
+	VkCommandPool commandPool;
+	VkQueue transferQueue;
+	GeometryPoolCreateInfo createInfo;
+
+	// blocks are never moved, their address is used as a binding key by the render batches
+	std::vector<std::unique_ptr<GeometryPoolBlock>> blocks;
+
+	// allocations freed during each frame slot, pending frames may still draw them
+	std::vector<std::vector<GeometryAllocation>> pendingFreesPerFrame;
+	uint32_t currentFrame = 0;
+
+	void addBlock();
+	void release(const GeometryAllocation& allocation);
+
+public:
+	void create(VkPhysicalDevice _physicalDevice, VkDevice _device, VkCommandPool _commandPool, VkQueue _transferQueue, uint32_t frameCount, const GeometryPoolCreateInfo& _createInfo);
+	void destroy();
+
+	// call once the fence of the frame slot is signaled, the ranges freed during its last use become reusable
+	void beginFrame(uint32_t frameIndex);
+
+	// copy the mesh to the pool, indices are given relative to the first vertex of the mesh
+	// throw if the mesh is larger than a block or if its indices can't be stored with the pool index type
+	GeometryAllocation allocate(const void* vertices, uint32_t vertexCount, const uint32_t* indices, uint32_t indexCount);
+	// same with indices of any type, they are converted to the pool index type if needed
+	GeometryAllocation allocate(const void* vertices, uint32_t vertexCount, const void* indices, VkIndexType sourceIndexType, uint32_t indexCount);
+	// the ranges are reused when the current frame slot comes back, the allocation is reset
+	void free(GeometryAllocation& allocation);
+
+	void cmdBindBuffers(VkCommandBuffer commandBuffer, uint32_t blockIndex) const;
+
+	const GeometryPoolBlock& getBlock(uint32_t blockIndex) const;
+	uint32_t getBlockCount() const;
+	VkIndexType getIndexType() const;
+};
+
+// One geometry pool per vertex type and index type, created on first use.
+// Meshes with few vertices go to the 16 bits pool of their vertex type, see MeshOptimizer::selectIndexType().
+class GeometryPoolRegistry
+{
+private:
+	typedef std::pair<std::type_index, VkIndexType> PoolKey;
+
+	VkPhysicalDevice physicalDevice;
+	VkDevice device;
+	VkCommandPool commandPool;
+	VkQueue transferQueue;
+	uint32_t frameCount = 1;
+
+	std::map<PoolKey, std::unique_ptr<GeometryPool>> pools;
+
+public:
+	void create(VkPhysicalDevice _physicalDevice, VkDevice _device, VkCommandPool _commandPool, VkQueue _transferQueue, uint32_t _frameCount);
+	void destroy();
+
+	// forward the frame slot to all the pools
+	void beginFrame(uint32_t frameIndex);
+
+	template<typename VertexType>
+	GeometryPool& getPool(VkIndexType indexType = VK_INDEX_TYPE_UINT32)
+	{
+		std::unique_ptr<GeometryPool>& pool = pools[PoolKey(std::type_index(typeid(VertexType)), indexType)];
+		if (!pool)
+		{
+			GeometryPoolCreateInfo createInfo = {};
+			createInfo.vertexStride = sizeof(VertexType);
+			createInfo.indexType = indexType;
+
+			pool = std::make_unique<GeometryPool>();
+			pool->create(physicalDevice, device, commandPool, transferQueue, frameCount, createInfo);
+		}
+
+		return *pool;
+	}
+};
@@ -18,7 +18,8 @@ void GraphicsContext::createInstance(const RenderSetup& renderSetup)
 	appInfos.applicationVersion = VK_MAKE_VERSION(0, 1, 0);
 	appInfos.engineVersion = VK_MAKE_VERSION(0, 1, 0);
 	appInfos.pEngineName = "Volcano";
-	appInfos.apiVersion = VK_API_VERSION_1_0;
+	// 1.1 for descriptor update templates
+	appInfos.apiVersion = VK_API_VERSION_1_1;
 
 	VkInstanceCreateInfo createInfo;
 	createInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
@@ -131,6 +132,45 @@ void GraphicsContext::createCommandPool()
 	}
 }
 
+void GraphicsContext::createDescriptorAllocator(uint32_t frameCount)
+{
+	descriptorAllocator = std::make_unique<DescriptorAllocator>();
+	descriptorAllocator->create(DescriptorAllocatorCreateInfo::makeDefault(device, frameCount));
+}
+
+void GraphicsContext::createDescriptorSetLayoutCache()
+{
+	descriptorSetLayoutCache = std::make_unique<DescriptorSetLayoutCache>();
+	descriptorSetLayoutCache->create(device);
+}
+
+void GraphicsContext::createBindlessTextureTable(uint32_t frameCount)
+{
+	if (!bindlessTexturesEnabled)
+		return;
+
+	bindlessTextureTable = std::make_unique<BindlessTextureTable>();
+	bindlessTextureTable->create(physicalDevice, device, frameCount);
+}
+
+void GraphicsContext::createMaterialParameterUploader(uint32_t frameCount)
+{
+	materialParameterUploader = std::make_unique<MaterialParameterUploader>();
+	materialParameterUploader->create(physicalDevice, device, queueFamilies.graphicFamily, graphicsQueue, frameCount);
+}
+
+void GraphicsContext::createGeometryPools(uint32_t frameCount)
+{
+	geometryPools = std::make_unique<GeometryPoolRegistry>();
+	geometryPools->create(physicalDevice, device, commandPool, graphicsQueue, frameCount);
+}
+
+void GraphicsContext::createBonePalette(uint32_t frameCount)
+{
+	bonePalette = std::make_unique<BonePaletteBuffer>();
+	bonePalette->create(physicalDevice, device, frameCount);
+}
+
 void GraphicsContext::createDevice(const RenderSetup& renderSetup) 
 {
 	std::vector<VkDeviceQueueCreateInfo> queueCreateInfos = {};
@@ -147,16 +187,38 @@ void GraphicsContext::createDevice(const RenderSetup& renderSetup)
 		queueCreateInfos.push_back(queueCreateInfo);
 	}
 
-	const VkPhysicalDeviceFeatures& deviceFeatures = renderSetup.requiredDeviceFeatures;
-	const std::vector<const char*>& deviceExtensions = renderSetup.deviceExtensions;
+	std::vector<const char*> deviceExtensions = renderSetup.deviceExtensions;
 	bool enableValidationLayers = renderSetup.validationLayersEnabled;
 	const std::vector<const char*>& validationLayers = renderSetup.validationLayers;
 
+	// Features are given through VkPhysicalDeviceFeatures2 to chain the descriptor indexing ones
+	VkPhysicalDeviceFeatures2 deviceFeatures = {};
+	deviceFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+	deviceFeatures.features = renderSetup.requiredDeviceFeatures;
+
+	VkPhysicalDeviceDescriptorIndexingFeaturesEXT indexingFeatures = {};
+	indexingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT;
+
+	// fallback to the per set texture path if the device can't handle bindless textures
+	bindlessTexturesEnabled = renderSetup.bindlessTexturesRequested && BindlessTextureTable::isSupported(physicalDevice);
+	if (bindlessTexturesEnabled)
+	{
+		BindlessTextureTable::appendRequiredDeviceExtensions(deviceExtensions);
+
+		indexingFeatures.shaderSampledImageArrayNonUniformIndexing = VK_TRUE;
+		indexingFeatures.runtimeDescriptorArray = VK_TRUE;
+		indexingFeatures.descriptorBindingPartiallyBound = VK_TRUE;
+		indexingFeatures.descriptorBindingVariableDescriptorCount = VK_TRUE;
+		indexingFeatures.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+		deviceFeatures.pNext = &indexingFeatures;
+	}
+
 	VkDeviceCreateInfo createInfo = {};
 	createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+	createInfo.pNext = &deviceFeatures;
 	createInfo.queueCreateInfoCount = static_cast<uint32_t>(queueCreateInfos.size());
 	createInfo.pQueueCreateInfos = queueCreateInfos.data();
-	createInfo.pEnabledFeatures = &deviceFeatures;
+	createInfo.pEnabledFeatures = nullptr;
 	createInfo.enabledExtensionCount = static_cast<uint32_t>(deviceExtensions.size());
 	createInfo.ppEnabledExtensionNames = deviceExtensions.data();
 	if (enableValidationLayers) {
@@ -179,6 +241,30 @@ void GraphicsContext::createDevice(const RenderSetup& renderSetup)
 
 void GraphicsContext::destroy()
 {
+	if (descriptorAllocator)
+		descriptorAllocator->destroy();
+	descriptorAllocator.reset();
+
+	if (descriptorSetLayoutCache)
+		descriptorSetLayoutCache->destroy();
+	descriptorSetLayoutCache.reset();
+
+	if (bindlessTextureTable)
+		bindlessTextureTable->destroy();
+	bindlessTextureTable.reset();
+
+	if (materialParameterUploader)
+		materialParameterUploader->destroy();
+	materialParameterUploader.reset();
+
+	if (geometryPools)
+		geometryPools->destroy();
+	geometryPools.reset();
+
+	if (bonePalette)
+		bonePalette->destroy();
+	bonePalette.reset();
+
 	vkDestroyDevice(device, nullptr);
 	DestroyDebugReportCallbackEXT(instance, callback, nullptr);
 
@@ -213,6 +299,36 @@ VkCommandPool GraphicsContext::getCommandPool() const
 	return commandPool;
 }
 
+DescriptorAllocator& GraphicsContext::getDescriptorAllocator() const
+{
+	return *descriptorAllocator;
+}
+
+DescriptorSetLayoutCache& GraphicsContext::getDescriptorSetLayoutCache() const
+{
+	return *descriptorSetLayoutCache;
+}
+
+BindlessTextureTable* GraphicsContext::getBindlessTextureTable() const
+{
+	return bindlessTextureTable.get();
+}
+
+MaterialParameterUploader& GraphicsContext::getMaterialParameterUploader() const
+{
+	return *materialParameterUploader;
+}
+
+GeometryPoolRegistry& GraphicsContext::getGeometryPools() const
+{
+	return *geometryPools;
+}
+
+BonePaletteBuffer& GraphicsContext::getBonePalette() const
+{
+	return *bonePalette;
+}
+
 //////////////////////////////////////////////
 
 void WindowContext::createSurface(VkInstance instance, GLFWwindow& window)
@@ -228,6 +344,14 @@ void WindowContext::createSwapChain(const glm::vec2& windowSize, VkPhysicalDevic
 	VkPresentModeKHR presentMode = chooseSwapPresentMode(swapChainSupport.presentMode);
 	VkExtent2D extent = chooseSwapExtent(windowSize, swapChainSupport.capabilities);
 
+	// when recreating, the views of the old images go away and the old swapchain is handed to the new one
+	// so the presentation engine can reuse its resources and finish presenting its images
+	VkSwapchainKHR oldSwapChain = swapChain;
+	for (auto& imageView : swapChainImageViews)
+		vkDestroyImageView(device, imageView, nullptr);
+	swapChainImageViews.clear();
+	swapChainImages.clear();
+
 	uint32_t imageCount = swapChainSupport.capabilities.minImageCount + 1;
 	if (swapChainSupport.capabilities.maxImageCount > 0
 		&& imageCount > swapChainSupport.capabilities.maxImageCount)
@@ -261,12 +385,15 @@ void WindowContext::createSwapChain(const glm::vec2& windowSize, VkPhysicalDevic
 	createInfo.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
 	createInfo.presentMode = presentMode;
 	createInfo.clipped = VK_TRUE;
-	createInfo.oldSwapchain = VK_NULL_HANDLE;
+	createInfo.oldSwapchain = oldSwapChain;
 
 	if (vkCreateSwapchainKHR(device, &createInfo, nullptr, &swapChain) != VK_SUCCESS) {
 		throw std::runtime_error("failed to create swap chain !");
 	}
 
+	if (oldSwapChain != VK_NULL_HANDLE)
+		vkDestroySwapchainKHR(device, oldSwapChain, nullptr);
+
 	// Get images
 	{
 		vkGetSwapchainImagesKHR(device, swapChain, &imageCount, nullptr);
@@ -303,14 +430,20 @@ void WindowContext::createSwapChain(const glm::vec2& windowSize, VkPhysicalDevic
 	}
 }
 
-void WindowContext::cleanupSwapChain()
+void WindowContext::cleanupSwapChain(VkDevice device)
 {
-	//TODO
+	for (auto& imageView : swapChainImageViews)
+		vkDestroyImageView(device, imageView, nullptr);
+	swapChainImageViews.clear();
+	swapChainImages.clear();
+
+	vkDestroySwapchainKHR(device, swapChain, nullptr);
+	swapChain = VK_NULL_HANDLE;
 }
 
-void WindowContext::destroy(VkInstance instance)
+void WindowContext::destroy(VkInstance instance, VkDevice device)
 {
-	cleanupSwapChain();
+	cleanupSwapChain(device);
 	vkDestroySurfaceKHR(instance, surface, nullptr);
 }
 
@@ -364,6 +497,11 @@ VkSwapchainKHR WindowContext::getSwapChain() const
 	return swapChain;
 }
 
+VkExtent2D WindowContext::getSwapChainExtent() const
+{
+	return swapChainExtent;
+}
+
 uint32_t WindowContext::getImageCount() const
 {
 	return swapChainImages.size();
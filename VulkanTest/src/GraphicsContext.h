@@ -3,6 +3,15 @@
 #include <vulkan/vulkan.hpp>
 #include <glm/glm.hpp>
 
+#include <memory>
+
+#include "DescriptorAllocator.h"
+#include "DescriptorSetLayoutCache.h"
+#include "BindlessTextureTable.h"
+#include "MaterialParameterBlock.h"
+#include "GeometryPool.h"
+#include "BonePalette.h"
+
 class Renderer;
 struct RenderSetup;
 class GLFWwindow;
@@ -30,6 +39,14 @@ private:
 	VkQueue presentQueue;
 	VkDebugReportCallbackEXT callback;
 	VkCommandPool commandPool;
+	std::unique_ptr<DescriptorAllocator> descriptorAllocator;
+	std::unique_ptr<DescriptorSetLayoutCache> descriptorSetLayoutCache;
+	// only created when the device supports descriptor indexing and the setup requested it
+	std::unique_ptr<BindlessTextureTable> bindlessTextureTable;
+	bool bindlessTexturesEnabled = false;
+	std::unique_ptr<MaterialParameterUploader> materialParameterUploader;
+	std::unique_ptr<GeometryPoolRegistry> geometryPools;
+	std::unique_ptr<BonePaletteBuffer> bonePalette;
 
 public:
 	void createInstance(const RenderSetup& renderSetup);
@@ -38,12 +55,25 @@ public:
 	void createDevice(const RenderSetup& renderSetup);
 	void initQueueFamilies(VkPhysicalDevice physicalDevice, VkSurfaceKHR surface);
 	void createCommandPool();
+	void createDescriptorAllocator(uint32_t frameCount);
+	void createDescriptorSetLayoutCache();
+	void createBindlessTextureTable(uint32_t frameCount);
+	void createMaterialParameterUploader(uint32_t frameCount);
+	void createGeometryPools(uint32_t frameCount);
+	void createBonePalette(uint32_t frameCount);
 	void destroy();
 
 	VkInstance getInstance() const;
 	VkDevice getDevice() const;
 	VkPhysicalDevice getPhysicalDevice() const;
 	VkCommandPool getCommandPool() const;
+	DescriptorAllocator& getDescriptorAllocator() const;
+	DescriptorSetLayoutCache& getDescriptorSetLayoutCache() const;
+	// nullptr when bindless textures are disabled : use the per set texture path
+	BindlessTextureTable* getBindlessTextureTable() const;
+	MaterialParameterUploader& getMaterialParameterUploader() const;
+	GeometryPoolRegistry& getGeometryPools() const;
+	BonePaletteBuffer& getBonePalette() const;
 
 	inline const QueueFamilies& getQueueFamilies() const
 	{
@@ -72,7 +102,7 @@ class WindowContext
 
 private:
 	VkSurfaceKHR surface;
-	VkSwapchainKHR swapChain;
+	VkSwapchainKHR swapChain = VK_NULL_HANDLE;
 	std::vector<VkImage> swapChainImages;
 	std::vector<VkImageView> swapChainImageViews;
 	VkFormat swapChainImageFormat;
@@ -80,10 +110,11 @@ private:
 
 public:
 	void createSurface(VkInstance instance, GLFWwindow& window);
+	// also recreates the swapchain, the previous one is retired then destroyed
 	void createSwapChain(const glm::vec2& windowSize, VkPhysicalDevice physicalDevice, VkDevice device, GraphicsContext::QueueFamilies queueFamilies);
 	
-	void cleanupSwapChain();
-	void destroy(VkInstance instance);
+	void cleanupSwapChain(VkDevice device);
+	void destroy(VkInstance instance, VkDevice device);
 
 	VkSurfaceFormatKHR chooseSwapSurfaceFormat(const std::vector<VkSurfaceFormatKHR>& availableFormats);
 	VkPresentModeKHR chooseSwapPresentMode(const std::vector<VkPresentModeKHR>& availablePresentModes);
@@ -91,6 +122,7 @@ public:
 
 	VkSurfaceKHR getSurface() const;
 	VkSwapchainKHR getSwapChain() const;
+	VkExtent2D getSwapChainExtent() const;
 	uint32_t getImageCount() const;
 	VkImage getImage(uint32_t imageIndex) const;
 	VkImageView getImageView(uint32_t imageIndex) const;
@@ -3,11 +3,14 @@
 #include <vulkan/vulkan.hpp>
 #include <glm/glm.hpp>
 
+#include <algorithm>
 #include <unordered_map>
 
 #include "VulkanUtils.h"
 #include "MaterialInputs.h"
 #include "Pipeline.h"
+#include "ShaderReflection.h"
+#include "MaterialVariant.h"
 
 class GraphicsContext;
 
@@ -17,8 +20,6 @@ public:
 	virtual void createGPUSide(const GraphicsContext& context) = 0;
 	virtual void destroyGPUSide() = 0;
 
-	virtual void createDescriptorPool(const GraphicsContext& context) = 0;
-
 	virtual void cmdBindPipeline(VkCommandBuffer commandBuffer, RenderableType renderableType, VkRenderPass currentPass, uint32_t currentSubpass) = 0;
 	virtual void cmdBindGlobalUniforms(VkCommandBuffer commandBuffer) = 0;
 	virtual void cmdBindLocalUniforms(VkCommandBuffer commandBuffer) = 0;
@@ -30,6 +31,42 @@ struct MaterialPipelineKey
 	RenderableType renderableType;
 	VkRenderPass renderPass;
 	uint32_t subPass;
+	// each variant has its own pipeline, compiled with its specialization constants
+	MaterialFeatureFlags features;
+
+	bool operator==(const MaterialPipelineKey& other) const
+	{
+		return renderableType == other.renderableType && renderPass == other.renderPass && subPass == other.subPass && features == other.features;
+	}
+};
+
+struct MaterialPipelineKeyHash
+{
+	size_t operator()(const MaterialPipelineKey& key) const
+	{
+		size_t hash = std::hash<uint64_t>()(reinterpret_cast<uint64_t>(key.renderPass));
+		hash ^= std::hash<uint32_t>()((static_cast<uint32_t>(key.renderableType) << 24) ^ (key.subPass << 16) ^ key.features) + 0x9e3779b9 + (hash << 6) + (hash >> 2);
+		return hash;
+	}
+};
+
+// Descriptor set indices used by material pipelines.
+// The bindless texture table is only present when the GraphicsContext provides one.
+enum MaterialSetIndex : uint32_t
+{
+	MATERIAL_SET_GLOBAL = 0,
+	MATERIAL_SET_LOCAL = 1,
+	MATERIAL_SET_RENDERABLE = 2,
+	MATERIAL_SET_BINDLESS_TEXTURES = 3
+};
+
+// Bindings of the renderable set
+enum MaterialRenderableBinding : uint32_t
+{
+	// dynamic uniform buffer of the renderable datas (ex : SkeletonMeshMaterialInputDatas)
+	MATERIAL_RENDERABLE_BINDING_DATAS = 0,
+	// storage buffer of the bones of the frame, skeletal meshes only
+	MATERIAL_RENDERABLE_BINDING_BONE_PALETTE = 1
 };
 
 class Material final : public MaterialInterface
@@ -38,24 +75,46 @@ private:
 	std::string vertexShaderPath;
 	std::string fragmentShaderPath;
 
+	// loaded once in createGPUSide, reused for every pipeline
+	std::vector<char> vertexShaderCode;
+	std::vector<char> fragmentShaderCode;
+	// merged reflection of all stages, give the layouts of the input sets and the push constant ranges
+	ShaderReflectionData shaderReflection;
+
 	VkDevice owningDevice;
+	DescriptorAllocator* descriptorAllocator;
+	// null if bindless textures are disabled, textures are then bound with the local set
+	BindlessTextureTable* bindlessTable;
 
 	MaterialInputSet materialGlobalInputs;
 	MaterialInputSet materialLocalInputs;
 	std::unordered_map<RenderableType, MaterialInputSet> materialRenderableInputs;
-	//MaterialDescriptors<3> materialData;
-	VkDescriptorPool descriptorPoolGlobalInputs;
-	VkDescriptorPool descriptorPoolLocalInputs;
-	std::unordered_map<RenderableType, VkDescriptorPool> descriptorPoolRenderableInputs;
 
-	std::unordered_map<materialPipelineKey, std::unique_ptr<Pipeline>> pipelines;
+	std::unordered_map<MaterialPipelineKey, std::unique_ptr<Pipeline>, MaterialPipelineKeyHash> pipelines;
+
+	// features the shaders implement, other bits are ignored
+	MaterialFeatureFlags supportedFeatures;
+	// features used when the material itself is bound
+	MaterialFeatureFlags enabledFeatures;
+	// variants used by the material and its instances, a pipeline is compiled for each of them
+	std::vector<MaterialFeatureFlags> variants;
 
 	std::vector<MaterialInstance*> instances;
 
+	// layout of the last pipeline bound, used to bind sets and push constants
+	VkPipelineLayout boundPipelineLayout;
+
 public:
 	// Il reste a creer le pipeline et l'ajouter par ref au renderer
 
 	Material()
+		: owningDevice(VK_NULL_HANDLE)
+		, descriptorAllocator(nullptr)
+		, bindlessTable(nullptr)
+		, supportedFeatures(0)
+		, enabledFeatures(0)
+		, variants(1, 0)
+		, boundPipelineLayout(VK_NULL_HANDLE)
 	{
 
 	}
@@ -71,23 +130,76 @@ public:
 	void createGPUSide(const GraphicsContext& context) override
 	{
 		owningDevice = context.getDevice();
+		descriptorAllocator = &context.getDescriptorAllocator();
+		bindlessTable = context.getBindlessTextureTable();
 
-		createDescriptorPool(context);
+		loadShaders();
 
-		materialGlobalInputs.createGPUSide(context, descriptorPoolGlobalInputs);
-		materialLocalInputs.createGPUSide(context, descriptorPoolLocalInputs);
+		// skeletal meshes read their bones in the palette of the frame, the input is dropped if the shaders don't use it
+		MaterialInputSet& skeletalMeshInputs = materialRenderableInputs[RenderableType::PIPELINE_TYPE_SKELETAL_MESH];
+		if (!skeletalMeshInputs.hasInput(MATERIAL_RENDERABLE_BINDING_BONE_PALETTE))
+		{
+			skeletalMeshInputs.addInput(std::unique_ptr<MaterialInput>(new BonePaletteMaterialInput(MATERIAL_RENDERABLE_BINDING_BONE_PALETTE, context.getBonePalette())));
+		}
+
+		materialGlobalInputs.setShaderReflection(&shaderReflection, MATERIAL_SET_GLOBAL);
+		materialLocalInputs.setShaderReflection(&shaderReflection, MATERIAL_SET_LOCAL);
+		for (auto& pair_type_input : materialRenderableInputs)
+		{
+			pair_type_input.second.setShaderReflection(&shaderReflection, MATERIAL_SET_RENDERABLE);
+		}
+
+		materialGlobalInputs.createGPUSide(context);
+		materialLocalInputs.createGPUSide(context);
 		for (auto& pair_type_input : materialRenderableInputs)
 		{
-			auto& found = descriptorPoolRenderableInputs.find(pair_type_input.first);
-			assert(found != descriptorPoolRenderableInputs.end());
-			pair_type_input.second.createGPUSide(context, found->second);
+			pair_type_input.second.createGPUSide(context);
 		}
 	}
 
+	void loadShaders()
+	{
+		vertexShaderCode = readShaderFile(vertexShaderPath);
+		fragmentShaderCode = readShaderFile(fragmentShaderPath);
+
+		shaderReflection = {};
+		ShaderReflectionData stageReflection;
+		SpirvReflection::reflect(vertexShaderCode, VK_SHADER_STAGE_VERTEX_BIT, stageReflection);
+		SpirvReflection::merge(stageReflection, shaderReflection);
+		SpirvReflection::reflect(fragmentShaderCode, VK_SHADER_STAGE_FRAGMENT_BIT, stageReflection);
+		SpirvReflection::merge(stageReflection, shaderReflection);
+	}
+
+	void setSupportedFeatures(MaterialFeatureFlags features)
+	{
+		supportedFeatures = features;
+	}
+
+	void setEnabledFeatures(MaterialFeatureFlags features)
+	{
+		enabledFeatures = requestVariant(features);
+	}
+
+	// register a variant, must be called before setMaterialValidFor
+	// return the features really used by the variant
+	MaterialFeatureFlags requestVariant(MaterialFeatureFlags features)
+	{
+		features &= supportedFeatures;
+		if (std::find(variants.begin(), variants.end(), features) == variants.end())
+			variants.push_back(features);
+
+		return features;
+	}
+
+	// compile the pipelines of all requested variants for this renderable type and subpass
 	void setMaterialValidFor(const PipelineInfoRenderableRelated& pipelineInfoRenderableRelated, const PipelineInfoSubpassRelated& pipelineInfoSubpassRelated)
 	{
-		MaterialPipelineKey key = { pipelineInfoRenderableRelated.renderableType, pipelineInfoSubpassRelated.renderPass, pipelineInfoSubpassRelated.subPass };
-		createPipeline(key, pipelineInfoRenderableRelated, pipelineInfoSubpassRelated);
+		for (MaterialFeatureFlags features : variants)
+		{
+			MaterialPipelineKey key = { pipelineInfoRenderableRelated.renderableType, pipelineInfoSubpassRelated.renderPass, pipelineInfoSubpassRelated.subPass, features };
+			if (pipelines.find(key) == pipelines.end())
+				createPipeline(key, pipelineInfoRenderableRelated, pipelineInfoSubpassRelated);
+		}
 	}
 
 	void createPipeline(const MaterialPipelineKey& key, const PipelineInfoRenderableRelated& pipelineInfoRenderableRelated, const PipelineInfoSubpassRelated& pipelineInfoSubpassRelated)
@@ -95,31 +207,41 @@ public:
 		PipelineInfoMaterialRelated pipelineInfoMaterialRelated = {};
 
 		// Create the PipelineInfoMaterialRelated 
-		VkDescriptorSetLayout setLayouts[3] = { materialGlobalInputs.getDescriptorSetLayout(), materialLocalInputs.getDescriptorSetLayout(), pair_type_input.second.getDescriptorSetLayout() };
+		std::vector<VkDescriptorSetLayout> setLayouts = { materialGlobalInputs.getDescriptorSetLayout(), materialLocalInputs.getDescriptorSetLayout(), materialRenderableInputs[key.renderableType].getDescriptorSetLayout() };
+		std::vector<VkPushConstantRange> pushConstantRanges = shaderReflection.pushConstantRanges;
+		if (bindlessTable != nullptr)
+		{
+			// textures are read from the table, indexed by push constants
+			setLayouts.push_back(bindlessTable->getDescriptorSetLayout());
+			BindlessTextureTable::mergePushConstantRange(pushConstantRanges);
+		}
+
 		VkPipelineLayoutCreateInfo pipelineLayoutInfo = {};
 		pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-		pipelineLayoutInfo.pushConstantRangeCount = 0;
-		pipelineLayoutInfo.pPushConstantRanges = nullptr;
-		pipelineLayoutInfo.setLayoutCount = 3;
-		pipelineLayoutInfo.pSetLayouts = setLayouts;
+		pipelineLayoutInfo.pushConstantRangeCount = static_cast<uint32_t>(pushConstantRanges.size());
+		pipelineLayoutInfo.pPushConstantRanges = pushConstantRanges.data();
+		pipelineLayoutInfo.setLayoutCount = static_cast<uint32_t>(setLayouts.size());
+		pipelineLayoutInfo.pSetLayouts = setLayouts.data();
 
-		auto vertShaderCode = readShaderFile(vertexShaderPath);
-		auto fragShaderCode = readShaderFile(fragmentShaderPath);
+		VkShaderModule vertShaderModule = createShaderModule(owningDevice, vertexShaderCode);
+		VkShaderModule fragShaderModule = createShaderModule(owningDevice, fragmentShaderCode);
 
-		VkShaderModule vertShaderModule = createShaderModule(owningDevice, vertShaderCode);
-		VkShaderModule fragShaderModule = createShaderModule(owningDevice, fragShaderCode);
+		MaterialSpecializationData specializationData;
+		specializationData.build(key.features);
 
 		VkPipelineShaderStageCreateInfo vertShaderStageInfo = {};
 		vertShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
 		vertShaderStageInfo.stage = VK_SHADER_STAGE_VERTEX_BIT;
 		vertShaderStageInfo.module = vertShaderModule;
 		vertShaderStageInfo.pName = "main";
+		vertShaderStageInfo.pSpecializationInfo = &specializationData.info;
 
 		VkPipelineShaderStageCreateInfo fragShaderStageInfo = {};
 		fragShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
 		fragShaderStageInfo.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
 		fragShaderStageInfo.module = fragShaderModule;
 		fragShaderStageInfo.pName = "main";
+		fragShaderStageInfo.pSpecializationInfo = &specializationData.info;
 
 		VkPipelineShaderStageCreateInfo shaderStages[] = { vertShaderStageInfo, fragShaderStageInfo };
 
@@ -139,96 +261,69 @@ public:
 
 	void destroyGPUSide() override
 	{
-		materialGlobalInputs.destroyGPUSide(owningDevice, descriptorPoolGlobalInputs);
-		materialLocalInputs.destroyGPUSide(owningDevice, descriptorPoolLocalInputs);
+		materialGlobalInputs.destroyGPUSide(owningDevice, *descriptorAllocator);
+		materialLocalInputs.destroyGPUSide(owningDevice, *descriptorAllocator);
 		for (auto& pair_type_input : materialRenderableInputs)
 		{
-			auto& found = descriptorPoolRenderableInputs.find(pair_type_input.first);
-			pair_type_input.second.destroyGPUSide(owningDevice, found->second);
+			pair_type_input.second.destroyGPUSide(owningDevice, *descriptorAllocator);
 		}
-
-		vkDestroyDescriptorPool(owningDevice, descriptorPoolGlobalInputs, nullptr);
-		vkDestroyDescriptorPool(owningDevice, descriptorPoolLocalInputs, nullptr);
-		for(auto& pair_type_pool : descriptorPoolRenderableInputs)
-			vkDestroyDescriptorPool(owningDevice, pair_type_pool.second, nullptr);
 	}
 
 	void cmdBindPipeline(VkCommandBuffer commandBuffer, RenderableType renderableType, VkRenderPass currentPass, uint32_t currentSubpass) override
 	{
-		auto& pipeline = pipelines[MaterialPipelineKey{ renderableType, currentPass, currentSubpass }];
-		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline->getPipelineHandle());
+		cmdBindPipelineVariant(commandBuffer, renderableType, currentPass, currentSubpass, enabledFeatures);
+	}
+
+	void cmdBindPipelineVariant(VkCommandBuffer commandBuffer, RenderableType renderableType, VkRenderPass currentPass, uint32_t currentSubpass, MaterialFeatureFlags features)
+	{
+		auto found = pipelines.find(MaterialPipelineKey{ renderableType, currentPass, currentSubpass, features });
+		CHECK_TRUE_THROW_ERROR(found != pipelines.end(), "material variant not compiled for this subpass, request it before setMaterialValidFor !");
+
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, found->second->getPipelineHandle());
+		boundPipelineLayout = found->second->getPipelineLayout();
 	}
 
 	void cmdBindGlobalUniforms(VkCommandBuffer commandBuffer) override
 	{
-		VkDescriptorSet set = materialGlobalInputs.getDescriptorSet();
-		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineRef->getPipelineLayout(), 0, 1, &set, 0, 0);
+		if (materialGlobalInputs.hasSetInputs())
+			materialGlobalInputs.cmdBindDescriptorSet(commandBuffer, boundPipelineLayout, MATERIAL_SET_GLOBAL);
+
+		// the table is shared by all materials, bound once with the global set
+		if (bindlessTable != nullptr)
+			bindlessTable->cmdBind(commandBuffer, boundPipelineLayout, MATERIAL_SET_BINDLESS_TEXTURES);
 	}
 
 	void cmdBindLocalUniforms(VkCommandBuffer commandBuffer) override
 	{
-		VkDescriptorSet set = materialLocalInputs.getDescriptorSet();
-		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineRef->getPipelineLayout(), 0, 1, &set, 0, 0);
+		if (materialLocalInputs.hasSetInputs())
+			materialLocalInputs.cmdBindDescriptorSet(commandBuffer, boundPipelineLayout, MATERIAL_SET_LOCAL);
+		materialLocalInputs.cmdPushBindlessTextureIndices(commandBuffer, boundPipelineLayout);
 	}
 
 	void cmdBindRenderableUniforms(VkCommandBuffer commandBuffer, RenderableType renderableType, uint32_t itemOffset) override
 	{
 		
-		auto& foundInput = materialRenderableInputs.find(renderableType);
-		auto& foundPipeline = pipelines.find(renderableType);
+		auto foundInput = materialRenderableInputs.find(renderableType);
 
-		if (foundInput != materialRenderableInputs.end() && foundPipeline != pipelines.end())
+		if (foundInput != materialRenderableInputs.end())
 		{
+			// the bone palette moves to the buffer of the new frame slot
+			foundInput->second.updateFrameDescriptorSet(owningDevice, *descriptorAllocator);
+
 			VkDescriptorSet set = foundInput->second.getDescriptorSet();
-			VkPipelineLayout pipelineLayout = foundPipeline->second->getPipelineLayout();
 			uint32_t offsets[] = { itemOffset };
-			vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &set, 1, &offsets);
+			vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, boundPipelineLayout, MATERIAL_SET_RENDERABLE, 1, &set, 1, offsets);
 		}
 	}
 
-	void createDescriptorPool(const GraphicsContext& context) override
+	VkPipelineLayout getBoundPipelineLayout() const
 	{
-		std::vector<VkDescriptorPoolSize> poolSizes;
-		VkDescriptorPoolCreateInfo poolInfo = {};
-		poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
-
-		///////////////////////////////
-		materialGlobalInputs.getPoolSizes(poolSizes);
-
-		poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
-		poolInfo.pPoolSizes = poolSizes.data();
-		poolInfo.maxSets = 1;
-
-		if (vkCreateDescriptorPool(context.getDevice(), &poolInfo, nullptr, &descriptorPoolGlobalInputs) != VK_SUCCESS) {
-			throw std::runtime_error("failed to create descriptor pool !");
-		}
-
-		///////////////////////////////
-		materialLocalInputs.getPoolSizes(poolSizes);
-
-		poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
-		poolInfo.pPoolSizes = poolSizes.data();
-		poolInfo.maxSets = 1;
-
-		if (vkCreateDescriptorPool(context.getDevice(), &poolInfo, nullptr, &descriptorPoolLocalInputs) != VK_SUCCESS) {
-			throw std::runtime_error("failed to create descriptor pool !");
-		}
-
-		///////////////////////////////
-		for (auto& pair_type_input : materialRenderableInputs)
-		{
-			pair_type_input.second.getPoolSizes(poolSizes);
-
-			poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
-			poolInfo.pPoolSizes = poolSizes.data();
-			poolInfo.maxSets = 1;
-
-			descriptorPoolRenderableInputs[pair_type_input.first] = VK_NULL_HANDLE;
-			if (vkCreateDescriptorPool(context.getDevice(), &poolInfo, nullptr, &descriptorPoolRenderableInputs[pair_type_input.first]) != VK_SUCCESS) {
-				throw std::runtime_error("failed to create descriptor pool !");
-			}
-		}
+		return boundPipelineLayout;
+	}
 
+	const ShaderReflectionData& getShaderReflection() const
+	{
+		return shaderReflection;
 	}
 };
 
@@ -236,17 +331,27 @@ class MaterialInstance final : public MaterialInterface
 {
 private:
 	VkDevice owningDevice;
+	DescriptorAllocator* descriptorAllocator;
 
 	Material* parentMaterial;
+	// variant of the parent material used by the instance
+	MaterialFeatureFlags enabledFeatures;
 
 	MaterialInputSet materialLocalInputs;
-	VkDescriptorPool descriptorPoolLocalInputs;
 
 public:
 	MaterialInstance()
 		: owningDevice(VK_NULL_HANDLE)
+		, descriptorAllocator(nullptr)
+		, enabledFeatures(0)
 	{}
 
+	// must be called before the parent material is made valid for its subpasses
+	void setEnabledFeatures(MaterialFeatureFlags features)
+	{
+		enabledFeatures = parentMaterial->requestVariant(features);
+	}
+
 	~MaterialInstance()
 	{
 		if (owningDevice != VK_NULL_HANDLE)
@@ -258,25 +363,21 @@ public:
 	void createGPUSide(const GraphicsContext& context) override
 	{
 		owningDevice = context.getDevice();
+		descriptorAllocator = &context.getDescriptorAllocator();
 
+		// global and renderable inputs are shared with the parent material
+		materialLocalInputs.setShaderReflection(&parentMaterial->getShaderReflection(), MATERIAL_SET_LOCAL);
 		materialLocalInputs.createGPUSide(context);
-
-		std::array<MaterialInputSet*, 3> inputSets = { &materialGlobalInputs , &materialLocalInputs, &materialRenderableInputs };
-		materialData.createGPUSide(context, inputSets);
 	}
 
 	void destroyGPUSide() override
 	{
-		materialGlobalInputs.destroyGPUSide(owningDevice);
-		materialLocalInputs.destroyGPUSide(owningDevice);
-		materialRenderableInputs.destroyGPUSide(owningDevice);
-
-		vkDestroyDescriptorPool(owningDevice, descriptorPool, nullptr);
+		materialLocalInputs.destroyGPUSide(owningDevice, *descriptorAllocator);
 	}
 
-	void cmdBindPipeline(VkCommandBuffer commandBuffer) override
+	void cmdBindPipeline(VkCommandBuffer commandBuffer, RenderableType renderableType, VkRenderPass currentPass, uint32_t currentSubpass) override
 	{
-		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineRef->getPipelineHandle());
+		parentMaterial->cmdBindPipelineVariant(commandBuffer, renderableType, currentPass, currentSubpass, enabledFeatures);
 	}
 
 	void cmdBindGlobalUniforms(VkCommandBuffer commandBuffer) override
@@ -286,7 +387,13 @@ public:
 
 	void cmdBindLocalUniforms(VkCommandBuffer commandBuffer) override
 	{
-		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineRef->getPipelineLayout(), 0, 1, &materialData.descriptorSets[1], 0, 0);
+		// instances only override the local inputs, the pipeline is the parent one
+		VkPipelineLayout pipelineLayout = parentMaterial->getBoundPipelineLayout();
+		// with all the textures in the bindless table, pushing their indices is the only per instance work,
+		// the set is only bound for the inputs which can't be bindless (ex : the uniform buffer of the instance)
+		if (materialLocalInputs.hasSetInputs())
+			materialLocalInputs.cmdBindDescriptorSet(commandBuffer, pipelineLayout, MATERIAL_SET_LOCAL);
+		materialLocalInputs.cmdPushBindlessTextureIndices(commandBuffer, pipelineLayout);
 	}
 
 	void cmdBindRenderableUniforms(VkCommandBuffer commandBuffer, size_t itemOffset) override
@@ -294,24 +401,6 @@ public:
 		uint32_t memoryOffset = itemOffsetToMemoryOffset(itemOffset); //TODO
 		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineRef->getPipelineLayout(), 0, 1, &materialData.descriptorSets[2], 1, &memoryOffset);
 	}
-
-	void createDescriptorPool(const GraphicsContext& context) override
-	{
-		std::vector<VkDescriptorPoolSize> poolSizes;
-		VkDescriptorPoolCreateInfo poolInfo = {};
-		poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
-
-		///////////////////////////////
-		materialLocalInputs.getPoolSizes(poolSizes);
-
-		poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
-		poolInfo.pPoolSizes = poolSizes.data();
-		poolInfo.maxSets = 1;
-
-		if (vkCreateDescriptorPool(context.getDevice(), &poolInfo, nullptr, &descriptorPoolLocalInputs) != VK_SUCCESS) {
-			throw std::runtime_error("failed to create descriptor pool !");
-		}
-	}
 };
 
 //
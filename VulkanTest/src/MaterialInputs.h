@@ -3,10 +3,17 @@
 #include <vulkan/vulkan.hpp>
 #include <glm/glm.hpp>
 
+#include <algorithm>
+
+#include "BonePalette.h"
 #include "Buffer.h"
+#include "DescriptorAllocator.h"
+#include "DescriptorSetLayoutCache.h"
+#include "BindlessTextureTable.h"
+#include "ShaderReflection.h"
 
 // Material input and MaterialInputSet only handle the allocation of the resource (buffer/sampler/...)
-// The allocation of descriptors is performed inside MaterialDescriptors
+// The descriptor sets are allocated from the DescriptorAllocator owned by the GraphicsContext
 
 // Base class for representing an input in a shader
 // Can be for example a ubo or a texture sampler
@@ -22,9 +29,35 @@ public:
 		: binding(_binding)
 	{}
 
-	virtual VkWriteDescriptorSet getWriteDescriptorSet(const VkDescriptorSet& owningSet) const = 0;
+	// fill the buffer / image info read by the descriptor update template
+	virtual void getDescriptorUpdateData(DescriptorUpdateData& outData) const = 0;
 	virtual VkDescriptorType getDescriptorType() const = 0;
-	virtual const VkDescriptorSetLayoutBinding& getDescriptorSetLayoutBinding() const = 0;
+
+	// true when the descriptor changes every frame, the set holding it is then rewritten at each frame
+	virtual bool isUpdatedEveryFrame() const
+	{
+		return false;
+	}
+
+	// offset given when the set is bound, for the dynamic descriptors whose offset is owned by the input
+	virtual uint32_t getDynamicOffset() const
+	{
+		return 0;
+	}
+
+	// binding used when no shader reflection is available, visible to all graphics stages
+	VkDescriptorSetLayoutBinding getDescriptorSetLayoutBinding() const
+	{
+		VkDescriptorSetLayoutBinding layoutBinding = {};
+		layoutBinding.binding = binding;
+		layoutBinding.descriptorCount = 1;
+		layoutBinding.descriptorType = getDescriptorType();
+		layoutBinding.pImmutableSamplers = nullptr;
+		layoutBinding.stageFlags = VK_SHADER_STAGE_ALL_GRAPHICS;
+
+		return layoutBinding;
+	}
+
 	uint32_t getBinding() const
 	{
 		return binding;
@@ -32,14 +65,54 @@ public:
 };
 
 
+// Where an input of a MaterialInputSet ends up
+enum class MaterialInputPlacement
+{
+	DescriptorSet,
+	BindlessTable,
+	// no shader stage reads it, it is not part of the layout
+	Unused
+};
+
 // Represent a set of inputs
+// The layout and its update template come from the DescriptorSetLayoutCache, so sets with
+// the same bindings share them. The set is updated in a single call from descriptorUpdateDatas.
+// When the GraphicsContext has a bindless texture table, combined image samplers are registered
+// in the table instead of the set and are referenced by their index in bindlessTextureIndices.
+// With a shader reflection, bindings get the exact stage mask of the shaders and unused inputs are dropped.
 class MaterialInputSet
 {
 private:
 	std::vector<std::unique_ptr<MaterialInput>> inputs;
-	std::vector<VkWriteDescriptorSet> writeDescriptorSets;
 	VkDescriptorSetLayout descriptorSetLayout;
+	VkDescriptorUpdateTemplate descriptorUpdateTemplate;
 	VkDescriptorSet descriptorSet;
+	DescriptorSetAllocation descriptorSetAllocation;
+
+	// packed infos read by descriptorUpdateTemplate, ordered by binding number
+	std::vector<DescriptorUpdateData> descriptorUpdateDatas;
+	// inputs stored inside the descriptor set
+	std::vector<uint32_t> setInputIndices;
+	// index of each input inside descriptorUpdateDatas, or inside bindlessTextureIndices for bindless inputs
+	std::vector<uint32_t> inputSlots;
+	// descriptor count of the binding of each input stored inside the set, its data is repeated in all the array elements
+	std::vector<uint32_t> inputDescriptorCounts;
+	std::vector<MaterialInputPlacement> inputPlacements;
+	// inputs stored inside the set with a dynamic descriptor, ordered by binding like the dynamic offsets
+	std::vector<uint32_t> dynamicInputIndices;
+	std::vector<uint32_t> dynamicOffsetsScratch;
+
+	// reflection of the shaders using the set, owned by the material
+	const ShaderReflectionData* shaderReflection = nullptr;
+	uint32_t setIndex = 0;
+
+	BindlessTextureTable* bindlessTable = nullptr;
+	BindlessTextureIndices bindlessTextureIndices = {};
+	uint32_t bindlessTextureCount = 0;
+
+	// some inputs of the set change every frame, frameSetNumber is the DescriptorAllocator frame of the current set
+	bool hasFrameInputs = false;
+	uint64_t frameSetNumber = 0;
 
 public:
 
@@ -50,19 +123,40 @@ public:
 		inputs.push_back(std::make_unique<InputClass>(this, newInputIndex));
 	}
 
-	void createGPUSide(const GraphicsContext& context, VkDescriptorPool descriptorPool)
+	// must be called before createGPUSide
+	void addInput(std::unique_ptr<MaterialInput> input)
 	{
-		createDescriptorSetLayout(context);
-		allocateDescriptorSet(context, descriptorPool);
-
-		assert(inputs.size() == writeDescriptorSets.size());
+		inputs.push_back(std::move(input));
+	}
 
-		int index = 0;
-		for (auto input : inputs)
+	bool hasInput(uint32_t binding) const
+	{
+		return std::any_of(inputs.begin(), inputs.end(), [binding](const std::unique_ptr<MaterialInput>& input)
 		{
-			writeDescriptorSets[index] = input->getWriteDescriptorSet(descriptorSet);
-			index++;
-		}
+			return input->getBinding() == binding;
+		});
+	}
+
+	// must be called before createGPUSide
+	void setShaderReflection(const ShaderReflectionData* reflection, uint32_t _setIndex)
+	{
+		shaderReflection = reflection;
+		setIndex = _setIndex;
+	}
+
+	void createGPUSide(const GraphicsContext& context)
+	{
+		bindlessTable = context.getBindlessTextureTable();
+		dispatchInputs();
+		registerBindlessTextures();
+
+		// the layout is created even if all inputs are bindless to keep the pipeline layouts identical,
+		// but an empty set is neither allocated nor bound
+		createDescriptorSetLayout(context);
+		if (hasSetInputs())
+			allocateDescriptorSet(context);
+
+		updateDescriptorSet(context);
 	}
 
 	void createDescriptorSetLayout(const GraphicsContext& context)
@@ -70,61 +164,153 @@ public:
 		std::vector<VkDescriptorSetLayoutBinding> bindings;
 		getDescriptorSetLayoutBindings(bindings);
 
-		VkDescriptorSetLayoutCreateInfo layoutInfo = {};
-		layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
-		layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
-		layoutInfo.pBindings = bindings.data();
+		const CachedDescriptorSetLayout& cachedLayout = context.getDescriptorSetLayoutCache().getOrCreate(bindings);
+		descriptorSetLayout = cachedLayout.layout;
+		descriptorUpdateTemplate = cachedLayout.updateTemplate;
+
+		std::vector<uint32_t> updateDataSlots;
+		const uint32_t updateDataCount = DescriptorSetLayoutCache::computeUpdateDataSlots(bindings, updateDataSlots);
+		descriptorUpdateDatas.resize(updateDataCount);
+		inputDescriptorCounts.resize(inputs.size());
+		dynamicInputIndices.clear();
+		for (size_t i = 0; i < setInputIndices.size(); i++)
+		{
+			inputSlots[setInputIndices[i]] = updateDataSlots[i];
+			inputDescriptorCounts[setInputIndices[i]] = bindings[i].descriptorCount;
 
-		if (vkCreateDescriptorSetLayout(context.getDevice(), &layoutInfo, nullptr, &descriptorSetLayouts[index]) != VK_SUCCESS) {
-			throw std::runtime_error("failed to create descriptor set layout !");
+			if (bindings[i].descriptorType == VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC || bindings[i].descriptorType == VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC)
+				dynamicInputIndices.push_back(setInputIndices[i]);
 		}
+		std::sort(dynamicInputIndices.begin(), dynamicInputIndices.end(), [this](uint32_t a, uint32_t b)
+		{
+			return inputs[a]->getBinding() < inputs[b]->getBinding();
+		});
 	}
 
-	void allocateDescriptorSet(const GraphicsContext& context, VkDescriptorPool descriptorPool)
+	void allocateDescriptorSet(const GraphicsContext& context)
 	{
-		VkDescriptorSetAllocateInfo allocInfo = {};
-		allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-		allocInfo.descriptorPool = descriptorPools;
-		allocInfo.descriptorSetCount = 1;
-		allocInfo.pSetLayouts = &descriptorSetLayout;
-
-		if (vkAllocateDescriptorSets(context.getDevice(), &allocInfo, &descriptorSet) != VK_SUCCESS) {
-			throw std::runtime_error("failed to allocate descriptor set !");
-		}
+		descriptorSetAllocation = context.getDescriptorAllocator().allocate(descriptorSetLayout);
+		descriptorSet = descriptorSetAllocation.descriptorSet;
 	}
 
-	void destroyGPUSide(const VkDevice& device, VkDescriptorPool descriptorPool)
+	// the layout is owned by the DescriptorSetLayoutCache, only the set is released here
+	void destroyGPUSide(const VkDevice& device, DescriptorAllocator& descriptorAllocator)
 	{
-		vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr);
-		vkFreeDescriptorSets(device, descriptorPool, , );
+		for (uint32_t i = 0; i < bindlessTextureCount; i++)
+			bindlessTable->unregisterImage(bindlessTextureIndices.indices[i]);
+		bindlessTextureCount = 0;
+
+		descriptorAllocator.free(descriptorSetAllocation);
+		descriptorSetAllocation = {};
+		descriptorSet = VK_NULL_HANDLE;
+		descriptorSetLayout = VK_NULL_HANDLE;
+		descriptorUpdateTemplate = VK_NULL_HANDLE;
 	}
 
+	// bindings of the inputs stored inside the set
 	void getDescriptorSetLayoutBindings(std::vector<VkDescriptorSetLayoutBinding>& outBindings) const
 	{
-		outBindings.resize(inputs.size());
+		outBindings.resize(setInputIndices.size());
 
-		for (size_t i = 0; i < inputs.size(); i++)
+		for (size_t i = 0; i < setInputIndices.size(); i++)
 		{
-			outBindings[i] = inputs[i]->getDescriptorSetLayoutBinding();
+			const MaterialInput& input = *inputs[setInputIndices[i]];
+			outBindings[i] = input.getDescriptorSetLayoutBinding();
+
+			// the input keeps its type (ex : a dynamic uniform buffer is reflected as a uniform buffer)
+			if (shaderReflection != nullptr)
+			{
+				const ReflectedDescriptorBinding* reflectedBinding = shaderReflection->findBinding(setIndex, input.getBinding());
+				outBindings[i].stageFlags = reflectedBinding->stageFlags;
+				outBindings[i].descriptorCount = std::max(1u, reflectedBinding->descriptorCount);
+			}
 		}
 	}
 
-	void updateAllWriteDescriptorSets(const GraphicsContext& context)
+	// gather the infos of all inputs and update the whole set with the template
+	void updateDescriptorSet(const GraphicsContext& context)
 	{
-		vkUpdateDescriptorSets(context.getDevice(), static_cast<uint32_t>(writeDescriptorSets.size()), writeDescriptorSets.data(), 0, nullptr);
+		if (setInputIndices.empty())
+			return;
+
+		for (uint32_t inputIndex : setInputIndices)
+		{
+			writeInputUpdateDatas(inputIndex);
+		}
+
+		vkUpdateDescriptorSetWithTemplate(context.getDevice(), descriptorSet, descriptorUpdateTemplate, descriptorUpdateDatas.data());
 	}
 
-	void updateWriteDescriptorSet(const GraphicsContext& context, int inputIndex)
+	// Sets with inputs changing every frame (ex : the bone palette of the frame slot) are written in a new transient set
+	// at their first bind of each frame : the sets bound by the previous frames may still be read by the GPU.
+	void updateFrameDescriptorSet(VkDevice device, DescriptorAllocator& descriptorAllocator)
 	{
-		vkUpdateDescriptorSets(context.getDevice(), 1, &writeDescriptorSets[inputIndex], 0, nullptr);
+		if (!hasFrameInputs || frameSetNumber == descriptorAllocator.getFrameNumber())
+			return;
+
+		frameSetNumber = descriptorAllocator.getFrameNumber();
+		descriptorSet = descriptorAllocator.allocateTransient(descriptorSetLayout);
+		for (uint32_t inputIndex : setInputIndices)
+		{
+			writeInputUpdateDatas(inputIndex);
+		}
+
+		vkUpdateDescriptorSetWithTemplate(device, descriptorSet, descriptorUpdateTemplate, descriptorUpdateDatas.data());
 	}
 
-	void appendPoolSizes(std::vector<VkDescriptorPoolSize>& outSizes)
+	// refresh a single input (ex : a texture change on a material instance)
+	// the other packed infos are still valid so the template update is a plain copy of the array
+	void updateInputDescriptor(const GraphicsContext& context, int inputIndex)
 	{
-		for (int i = 0; i < inputs.size(); i++)
+		if (inputPlacements[inputIndex] == MaterialInputPlacement::Unused)
+			return;
+
+		if (inputPlacements[inputIndex] == MaterialInputPlacement::BindlessTable)
 		{
-			outSizes.push_back(VkDescriptorPoolSize{ inputs[i]->getDescriptorType(), 1 });
+			DescriptorUpdateData data;
+			inputs[inputIndex]->getDescriptorUpdateData(data);
+			bindlessTable->updateImage(bindlessTextureIndices.indices[inputSlots[inputIndex]], data.imageInfo);
+			return;
 		}
+
+		writeInputUpdateDatas(inputIndex);
+
+		vkUpdateDescriptorSetWithTemplate(context.getDevice(), descriptorSet, descriptorUpdateTemplate, descriptorUpdateDatas.data());
+	}
+
+	// the template reads every element of an array binding, an input fills them all with its descriptor
+	void writeInputUpdateDatas(uint32_t inputIndex)
+	{
+		const uint32_t firstSlot = inputSlots[inputIndex];
+		inputs[inputIndex]->getDescriptorUpdateData(descriptorUpdateDatas[firstSlot]);
+		for (uint32_t element = 1; element < inputDescriptorCounts[inputIndex]; element++)
+		{
+			descriptorUpdateDatas[firstSlot + element] = descriptorUpdateDatas[firstSlot];
+		}
+	}
+
+	// bind the set with the dynamic offsets of its inputs (ex : the copy of the current frame slot of a parameter block)
+	void cmdBindDescriptorSet(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, uint32_t boundSetIndex)
+	{
+		dynamicOffsetsScratch.clear();
+		for (uint32_t inputIndex : dynamicInputIndices)
+			dynamicOffsetsScratch.insert(dynamicOffsetsScratch.end(), inputDescriptorCounts[inputIndex], inputs[inputIndex]->getDynamicOffset());
+
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, boundSetIndex, 1, &descriptorSet
+			, static_cast<uint32_t>(dynamicOffsetsScratch.size()), dynamicOffsetsScratch.data());
+	}
+
+	// push the bindless texture indices, they are read by the fragment shader
+	// the push must name every stage whose reflected range overlaps the indices
+	void cmdPushBindlessTextureIndices(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout) const
+	{
+		if (bindlessTextureCount == 0)
+			return;
+
+		const VkShaderStageFlags stages = shaderReflection != nullptr
+			? BindlessTextureTable::getPushConstantStages(shaderReflection->pushConstantRanges)
+			: BindlessTextureTable::getPushConstantRange().stageFlags;
+		vkCmdPushConstants(commandBuffer, pipelineLayout, stages, 0, sizeof(BindlessTextureIndices), &bindlessTextureIndices);
 	}
 
 	// getters
@@ -139,14 +325,20 @@ public:
 		return descriptorSet;
 	}
 
-	size_t size() const
+	// false if the set is empty (ex : all inputs are bindless textures), it isn't allocated and mustn't be bound
+	bool hasSetInputs() const
 	{
-		return inputs.size();
+		return !setInputIndices.empty();
 	}
 
-	VkWriteDescriptorSet getWriteDescriptorSet(int inputIndex, const VkDescriptorSet& owningSet) const
+	uint32_t getBindlessTextureCount() const
 	{
-		return inputs[inputIndex]->getWriteDescriptorSet(owningSet);
+		return bindlessTextureCount;
+	}
+
+	size_t size() const
+	{
+		return inputs.size();
 	}
 
 	VkDescriptorType getDescriptorType(int inputIndex) const
@@ -154,12 +346,49 @@ public:
 		return inputs[inputIndex]->getDescriptorType();
 	}
 
-	void getPoolSizes(std::vector<VkDescriptorPoolSize>& outSizes) const
+private:
+
+	// choose for each input if it goes inside the set or inside the bindless table
+	void dispatchInputs()
 	{
-		outSizes.resize(inputs.size());
-		for (int i = 0; i < inputs.size(); i++)
+		setInputIndices.clear();
+		hasFrameInputs = false;
+		inputSlots.assign(inputs.size(), 0);
+		inputPlacements.assign(inputs.size(), MaterialInputPlacement::DescriptorSet);
+		bindlessTextureCount = 0;
+
+		for (uint32_t i = 0; i < inputs.size(); i++)
 		{
-			outSizes[i] = (VkDescriptorPoolSize{ inputs[i]->getDescriptorType(), 1 });
+			if (bindlessTable != nullptr
+				&& inputs[i]->getDescriptorType() == VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER
+				&& bindlessTextureCount < BINDLESS_MAX_TEXTURES_PER_MATERIAL)
+			{
+				inputPlacements[i] = MaterialInputPlacement::BindlessTable;
+				inputSlots[i] = bindlessTextureCount;
+				bindlessTextureCount++;
+			}
+			else if (shaderReflection != nullptr && shaderReflection->findBinding(setIndex, inputs[i]->getBinding()) == nullptr)
+			{
+				inputPlacements[i] = MaterialInputPlacement::Unused;
+			}
+			else
+			{
+				setInputIndices.push_back(i);
+				hasFrameInputs |= inputs[i]->isUpdatedEveryFrame();
+			}
+		}
+	}
+
+	void registerBindlessTextures()
+	{
+		for (uint32_t i = 0; i < inputs.size(); i++)
+		{
+			if (inputPlacements[i] != MaterialInputPlacement::BindlessTable)
+				continue;
+
+			DescriptorUpdateData data;
+			inputs[i]->getDescriptorUpdateData(data);
+			bindlessTextureIndices.indices[inputSlots[i]] = bindlessTable->registerImage(data.imageInfo);
 		}
 	}
 
@@ -207,23 +436,11 @@ public:
 		ubo.destroy();
 	}
 
-	VkWriteDescriptorSet getWriteDescriptorSet(const VkDescriptorSet& owningSet) const override
+	void getDescriptorUpdateData(DescriptorUpdateData& outData) const override
 	{
-		VkDescriptorBufferInfo bufferInfo = {};
-		bufferInfo.buffer = *ubo.getBufferHandle();
-		bufferInfo.offset = 0;
-		bufferInfo.range = ubo.getSize();
-
-		VkWriteDescriptorSet descriptorSetWrite;
-		descriptorSetWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-		descriptorSetWrite.dstSet = owningSet;
-		descriptorSetWrite.dstBinding = 0;
-		descriptorSetWrite.dstArrayElement = 0;
-		descriptorSetWrite.descriptorType = getDescriptorType();
-		descriptorSetWrite.descriptorCount = 1;
-		descriptorSetWrite.pBufferInfo = &bufferInfo;
-
-		return descriptorSetWrite;
+		outData.bufferInfo.buffer = *ubo.getBufferHandle();
+		outData.bufferInfo.offset = 0;
+		outData.bufferInfo.range = ubo.getSize();
 	}
 
 	VkDescriptorType getDescriptorType() const override
@@ -231,16 +448,32 @@ public:
 		return VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
 	}
 
-	const VkDescriptorSetLayoutBinding& getDescriptorSetLayoutBinding() const override
+};
+// Bones of the skeletal meshes, read by the vertex shader in the palette of the current frame slot.
+// Each slot has its own buffer, so the set holding this input is rewritten every frame.
+class BonePaletteMaterialInput : public MaterialInput
+{
+private:
+	const BonePaletteBuffer* bonePalette;
+
+public:
+	BonePaletteMaterialInput(uint32_t _binding, const BonePaletteBuffer& _bonePalette)
+		: MaterialInput(_binding)
+		, bonePalette(&_bonePalette)
+	{}
+
+	void getDescriptorUpdateData(DescriptorUpdateData& outData) const override
 	{
-		VkDescriptorSetLayoutBinding binding;
-		binding.binding = 0;
-		binding.descriptorCount = 1;
-		binding.descriptorType = getDescriptorType();
-		binding.pImmutableSamplers = nullptr;
-		binding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+		outData.bufferInfo = bonePalette->getDescriptorBufferInfo();
+	}
 
-		return binding;
+	VkDescriptorType getDescriptorType() const override
+	{
+		return VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
 	}
 
-};
\ No newline at end of file
+	bool isUpdatedEveryFrame() const override
+	{
+		return true;
+	}
+};
@@ -0,0 +1,374 @@
+#include "MaterialParameterBlock.h"
+#include "VulkanUtils.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/////////// MaterialParameterBlock
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+MaterialParameterBlock::MaterialParameterBlock()
+	: uploader(nullptr)
+	, isQueued(false)
+	, regionSize(0)
+{}
+
+MaterialParameterBlock::~MaterialParameterBlock()
+{
+	destroyGPUSide();
+}
+
+uint32_t MaterialParameterBlock::addParameter(uint32_t size, uint32_t alignment)
+{
+	uint32_t offset = computeAlignedSize(static_cast<uint32_t>(cpuData.size()), alignment);
+	cpuData.resize(offset + size, 0);
+
+	return offset;
+}
+
+void MaterialParameterBlock::resetLayout()
+{
+	assert(uploader == nullptr);
+	cpuData.clear();
+}
+
+void MaterialParameterBlock::createGPUSide(VkPhysicalDevice physicalDevice, VkDevice device, MaterialParameterUploader& _uploader)
+{
+	uploader = &_uploader;
+
+	// std140 blocks are sized to a multiple of 16 bytes
+	cpuData.resize(computeAlignedSize(std::max(static_cast<uint32_t>(cpuData.size()), 16u), 16));
+
+	// one copy per frame slot, each one at a valid dynamic offset
+	const uint32_t frameCount = uploader->getFrameCount();
+	regionSize = computeAlignedSize(getSize(), uploader->getUniformOffsetAlignment());
+	BufferCreateInfo createInfo = BufferCreateInfo::makeNotAligned(physicalDevice, device, frameCount, regionSize, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT);
+	// device local, only written by the uploader copies
+	deviceBuffer.create(createInfo, true);
+
+	dirtyRangesPerSlot.resize(frameCount);
+	invalidate();
+}
+
+void MaterialParameterBlock::destroyGPUSide()
+{
+	if (uploader == nullptr)
+		return;
+
+	uploader->remove(*this);
+	deviceBuffer.destroy();
+	dirtyRangesPerSlot.clear();
+	regionSize = 0;
+	uploader = nullptr;
+}
+
+void MaterialParameterBlock::write(uint32_t offset, const void* data, uint32_t size)
+{
+	memcpy(writeRange(offset, size), data, size);
+}
+
+char* MaterialParameterBlock::writeRange(uint32_t offset, uint32_t size)
+{
+	assert(offset + size <= cpuData.size());
+
+	// the copies of all the slots have to be updated
+	for (auto& dirtyRanges : dirtyRangesPerSlot)
+		dirtyRanges.push_back(MaterialParameterDirtyRange{ offset, size });
+
+	if (!isQueued && uploader != nullptr)
+		uploader->enqueue(*this);
+
+	return cpuData.data() + offset;
+}
+
+void MaterialParameterBlock::invalidate()
+{
+	for (auto& dirtyRanges : dirtyRangesPerSlot)
+	{
+		dirtyRanges.clear();
+		dirtyRanges.push_back(MaterialParameterDirtyRange{ 0, getSize() });
+	}
+
+	if (!isQueued && uploader != nullptr)
+		uploader->enqueue(*this);
+}
+
+void MaterialParameterBlock::extractDirtyRanges(uint32_t frameSlot, std::vector<MaterialParameterDirtyRange>& outRanges)
+{
+	std::vector<MaterialParameterDirtyRange>& dirtyRanges = dirtyRangesPerSlot[frameSlot];
+	if (dirtyRanges.empty())
+		return;
+
+	std::sort(dirtyRanges.begin(), dirtyRanges.end(), [](const MaterialParameterDirtyRange& a, const MaterialParameterDirtyRange& b) { return a.offset < b.offset; });
+
+	// merge overlapping and adjacent ranges
+	MaterialParameterDirtyRange current = dirtyRanges[0];
+	for (size_t i = 1; i < dirtyRanges.size(); i++)
+	{
+		const MaterialParameterDirtyRange& range = dirtyRanges[i];
+		const uint32_t currentEnd = current.offset + current.size;
+		if (range.offset <= currentEnd)
+		{
+			current.size = std::max(currentEnd, range.offset + range.size) - current.offset;
+		}
+		else
+		{
+			outRanges.push_back(current);
+			current = range;
+		}
+	}
+	outRanges.push_back(current);
+
+	dirtyRanges.clear();
+}
+
+void MaterialParameterBlock::restoreDirtyRanges(uint32_t frameSlot, const MaterialParameterDirtyRange* ranges, size_t rangeCount)
+{
+	std::vector<MaterialParameterDirtyRange>& dirtyRanges = dirtyRangesPerSlot[frameSlot];
+	dirtyRanges.insert(dirtyRanges.end(), ranges, ranges + rangeCount);
+}
+
+bool MaterialParameterBlock::hasDirtyRanges() const
+{
+	return std::any_of(dirtyRangesPerSlot.begin(), dirtyRangesPerSlot.end(), [](const std::vector<MaterialParameterDirtyRange>& dirtyRanges)
+	{
+		return !dirtyRanges.empty();
+	});
+}
+
+void MaterialParameterBlock::setQueued(bool queued)
+{
+	isQueued = queued;
+}
+
+bool MaterialParameterBlock::getIsQueued() const
+{
+	return isQueued;
+}
+
+const char* MaterialParameterBlock::getCPUData() const
+{
+	return cpuData.data();
+}
+
+uint32_t MaterialParameterBlock::getSize() const
+{
+	return static_cast<uint32_t>(cpuData.size());
+}
+
+Buffer& MaterialParameterBlock::getBuffer()
+{
+	return deviceBuffer;
+}
+
+uint32_t MaterialParameterBlock::getRegionSize() const
+{
+	return regionSize;
+}
+
+uint32_t MaterialParameterBlock::getDynamicOffset() const
+{
+	return uploader != nullptr ? uploader->getCurrentFrame() * regionSize : 0;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/////////// MaterialParameterUploader
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+MaterialParameterUploader::MaterialParameterUploader()
+	: owningDevice(VK_NULL_HANDLE)
+	, commandPool(VK_NULL_HANDLE)
+	, queue(VK_NULL_HANDLE)
+	, stagingCapacity(0)
+	, currentFrame(0)
+	, uniformOffsetAlignment(1)
+	, lastUploadedBytes(0)
+{}
+
+MaterialParameterUploader::~MaterialParameterUploader()
+{
+	destroy();
+}
+
+void MaterialParameterUploader::create(VkPhysicalDevice physicalDevice, VkDevice device, uint32_t queueFamilyIndex, VkQueue _queue, uint32_t frameCount, uint32_t _stagingCapacity)
+{
+	owningDevice = device;
+	queue = _queue;
+	stagingCapacity = _stagingCapacity;
+	currentFrame = 0;
+
+	VkPhysicalDeviceProperties properties;
+	vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+	uniformOffsetAlignment = static_cast<uint32_t>(properties.limits.minUniformBufferOffsetAlignment);
+
+	VkCommandPoolCreateInfo poolInfo = {};
+	poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+	poolInfo.queueFamilyIndex = queueFamilyIndex;
+	poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT | VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+
+	CHECK_VK_THROW_ERROR(vkCreateCommandPool(owningDevice, &poolInfo, nullptr, &commandPool), "failed to create material parameter command pool !");
+
+	frames.resize(frameCount);
+	for (auto& frame : frames)
+	{
+		BufferCreateInfo createInfo = BufferCreateInfo::makeNotAligned(physicalDevice, device, 1, stagingCapacity, VK_BUFFER_USAGE_TRANSFER_SRC_BIT);
+		frame.stagingBuffer.create(createInfo, false);
+
+		// host coherent, stays mapped for the uploader lifetime
+		CHECK_VK_THROW_ERROR(vkMapMemory(owningDevice, *frame.stagingBuffer.getMemoryHandle(), 0, stagingCapacity, 0, &frame.mappedStaging), "failed to map material parameter staging buffer !");
+
+		VkCommandBufferAllocateInfo allocInfo = {};
+		allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+		allocInfo.commandPool = commandPool;
+		allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+		allocInfo.commandBufferCount = 1;
+
+		CHECK_VK_THROW_ERROR(vkAllocateCommandBuffers(owningDevice, &allocInfo, &frame.commandBuffer), "failed to allocate material parameter command buffer !");
+	}
+}
+
+void MaterialParameterUploader::destroy()
+{
+	if (owningDevice == VK_NULL_HANDLE)
+		return;
+
+	for (auto& frame : frames)
+	{
+		vkFreeCommandBuffers(owningDevice, commandPool, 1, &frame.commandBuffer);
+		vkUnmapMemory(owningDevice, *frame.stagingBuffer.getMemoryHandle());
+		frame.stagingBuffer.destroy();
+	}
+	frames.clear();
+	vkDestroyCommandPool(owningDevice, commandPool, nullptr);
+	commandPool = VK_NULL_HANDLE;
+
+	for (auto block : dirtyBlocks)
+		block->setQueued(false);
+	dirtyBlocks.clear();
+
+	owningDevice = VK_NULL_HANDLE;
+}
+
+void MaterialParameterUploader::enqueue(MaterialParameterBlock& block)
+{
+	block.setQueued(true);
+	dirtyBlocks.push_back(&block);
+}
+
+void MaterialParameterUploader::remove(MaterialParameterBlock& block)
+{
+	if (!block.getIsQueued())
+		return;
+
+	dirtyBlocks.erase(std::remove(dirtyBlocks.begin(), dirtyBlocks.end(), &block), dirtyBlocks.end());
+	block.setQueued(false);
+}
+
+void MaterialParameterUploader::beginFrame(uint32_t frameIndex)
+{
+	currentFrame = frameIndex % static_cast<uint32_t>(frames.size());
+}
+
+void MaterialParameterUploader::flush()
+{
+	lastUploadedBytes = 0;
+	if (dirtyBlocks.empty())
+		return;
+
+	FrameResources& frame = frames[currentFrame];
+	char* staging = static_cast<char*>(frame.mappedStaging);
+
+	VkCommandBufferBeginInfo beginInfo = {};
+	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+	vkResetCommandBuffer(frame.commandBuffer, 0);
+	vkBeginCommandBuffer(frame.commandBuffer, &beginInfo);
+
+	// Only the copies of this slot are written. They were last read by the frame whose fence
+	// Renderer::beginFrame() waited for, the frames still in flight read the copies of their own slot.
+	uint32_t stagingOffset = 0;
+	size_t keptBlockCount = 0;
+	for (size_t blockIndex = 0; blockIndex < dirtyBlocks.size(); blockIndex++)
+	{
+		MaterialParameterBlock* block = dirtyBlocks[blockIndex];
+
+		rangesScratch.clear();
+		block->extractDirtyRanges(currentFrame, rangesScratch);
+		const uint32_t regionOffset = currentFrame * block->getRegionSize();
+
+		copiesScratch.clear();
+		size_t rangeIndex = 0;
+		for (; rangeIndex < rangesScratch.size(); rangeIndex++)
+		{
+			const MaterialParameterDirtyRange& range = rangesScratch[rangeIndex];
+			// keep copies 4 bytes aligned
+			uint32_t alignedOffset = computeAlignedSize(stagingOffset, 4);
+			if (alignedOffset + range.size > stagingCapacity)
+				break;
+
+			memcpy(staging + alignedOffset, block->getCPUData() + range.offset, range.size);
+			copiesScratch.push_back(VkBufferCopy{ alignedOffset, regionOffset + range.offset, range.size });
+			stagingOffset = alignedOffset + range.size;
+		}
+
+		if (!copiesScratch.empty())
+		{
+			vkCmdCopyBuffer(frame.commandBuffer, *frame.stagingBuffer.getBufferHandle(), *block->getBuffer().getBufferHandle(), static_cast<uint32_t>(copiesScratch.size()), copiesScratch.data());
+		}
+
+		// staging buffer is full, the remaining ranges are uploaded the next time this slot comes back
+		if (rangeIndex < rangesScratch.size())
+			block->restoreDirtyRanges(currentFrame, rangesScratch.data() + rangeIndex, rangesScratch.size() - rangeIndex);
+
+		// the block stays queued until the copies of the other slots are updated too
+		if (block->hasDirtyRanges())
+		{
+			dirtyBlocks[keptBlockCount] = block;
+			keptBlockCount++;
+		}
+		else
+		{
+			block->setQueued(false);
+		}
+	}
+	dirtyBlocks.resize(keptBlockCount);
+	lastUploadedBytes = stagingOffset;
+
+	VkMemoryBarrier writeBeforeRead = {};
+	writeBeforeRead.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	writeBeforeRead.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	writeBeforeRead.dstAccessMask = VK_ACCESS_UNIFORM_READ_BIT;
+	vkCmdPipelineBarrier(frame.commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 1, &writeBeforeRead, 0, nullptr, 0, nullptr);
+
+	vkEndCommandBuffer(frame.commandBuffer);
+
+	// submitted on the graphics queue before the processes, queue order makes the barriers apply to them
+	VkSubmitInfo submitInfo = {};
+	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	submitInfo.commandBufferCount = 1;
+	submitInfo.pCommandBuffers = &frame.commandBuffer;
+
+	CHECK_VK_THROW_ERROR(vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE), "failed to submit material parameter upload !");
+}
+
+uint32_t MaterialParameterUploader::getLastUploadedBytes() const
+{
+	return lastUploadedBytes;
+}
+
+uint32_t MaterialParameterUploader::getFrameCount() const
+{
+	return static_cast<uint32_t>(frames.size());
+}
+
+uint32_t MaterialParameterUploader::getCurrentFrame() const
+{
+	return currentFrame;
+}
+
+uint32_t MaterialParameterUploader::getUniformOffsetAlignment() const
+{
+	return uniformOffsetAlignment;
+}
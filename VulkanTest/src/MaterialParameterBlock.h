@@ -0,0 +1,131 @@
+#pragma once
+
+#include <vulkan/vulkan.hpp>
+
+#include <vector>
+
+#include "Buffer.h"
+
+class MaterialParameterUploader;
+
+// Byte range of a parameter block modified since its last flush
+struct MaterialParameterDirtyRange
+{
+	uint32_t offset;
+	uint32_t size;
+};
+
+// CPU copy of a material uniform block, laid out once.
+// The device buffer holds one copy of the block per frame slot, so a frame never writes the copy
+// read by the frames still in flight. Writes only touch the CPU copy and record the modified byte range
+// for every slot. When a frame is submitted the MaterialParameterUploader copies the coalesced dirty ranges
+// of its slot into the frame staging buffer and then into the copy of the slot.
+// The shaders read the copy of the current slot through a dynamic offset, so the descriptors never change.
+class MaterialParameterBlock
+{
+private:
+	MaterialParameterUploader* uploader;
+
+	std::vector<char> cpuData;
+	// ranges not uploaded yet in the copy of each frame slot
+	std::vector<std::vector<MaterialParameterDirtyRange>> dirtyRangesPerSlot;
+	// true while the block is inside the uploader dirty list
+	bool isQueued;
+
+	Buffer deviceBuffer;
+	// size of the copy of a frame slot, aligned to minUniformBufferOffsetAlignment
+	uint32_t regionSize;
+
+public:
+	MaterialParameterBlock();
+	~MaterialParameterBlock();
+
+	// Layout, must be called before createGPUSide
+	// return the offset of the parameter inside the block
+	uint32_t addParameter(uint32_t size, uint32_t alignment);
+
+	// remove all parameters, the block must not be on the GPU side
+	void resetLayout();
+
+	void createGPUSide(VkPhysicalDevice physicalDevice, VkDevice device, MaterialParameterUploader& _uploader);
+	void destroyGPUSide();
+
+	// copy the value in the CPU block and mark its range dirty
+	void write(uint32_t offset, const void* data, uint32_t size);
+	// mark the range dirty and return where to store its new value (used by the typed stores of MaterialUniformLayout.h)
+	char* writeRange(uint32_t offset, uint32_t size);
+	// mark the whole block dirty (ex : after the initial values are set)
+	void invalidate();
+
+	// append the coalesced dirty ranges of the frame slot to outRanges and clear them
+	void extractDirtyRanges(uint32_t frameSlot, std::vector<MaterialParameterDirtyRange>& outRanges);
+	// put back ranges which didn't fit in the uploader staging buffer
+	void restoreDirtyRanges(uint32_t frameSlot, const MaterialParameterDirtyRange* ranges, size_t rangeCount);
+	// true until the copies of all the slots are up to date
+	bool hasDirtyRanges() const;
+
+	void setQueued(bool queued);
+	bool getIsQueued() const;
+
+	// Getters
+	const char* getCPUData() const;
+	uint32_t getSize() const;
+	Buffer& getBuffer();
+	uint32_t getRegionSize() const;
+	// dynamic offset of the copy read by the frame being recorded
+	uint32_t getDynamicOffset() const;
+};
+
+// Gather the dirty parameter blocks and upload them once per frame, in the copies of the frame slot.
+// Each frame slot owns a persistently mapped staging buffer, recycled every frameCount frames like
+// the transient descriptor pools of the DescriptorAllocator.
+class MaterialParameterUploader
+{
+private:
+	struct FrameResources
+	{
+		Buffer stagingBuffer;
+		void* mappedStaging = nullptr;
+		VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+	};
+
+	VkDevice owningDevice;
+	// own pool, its command buffers are reset every time their frame slot comes back
+	VkCommandPool commandPool;
+	VkQueue queue;
+
+	uint32_t stagingCapacity;
+	std::vector<FrameResources> frames;
+	uint32_t currentFrame;
+	uint32_t uniformOffsetAlignment;
+
+	std::vector<MaterialParameterBlock*> dirtyBlocks;
+
+	// scratch arrays reused every frame
+	std::vector<MaterialParameterDirtyRange> rangesScratch;
+	std::vector<VkBufferCopy> copiesScratch;
+
+	uint32_t lastUploadedBytes;
+
+public:
+	MaterialParameterUploader();
+	~MaterialParameterUploader();
+
+	void create(VkPhysicalDevice physicalDevice, VkDevice device, uint32_t queueFamilyIndex, VkQueue _queue, uint32_t frameCount, uint32_t _stagingCapacity = 1024 * 1024);
+	void destroy();
+
+	void enqueue(MaterialParameterBlock& block);
+	void remove(MaterialParameterBlock& block);
+
+	// The frames recorded from now read the copies of this frame slot. Called by Renderer::beginFrame() once
+	// the fence of the slot is signaled, so the copies of the slot and its staging buffer are not in use anymore.
+	void beginFrame(uint32_t frameIndex);
+	// flush the dirty ranges of all queued blocks through the staging buffer of the current slot
+	// and submit the copies before the frame commands
+	void flush();
+
+	uint32_t getLastUploadedBytes() const;
+	uint32_t getFrameCount() const;
+	uint32_t getCurrentFrame() const;
+	uint32_t getUniformOffsetAlignment() const;
+};
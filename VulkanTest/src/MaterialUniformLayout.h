@@ -0,0 +1,211 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <tuple>
+
+// Compile time std140 / std430 layouts for material uniform blocks.
+// A block is declared as a type list, member offsets and block size are constant expressions
+// and values are written with typed stores handling the GPU side padding (ex : mat3 columns).
+
+enum class UniformLayoutRule
+{
+	Std140, // uniform buffers
+	Std430  // storage buffers
+};
+
+namespace UniformLayoutDetail
+{
+	constexpr uint32_t alignUp(uint32_t value, uint32_t alignment)
+	{
+		return (value + alignment - 1) / alignment * alignment;
+	}
+
+	constexpr uint32_t maxValue(uint32_t a, uint32_t b)
+	{
+		return a > b ? a : b;
+	}
+
+	// types stored as is, GPU size may be larger than sizeof(T) (ex : vec3 aligned on 16)
+	template<typename T, uint32_t Size, uint32_t Alignment>
+	struct PlainLayout
+	{
+		static constexpr uint32_t size = Size;
+		static constexpr uint32_t alignment = Alignment;
+
+		static void store(char* dst, const T& value)
+		{
+			memcpy(dst, &value, sizeof(T));
+		}
+	};
+
+	// matrices are stored as arrays of column vectors
+	template<typename Matrix, uint32_t ColumnCount, uint32_t ColumnStride>
+	struct MatrixLayout
+	{
+		static constexpr uint32_t size = ColumnCount * ColumnStride;
+		static constexpr uint32_t alignment = ColumnStride;
+
+		static void store(char* dst, const Matrix& value)
+		{
+			for (uint32_t column = 0; column < ColumnCount; column++)
+				memcpy(dst + column * ColumnStride, &value[column], sizeof(value[column]));
+		}
+	};
+}
+
+// Size, alignment and store function of a type inside a block.
+// Unsupported types don't compile.
+template<typename T, UniformLayoutRule Rule>
+struct UniformTypeLayout
+{
+	static_assert(sizeof(T) == 0, "type not supported inside a material uniform block !");
+};
+
+template<UniformLayoutRule Rule> struct UniformTypeLayout<float, Rule> : UniformLayoutDetail::PlainLayout<float, 4, 4> {};
+template<UniformLayoutRule Rule> struct UniformTypeLayout<int32_t, Rule> : UniformLayoutDetail::PlainLayout<int32_t, 4, 4> {};
+template<UniformLayoutRule Rule> struct UniformTypeLayout<uint32_t, Rule> : UniformLayoutDetail::PlainLayout<uint32_t, 4, 4> {};
+
+template<UniformLayoutRule Rule> struct UniformTypeLayout<glm::vec2, Rule> : UniformLayoutDetail::PlainLayout<glm::vec2, 8, 8> {};
+template<UniformLayoutRule Rule> struct UniformTypeLayout<glm::ivec2, Rule> : UniformLayoutDetail::PlainLayout<glm::ivec2, 8, 8> {};
+template<UniformLayoutRule Rule> struct UniformTypeLayout<glm::uvec2, Rule> : UniformLayoutDetail::PlainLayout<glm::uvec2, 8, 8> {};
+
+// a vec3 is aligned as a vec4 but a scalar can use its last 4 bytes
+template<UniformLayoutRule Rule> struct UniformTypeLayout<glm::vec3, Rule> : UniformLayoutDetail::PlainLayout<glm::vec3, 12, 16> {};
+template<UniformLayoutRule Rule> struct UniformTypeLayout<glm::ivec3, Rule> : UniformLayoutDetail::PlainLayout<glm::ivec3, 12, 16> {};
+template<UniformLayoutRule Rule> struct UniformTypeLayout<glm::uvec3, Rule> : UniformLayoutDetail::PlainLayout<glm::uvec3, 12, 16> {};
+
+template<UniformLayoutRule Rule> struct UniformTypeLayout<glm::vec4, Rule> : UniformLayoutDetail::PlainLayout<glm::vec4, 16, 16> {};
+template<UniformLayoutRule Rule> struct UniformTypeLayout<glm::ivec4, Rule> : UniformLayoutDetail::PlainLayout<glm::ivec4, 16, 16> {};
+template<UniformLayoutRule Rule> struct UniformTypeLayout<glm::uvec4, Rule> : UniformLayoutDetail::PlainLayout<glm::uvec4, 16, 16> {};
+
+// GLSL bool is 4 bytes
+template<UniformLayoutRule Rule>
+struct UniformTypeLayout<bool, Rule>
+{
+	static constexpr uint32_t size = 4;
+	static constexpr uint32_t alignment = 4;
+
+	static void store(char* dst, const bool& value)
+	{
+		uint32_t glslBool = value ? 1 : 0;
+		memcpy(dst, &glslBool, sizeof(glslBool));
+	}
+};
+
+// std140 rounds the column stride of every matrix to a vec4, std430 only the vec3 columns
+template<> struct UniformTypeLayout<glm::mat2, UniformLayoutRule::Std140> : UniformLayoutDetail::MatrixLayout<glm::mat2, 2, 16> {};
+template<> struct UniformTypeLayout<glm::mat2, UniformLayoutRule::Std430> : UniformLayoutDetail::MatrixLayout<glm::mat2, 2, 8> {};
+template<UniformLayoutRule Rule> struct UniformTypeLayout<glm::mat3, Rule> : UniformLayoutDetail::MatrixLayout<glm::mat3, 3, 16> {};
+template<UniformLayoutRule Rule> struct UniformTypeLayout<glm::mat4, Rule> : UniformLayoutDetail::MatrixLayout<glm::mat4, 4, 16> {};
+
+// Arrays : std140 rounds the element stride to a vec4, std430 uses the element alignment
+template<typename T, size_t N, UniformLayoutRule Rule>
+struct UniformTypeLayout<std::array<T, N>, Rule>
+{
+	using ElementLayout = UniformTypeLayout<T, Rule>;
+
+	static constexpr uint32_t alignment = Rule == UniformLayoutRule::Std140
+		? UniformLayoutDetail::alignUp(ElementLayout::alignment, 16)
+		: ElementLayout::alignment;
+	static constexpr uint32_t stride = UniformLayoutDetail::alignUp(ElementLayout::size, alignment);
+	static constexpr uint32_t size = stride * static_cast<uint32_t>(N);
+
+	static_assert(N > 0, "empty arrays are not allowed inside a material uniform block !");
+
+	static void store(char* dst, const std::array<T, N>& value)
+	{
+		for (size_t i = 0; i < N; i++)
+			ElementLayout::store(dst + i * stride, value[i]);
+	}
+};
+
+namespace UniformLayoutDetail
+{
+	template<UniformLayoutRule Rule, typename... Ts>
+	constexpr uint32_t computeMemberOffset(uint32_t memberIndex)
+	{
+		// leading 0 so the arrays are never empty
+		const uint32_t sizes[] = { 0u, UniformTypeLayout<Ts, Rule>::size... };
+		const uint32_t alignments[] = { 1u, UniformTypeLayout<Ts, Rule>::alignment... };
+
+		uint32_t offset = 0;
+		for (uint32_t i = 1; i <= memberIndex; i++)
+			offset = alignUp(offset, alignments[i]) + sizes[i];
+
+		return alignUp(offset, alignments[memberIndex + 1]);
+	}
+
+	template<UniformLayoutRule Rule, typename... Ts>
+	constexpr uint32_t computeBlockAlignment()
+	{
+		const uint32_t alignments[] = { 1u, UniformTypeLayout<Ts, Rule>::alignment... };
+
+		uint32_t maxAlignment = 1;
+		for (uint32_t i = 1; i <= sizeof...(Ts); i++)
+			maxAlignment = maxValue(maxAlignment, alignments[i]);
+
+		// std140 structures are aligned as vec4
+		return Rule == UniformLayoutRule::Std140 ? alignUp(maxAlignment, 16) : maxAlignment;
+	}
+
+	template<UniformLayoutRule Rule, typename... Ts>
+	constexpr uint32_t computeBlockSize()
+	{
+		const uint32_t sizes[] = { 0u, UniformTypeLayout<Ts, Rule>::size... };
+		const uint32_t lastMember = static_cast<uint32_t>(sizeof...(Ts)) - 1;
+
+		return alignUp(computeMemberOffset<Rule, Ts...>(lastMember) + sizes[lastMember + 1], computeBlockAlignment<Rule, Ts...>());
+	}
+}
+
+// Layout of a whole block, members are placed in declaration order
+template<UniformLayoutRule Rule, typename... Ts>
+struct UniformBlockLayout
+{
+	static_assert(sizeof...(Ts) > 0, "a material uniform block needs at least one member !");
+
+	template<size_t I>
+	using MemberType = typename std::tuple_element<I, std::tuple<Ts...>>::type;
+
+	template<size_t I>
+	using MemberLayout = UniformTypeLayout<MemberType<I>, Rule>;
+
+	static constexpr uint32_t memberCount = static_cast<uint32_t>(sizeof...(Ts));
+	static constexpr uint32_t alignment = UniformLayoutDetail::computeBlockAlignment<Rule, Ts...>();
+	static constexpr uint32_t size = UniformLayoutDetail::computeBlockSize<Rule, Ts...>();
+
+	template<size_t I>
+	static constexpr uint32_t offset()
+	{
+		static_assert(I < sizeof...(Ts), "material uniform block member index out of range !");
+		return UniformLayoutDetail::computeMemberOffset<Rule, Ts...>(static_cast<uint32_t>(I));
+	}
+
+	// 16KB is the minimum maxUniformBufferRange guaranteed by Vulkan
+	static_assert(Rule != UniformLayoutRule::Std140 || size <= 16384, "material uniform block is larger than the guaranteed uniform buffer range !");
+};
+
+// Check the engine against the std140 / std430 rules
+namespace UniformLayoutDetail
+{
+	using CheckScalarAfterVec3 = UniformBlockLayout<UniformLayoutRule::Std140, glm::vec3, float>;
+	static_assert(CheckScalarAfterVec3::offset<1>() == 12, "a scalar must fill the padding of a vec3 !");
+	static_assert(CheckScalarAfterVec3::size == 16, "std140 block size must be rounded to 16 !");
+
+	using CheckVec3AfterScalar = UniformBlockLayout<UniformLayoutRule::Std140, float, glm::vec3, glm::vec2>;
+	static_assert(CheckVec3AfterScalar::offset<1>() == 16, "a vec3 must be aligned on 16 bytes !");
+	static_assert(CheckVec3AfterScalar::offset<2>() == 32, "a vec2 can't use the padding of a vec3 !");
+
+	using CheckMatrices = UniformBlockLayout<UniformLayoutRule::Std140, float, glm::mat3, glm::mat4>;
+	static_assert(CheckMatrices::offset<1>() == 16 && CheckMatrices::offset<2>() == 64, "mat3 columns must have a 16 bytes stride !");
+
+	using CheckStd140Array = UniformBlockLayout<UniformLayoutRule::Std140, std::array<float, 4>, float>;
+	static_assert(CheckStd140Array::offset<1>() == 64, "std140 array elements must have a 16 bytes stride !");
+
+	using CheckStd430Array = UniformBlockLayout<UniformLayoutRule::Std430, std::array<float, 4>, float>;
+	static_assert(CheckStd430Array::offset<1>() == 16 && CheckStd430Array::size == 20, "std430 scalar arrays must be tightly packed !");
+}
@@ -40,38 +40,14 @@ void MaterialUniformBuffer::destroyGPUSide(const GraphicsContext& context)
 	ubo.destroy();
 }
 
-VkWriteDescriptorSet MaterialUniformBuffer::getWriteDescriptorSet(const VkDescriptorSet& owningSet) const
+void MaterialUniformBuffer::getDescriptorUpdateData(DescriptorUpdateData& outData) const
 {
-	VkDescriptorBufferInfo bufferInfo = {};
-	bufferInfo.buffer = *ubo.getBufferHandle();
-	bufferInfo.offset = 0;
-	bufferInfo.range = ubo.getSize();
-
-	VkWriteDescriptorSet descriptorSetWrite;
-	descriptorSetWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-	descriptorSetWrite.dstSet = owningSet;
-	descriptorSetWrite.dstBinding = 0;
-	descriptorSetWrite.dstArrayElement = 0;
-	descriptorSetWrite.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-	descriptorSetWrite.descriptorCount = 1;
-	descriptorSetWrite.pBufferInfo = &bufferInfo;
-
-	return descriptorSetWrite;
+	outData.bufferInfo.buffer = *ubo.getBufferHandle();
+	outData.bufferInfo.offset = 0;
+	outData.bufferInfo.range = ubo.getSize();
 }
 
 VkDescriptorType MaterialUniformBuffer::getDescriptorType() const
 {
 	return VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-}
-
-const VkDescriptorSetLayoutBinding& MaterialUniformBuffer::getDescriptorSetLayoutBinding() const
-{
-	VkDescriptorSetLayoutBinding binding;
-	binding.binding = 0;
-	binding.descriptorCount = 1;
-	binding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-	binding.pImmutableSamplers = nullptr;
-	binding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
-
-	return binding;
 }
\ No newline at end of file
@@ -2,6 +2,8 @@
 
 #include "MaterialParameter.h"
 #include "MaterialInputs.h"
+#include "MaterialParameterBlock.h"
+#include "MaterialUniformLayout.h"
 
 class GraphicsContext;
 
@@ -9,18 +11,55 @@ class GraphicsContext;
 
 class MaterialInternalUniformBase : public MaterialParameter
 {
+protected:
+	// block holding the value once the parameter buffer is created
+	MaterialParameterBlock* parameterBlock = nullptr;
+	uint32_t blockOffset = 0;
+
 public:
 	virtual void* getValuePtr() = 0;
 	virtual size_t getValueSize() = 0;
+
+	// std140 size and alignment of the value inside the block
+	virtual uint32_t getLayoutSize() const = 0;
+	virtual uint32_t getLayoutAlignment() const = 0;
+	// write the whole value in the block, only used when the block is created
+	virtual void storeToBlock() = 0;
+
+	void bindToBlock(MaterialParameterBlock* block, uint32_t offset)
+	{
+		parameterBlock = block;
+		blockOffset = offset;
+	}
+
+	uint32_t getBlockOffset() const
+	{
+		return blockOffset;
+	}
 };
 
 template<typename T>
-class MaterialInternalUniform : public MaterialUniformBase
+class MaterialInternalUniform : public MaterialInternalUniformBase
 {
 private:
+	using ValueLayout = UniformTypeLayout<T, UniformLayoutRule::Std140>;
+
 	T value;
 
 public:
+	// only the bytes of this uniform are uploaded at the next frame
+	void setValue(const T& newValue)
+	{
+		value = newValue;
+		if (parameterBlock != nullptr)
+			ValueLayout::store(parameterBlock->writeRange(blockOffset, ValueLayout::size), value);
+	}
+
+	const T& getValue() const
+	{
+		return value;
+	}
+
 	virtual void* getValuePtr() override
 	{
 		return &value;
@@ -30,6 +69,21 @@ public:
 	{
 		return sizeof(T);
 	}
+
+	virtual uint32_t getLayoutSize() const override
+	{
+		return ValueLayout::size;
+	}
+
+	virtual uint32_t getLayoutAlignment() const override
+	{
+		return ValueLayout::alignment;
+	}
+
+	virtual void storeToBlock() override
+	{
+		ValueLayout::store(parameterBlock->writeRange(blockOffset, ValueLayout::size), value);
+	}
 };
 
 class IMaterialInternalParameterBuffer
@@ -39,11 +93,13 @@ public:
 	virtual void destroyGPUSide(const VkDevice& device) = 0;
 };
 
+// The uniforms are laid out once in a MaterialParameterBlock.
+// Changing a uniform afterward only uploads its bytes at the next frame start.
 class MaterialInternalUniformParameterBuffer : public IMaterialInternalParameterBuffer
 {
 private:
 	std::vector<std::unique_ptr<MaterialInternalUniformBase>> uniforms;
-	Buffer ubo;
+	MaterialParameterBlock parameterBlock;
 
 public:
 	void AddUniform(std::unique_ptr<MaterialInternalUniformBase>&& newUniform)
@@ -51,84 +107,108 @@ public:
 		uniforms.push_back(std::move(newUniform));
 	}
 
-	// create the ubo based on the uniforms
+	// layout the uniforms and create the ubo, initial values are uploaded at the next frame
 	void createGPUSide(const GraphicsContext& context) override
 	{
-		std::vector<void*> datas(uniforms.size());
-
-		size_t totalSize = 0;
-		int index = 0;
 		for (auto& uniform : uniforms)
 		{
-			totalSize += uniform->getValueSize();
-			datas[index] = uniform->getValuePtr();
-			index++;
+			uint32_t offset = parameterBlock.addParameter(uniform->getLayoutSize(), uniform->getLayoutAlignment());
+			uniform->bindToBlock(&parameterBlock, offset);
 		}
 
-		// create buffer based on data size inside ubos
-		BufferCreateInfo createInfo;
-		createInfo.physicalDevice = context.getPhysicalDevice();
-		createInfo.owningDevice = context.getDevice();
-		createInfo.itemCount = 1;
-		createInfo.itemSizeNotAligned = totalSize;
-		createInfo.usage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT;
-		ubo.create(createInfo, false);
+		parameterBlock.createGPUSide(context.getPhysicalDevice(), context.getDevice(), context.getMaterialParameterUploader());
 
-		// map these datas to buffer
-		BufferCopyInfo mappingInfo(totalSize, 1);
-		ubo.pushDatasToBuffer(context.getPhysicalDevice(), datas.data(), mappingInfo);
+		for (auto& uniform : uniforms)
+		{
+			uniform->storeToBlock();
+		}
 	}
 
 	void destroyGPUSide(const VkDevice& device) override
 	{
-		ubo.destroy();
+		for (auto& uniform : uniforms)
+		{
+			uniform->bindToBlock(nullptr, 0);
+		}
+		parameterBlock.destroyGPUSide();
+		parameterBlock.resetLayout();
+	}
+
+	MaterialParameterBlock* getParameterBlock()
+	{
+		return &parameterBlock;
 	}
 };
 
-class MaterialUniformBuffer final : public MaterialInput
+// Parameter block declared as a type list, laid out at compile time :
+//	MaterialTypedParameterBuffer<UniformLayoutRule::Std140, glm::vec4, float, glm::mat4> buffer;
+//	buffer.set<1>(roughness);
+// Values are stored directly at their constant offset, without virtual calls.
+template<UniformLayoutRule Rule, typename... Ts>
+class MaterialTypedParameterBuffer final : public IMaterialInternalParameterBuffer
 {
+public:
+	using Layout = UniformBlockLayout<Rule, Ts...>;
+
 private:
-	Buffer* ubo;
+	MaterialParameterBlock parameterBlock;
 
 public:
-	void setUBORef(Buffer* uboRef)
+	MaterialTypedParameterBuffer()
 	{
-		ubo = uboRef;
+		// values set before createGPUSide are kept in the CPU block
+		parameterBlock.addParameter(Layout::size, Layout::alignment);
 	}
 
-	VkWriteDescriptorSet getWriteDescriptorSet(const VkDescriptorSet& owningSet) const override
+	template<size_t I>
+	void set(const typename Layout::template MemberType<I>& value)
 	{
-		VkDescriptorBufferInfo bufferInfo = {};
-		bufferInfo.buffer = *(ubo->getBufferHandle());
-		bufferInfo.offset = 0;
-		bufferInfo.range = ubo->getSize();
+		using MemberLayout = typename Layout::template MemberLayout<I>;
+		MemberLayout::store(parameterBlock.writeRange(Layout::template offset<I>(), MemberLayout::size), value);
+	}
 
-		VkWriteDescriptorSet descriptorSetWrite;
-		descriptorSetWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-		descriptorSetWrite.dstSet = owningSet;
-		descriptorSetWrite.dstBinding = binding;
-		descriptorSetWrite.dstArrayElement = 0;
-		descriptorSetWrite.descriptorType = getDescriptorType();
-		descriptorSetWrite.descriptorCount = 1;
-		descriptorSetWrite.pBufferInfo = &bufferInfo;
+	void createGPUSide(const GraphicsContext& context) override
+	{
+		parameterBlock.createGPUSide(context.getPhysicalDevice(), context.getDevice(), context.getMaterialParameterUploader());
+	}
 
-		return descriptorSetWrite;
+	void destroyGPUSide(const VkDevice& device) override
+	{
+		parameterBlock.destroyGPUSide();
 	}
 
-	VkDescriptorType getDescriptorType() const override
+	MaterialParameterBlock* getParameterBlock()
 	{
-		return VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+		return &parameterBlock;
 	}
+};
 
-	const VkDescriptorSetLayoutBinding& getDescriptorSetLayoutBinding() const override
+// The descriptor covers one copy of the block, the copy of the current frame slot is selected by the dynamic offset
+class MaterialUniformBuffer final : public MaterialInput
+{
+private:
+	MaterialParameterBlock* parameterBlock;
+
+public:
+	void setParameterBlock(MaterialParameterBlock* block)
+	{
+		parameterBlock = block;
+	}
+
+	void getDescriptorUpdateData(DescriptorUpdateData& outData) const override
 	{
-		VkDescriptorSetLayoutBinding binding;
-		binding.binding = binding;
-		binding.descriptorCount = 1;
-		binding.descriptorType = getDescriptorType();
-		binding.pImmutableSamplers = nullptr;
-		binding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+		outData.bufferInfo.buffer = *(parameterBlock->getBuffer().getBufferHandle());
+		outData.bufferInfo.offset = 0;
+		outData.bufferInfo.range = parameterBlock->getSize();
+	}
 
-		return binding;
+	VkDescriptorType getDescriptorType() const override
+	{
+		return VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+	}
+
+	uint32_t getDynamicOffset() const override
+	{
+		return parameterBlock->getDynamicOffset();
 	}
 };
\ No newline at end of file
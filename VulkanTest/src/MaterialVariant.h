@@ -0,0 +1,44 @@
+#pragma once
+
+#include <vulkan/vulkan.hpp>
+
+// Feature switches of a material.
+// Each feature is a boolean specialization constant, its constant_id is the index of its bit :
+//	layout(constant_id = 0) const bool NORMAL_MAPPING = false;
+// Dead branches are removed when the pipeline of a variant is compiled.
+enum MaterialFeatureBits : uint32_t
+{
+	MATERIAL_FEATURE_NORMAL_MAPPING = 1 << 0,
+	MATERIAL_FEATURE_ALPHA_TEST = 1 << 1,
+	MATERIAL_FEATURE_SKINNING = 1 << 2,
+	MATERIAL_FEATURE_SHADOW_RECEIVE = 1 << 3
+};
+typedef uint32_t MaterialFeatureFlags;
+
+#define MATERIAL_FEATURE_COUNT 4
+
+// Specialization constants of a variant, given to all shader stages.
+// VkSpecializationInfo points inside the struct, don't copy it after build().
+struct MaterialSpecializationData
+{
+	VkBool32 values[MATERIAL_FEATURE_COUNT];
+	VkSpecializationMapEntry entries[MATERIAL_FEATURE_COUNT];
+	VkSpecializationInfo info;
+
+	void build(MaterialFeatureFlags features)
+	{
+		for (uint32_t i = 0; i < MATERIAL_FEATURE_COUNT; i++)
+		{
+			values[i] = (features & (1u << i)) != 0 ? VK_TRUE : VK_FALSE;
+
+			entries[i].constantID = i;
+			entries[i].offset = i * sizeof(VkBool32);
+			entries[i].size = sizeof(VkBool32);
+		}
+
+		info.mapEntryCount = MATERIAL_FEATURE_COUNT;
+		info.pMapEntries = entries;
+		info.dataSize = sizeof(values);
+		info.pData = values;
+	}
+};
@@ -2,60 +2,131 @@
 
 #include <vulkan/vulkan.hpp>
 #include <glm/glm.hpp>
+#include <algorithm>
+#include <cstring>
 #include <map>
+#include <utility>
+#include <vector>
 
+#include "Bounds.h"
 #include "Buffer.h"
+#include "GeometryPool.h"
+#include "GraphicsContext.h"
+#include "MeshFile.h"
+#include "MeshLod.h"
+#include "MeshOptimizer.h"
+#include "MeshSimplifier.h"
+#include "OcclusionCulling.h"
 #include "Renderable.h"
+#include "Skeleton.h"
+#include "VertexLayout.h"
+#include "VulkanUtils.h"
 
-struct Vertex
+template<typename VertexType>
+class TMeshData
 {
-	glm::vec3 position;
-	glm::vec3 color;
-	glm::vec2 texCoord;
+private:
+	std::vector<VertexType> vertices;
+	std::vector<uint32_t> indices;
+
+	Buffer vertexBuffer;
+	Buffer indexBuffer;
+	// indices are narrowed to 16 bits on upload when the vertex count allows it
+	VkIndexType indexType = VK_INDEX_TYPE_UINT32;
+
+	// dynamic meshes only : persistently mapped staging buffer with a slice of the whole vertex count per frame slot,
+	// the slice written during the current frame and the vertex ranges written since the last flush
+	Buffer vertexStagingBuffer;
+	uint32_t stagingSliceCount = 0;
+	uint32_t currentStagingSlice = 0;
+	// sorted, disjoint [begin, end) ranges : only they are valid in the slice
+	std::vector<std::pair<uint32_t, uint32_t>> dirtyVertexRanges;
 
-	static VkVertexInputBindingDescription getBindingDescription()
+	// only used by vertex types with quantized positions
+	VertexQuantization quantization;
+
+	// object space bounds, computed when the GPU side is created
+	Bounds bounds;
+
+	// empty until generateLods() is called, the first level is the full resolution mesh
+	std::vector<MeshLod> lods;
+
+	// set when the mesh lives inside a shared geometry pool instead of its own buffers
+	GeometryPool* geometryPool = nullptr;
+	GeometryAllocation geometryAllocation;
+
+	VertexType* getStagingSlice(uint32_t slice) const
 	{
-		VkVertexInputBindingDescription bindingDescription = {};
-		bindingDescription.binding = 0;
-		bindingDescription.stride = sizeof(Vertex);
-		bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
-		return bindingDescription;
+		return static_cast<VertexType*>(vertexStagingBuffer.getMappedData()) + slice * vertexBuffer.getItemCount();
 	}
 
-	static std::array<VkVertexInputAttributeDescription, 3> getAttributeDescriptions()
+	void addDirtyVertexRange(uint32_t begin, uint32_t end)
 	{
-		std::array<VkVertexInputAttributeDescription, 3> attributeDescription = {};
-		attributeDescription[0].binding = 0;
-		attributeDescription[0].format = VK_FORMAT_R32G32B32_SFLOAT;
-		attributeDescription[0].location = 0;
-		attributeDescription[0].offset = offsetof(Vertex, position);
-
-		attributeDescription[1].binding = 0;
-		attributeDescription[1].format = VK_FORMAT_R32G32B32_SFLOAT;
-		attributeDescription[1].location = 1;
-		attributeDescription[1].offset = offsetof(Vertex, color);
+		// first range ending at or after begin, then merge all the ranges touching [begin, end)
+		auto first = std::lower_bound(dirtyVertexRanges.begin(), dirtyVertexRanges.end(), begin, [](const std::pair<uint32_t, uint32_t>& range, uint32_t value)
+		{
+			return range.second < value;
+		});
+		auto last = first;
+		for (; last != dirtyVertexRanges.end() && last->first <= end; ++last)
+		{
+			begin = std::min(begin, last->first);
+			end = std::max(end, last->second);
+		}
 
-		attributeDescription[2].binding = 0;
-		attributeDescription[2].format = VK_FORMAT_R32G32_SFLOAT;;
-		attributeDescription[2].location = 2;
-		attributeDescription[2].offset = offsetof(Vertex, texCoord);
+		first = dirtyVertexRanges.erase(first, last);
+		dirtyVertexRanges.insert(first, std::make_pair(begin, end));
+	}
 
-		return attributeDescription;
+	void checkNotDynamic() const
+	{
+		if (isDynamic())
+			throw std::runtime_error("the arrays of a dynamic mesh can't be replaced, use mapVertices() or updateVertices() !");
 	}
-};
 
+	// lods and quantization of a cooked mesh, throw if it was cooked for another vertex format
+	void readFileDescription(const MeshFileView& file)
+	{
+		if (!file.template matchesVertexLayout<VertexType>())
+			throw std::runtime_error("cooked mesh vertex layout doesn't match the mesh vertex format !");
 
-template<typename VertexType>
-class TMeshData
-{
-private:
-	std::vector<VertexType> vertices;
-	std::vector<uint32_t> indices;
+		vertices.clear();
+		indices.clear();
+		lods.assign(file.getLods(), file.getLods() + file.getLodCount());
+		quantization = file.getQuantization();
 
-	Buffer vertexBuffer;
-	Buffer indexBuffer;
+		const MeshFileHeader& header = file.getHeader();
+		AABB box;
+		box.min = glm::vec3(header.boundsMin[0], header.boundsMin[1], header.boundsMin[2]);
+		box.max = glm::vec3(header.boundsMax[0], header.boundsMax[1], header.boundsMax[2]);
+		bounds = Bounds::fromBox(box);
+	}
+
+	void computeBounds()
+	{
+		std::vector<glm::vec3> positions;
+		gatherPositions(positions);
+		bounds = Bounds::fromPoints(positions.data(), positions.size());
+	}
+
+	void gatherPositions(std::vector<glm::vec3>& outPositions) const
+	{
+		outPositions.resize(vertices.size());
+		for (size_t i = 0; i < vertices.size(); i++)
+			outPositions[i] = getVertexPosition(vertices[i], quantization);
+	}
 
 public:
+	void setQuantization(const VertexQuantization& _quantization)
+	{
+		quantization = _quantization;
+	}
+
+	const VertexQuantization& getQuantization() const
+	{
+		return quantization;
+	}
+
 	void setVertexCount(size_t count)
 	{
 		vertices.resize(count);
@@ -63,61 +134,386 @@ public:
 
 	bool setVertexData(uint32_t vertexIndex, const VertexType& data, bool adaptSize = false)
 	{
-		if (vertexIndex < 0 || (!adaptSize && vertexIndex >= vertices.size()))
-			return false;
+		return setVerticesData(&data, 1, vertexIndex, adaptSize);
+	}
 
-		if (adaptSize && vertexIndex >= vertices.size())
-			vertices.resize(vertexIndex + 1);
+	// Bulk copy of count vertices starting at firstVertex.
+	// Once a dynamic GPU side exists the vertices are written straight into its staging memory and can't be resized.
+	bool setVerticesData(const VertexType* verticesData, size_t count, uint32_t firstVertex = 0, bool adaptSize = false)
+	{
+		const size_t lastVertex = firstVertex + count;
+		if (isDynamic())
+		{
+			if (lastVertex > vertexBuffer.getItemCount())
+				return false;
+
+			updateVertices(verticesData, static_cast<uint32_t>(count), firstVertex);
+			return true;
+		}
+
+		if (lastVertex > vertices.size())
+		{
+			if (!adaptSize)
+				return false;
+			vertices.resize(lastVertex);
+		}
 
-		vertices[vertexIndex] = data;
+		std::copy(verticesData, verticesData + count, vertices.begin() + firstVertex);
 		return true;
 	}
 
-	bool setVerticesData(const std::vector<VertexType>& verticesData, uint32_t firstIndex = 0, bool adaptSize = false)
+	bool setVerticesData(const std::vector<VertexType>& verticesData, uint32_t firstVertex = 0, bool adaptSize = false)
 	{
-		if (adaptSize)
-			setVertexCount(firstIndex + verticesData.size());
+		return setVerticesData(verticesData.data(), verticesData.size(), firstVertex, adaptSize);
+	}
 
-		int index = firstIndex;
-		bool success = true;
-		for (const auto& vertexData : verticesData)
+	// the index buffer of a dynamic mesh is never uploaded again, so this fails once the dynamic GPU side exists
+	bool setIndicesData(const uint32_t* indicesData, size_t count, uint32_t firstIndex = 0, bool adaptSize = false)
+	{
+		if (isDynamic())
+			return false;
+
+		const size_t lastIndex = firstIndex + count;
+		if (lastIndex > indices.size())
 		{
-			success = setVertexData(index, vertexData, false);
-			if (!success)
+			if (!adaptSize)
 				return false;
+			indices.resize(lastIndex);
 		}
-		return success;
+
+		std::copy(indicesData, indicesData + count, indices.begin() + firstIndex);
+		lods.clear();
+		return true;
 	}
 
-	void createGPUSide(const GraphicsContext& context)
+	// Take the arrays without copying them. The swap versions give back the previous arrays,
+	// so a mesh rebuilt every frame on the CPU side can ping pong between two arrays and keep their capacity.
+	// They throw on dynamic meshes : their vertices live in the staging memory, see mapVertices() and updateVertices(),
+	// and their indices can't be updated.
+	void adoptVertices(std::vector<VertexType>&& verticesData)
 	{
+		checkNotDynamic();
+		vertices = std::move(verticesData);
+	}
+
+	void adoptIndices(std::vector<uint32_t>&& indicesData)
+	{
+		checkNotDynamic();
+		indices = std::move(indicesData);
+		lods.clear();
+	}
+
+	void swapVertices(std::vector<VertexType>& verticesData)
+	{
+		checkNotDynamic();
+		vertices.swap(verticesData);
+	}
+
+	void swapIndices(std::vector<uint32_t>& indicesData)
+	{
+		checkNotDynamic();
+		indices.swap(indicesData);
+		lods.clear();
+	}
+
+	const std::vector<VertexType>& getVertices() const
+	{
+		return vertices;
+	}
+
+	const std::vector<uint32_t>& getIndices() const
+	{
+		return indices;
+	}
+
+	// Reorder triangles and vertices for the post transform cache, overdraw and vertex fetch.
+	// Must be called before generateLods() and createGPUSide().
+	void optimize(MeshOptimizationReport* outReport = nullptr)
+	{
+		if (lods.size() > 1)
+			throw std::runtime_error("mesh optimization must be done before generating the levels of detail !");
+
+		std::vector<glm::vec3> positions;
+		gatherPositions(positions);
+		MeshOptimizer::optimizeMesh(vertices, indices, positions, outReport);
+	}
+
+	// Append simplified versions of the mesh after the full resolution indices, all levels share the vertices.
+	// Each level is simplified from the full resolution mesh so its error is measured against it.
+	void generateLods(const MeshLodSettings& settings = MeshLodSettings())
+	{
+		// drop the levels of a previous generation
+		if (!lods.empty())
+			indices.resize(lods[0].indexCount);
+
+		std::vector<glm::vec3> positions;
+		gatherPositions(positions);
+		MeshSimplifier::generateLodChain(indices, positions, settings, lods);
+	}
+
+	const std::vector<MeshLod>& getLods() const
+	{
+		return lods;
+	}
+
+	// the whole index buffer if no level of detail was generated
+	MeshLod getLod(uint32_t lodIndex) const
+	{
+		if (lods.empty())
+			return MeshLod{ 0, static_cast<uint32_t>(indices.size()), 0.f };
+
+		return lods[std::min<size_t>(lodIndex, lods.size() - 1)];
+	}
+
+	// extraVertexUsage : the vertex buffer can also be read by other stages, like the skinning compute shader
+	void createGPUSide(const GraphicsContext& context, VkBufferUsageFlags extraVertexUsage = 0)
+	{
+		computeBounds();
+
 		{
 			BufferCreateInfo createInfo = {};
-			createInfo.itemCount = static_cast<uint32_t>(vertexBuffer.getSize());
+			createInfo.itemCount = static_cast<uint32_t>(vertices.size());
+			createInfo.itemSizeNotAligned = sizeof(VertexType);
+			createInfo.owningDevice = context.getDevice();
+			createInfo.physicalDevice = context.getPhysicalDevice();
+			createInfo.usage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | extraVertexUsage;
+
+			vertexBuffer.create(createInfo, true);
+			vertexBuffer.pushDatasToBuffer(vertices.data(), BufferCopyInfo::makeFromItem(createInfo.itemCount), true, context.getPhysicalDevice(), context.getCommandPool(), context.getGraphicsQueue());
+		}
+
+		{
+			indexType = MeshOptimizer::selectIndexType(vertices.size());
+
+			BufferCreateInfo createInfo = {};
+			createInfo.itemCount = static_cast<uint32_t>(indices.size());
+			createInfo.itemSizeNotAligned = MeshOptimizer::getIndexSize(indexType);
+			createInfo.owningDevice = context.getDevice();
+			createInfo.physicalDevice = context.getPhysicalDevice();
+			createInfo.usage = VK_BUFFER_USAGE_INDEX_BUFFER_BIT;
+
+			indexBuffer.create(createInfo, true);
+
+			const BufferCopyInfo copyInfo = BufferCopyInfo::makeFromItem(createInfo.itemCount);
+			if (indexType == VK_INDEX_TYPE_UINT16)
+			{
+				std::vector<uint16_t> narrowedIndices(indices.begin(), indices.end());
+				indexBuffer.pushDatasToBuffer(narrowedIndices.data(), copyInfo, true, context.getPhysicalDevice(), context.getCommandPool(), context.getGraphicsQueue());
+			}
+			else
+			{
+				indexBuffer.pushDatasToBuffer(indices.data(), copyInfo, true, context.getPhysicalDevice(), context.getCommandPool(), context.getGraphicsQueue());
+			}
+		}
+	}
+
+	// For meshes rebuilt at runtime : updates are written into a persistently mapped staging buffer
+	// and only the modified range is copied by cmdFlushVertexUpdates(), in the command buffer of the frame.
+	// The staging buffer has a slice per frame slot, so the CPU never writes a slice that a pending frame copies from.
+	// The vertex count is fixed by this call and the indices can't be updated afterwards.
+	void createDynamicGPUSide(const GraphicsContext& context, uint32_t frameCount)
+	{
+		createGPUSide(context);
+
+		stagingSliceCount = std::max(frameCount, 1u);
+		currentStagingSlice = 0;
+
+		BufferCreateInfo createInfo = {};
+		createInfo.itemCount = static_cast<uint32_t>(vertices.size()) * stagingSliceCount;
+		createInfo.itemSizeNotAligned = sizeof(VertexType);
+		createInfo.owningDevice = context.getDevice();
+		createInfo.physicalDevice = context.getPhysicalDevice();
+		createInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+
+		vertexStagingBuffer.create(createInfo, false);
+		if (vertexStagingBuffer.map() == nullptr)
+			throw std::runtime_error("failed to map dynamic mesh staging buffer !");
+
+		// the vertices are in the vertex buffer, updates only go through the staging slices
+		vertices.clear();
+		vertices.shrink_to_fit();
+	}
+
+	bool isDynamic() const
+	{
+		return vertexStagingBuffer.getMappedData() != nullptr;
+	}
+
+	// Call with the slot returned by Renderer::beginFrame(), before writing the vertices of the frame.
+	// The fence of the slot has been waited for, so the copy reading its slice is done.
+	void beginFrame(uint32_t frameIndex)
+	{
+		if (!isDynamic())
+			return;
+
+		const uint32_t previousSlice = currentStagingSlice;
+		currentStagingSlice = frameIndex % stagingSliceCount;
+
+		// ranges written but not flushed during the previous frame move to the new slice
+		if (previousSlice == currentStagingSlice)
+			return;
+
+		for (const auto& range : dirtyVertexRanges)
+		{
+			memcpy(getStagingSlice(currentStagingSlice) + range.first, getStagingSlice(previousSlice) + range.first
+				, (range.second - range.first) * sizeof(VertexType));
+		}
+	}
+
+	// Staging memory of a vertex range of a dynamic mesh, to be filled before the next flush.
+	// The slice only holds the ranges written this frame : the whole range must be written, not only read back.
+	VertexType* mapVertices(uint32_t firstVertex, uint32_t count)
+	{
+		if (!isDynamic())
+			throw std::runtime_error("only dynamic meshes can map their vertices !");
+		if (firstVertex + count > vertexBuffer.getItemCount())
+			throw std::runtime_error("mapped vertex range out of the vertex buffer !");
+
+		if (count > 0)
+			addDirtyVertexRange(firstVertex, firstVertex + count);
+
+		return getStagingSlice(currentStagingSlice) + firstVertex;
+	}
+
+	void updateVertices(const VertexType* verticesData, uint32_t count, uint32_t firstVertex = 0)
+	{
+		memcpy(mapVertices(firstVertex, count), verticesData, count * sizeof(VertexType));
+	}
+
+	// Record the copy of the vertex ranges modified this frame to the vertex buffer.
+	// Must be recorded outside of a render pass, before the first pass drawing the mesh.
+	void cmdFlushVertexUpdates(const GraphicsContext& context, VkCommandBuffer commandBuffer)
+	{
+		if (dirtyVertexRanges.empty())
+			return;
+
+		// the passes of the previous frames read the vertices before they are overwritten
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 0, nullptr);
+
+		const uint32_t sliceFirstVertex = currentStagingSlice * vertexBuffer.getItemCount();
+		std::vector<BufferCopyInfo> copyInfos;
+		copyInfos.reserve(dirtyVertexRanges.size());
+		for (const auto& range : dirtyVertexRanges)
+			copyInfos.push_back(BufferCopyInfo::makeFromItem(range.second - range.first, sliceFirstVertex + range.first, range.first));
+		cmdCopyBufferToBuffer(context.getDevice(), commandBuffer, context.getGraphicsQueue(), vertexStagingBuffer, vertexBuffer
+			, copyInfos.data(), static_cast<uint32_t>(copyInfos.size()));
+
+		const uint32_t dirtyVertexBegin = dirtyVertexRanges.front().first;
+		const uint32_t dirtyVertexEnd = dirtyVertexRanges.back().second;
+
+		VkBufferMemoryBarrier writeBeforeRead = {};
+		writeBeforeRead.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+		writeBeforeRead.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		writeBeforeRead.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT;
+		writeBeforeRead.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		writeBeforeRead.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		writeBeforeRead.buffer = *vertexBuffer.getBufferHandle();
+		writeBeforeRead.offset = dirtyVertexBegin * sizeof(VertexType);
+		writeBeforeRead.size = (dirtyVertexEnd - dirtyVertexBegin) * sizeof(VertexType);
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, 0, 0, nullptr, 1, &writeBeforeRead, 0, nullptr);
+
+		dirtyVertexRanges.clear();
+	}
+
+	// Copy the mesh inside the shared buffers of its vertex format, so it can be drawn
+	// without rebinding the vertex and index buffers between meshes of the same pool block.
+	void createGPUSideInPool(GeometryPool& pool)
+	{
+		computeBounds();
+
+		geometryAllocation = pool.allocate(vertices.data(), static_cast<uint32_t>(vertices.size()), indices.data(), static_cast<uint32_t>(indices.size()));
+		geometryPool = &pool;
+		indexType = pool.getIndexType();
+	}
+
+	// Upload a cooked mesh directly from the file memory, the blobs are copied once to the staging buffers.
+	// The CPU side vertices and indices stay empty.
+	void createGPUSide(const GraphicsContext& context, const MeshFileView& file)
+	{
+		readFileDescription(file);
+
+		{
+			BufferCreateInfo createInfo = {};
+			createInfo.itemCount = file.getVertexCount();
 			createInfo.itemSizeNotAligned = sizeof(VertexType);
 			createInfo.owningDevice = context.getDevice();
 			createInfo.physicalDevice = context.getPhysicalDevice();
 			createInfo.usage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT;
 
 			vertexBuffer.create(createInfo, true);
+			vertexBuffer.pushDatasToBuffer(file.getVertexData(), BufferCopyInfo::makeFromItem(createInfo.itemCount), true, context.getPhysicalDevice(), context.getCommandPool(), context.getGraphicsQueue());
 		}
 
 		{
+			indexType = file.getIndexType();
+
 			BufferCreateInfo createInfo = {};
-			createInfo.itemCount = static_cast<uint32_t>(indexBuffer.getSize());
-			createInfo.itemSizeNotAligned = sizeof(uint32_t);
+			createInfo.itemCount = file.getIndexCount();
+			createInfo.itemSizeNotAligned = MeshOptimizer::getIndexSize(indexType);
 			createInfo.owningDevice = context.getDevice();
 			createInfo.physicalDevice = context.getPhysicalDevice();
 			createInfo.usage = VK_BUFFER_USAGE_INDEX_BUFFER_BIT;
 
 			indexBuffer.create(createInfo, true);
+			indexBuffer.pushDatasToBuffer(file.getIndexData(), BufferCopyInfo::makeFromItem(createInfo.itemCount), true, context.getPhysicalDevice(), context.getCommandPool(), context.getGraphicsQueue());
 		}
 	}
 
+	void createGPUSideInPool(GeometryPool& pool, const MeshFileView& file)
+	{
+		readFileDescription(file);
+
+		geometryAllocation = pool.allocate(file.getVertexData(), file.getVertexCount(), file.getIndexData(), file.getIndexType(), file.getIndexCount());
+		geometryPool = &pool;
+		indexType = pool.getIndexType();
+	}
+
 	void destroyGPUSide()
 	{
-		vertexBuffer.destroy();
-		indexBuffer.destroy();
+		if (geometryPool != nullptr)
+		{
+			geometryPool->free(geometryAllocation);
+			geometryPool = nullptr;
+		}
+		else
+		{
+			vertexBuffer.destroy();
+			indexBuffer.destroy();
+			vertexStagingBuffer.destroy();
+			stagingSliceCount = 0;
+			currentStagingSlice = 0;
+			dirtyVertexRanges.clear();
+		}
+	}
+
+	void cmdBindBuffers(VkCommandBuffer commandBuffer) const
+	{
+		if (geometryPool != nullptr)
+		{
+			geometryPool->cmdBindBuffers(commandBuffer, geometryAllocation.blockIndex);
+		}
+		else
+		{
+			VkDeviceSize offsets[] = { 0 };
+			vkCmdBindVertexBuffers(commandBuffer, 0, 1, vertexBuffer.getBufferHandle(), offsets);
+			vkCmdBindIndexBuffer(commandBuffer, *indexBuffer.getBufferHandle(), 0, indexType);
+		}
+	}
+
+	void cmdDrawLod(VkCommandBuffer commandBuffer, uint32_t lodIndex) const
+	{
+		const MeshLod lod = getLod(lodIndex);
+		// geometryAllocation is zero when the mesh owns its buffers
+		vkCmdDrawIndexed(commandBuffer, lod.indexCount, 1, geometryAllocation.firstIndex + lod.firstIndex, static_cast<int32_t>(geometryAllocation.vertexOffset), 0);
+	}
+
+	// meshes returning the same key use the same vertex and index buffers
+	const void* getGeometryBindingKey() const
+	{
+		if (geometryPool != nullptr)
+			return &geometryPool->getBlock(geometryAllocation.blockIndex);
+
+		return this;
 	}
 
 	const Buffer& getVertexBuffer() const
@@ -129,50 +525,78 @@ public:
 	{
 		return indexBuffer;
 	}
+
+	VkIndexType getIndexType() const
+	{
+		return indexType;
+	}
+
+	const Bounds& getBounds() const
+	{
+		return bounds;
+	}
+
+	// dynamic meshes give the bounds of their new vertices, they are not computed back from the staging memory
+	void setBounds(const Bounds& _bounds)
+	{
+		bounds = _bounds;
+	}
 };
 
 typedef TMeshData<Vertex> StaticMeshData;
 typedef TMeshData<WeightedVertex> SkeletalMeshData;
+// compact layouts, positions are dequantized with the mesh data quantization
+typedef TMeshData<PackedStaticVertex> PackedStaticMeshData;
+typedef TMeshData<PackedSkinnedVertex> PackedSkeletalMeshData;
 
 class StaticMesh : public Renderable
 {
 private:
 	StaticMeshData meshData;
-	//AABB renderBox;
 
 public:
-	void createGPUSide(const GraphicsContext& context)
+	// static geometry goes to the shared geometry pool by default
+	void createGPUSide(const GraphicsContext& context, bool useGeometryPool = true)
 	{
-		meshData.createGPUSide(context);
+		if (useGeometryPool)
+		{
+			// 16 bits indices when the vertices allow it, in the pool of this index type
+			const VkIndexType poolIndexType = MeshOptimizer::selectIndexType(meshData.getVertices().size());
+			meshData.createGPUSideInPool(context.getGeometryPools().getPool<Vertex>(poolIndexType));
+		}
+		else
+			meshData.createGPUSide(context);
 	}
 
-	void destroyGPUSide()
+	// meshes updated at runtime own their buffers, see TMeshData::createDynamicGPUSide()
+	void createDynamicGPUSide(const GraphicsContext& context, uint32_t frameCount)
 	{
-		meshData.destroyGPUSide();
+		meshData.createDynamicGPUSide(context, frameCount);
 	}
 
-	void cmdbindVBOsAndIBOs(VkCommandBuffer commandBuffer) override
+	StaticMeshData& getMeshData()
 	{
-		VkDeviceSize offsets[] = { 0 };
-		vkCmdBindVertexBuffers(commandBuffer, 0, 1, meshData.getVertexBuffer().getBufferHandle(), offsets);
-		vkCmdBindIndexBuffer(commandBuffer, *meshData.getIndexBuffer().getBufferHandle(), 0, VK_INDEX_TYPE_UINT16);
+		return meshData;
 	}
-	virtual void cmdDraw(VkCommandBuffer commandBuffer)
+
+	const StaticMeshData& getMeshData() const
 	{
-		vkCmdDrawIndexed(commandBuffer, meshData.getIndexBuffer().getItemCount(), 1, 0, 0, 0);
+		return meshData;
 	}
-};
 
-class SkeletalMesh : public Renderable
-{
-	SkeletalMeshData meshData;
-	SkeletonInstanceData skeletonInstanceData;
-	//AABB renderBox;
+	// identity for float positions, folded in the transform of the mesh by the MeshRenderer
+	glm::mat4 getDequantizationMatrix() const
+	{
+		return meshData.getQuantization().getDequantizationMatrix();
+	}
 
-public:
-	void createGPUSide(const GraphicsContext& context)
+	// load a mesh cooked for the Vertex format, the file can be closed once this returns
+	void loadFromFile(const GraphicsContext& context, const MeshFileView& file, bool useGeometryPool = true)
 	{
-		meshData.createGPUSide(context);
+		if (useGeometryPool)
+			meshData.createGPUSideInPool(context.getGeometryPools().getPool<Vertex>(file.getIndexType()), file);
+		else
+			meshData.createGPUSide(context, file);
 	}
 
 	void destroyGPUSide()
@@ -180,227 +604,175 @@ public:
 		meshData.destroyGPUSide();
 	}
 
-	void cmdbindVBOsAndIBOs(VkCommandBuffer commandBuffer) override
+	void optimize(MeshOptimizationReport* outReport = nullptr)
 	{
-		VkDeviceSize offsets[] = { 0 };
-		vkCmdBindVertexBuffers(commandBuffer, 0, 1, meshData.getVertexBuffer().getBufferHandle(), offsets);
-		vkCmdBindIndexBuffer(commandBuffer, *meshData.getIndexBuffer().getBufferHandle(), 0, VK_INDEX_TYPE_UINT16);
+		meshData.optimize(outReport);
 	}
-	virtual void cmdDraw(VkCommandBuffer commandBuffer)
+
+	void generateLods(const MeshLodSettings& settings = MeshLodSettings())
 	{
-		vkCmdDrawIndexed(commandBuffer, meshData.getIndexBuffer().getItemCount(), 1, 0, 0, 0);
+		meshData.generateLods(settings);
 	}
-};
-
-template<typename KeyType>
-struct AnimKey
-{
-	KeyType value;
-	float time;
-};
-
-class SkeletalAnimation
-{
-private:
-	float duration;
-	float ticksPerSecond;
 
-	std::vector<float> rotationKeysTime;
-	std::vector<std::vector<glm::quat>> bonesRotation;
-	std::vector<float> translationKeysTime;
-	std::vector<std::vector<glm::vec3>> bonesTranslation;
+	void cmdbindVBOsAndIBOs(VkCommandBuffer commandBuffer) override
+	{
+		meshData.cmdBindBuffers(commandBuffer);
+	}
 
-public:
-	uint32_t getRotationKeyIndex(float animationTime, float& outOverTime) const
+	const void* getGeometryBindingKey() const override
 	{
-		for (uint32_t keyIndex = 0; keyIndex  < rotationKeysTime.size(); keyIndex++)
-		{
-			// reach last key : we can't go further
-			if (keyIndex == rotationKeysTime.size() - 1)
-			{
-				outOverTime = animationTime - rotationKeysTime.back();
-				return keyIndex;
-			}
+		return meshData.getGeometryBindingKey();
+	}
 
-			if (rotationKeysTime[keyIndex] <= animationTime
-				&& rotationKeysTime[keyIndex + 1] > animationTime)
-			{
-				outOverTime = animationTime - rotationKeysTime[keyIndex];
-				return keyIndex;
-			}
-		}
+	const Bounds* getLocalBounds() const override
+	{
+		return &meshData.getBounds();
 	}
 
-	uint32_t getTranslationKeyIndex(float animationTime, float& outOverTime) const
+	// rasterize a level of detail of the mesh in the occlusion buffer, the coarsest one by default
+	void addAsOccluder(OcclusionCuller& culler, const glm::mat4& transform, uint32_t lodIndex = ~0u) const
 	{
-		for (uint32_t keyIndex = 0; keyIndex < translationKeysTime.size(); keyIndex++)
-		{
-			// reach last key : we can't go further
-			if (keyIndex == translationKeysTime.size() - 1)
-			{
-				outOverTime = animationTime - translationKeysTime.back();
-				return keyIndex;
-			}
+		const std::vector<Vertex>& vertices = meshData.getVertices();
+		if (vertices.empty())
+			throw std::runtime_error("occluders need their vertices on the CPU side !");
 
-			if (translationKeysTime[keyIndex] <= animationTime
-				&& translationKeysTime[keyIndex + 1] > animationTime)
-			{
-				outOverTime = animationTime - translationKeysTime[keyIndex];
-				return keyIndex;
-			}
-		}
+		const MeshLod lod = meshData.getLod(lodIndex);
+		culler.addOccluder(&vertices[0].position, static_cast<uint32_t>(vertices.size()), sizeof(Vertex), meshData.getIndices().data() + lod.firstIndex, lod.indexCount, transform);
 	}
-
-	const glm::quat& getRotation(uint32_t boneIndex, uint32_t rotationKeyIndex) const
+	virtual void cmdDraw(VkCommandBuffer commandBuffer)
 	{
-		return bonesRotation[boneIndex][rotationKeyIndex];
+		cmdDrawLod(commandBuffer, 0);
 	}
 
-	const glm::vec3& getTranslation(uint32_t boneIndex, uint32_t translationKeyIndex) const
+	const MeshLod* getLods(uint32_t& outLodCount) const override
 	{
-		return bonesTranslation[boneIndex][translationKeyIndex];
+		outLodCount = static_cast<uint32_t>(meshData.getLods().size());
+		return meshData.getLods().data();
 	}
 
-	float getTickPerSecond() const
+	void cmdDrawLod(VkCommandBuffer commandBuffer, uint32_t lodIndex) override
 	{
-		return ticksPerSecond;
+		meshData.cmdDrawLod(commandBuffer, lodIndex);
 	}
 };
 
-class SkeletalAnimationInstance
+class SkeletalMesh : public Renderable
 {
-private:
-	SkeletalAnimation* animation;
-	float animationBeginTime;
+	SkeletalMeshData meshData;
+	SkeletonInstanceData skeletonInstanceData;
+
+	// set when the mesh is skinned by the SkinningNode, the passes then draw it like a static mesh
+	const Buffer* skinnedVertexBuffer = nullptr;
 
 public:
-	float getAnimationTickTime(float timeInSecond) const
+	SkeletalMesh()
+		: Renderable(RenderableType::PIPELINE_TYPE_SKELETAL_MESH, RenderableTypeFlag::PIPELINE_TYPE_SKELETAL_MESH)
+	{}
+
+	// the weighted vertices can be read by the skinning compute shader
+	void createGPUSide(const GraphicsContext& context)
 	{
-		return timeInSecond * animation->getTickPerSecond();
+		meshData.createGPUSide(context, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
 	}
 
-	uint32_t getRotationKeyIndex(float animationTime, float& outOverTime) const
+	const SkeletalMeshData& getMeshData() const
 	{
-		return animation->getRotationKeyIndex(animationTime, outOverTime);
+		return meshData;
 	}
 
-	uint32_t getTranslationKeyIndex(float animationTime, float& outOverTime) const
+	void destroyGPUSide()
 	{
-		return animation->getTranslationKeyIndex(animationTime, outOverTime);
+		meshData.destroyGPUSide();
 	}
 
-	const glm::quat& getRotation(uint32_t boneIndex, uint32_t rotationKeyIndex) const
+	void optimize(MeshOptimizationReport* outReport = nullptr)
 	{
-		return animation->getRotation(boneIndex, rotationKeyIndex);
+		meshData.optimize(outReport);
 	}
 
-	const glm::vec3& getTranslation(uint32_t boneIndex, uint32_t translationKeyIndex) const
+	void generateLods(const MeshLodSettings& settings = MeshLodSettings())
 	{
-		return animation->getTranslation(boneIndex, translationKeyIndex);
+		meshData.generateLods(settings);
 	}
 
-	float getTickPerSecond() const
+	void cmdbindVBOsAndIBOs(VkCommandBuffer commandBuffer) override
 	{
-		return animation->getTickPerSecond();
+		if (skinnedVertexBuffer != nullptr)
+		{
+			VkDeviceSize offsets[] = { 0 };
+			vkCmdBindVertexBuffers(commandBuffer, 0, 1, skinnedVertexBuffer->getBufferHandle(), offsets);
+			vkCmdBindIndexBuffer(commandBuffer, *meshData.getIndexBuffer().getBufferHandle(), 0, meshData.getIndexType());
+		}
+		else
+		{
+			meshData.cmdBindBuffers(commandBuffer);
+		}
 	}
-};
 
-class Skeleton
-{
-	SkeletonData skeletonData;
+	const void* getGeometryBindingKey() const override
+	{
+		if (skinnedVertexBuffer != nullptr)
+			return skinnedVertexBuffer;
+
+		return meshData.getGeometryBindingKey();
+	}
 
-	static void computeAnimationStep(const SkeletonInstanceData& skeletonInstance, float time, const SkeletalAnimationInstance& animation)
+	const Bounds* getLocalBounds() const override
 	{
-		float animTickTime = animation.getAnimationTickTime(time);
+		return &meshData.getBounds();
+	}
 
-		float rotationOverTime = 0;
-		int rotationKeyIndex = animation.getRotationKeyIndex(animTickTime, rotationOverTime);
-		float translationOverTime = 0;
-		int translationKeyIndex = animation.getTranslationKeyIndex(animTickTime, translationOverTime);
-		for (int i = 0; i < skeletonInstance.boneCurrentTransforms.size(); i++)
+	// Vertices in the static Vertex layout written by the SkinningNode, bound instead of the weighted vertices.
+	// The mesh is then batched and drawn with the static mesh pipelines and material input datas (MVP only).
+	// nullptr goes back to the vertex shader skinning.
+	// The batches pick the pipeline with the renderable type, add the mesh to them after this call.
+	void setSkinnedVertexBuffer(const Buffer* _skinnedVertexBuffer)
+	{
+		skinnedVertexBuffer = _skinnedVertexBuffer;
+		if (skinnedVertexBuffer != nullptr)
+		{
+			renderableType = RenderableType::PIPELINE_TYPE_STATIC_MESH;
+			renderableTypeFlag = RenderableTypeFlag::PIPELINE_TYPE_STATIC_MESH;
+		}
+		else
 		{
-			skeleton.boneCurrentTransforms[i].position = BoneTransform::interpolateRotation(animation.getRotation(i, rotationKeyIndex), animation.getRotation(i, rotationKeyIndex + 1));
-			skeleton.boneCurrentTransforms[i].rotation = BoneTransform::interpolateTranslation(animation.getTranslation(i, translationKeyIndex), animation.getTranslation(i, translationKeyIndex + 1));
-			skeleton.boneCurrentTransforms[i] = skeletonInstance.getRootInverseTransform() * skeleton.boneCurrentTransforms[i] * skeletonInstance.getBoneBaseTransform(i);
+			renderableType = RenderableType::PIPELINE_TYPE_SKELETAL_MESH;
+			renderableTypeFlag = RenderableTypeFlag::PIPELINE_TYPE_SKELETAL_MESH;
 		}
 	}
-};
 
-struct BoneTransform
-{
-	glm::vec3 position;
-	glm::quat rotation;
-};
+	const Buffer* getSkinnedVertexBuffer() const
+	{
+		return skinnedVertexBuffer;
+	}
 
-struct SkeletonData
-{
-	glm::mat4 rootInverseTransform;
-	std::map<std::string, uint32_t> boneMappingNameToIdx;
-	std::vector<BoneTransform> boneBaseTransforms;
-	std::vector<uint32_t> boneChilds;
-};
+	// animated by the AnimationSystem
+	SkeletonInstanceData& getSkeletonInstanceData()
+	{
+		return skeletonInstanceData;
+	}
 
-struct SkeletonInstanceData
-{
-	SkeletonData* skeletonData;
-	std::vector<BoneTransform> boneCurrentTransforms;
+	// write the skinning matrices of this frame in the palette, once the animation is updated
+	void writeMaterialInputDatas(BonePaletteBuffer& bonePalette, const glm::mat4& MVP, SkeletonMeshMaterialInputDatas& outDatas) const
+	{
+		outDatas.MVP = MVP;
+		outDatas.boneOffset = bonePalette.write(skeletonInstanceData);
+		outDatas.boneCount = skeletonInstanceData.skeletonData->getBoneCount();
+	}
 
-	const glm::mat4& getRootInverseTransform() const
+	virtual void cmdDraw(VkCommandBuffer commandBuffer)
 	{
-		return skeletonData->rootInverseTransform;
+		cmdDrawLod(commandBuffer, 0);
 	}
 
-	const BoneTransform& getBoneBaseTransform(uint32_t boneIndex)
+	const MeshLod* getLods(uint32_t& outLodCount) const override
 	{
-		return skeletonData->boneBaseTransforms[boneIndex];
+		outLodCount = static_cast<uint32_t>(meshData.getLods().size());
+		return meshData.getLods().data();
 	}
-};
 
-struct WeightedVertex
-{
-	glm::vec3 position;
-	glm::vec3 color;
-	glm::vec2 texCoord;
-	glm::ivec4 boneIndices;
-	glm::vec4 weights;
-
-	static VkVertexInputBindingDescription getBindingDescription()
-	{
-		VkVertexInputBindingDescription bindingDescription = {};
-		bindingDescription.binding = 0;
-		bindingDescription.stride = sizeof(WeightedVertex);
-		bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
-		return bindingDescription;
-	}
-
-	static std::array<VkVertexInputAttributeDescription, 3> getAttributeDescriptions()
-	{
-		std::array<VkVertexInputAttributeDescription, 3> attributeDescription = {};
-		attributeDescription[0].binding = 0;
-		attributeDescription[0].format = VK_FORMAT_R32G32B32_SFLOAT;
-		attributeDescription[0].location = 0;
-		attributeDescription[0].offset = offsetof(Vertex, position);
-
-		attributeDescription[1].binding = 0;
-		attributeDescription[1].format = VK_FORMAT_R32G32B32_SFLOAT;
-		attributeDescription[1].location = 1;
-		attributeDescription[1].offset = offsetof(Vertex, color);
-
-		attributeDescription[2].binding = 0;
-		attributeDescription[2].format = VK_FORMAT_R32G32_SFLOAT;
-		attributeDescription[2].location = 2;
-		attributeDescription[2].offset = offsetof(Vertex, texCoord);
-
-		attributeDescription[3].binding = 0;
-		attributeDescription[3].format = VK_FORMAT_R32G32B32A32_SINT;
-		attributeDescription[3].location = 3;
-		attributeDescription[3].offset = offsetof(WeightedVertex, boneIndices);
-
-		attributeDescription[4].binding = 0;
-		attributeDescription[4].format = VK_FORMAT_R32G32B32A32_SFLOAT;
-		attributeDescription[4].location = 4;
-		attributeDescription[4].offset = offsetof(WeightedVertex, weights);
-
-		return attributeDescription;
+	void cmdDrawLod(VkCommandBuffer commandBuffer, uint32_t lodIndex) override
+	{
+		meshData.cmdDrawLod(commandBuffer, lodIndex);
 	}
 };
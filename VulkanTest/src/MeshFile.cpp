@@ -0,0 +1,227 @@
+#include "MeshFile.h"
+#include "MappedFile.h"
+#include "MeshOptimizer.h"
+
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+namespace
+{
+	uint64_t alignOffset(uint64_t offset)
+	{
+		return (offset + MESH_FILE_BLOB_ALIGNMENT - 1) / MESH_FILE_BLOB_ALIGNMENT * MESH_FILE_BLOB_ALIGNMENT;
+	}
+
+	bool isRangeInside(uint64_t offset, uint64_t size, size_t fileSize)
+	{
+		return offset <= fileSize && size <= fileSize - offset;
+	}
+
+	template<typename IndexType>
+	bool areIndicesInside(const char* indexData, uint32_t indexCount, uint32_t vertexCount)
+	{
+		const IndexType* indices = reinterpret_cast<const IndexType*>(indexData);
+		for (uint32_t i = 0; i < indexCount; i++)
+		{
+			if (indices[i] >= vertexCount)
+				return false;
+		}
+
+		return true;
+	}
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/////////// MeshFileView
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void MeshFileView::open(const char* fileData, size_t fileSize)
+{
+	data = nullptr;
+	header = nullptr;
+
+	if (fileSize < sizeof(MeshFileHeader))
+		throw std::runtime_error("mesh file is too small !");
+
+	const MeshFileHeader* fileHeader = reinterpret_cast<const MeshFileHeader*>(fileData);
+	if (fileHeader->magic != MESH_FILE_MAGIC)
+		throw std::runtime_error("not a cooked mesh file !");
+	if (fileHeader->version != MESH_FILE_VERSION)
+		throw std::runtime_error("cooked mesh file version not supported, the mesh must be cooked again !");
+	if (fileHeader->vertexLayout.attributeCount > MESH_FILE_MAX_VERTEX_ATTRIBUTES)
+		throw std::runtime_error("invalid vertex layout in mesh file !");
+	if (fileHeader->indexType != VK_INDEX_TYPE_UINT16 && fileHeader->indexType != VK_INDEX_TYPE_UINT32)
+		throw std::runtime_error("invalid index type in mesh file !");
+	if (fileHeader->lodCount == 0)
+		throw std::runtime_error("mesh file without level of detail !");
+
+	const uint64_t indexSize = fileHeader->indexType == VK_INDEX_TYPE_UINT16 ? sizeof(uint16_t) : sizeof(uint32_t);
+	if (fileHeader->vertexDataSize != uint64_t(fileHeader->vertexCount) * fileHeader->vertexLayout.stride
+		|| fileHeader->indexDataSize != uint64_t(fileHeader->indexCount) * indexSize)
+		throw std::runtime_error("inconsistent blob sizes in mesh file !");
+
+	if (!isRangeInside(fileHeader->lodTableOffset, uint64_t(fileHeader->lodCount) * sizeof(MeshLod), fileSize)
+		|| !isRangeInside(fileHeader->submeshTableOffset, uint64_t(fileHeader->submeshCount) * sizeof(MeshFileSubmesh), fileSize)
+		|| !isRangeInside(fileHeader->vertexDataOffset, fileHeader->vertexDataSize, fileSize)
+		|| !isRangeInside(fileHeader->indexDataOffset, fileHeader->indexDataSize, fileSize))
+		throw std::runtime_error("truncated mesh file !");
+
+	// the tables are read in place
+	if (fileHeader->lodTableOffset % alignof(MeshLod) != 0 || fileHeader->submeshTableOffset % alignof(MeshFileSubmesh) != 0
+		|| fileHeader->vertexDataOffset % MESH_FILE_BLOB_ALIGNMENT != 0 || fileHeader->indexDataOffset % MESH_FILE_BLOB_ALIGNMENT != 0)
+		throw std::runtime_error("misaligned tables in mesh file !");
+
+	const MeshLod* lods = reinterpret_cast<const MeshLod*>(fileData + fileHeader->lodTableOffset);
+	for (uint32_t i = 0; i < fileHeader->lodCount; i++)
+	{
+		if (uint64_t(lods[i].firstIndex) + lods[i].indexCount > fileHeader->indexCount)
+			throw std::runtime_error("level of detail out of the index blob in mesh file !");
+	}
+
+	const MeshFileSubmesh* submeshes = reinterpret_cast<const MeshFileSubmesh*>(fileData + fileHeader->submeshTableOffset);
+	for (uint32_t i = 0; i < fileHeader->submeshCount; i++)
+	{
+		if (uint64_t(submeshes[i].firstIndex) + submeshes[i].indexCount > fileHeader->indexCount)
+			throw std::runtime_error("submesh out of the index blob in mesh file !");
+	}
+
+	// the blob goes to the GPU as is, an index past the vertices would read out of the vertex buffer
+	const char* indexData = fileData + fileHeader->indexDataOffset;
+	const bool validIndices = fileHeader->indexType == VK_INDEX_TYPE_UINT16
+		? areIndicesInside<uint16_t>(indexData, fileHeader->indexCount, fileHeader->vertexCount)
+		: areIndicesInside<uint32_t>(indexData, fileHeader->indexCount, fileHeader->vertexCount);
+	if (!validIndices)
+		throw std::runtime_error("index out of the vertex blob in mesh file !");
+
+	data = fileData;
+	header = fileHeader;
+}
+
+void MeshFileView::open(const MappedFile& file)
+{
+	open(file.getData(), file.getSize());
+}
+
+const MeshFileHeader& MeshFileView::getHeader() const
+{
+	return *header;
+}
+
+const MeshLod* MeshFileView::getLods() const
+{
+	return reinterpret_cast<const MeshLod*>(data + header->lodTableOffset);
+}
+
+uint32_t MeshFileView::getLodCount() const
+{
+	return header->lodCount;
+}
+
+const MeshFileSubmesh* MeshFileView::getSubmeshes() const
+{
+	return reinterpret_cast<const MeshFileSubmesh*>(data + header->submeshTableOffset);
+}
+
+uint32_t MeshFileView::getSubmeshCount() const
+{
+	return header->submeshCount;
+}
+
+const void* MeshFileView::getVertexData() const
+{
+	return data + header->vertexDataOffset;
+}
+
+uint32_t MeshFileView::getVertexCount() const
+{
+	return header->vertexCount;
+}
+
+const void* MeshFileView::getIndexData() const
+{
+	return data + header->indexDataOffset;
+}
+
+uint32_t MeshFileView::getIndexCount() const
+{
+	return header->indexCount;
+}
+
+VkIndexType MeshFileView::getIndexType() const
+{
+	return static_cast<VkIndexType>(header->indexType);
+}
+
+VertexQuantization MeshFileView::getQuantization() const
+{
+	VertexQuantization quantization;
+	quantization.positionOffset = glm::vec3(header->quantizationOffset[0], header->quantizationOffset[1], header->quantizationOffset[2]);
+	quantization.positionScale = glm::vec3(header->quantizationScale[0], header->quantizationScale[1], header->quantizationScale[2]);
+	return quantization;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/////////// MeshFileWriter
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void MeshFileWriter::write(const std::string& path, const MeshFileVertexLayout& vertexLayout, const void* vertexData, uint32_t vertexCount
+	, const std::vector<uint32_t>& indices, const std::vector<MeshLod>& lods, const std::vector<MeshFileSubmesh>& submeshes
+	, const glm::vec3& boundsMin, const glm::vec3& boundsMax, const VertexQuantization& quantization)
+{
+	const std::vector<MeshLod> fileLods = lods.empty() ? std::vector<MeshLod>{ MeshLod{ 0, static_cast<uint32_t>(indices.size()), 0.f } } : lods;
+	const VkIndexType indexType = MeshOptimizer::selectIndexType(vertexCount);
+
+	MeshFileHeader header = {};
+	header.magic = MESH_FILE_MAGIC;
+	header.version = MESH_FILE_VERSION;
+	header.vertexLayout = vertexLayout;
+	header.indexType = static_cast<uint32_t>(indexType);
+	header.vertexCount = vertexCount;
+	header.indexCount = static_cast<uint32_t>(indices.size());
+	header.lodCount = static_cast<uint32_t>(fileLods.size());
+	header.submeshCount = static_cast<uint32_t>(submeshes.size());
+	memcpy(header.boundsMin, &boundsMin[0], sizeof(header.boundsMin));
+	memcpy(header.boundsMax, &boundsMax[0], sizeof(header.boundsMax));
+	memcpy(header.quantizationOffset, &quantization.positionOffset[0], sizeof(header.quantizationOffset));
+	memcpy(header.quantizationScale, &quantization.positionScale[0], sizeof(header.quantizationScale));
+
+	header.lodTableOffset = sizeof(MeshFileHeader);
+	header.submeshTableOffset = header.lodTableOffset + fileLods.size() * sizeof(MeshLod);
+	header.vertexDataOffset = alignOffset(header.submeshTableOffset + submeshes.size() * sizeof(MeshFileSubmesh));
+	header.vertexDataSize = uint64_t(vertexCount) * vertexLayout.stride;
+	header.indexDataOffset = alignOffset(header.vertexDataOffset + header.vertexDataSize);
+	header.indexDataSize = indices.size() * MeshOptimizer::getIndexSize(indexType);
+
+	std::ofstream file(path, std::ios::binary | std::ios::trunc);
+	if (!file.is_open())
+		throw std::runtime_error("failed to create mesh file " + path + " !");
+
+	const char padding[MESH_FILE_BLOB_ALIGNMENT] = {};
+	auto padTo = [&](uint64_t offset)
+	{
+		const uint64_t current = static_cast<uint64_t>(file.tellp());
+		file.write(padding, static_cast<std::streamsize>(offset - current));
+	};
+
+	file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	file.write(reinterpret_cast<const char*>(fileLods.data()), fileLods.size() * sizeof(MeshLod));
+	file.write(reinterpret_cast<const char*>(submeshes.data()), submeshes.size() * sizeof(MeshFileSubmesh));
+
+	padTo(header.vertexDataOffset);
+	file.write(static_cast<const char*>(vertexData), header.vertexDataSize);
+
+	padTo(header.indexDataOffset);
+	if (indexType == VK_INDEX_TYPE_UINT16)
+	{
+		std::vector<uint16_t> narrowedIndices(indices.begin(), indices.end());
+		file.write(reinterpret_cast<const char*>(narrowedIndices.data()), header.indexDataSize);
+	}
+	else
+	{
+		file.write(reinterpret_cast<const char*>(indices.data()), header.indexDataSize);
+	}
+
+	if (!file.good())
+		throw std::runtime_error("failed to write mesh file " + path + " !");
+}
@@ -0,0 +1,171 @@
+#pragma once
+
+#include <vulkan/vulkan.hpp>
+#include <glm/glm.hpp>
+
+#include <string>
+#include <vector>
+
+#include "MeshLod.h"
+#include "VertexLayout.h"
+
+class MappedFile;
+
+// Cooked mesh file, all offsets are given from the start of the file :
+//	MeshFileHeader
+//	MeshLod[lodCount]
+//	MeshFileSubmesh[submeshCount]
+//	vertex blob, aligned on MESH_FILE_BLOB_ALIGNMENT
+//	index blob, aligned on MESH_FILE_BLOB_ALIGNMENT
+// The blobs have the exact layout of the GPU buffers so they can be copied to staging memory as is.
+// Values are stored with the endianness of the cooking platform.
+
+#define MESH_FILE_MAGIC 0x48534D56u // "VMSH"
+#define MESH_FILE_VERSION 1
+#define MESH_FILE_BLOB_ALIGNMENT 16
+#define MESH_FILE_MAX_VERTEX_ATTRIBUTES 8
+
+struct MeshFileVertexAttribute
+{
+	uint32_t format; // VkFormat
+	uint32_t offset;
+};
+
+// Vertex layout of the vertex blob, the location of an attribute is its index
+struct MeshFileVertexLayout
+{
+	uint32_t stride;
+	uint32_t attributeCount;
+	MeshFileVertexAttribute attributes[MESH_FILE_MAX_VERTEX_ATTRIBUTES];
+
+	template<typename VertexType>
+	static MeshFileVertexLayout make()
+	{
+		const auto vertexAttributes = VertexType::getAttributes();
+		static_assert(vertexAttributes.size() <= MESH_FILE_MAX_VERTEX_ATTRIBUTES, "too many vertex attributes for the mesh file format !");
+
+		MeshFileVertexLayout layout = {};
+		layout.stride = sizeof(VertexType);
+		layout.attributeCount = static_cast<uint32_t>(vertexAttributes.size());
+		for (uint32_t i = 0; i < layout.attributeCount; i++)
+		{
+			layout.attributes[i].format = static_cast<uint32_t>(vertexAttributes[i].format);
+			layout.attributes[i].offset = vertexAttributes[i].offset;
+		}
+
+		return layout;
+	}
+
+	bool operator==(const MeshFileVertexLayout& other) const
+	{
+		if (stride != other.stride || attributeCount != other.attributeCount)
+			return false;
+
+		for (uint32_t i = 0; i < attributeCount; i++)
+		{
+			if (attributes[i].format != other.attributes[i].format || attributes[i].offset != other.attributes[i].offset)
+				return false;
+		}
+
+		return true;
+	}
+};
+
+// Part of the full resolution level drawn with one material
+struct MeshFileSubmesh
+{
+	uint32_t firstIndex;
+	uint32_t indexCount;
+	uint32_t materialSlot;
+	uint32_t reserved;
+};
+
+struct MeshFileHeader
+{
+	uint32_t magic;
+	uint32_t version;
+	MeshFileVertexLayout vertexLayout;
+	uint32_t indexType; // VkIndexType
+	uint32_t vertexCount;
+	uint32_t indexCount;
+	uint32_t lodCount;
+	uint32_t submeshCount;
+	uint32_t reserved;
+	float boundsMin[3];
+	float boundsMax[3];
+	float quantizationOffset[3];
+	float quantizationScale[3];
+	uint64_t lodTableOffset;
+	uint64_t submeshTableOffset;
+	uint64_t vertexDataOffset;
+	uint64_t vertexDataSize;
+	uint64_t indexDataOffset;
+	uint64_t indexDataSize;
+};
+
+// the layout of the file must not depend on the compiler
+static_assert(sizeof(MeshFileVertexLayout) == 72, "unexpected MeshFileVertexLayout padding !");
+static_assert(sizeof(MeshFileHeader) == 200, "unexpected MeshFileHeader padding !");
+static_assert(sizeof(MeshFileSubmesh) == 16, "unexpected MeshFileSubmesh padding !");
+static_assert(sizeof(MeshLod) == 12, "unexpected MeshLod padding !");
+
+// Read access to a cooked mesh, pointing directly inside the file memory : nothing is copied
+// and the view is only valid while the memory is.
+class MeshFileView
+{
+private:
+	const char* data = nullptr;
+	const MeshFileHeader* header = nullptr;
+
+public:
+	// check the header, the table ranges and the index values, throw if the data is not a valid cooked mesh
+	void open(const char* fileData, size_t fileSize);
+	void open(const MappedFile& file);
+
+	const MeshFileHeader& getHeader() const;
+	const MeshLod* getLods() const;
+	uint32_t getLodCount() const;
+	const MeshFileSubmesh* getSubmeshes() const;
+	uint32_t getSubmeshCount() const;
+
+	const void* getVertexData() const;
+	uint32_t getVertexCount() const;
+	const void* getIndexData() const;
+	uint32_t getIndexCount() const;
+	VkIndexType getIndexType() const;
+
+	VertexQuantization getQuantization() const;
+
+	template<typename VertexType>
+	bool matchesVertexLayout() const
+	{
+		return header->vertexLayout == MeshFileVertexLayout::make<VertexType>();
+	}
+};
+
+class MeshFileWriter
+{
+public:
+	// Indices are stored on 16 bits when the vertex count allows it.
+	// An empty lods gives a single level covering all the indices.
+	static void write(const std::string& path, const MeshFileVertexLayout& vertexLayout, const void* vertexData, uint32_t vertexCount
+		, const std::vector<uint32_t>& indices, const std::vector<MeshLod>& lods, const std::vector<MeshFileSubmesh>& submeshes
+		, const glm::vec3& boundsMin, const glm::vec3& boundsMax, const VertexQuantization& quantization);
+
+	template<typename VertexType>
+	static void write(const std::string& path, const std::vector<VertexType>& vertices, const std::vector<uint32_t>& indices
+		, const std::vector<MeshLod>& lods, const std::vector<MeshFileSubmesh>& submeshes, const VertexQuantization& quantization = VertexQuantization())
+	{
+		glm::vec3 boundsMin(0.f);
+		glm::vec3 boundsMax(0.f);
+		for (size_t i = 0; i < vertices.size(); i++)
+		{
+			const glm::vec3 position = getVertexPosition(vertices[i], quantization);
+			boundsMin = i == 0 ? position : glm::min(boundsMin, position);
+			boundsMax = i == 0 ? position : glm::max(boundsMax, position);
+		}
+
+		write(path, MeshFileVertexLayout::make<VertexType>(), vertices.data(), static_cast<uint32_t>(vertices.size())
+			, indices, lods, submeshes, boundsMin, boundsMax, quantization);
+	}
+};
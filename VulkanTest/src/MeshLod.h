@@ -0,0 +1,100 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+// A level of detail is a range of the index buffer of a mesh, all levels share the same vertices
+struct MeshLod
+{
+	uint32_t firstIndex;
+	uint32_t indexCount;
+	// largest distance from a removed vertex of the full resolution mesh to the surface of the level, in object space
+	float error;
+};
+
+struct MeshLodSettings
+{
+	// including the full resolution level
+	uint32_t maxLodCount = 4;
+	// index count of a level relative to the previous one
+	float reductionRatio = 0.5f;
+	// maximum quadric error (RMS plane distance) of the collapses, relative to the mesh radius
+	float maxRelativeError = 0.05f;
+	// stop the chain when a level removes less than this fraction of the previous level triangles
+	float minReduction = 0.1f;
+};
+
+// Camera parameters needed to project an object space error on screen
+struct LodViewInfo
+{
+	glm::vec3 cameraPosition;
+	// pixels covered by a unit length seen at a unit distance
+	float projectionScale;
+
+	static LodViewInfo make(const glm::vec3& cameraPosition, float verticalFov, float viewportHeight)
+	{
+		LodViewInfo viewInfo;
+		viewInfo.cameraPosition = cameraPosition;
+		viewInfo.projectionScale = viewportHeight / (2.f * std::tan(verticalFov * 0.5f));
+		return viewInfo;
+	}
+};
+
+struct LodSelectionSettings
+{
+	// a level is used while its error covers less pixels than this
+	float maxPixelError = 1.f;
+	// the error must go below maxPixelError * (1 - hysteresis) to switch to a coarser level
+	// and above maxPixelError * (1 + hysteresis) to switch to a finer one, so instances near a threshold don't flicker
+	float hysteresis = 0.15f;
+	// lowers all the levels, ex : 1 keeps the first level out of the selection
+	uint32_t lodBias = 0;
+};
+
+// Level currently used by an instance, owned by whoever owns the instance
+struct LodSelectionState
+{
+	uint32_t currentLod = 0;
+};
+
+class LodSelector
+{
+public:
+	// levels are sorted from the finest to the coarsest, worldScale is the largest scale of the instance transform
+	static uint32_t selectLod(const MeshLod* lods, uint32_t lodCount, const glm::vec3& worldCenter, float worldScale
+		, const LodViewInfo& viewInfo, const LodSelectionSettings& settings, LodSelectionState& inOutState)
+	{
+		if (lodCount <= 1)
+		{
+			inOutState.currentLod = 0;
+			return 0;
+		}
+
+		const float distance = std::max(glm::length(worldCenter - viewInfo.cameraPosition), 1e-4f);
+		const float errorToPixels = worldScale * viewInfo.projectionScale / distance;
+
+		const uint32_t firstLod = std::min(settings.lodBias, lodCount - 1);
+		uint32_t currentLod = std::max(std::min(inOutState.currentLod, lodCount - 1), firstLod);
+
+		// coarsest level below the given pixel error
+		auto findCoarsestLod = [&](float maxPixelError) -> uint32_t
+		{
+			uint32_t lod = firstLod;
+			while (lod + 1 < lodCount && lods[lod + 1].error * errorToPixels <= maxPixelError)
+				lod++;
+			return lod;
+		};
+
+		const uint32_t coarserLod = findCoarsestLod(settings.maxPixelError * (1.f - settings.hysteresis));
+		if (coarserLod > currentLod)
+			currentLod = coarserLod;
+		else if (lods[currentLod].error * errorToPixels > settings.maxPixelError * (1.f + settings.hysteresis))
+			currentLod = findCoarsestLod(settings.maxPixelError);
+
+		inOutState.currentLod = currentLod;
+		return currentLod;
+	}
+};
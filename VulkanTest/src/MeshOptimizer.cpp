@@ -0,0 +1,339 @@
+#include "MeshOptimizer.h"
+
+#include <algorithm>
+#include <cassert>
+
+namespace
+{
+	// triangles using each vertex, stored contiguously
+	struct TriangleAdjacency
+	{
+		std::vector<uint32_t> offsets;
+		std::vector<uint32_t> counts;
+		std::vector<uint32_t> triangles;
+
+		void build(const std::vector<uint32_t>& indices, size_t vertexCount)
+		{
+			offsets.assign(vertexCount, 0);
+			counts.assign(vertexCount, 0);
+			triangles.resize(indices.size());
+
+			for (uint32_t index : indices)
+				counts[index]++;
+
+			uint32_t offset = 0;
+			for (size_t i = 0; i < vertexCount; i++)
+			{
+				offsets[i] = offset;
+				offset += counts[i];
+			}
+
+			std::vector<uint32_t> fill = offsets;
+			for (size_t i = 0; i < indices.size(); i++)
+				triangles[fill[indices[i]]++] = static_cast<uint32_t>(i / 3);
+		}
+	};
+
+	// FIFO post transform cache, a vertex is in the cache if it was transformed less than cacheSize misses ago
+	struct FifoCache
+	{
+		std::vector<uint32_t> timestamps;
+		uint32_t time;
+		uint32_t cacheSize;
+
+		FifoCache(size_t vertexCount, uint32_t _cacheSize)
+			: timestamps(vertexCount, 0)
+			, time(_cacheSize + 1)
+			, cacheSize(_cacheSize)
+		{}
+
+		// return true on a cache miss
+		bool access(uint32_t vertex)
+		{
+			if (time - timestamps[vertex] > cacheSize)
+			{
+				timestamps[vertex] = time++;
+				return true;
+			}
+			return false;
+		}
+
+		void flush()
+		{
+			time += cacheSize + 1;
+		}
+	};
+}
+
+const uint32_t MeshOptimizer::DEFAULT_CACHE_SIZE;
+const uint32_t MeshOptimizer::INVALID_INDEX;
+
+VertexCacheStatistics MeshOptimizer::analyzeVertexCache(const std::vector<uint32_t>& indices, size_t vertexCount, uint32_t cacheSize)
+{
+	assert(indices.size() % 3 == 0);
+
+	VertexCacheStatistics statistics;
+	if (indices.empty())
+		return statistics;
+
+	FifoCache cache(vertexCount, cacheSize);
+	std::vector<bool> referenced(vertexCount, false);
+	uint32_t referencedCount = 0;
+
+	for (uint32_t index : indices)
+	{
+		if (cache.access(index))
+			statistics.vertexTransformCount++;
+
+		if (!referenced[index])
+		{
+			referenced[index] = true;
+			referencedCount++;
+		}
+	}
+
+	statistics.acmr = static_cast<float>(statistics.vertexTransformCount) / static_cast<float>(indices.size() / 3);
+	statistics.atvr = static_cast<float>(statistics.vertexTransformCount) / static_cast<float>(referencedCount);
+	return statistics;
+}
+
+void MeshOptimizer::optimizeVertexCache(std::vector<uint32_t>& indices, size_t vertexCount, std::vector<uint32_t>& outClusters, uint32_t cacheSize)
+{
+	assert(indices.size() % 3 == 0);
+
+	outClusters.clear();
+	const size_t triangleCount = indices.size() / 3;
+	if (triangleCount == 0)
+		return;
+
+	TriangleAdjacency adjacency;
+	adjacency.build(indices, vertexCount);
+
+	// triangles not emitted yet around each vertex
+	std::vector<uint32_t> liveCounts = adjacency.counts;
+	std::vector<bool> emitted(triangleCount, false);
+	std::vector<uint32_t> cacheTimestamps(vertexCount, 0);
+	uint32_t time = cacheSize + 1;
+
+	std::vector<uint32_t> deadEndStack;
+	std::vector<uint32_t> candidates;
+	uint32_t cursor = 0;
+
+	std::vector<uint32_t> result;
+	result.reserve(indices.size());
+
+	// next vertex with live triangles, in the dead end stack first then in input order
+	auto skipDeadEnd = [&]() -> uint32_t
+	{
+		while (!deadEndStack.empty())
+		{
+			uint32_t vertex = deadEndStack.back();
+			deadEndStack.pop_back();
+			if (liveCounts[vertex] > 0)
+				return vertex;
+		}
+
+		while (cursor < vertexCount)
+		{
+			if (liveCounts[cursor] > 0)
+				return cursor;
+			cursor++;
+		}
+
+		return INVALID_INDEX;
+	};
+
+	uint32_t fanningVertex = skipDeadEnd();
+	outClusters.push_back(0);
+
+	while (fanningVertex != INVALID_INDEX)
+	{
+		candidates.clear();
+
+		const uint32_t* triangles = &adjacency.triangles[adjacency.offsets[fanningVertex]];
+		for (uint32_t i = 0; i < adjacency.counts[fanningVertex]; i++)
+		{
+			const uint32_t triangle = triangles[i];
+			if (emitted[triangle])
+				continue;
+
+			for (uint32_t corner = 0; corner < 3; corner++)
+			{
+				const uint32_t vertex = indices[triangle * 3 + corner];
+				result.push_back(vertex);
+				deadEndStack.push_back(vertex);
+				candidates.push_back(vertex);
+				liveCounts[vertex]--;
+
+				if (time - cacheTimestamps[vertex] > cacheSize)
+					cacheTimestamps[vertex] = time++;
+			}
+			emitted[triangle] = true;
+		}
+
+		// pick the candidate that will still be in the cache after its remaining triangles are emitted
+		uint32_t bestVertex = INVALID_INDEX;
+		int bestPriority = -1;
+		for (uint32_t vertex : candidates)
+		{
+			if (liveCounts[vertex] == 0)
+				continue;
+
+			int priority = 0;
+			if (time - cacheTimestamps[vertex] + 2 * liveCounts[vertex] <= cacheSize)
+				priority = static_cast<int>(time - cacheTimestamps[vertex]);
+
+			if (priority > bestPriority)
+			{
+				bestPriority = priority;
+				bestVertex = vertex;
+			}
+		}
+
+		if (bestVertex == INVALID_INDEX)
+		{
+			// non local jump : a new cluster starts here
+			bestVertex = skipDeadEnd();
+			if (bestVertex != INVALID_INDEX)
+				outClusters.push_back(static_cast<uint32_t>(result.size() / 3));
+		}
+
+		fanningVertex = bestVertex;
+	}
+
+	assert(result.size() == indices.size());
+	indices.swap(result);
+}
+
+void MeshOptimizer::optimizeOverdraw(std::vector<uint32_t>& indices, const std::vector<glm::vec3>& positions, const std::vector<uint32_t>& clusters
+	, float threshold, uint32_t cacheSize)
+{
+	assert(indices.size() % 3 == 0);
+
+	const size_t triangleCount = indices.size() / 3;
+	if (triangleCount == 0 || clusters.empty())
+		return;
+
+	// Split the clusters where the cache is in a good state, so they can be reordered without a large cost.
+	// Each sub cluster starts with a cold cache as its predecessor is not known after sorting.
+	std::vector<uint32_t> splitClusters;
+	splitClusters.reserve(clusters.size());
+	{
+		FifoCache cache(positions.size(), cacheSize);
+		for (size_t clusterIndex = 0; clusterIndex < clusters.size(); clusterIndex++)
+		{
+			const uint32_t begin = clusters[clusterIndex];
+			const uint32_t end = clusterIndex + 1 < clusters.size() ? clusters[clusterIndex + 1] : static_cast<uint32_t>(triangleCount);
+
+			cache.flush();
+			uint32_t clusterMisses = 0;
+			for (uint32_t i = begin * 3; i < end * 3; i++)
+				clusterMisses += cache.access(indices[i]) ? 1 : 0;
+			const float clusterAcmr = static_cast<float>(clusterMisses) / (end - begin);
+
+			splitClusters.push_back(begin);
+
+			cache.flush();
+			uint32_t subClusterBegin = begin;
+			uint32_t misses = 0;
+			for (uint32_t triangle = begin; triangle < end; triangle++)
+			{
+				for (uint32_t corner = 0; corner < 3; corner++)
+					misses += cache.access(indices[triangle * 3 + corner]) ? 1 : 0;
+
+				const uint32_t subClusterTriangleCount = triangle + 1 - subClusterBegin;
+				if (triangle + 1 < end && static_cast<float>(misses) / subClusterTriangleCount <= threshold * clusterAcmr)
+				{
+					splitClusters.push_back(triangle + 1);
+					subClusterBegin = triangle + 1;
+					misses = 0;
+					cache.flush();
+				}
+			}
+		}
+	}
+
+	// mesh centroid, weighted by triangle area
+	glm::vec3 meshCentroid(0.f);
+	float meshArea = 0.f;
+	for (size_t triangle = 0; triangle < triangleCount; triangle++)
+	{
+		const glm::vec3& p0 = positions[indices[triangle * 3 + 0]];
+		const glm::vec3& p1 = positions[indices[triangle * 3 + 1]];
+		const glm::vec3& p2 = positions[indices[triangle * 3 + 2]];
+
+		const float area = glm::length(glm::cross(p1 - p0, p2 - p0));
+		meshCentroid += (p0 + p1 + p2) * (area / 3.f);
+		meshArea += area;
+	}
+	meshCentroid /= std::max(meshArea, 1e-12f);
+
+	// clusters facing outward are likely to occlude the others
+	std::vector<float> sortKeys(splitClusters.size());
+	for (size_t clusterIndex = 0; clusterIndex < splitClusters.size(); clusterIndex++)
+	{
+		const uint32_t begin = splitClusters[clusterIndex];
+		const uint32_t end = clusterIndex + 1 < splitClusters.size() ? splitClusters[clusterIndex + 1] : static_cast<uint32_t>(triangleCount);
+
+		glm::vec3 centroid(0.f);
+		glm::vec3 normal(0.f);
+		float area = 0.f;
+		for (uint32_t triangle = begin; triangle < end; triangle++)
+		{
+			const glm::vec3& p0 = positions[indices[triangle * 3 + 0]];
+			const glm::vec3& p1 = positions[indices[triangle * 3 + 1]];
+			const glm::vec3& p2 = positions[indices[triangle * 3 + 2]];
+
+			// the cross product length is twice the area, the weighting is the same for centroid and normal
+			const glm::vec3 areaNormal = glm::cross(p1 - p0, p2 - p0);
+			const float triangleArea = glm::length(areaNormal);
+			centroid += (p0 + p1 + p2) * (triangleArea / 3.f);
+			normal += areaNormal;
+			area += triangleArea;
+		}
+
+		centroid /= std::max(area, 1e-12f);
+		const float normalLength = glm::length(normal);
+		normal = normalLength > 0.f ? normal / normalLength : glm::vec3(0.f);
+
+		sortKeys[clusterIndex] = glm::dot(centroid - meshCentroid, normal);
+	}
+
+	std::vector<uint32_t> clusterOrder(splitClusters.size());
+	for (uint32_t i = 0; i < clusterOrder.size(); i++)
+		clusterOrder[i] = i;
+
+	std::stable_sort(clusterOrder.begin(), clusterOrder.end(), [&sortKeys](uint32_t a, uint32_t b)
+	{
+		return sortKeys[a] > sortKeys[b];
+	});
+
+	std::vector<uint32_t> result;
+	result.reserve(indices.size());
+	for (uint32_t clusterIndex : clusterOrder)
+	{
+		const uint32_t begin = splitClusters[clusterIndex];
+		const uint32_t end = clusterIndex + 1 < splitClusters.size() ? splitClusters[clusterIndex + 1] : static_cast<uint32_t>(triangleCount);
+		result.insert(result.end(), indices.begin() + begin * 3, indices.begin() + end * 3);
+	}
+
+	indices.swap(result);
+}
+
+size_t MeshOptimizer::optimizeVertexFetch(std::vector<uint32_t>& indices, size_t vertexCount, std::vector<uint32_t>& outRemap)
+{
+	outRemap.assign(vertexCount, INVALID_INDEX);
+
+	uint32_t nextVertex = 0;
+	for (uint32_t& index : indices)
+	{
+		assert(index < vertexCount);
+
+		if (outRemap[index] == INVALID_INDEX)
+			outRemap[index] = nextVertex++;
+
+		index = outRemap[index];
+	}
+
+	return nextVertex;
+}
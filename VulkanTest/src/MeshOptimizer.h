@@ -0,0 +1,98 @@
+#pragma once
+
+#include <vulkan/vulkan.hpp>
+#include <glm/glm.hpp>
+
+#include <vector>
+
+// Post transform cache efficiency of an index buffer, simulated with a FIFO cache
+struct VertexCacheStatistics
+{
+	// average cache miss ratio : transformed vertices per triangle, 0.5 is the best case on a regular grid, 3 the worst
+	float acmr = 0.f;
+	// average transform to vertex ratio : transformed vertices per referenced vertex, 1 is optimal
+	float atvr = 0.f;
+	uint32_t vertexTransformCount = 0;
+};
+
+struct MeshOptimizationReport
+{
+	VertexCacheStatistics before;
+	VertexCacheStatistics after;
+	// vertices removed because no triangle referenced them
+	uint32_t removedVertexCount = 0;
+};
+
+// Load time reordering of indexed triangle lists.
+// The passes are meant to be run in this order :
+//	optimizeVertexCache -> optimizeOverdraw -> optimizeVertexFetch
+class MeshOptimizer
+{
+public:
+	static const uint32_t DEFAULT_CACHE_SIZE = 16;
+	static const uint32_t INVALID_INDEX = ~0u;
+
+	static VertexCacheStatistics analyzeVertexCache(const std::vector<uint32_t>& indices, size_t vertexCount, uint32_t cacheSize = DEFAULT_CACHE_SIZE);
+
+	// Tipsify (Sander et al. 2007) : triangles are emitted around a fanning vertex chosen to stay in the cache.
+	// The start of each cluster of triangles is written in outClusters, it is the input of optimizeOverdraw.
+	static void optimizeVertexCache(std::vector<uint32_t>& indices, size_t vertexCount, std::vector<uint32_t>& outClusters, uint32_t cacheSize = DEFAULT_CACHE_SIZE);
+
+	// Sort the clusters so the triangles facing away from the mesh center are drawn first.
+	// Clusters are split where the cache efficiency is within threshold of the whole cluster, a higher threshold
+	// gives smaller clusters : less overdraw but more cache misses.
+	static void optimizeOverdraw(std::vector<uint32_t>& indices, const std::vector<glm::vec3>& positions, const std::vector<uint32_t>& clusters
+		, float threshold = 1.05f, uint32_t cacheSize = DEFAULT_CACHE_SIZE);
+
+	// Renumber the vertices in the order they are first used by the index buffer.
+	// outRemap gives the new index of each old vertex (INVALID_INDEX if unused), returns the new vertex count.
+	static size_t optimizeVertexFetch(std::vector<uint32_t>& indices, size_t vertexCount, std::vector<uint32_t>& outRemap);
+
+	template<typename VertexType>
+	static void remapVertices(std::vector<VertexType>& vertices, const std::vector<uint32_t>& remap, size_t newVertexCount)
+	{
+		std::vector<VertexType> remappedVertices(newVertexCount);
+		for (size_t i = 0; i < vertices.size(); i++)
+		{
+			if (remap[i] != INVALID_INDEX)
+				remappedVertices[remap[i]] = vertices[i];
+		}
+
+		vertices.swap(remappedVertices);
+	}
+
+	// Run all the passes on a mesh, positions are given in the vertex order before optimization
+	template<typename VertexType>
+	static void optimizeMesh(std::vector<VertexType>& vertices, std::vector<uint32_t>& indices, const std::vector<glm::vec3>& positions
+		, MeshOptimizationReport* outReport = nullptr)
+	{
+		const size_t vertexCount = vertices.size();
+		if (outReport != nullptr)
+			outReport->before = analyzeVertexCache(indices, vertexCount);
+
+		std::vector<uint32_t> clusters;
+		optimizeVertexCache(indices, vertexCount, clusters);
+		optimizeOverdraw(indices, positions, clusters);
+
+		std::vector<uint32_t> remap;
+		const size_t newVertexCount = optimizeVertexFetch(indices, vertexCount, remap);
+		remapVertices(vertices, remap, newVertexCount);
+
+		if (outReport != nullptr)
+		{
+			outReport->after = analyzeVertexCache(indices, newVertexCount);
+			outReport->removedVertexCount = static_cast<uint32_t>(vertexCount - newVertexCount);
+		}
+	}
+
+	// Indices are stored on 16 bits when all vertices can be addressed with them
+	static VkIndexType selectIndexType(size_t vertexCount)
+	{
+		return vertexCount <= 0x10000 ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32;
+	}
+
+	static uint32_t getIndexSize(VkIndexType indexType)
+	{
+		return indexType == VK_INDEX_TYPE_UINT16 ? sizeof(uint16_t) : sizeof(uint32_t);
+	}
+};
@@ -18,7 +18,8 @@ MeshRenderer::~MeshRenderer()
 
 void MeshRenderer::updateModelMatrix(const glm::mat4& newTransform)
 {
-	inputData->MVP = newTransform;
+	// quantized positions are brought back to object space before the transform
+	inputData->MVP = newTransform * mesh->getDequantizationMatrix();
 }
 
 void MeshRenderer::cmdbindVBOsAndIBOs(VkCommandBuffer commandBuffer)
@@ -0,0 +1,448 @@
+#include "MeshSimplifier.h"
+#include "MeshOptimizer.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+#include <unordered_map>
+
+namespace
+{
+	// Sum of squared distances to a set of planes, weighted by the area of the triangles defining them
+	struct Quadric
+	{
+		double a2 = 0, ab = 0, ac = 0, ad = 0;
+		double b2 = 0, bc = 0, bd = 0;
+		double c2 = 0, cd = 0;
+		double d2 = 0;
+		double weight = 0;
+
+		void addPlane(const glm::vec3& normal, float distance, float planeWeight)
+		{
+			const double a = normal.x, b = normal.y, c = normal.z, d = distance;
+			a2 += planeWeight * a * a; ab += planeWeight * a * b; ac += planeWeight * a * c; ad += planeWeight * a * d;
+			b2 += planeWeight * b * b; bc += planeWeight * b * c; bd += planeWeight * b * d;
+			c2 += planeWeight * c * c; cd += planeWeight * c * d;
+			d2 += planeWeight * d * d;
+			weight += planeWeight;
+		}
+
+		void add(const Quadric& other)
+		{
+			a2 += other.a2; ab += other.ab; ac += other.ac; ad += other.ad;
+			b2 += other.b2; bc += other.bc; bd += other.bd;
+			c2 += other.c2; cd += other.cd;
+			d2 += other.d2;
+			weight += other.weight;
+		}
+
+		double evaluate(const glm::vec3& position) const
+		{
+			const double x = position.x, y = position.y, z = position.z;
+			return a2 * x * x + b2 * y * y + c2 * z * z
+				+ 2 * (ab * x * y + ac * x * z + bc * y * z)
+				+ 2 * (ad * x + bd * y + cd * z)
+				+ d2;
+		}
+	};
+
+	struct Collapse
+	{
+		uint32_t source;
+		uint32_t target;
+		// mean squared distance of the target position to the planes of both vertices
+		float cost;
+	};
+
+	uint64_t makeEdgeKey(uint32_t a, uint32_t b)
+	{
+		return a < b ? (uint64_t(a) << 32) | b : (uint64_t(b) << 32) | a;
+	}
+
+	// vertices sharing their position with another one are on an attribute seam,
+	// vertices on an edge used by a single triangle are on a border
+	void findLockedVertices(const std::vector<uint32_t>& indices, const std::vector<glm::vec3>& positions, std::vector<bool>& outLocked)
+	{
+		struct PositionHash
+		{
+			size_t operator()(const glm::vec3& position) const
+			{
+				uint32_t bits[3];
+				memcpy(bits, &position, sizeof(bits));
+				return (bits[0] * 73856093u) ^ (bits[1] * 19349663u) ^ (bits[2] * 83492791u);
+			}
+		};
+		struct PositionEqual
+		{
+			bool operator()(const glm::vec3& a, const glm::vec3& b) const
+			{
+				return memcmp(&a, &b, sizeof(glm::vec3)) == 0;
+			}
+		};
+
+		outLocked.assign(positions.size(), false);
+
+		std::vector<uint32_t> canonicalVertices(positions.size());
+		std::unordered_map<glm::vec3, uint32_t, PositionHash, PositionEqual> firstVertexAtPosition;
+		for (uint32_t vertex = 0; vertex < positions.size(); vertex++)
+		{
+			auto inserted = firstVertexAtPosition.insert(std::make_pair(positions[vertex], vertex));
+			canonicalVertices[vertex] = inserted.first->second;
+			if (!inserted.second)
+			{
+				outLocked[vertex] = true;
+				outLocked[inserted.first->second] = true;
+			}
+		}
+
+		std::unordered_map<uint64_t, uint32_t> edgeUseCounts;
+		for (size_t i = 0; i < indices.size(); i += 3)
+		{
+			for (uint32_t corner = 0; corner < 3; corner++)
+			{
+				const uint32_t a = canonicalVertices[indices[i + corner]];
+				const uint32_t b = canonicalVertices[indices[i + (corner + 1) % 3]];
+				edgeUseCounts[makeEdgeKey(a, b)]++;
+			}
+		}
+
+		for (size_t i = 0; i < indices.size(); i += 3)
+		{
+			for (uint32_t corner = 0; corner < 3; corner++)
+			{
+				const uint32_t a = indices[i + corner];
+				const uint32_t b = indices[i + (corner + 1) % 3];
+				if (edgeUseCounts[makeEdgeKey(canonicalVertices[a], canonicalVertices[b])] == 1)
+				{
+					outLocked[a] = true;
+					outLocked[b] = true;
+				}
+			}
+		}
+	}
+
+	glm::vec3 computeTriangleNormal(const glm::vec3& p0, const glm::vec3& p1, const glm::vec3& p2)
+	{
+		return glm::cross(p1 - p0, p2 - p0);
+	}
+
+	// closest point of the triangle by region tests (Ericson, Real-Time Collision Detection 5.1.5)
+	float computePointTriangleDistance(const glm::vec3& p, const glm::vec3& a, const glm::vec3& b, const glm::vec3& c)
+	{
+		const glm::vec3 ab = b - a;
+		const glm::vec3 ac = c - a;
+		const glm::vec3 ap = p - a;
+		const float d1 = glm::dot(ab, ap);
+		const float d2 = glm::dot(ac, ap);
+		if (d1 <= 0.f && d2 <= 0.f)
+			return glm::length(ap);
+
+		const glm::vec3 bp = p - b;
+		const float d3 = glm::dot(ab, bp);
+		const float d4 = glm::dot(ac, bp);
+		if (d3 >= 0.f && d4 <= d3)
+			return glm::length(bp);
+
+		const float vc = d1 * d4 - d3 * d2;
+		if (vc <= 0.f && d1 >= 0.f && d3 <= 0.f)
+			return glm::length(p - (a + ab * (d1 / (d1 - d3))));
+
+		const glm::vec3 cp = p - c;
+		const float d5 = glm::dot(ab, cp);
+		const float d6 = glm::dot(ac, cp);
+		if (d6 >= 0.f && d5 <= d6)
+			return glm::length(cp);
+
+		const float vb = d5 * d2 - d1 * d6;
+		if (vb <= 0.f && d2 >= 0.f && d6 <= 0.f)
+			return glm::length(p - (a + ac * (d2 / (d2 - d6))));
+
+		const float va = d3 * d6 - d5 * d4;
+		if (va <= 0.f && (d4 - d3) >= 0.f && (d5 - d6) >= 0.f)
+			return glm::length(p - (b + (c - b) * ((d4 - d3) / ((d4 - d3) + (d5 - d6)))));
+
+		const float denominator = 1.f / (va + vb + vc);
+		return glm::length(p - (a + ab * (vb * denominator) + ac * (vc * denominator)));
+	}
+
+	// Largest distance from a collapsed vertex to the simplified surface near the vertex it was collapsed into
+	// (the triangles of its representative and of their vertices). A vertex can end up closer to a triangle
+	// outside this neighborhood, so it is an upper bound of the distance between the two surfaces at the removed vertices.
+	float measureCollapseDistance(const std::vector<uint32_t>& simplifiedIndices, const std::vector<glm::vec3>& positions, std::vector<uint32_t>& representatives)
+	{
+		const size_t vertexCount = positions.size();
+		std::vector<uint32_t> adjacencyOffsets(vertexCount + 1, 0);
+		for (uint32_t index : simplifiedIndices)
+			adjacencyOffsets[index + 1]++;
+		for (size_t i = 0; i < vertexCount; i++)
+			adjacencyOffsets[i + 1] += adjacencyOffsets[i];
+		std::vector<uint32_t> adjacencyTriangles(simplifiedIndices.size());
+		{
+			std::vector<uint32_t> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+			for (size_t i = 0; i < simplifiedIndices.size(); i++)
+				adjacencyTriangles[fill[simplifiedIndices[i]]++] = static_cast<uint32_t>(i / 3);
+		}
+
+		float maxDistance = 0.f;
+		for (uint32_t vertex = 0; vertex < vertexCount; vertex++)
+		{
+			// follow the collapse chain to the vertex kept in the simplified mesh
+			uint32_t representative = representatives[vertex];
+			while (representatives[representative] != representative)
+				representative = representatives[representative];
+			representatives[vertex] = representative;
+
+			if (representative == vertex)
+				continue;
+
+			float distance = -1.f;
+			for (uint32_t i = adjacencyOffsets[representative]; i < adjacencyOffsets[representative + 1]; i++)
+			{
+				const uint32_t* ringTriangle = &simplifiedIndices[adjacencyTriangles[i] * 3];
+				for (uint32_t corner = 0; corner < 3; corner++)
+				{
+					const uint32_t ringVertex = ringTriangle[corner];
+					for (uint32_t j = adjacencyOffsets[ringVertex]; j < adjacencyOffsets[ringVertex + 1]; j++)
+					{
+						const uint32_t* triangle = &simplifiedIndices[adjacencyTriangles[j] * 3];
+						const float triangleDistance = computePointTriangleDistance(positions[vertex], positions[triangle[0]], positions[triangle[1]], positions[triangle[2]]);
+						distance = distance < 0.f ? triangleDistance : std::min(distance, triangleDistance);
+					}
+				}
+			}
+
+			// no triangle left around the representative : the vertex is at its distance from it
+			if (distance < 0.f)
+				distance = glm::length(positions[vertex] - positions[representative]);
+
+			maxDistance = std::max(maxDistance, distance);
+		}
+
+		return maxDistance;
+	}
+}
+
+float MeshSimplifier::simplify(const std::vector<uint32_t>& indices, const std::vector<glm::vec3>& positions
+	, size_t targetIndexCount, float targetError, std::vector<uint32_t>& outIndices)
+{
+	assert(indices.size() % 3 == 0);
+
+	outIndices = indices;
+	const size_t vertexCount = positions.size();
+	const size_t targetTriangleCount = targetIndexCount / 3;
+	const double maxCost = double(targetError) * double(targetError);
+
+	std::vector<Quadric> quadrics(vertexCount);
+	for (size_t i = 0; i < indices.size(); i += 3)
+	{
+		const glm::vec3& p0 = positions[indices[i + 0]];
+		const glm::vec3& p1 = positions[indices[i + 1]];
+		const glm::vec3& p2 = positions[indices[i + 2]];
+
+		glm::vec3 normal = computeTriangleNormal(p0, p1, p2);
+		const float doubleArea = glm::length(normal);
+		if (doubleArea <= 0.f)
+			continue;
+
+		normal /= doubleArea;
+		for (uint32_t corner = 0; corner < 3; corner++)
+			quadrics[indices[i + corner]].addPlane(normal, -glm::dot(normal, p0), doubleArea * 0.5f);
+	}
+
+	std::vector<bool> locked;
+	findLockedVertices(indices, positions, locked);
+
+	// vertex each vertex was collapsed into, chains are resolved when measuring the error
+	std::vector<uint32_t> representatives(vertexCount);
+	for (uint32_t i = 0; i < vertexCount; i++)
+		representatives[i] = i;
+
+	std::vector<Collapse> collapses;
+	std::vector<uint64_t> edges;
+	std::vector<uint32_t> adjacencyOffsets;
+	std::vector<uint32_t> adjacencyTriangles;
+	std::vector<uint32_t> remap(vertexCount);
+	std::vector<bool> touched(vertexCount);
+
+	// each pass collapses a set of independent edges, cheapest first
+	while (outIndices.size() / 3 > targetTriangleCount)
+	{
+		const size_t triangleCount = outIndices.size() / 3;
+
+		edges.clear();
+		for (size_t i = 0; i < outIndices.size(); i += 3)
+		{
+			for (uint32_t corner = 0; corner < 3; corner++)
+				edges.push_back(makeEdgeKey(outIndices[i + corner], outIndices[i + (corner + 1) % 3]));
+		}
+		std::sort(edges.begin(), edges.end());
+		edges.erase(std::unique(edges.begin(), edges.end()), edges.end());
+
+		collapses.clear();
+		for (uint64_t edge : edges)
+		{
+			const uint32_t a = static_cast<uint32_t>(edge >> 32);
+			const uint32_t b = static_cast<uint32_t>(edge & 0xffffffffu);
+
+			Quadric merged = quadrics[a];
+			merged.add(quadrics[b]);
+			const double normalization = merged.weight > 0 ? 1.0 / merged.weight : 1.0;
+
+			Collapse collapse = { a, b, 0.f };
+			double cost = -1;
+			if (!locked[a])
+				cost = std::max(merged.evaluate(positions[b]), 0.0) * normalization;
+			if (!locked[b])
+			{
+				const double reverseCost = std::max(merged.evaluate(positions[a]), 0.0) * normalization;
+				if (cost < 0 || reverseCost < cost)
+				{
+					collapse = { b, a, 0.f };
+					cost = reverseCost;
+				}
+			}
+
+			if (cost < 0 || cost > maxCost)
+				continue;
+
+			collapse.cost = static_cast<float>(cost);
+			collapses.push_back(collapse);
+		}
+
+		if (collapses.empty())
+			break;
+
+		std::sort(collapses.begin(), collapses.end(), [](const Collapse& a, const Collapse& b)
+		{
+			return a.cost < b.cost;
+		});
+
+		// triangles around each vertex
+		adjacencyOffsets.assign(vertexCount + 1, 0);
+		for (uint32_t index : outIndices)
+			adjacencyOffsets[index + 1]++;
+		for (size_t i = 0; i < vertexCount; i++)
+			adjacencyOffsets[i + 1] += adjacencyOffsets[i];
+		adjacencyTriangles.resize(outIndices.size());
+		{
+			std::vector<uint32_t> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+			for (size_t i = 0; i < outIndices.size(); i++)
+				adjacencyTriangles[fill[outIndices[i]]++] = static_cast<uint32_t>(i / 3);
+		}
+
+		for (uint32_t i = 0; i < vertexCount; i++)
+			remap[i] = i;
+		std::fill(touched.begin(), touched.end(), false);
+
+		size_t removedTriangleCount = 0;
+		size_t collapseCount = 0;
+		for (const Collapse& collapse : collapses)
+		{
+			if (triangleCount - removedTriangleCount <= targetTriangleCount)
+				break;
+
+			if (touched[collapse.source] || touched[collapse.target])
+				continue;
+
+			// reject the collapse if a remaining triangle would flip
+			bool flips = false;
+			size_t collapsedTriangleCount = 0;
+			for (uint32_t i = adjacencyOffsets[collapse.source]; i < adjacencyOffsets[collapse.source + 1] && !flips; i++)
+			{
+				const uint32_t* triangle = &outIndices[adjacencyTriangles[i] * 3];
+				if (triangle[0] == collapse.target || triangle[1] == collapse.target || triangle[2] == collapse.target)
+				{
+					collapsedTriangleCount++;
+					continue;
+				}
+
+				glm::vec3 before[3] = { positions[triangle[0]], positions[triangle[1]], positions[triangle[2]] };
+				glm::vec3 after[3] = { before[0], before[1], before[2] };
+				for (uint32_t corner = 0; corner < 3; corner++)
+				{
+					if (triangle[corner] == collapse.source)
+						after[corner] = positions[collapse.target];
+				}
+
+				flips = glm::dot(computeTriangleNormal(before[0], before[1], before[2]), computeTriangleNormal(after[0], after[1], after[2])) <= 0.f;
+			}
+
+			if (flips)
+				continue;
+
+			remap[collapse.source] = collapse.target;
+			representatives[collapse.source] = collapse.target;
+			quadrics[collapse.target].add(quadrics[collapse.source]);
+			removedTriangleCount += collapsedTriangleCount;
+			collapseCount++;
+
+			// the neighborhood must stay unchanged for the flip tests of the next collapses of this pass
+			for (uint32_t i = adjacencyOffsets[collapse.source]; i < adjacencyOffsets[collapse.source + 1]; i++)
+			{
+				const uint32_t* triangle = &outIndices[adjacencyTriangles[i] * 3];
+				touched[triangle[0]] = true;
+				touched[triangle[1]] = true;
+				touched[triangle[2]] = true;
+			}
+		}
+
+		if (collapseCount == 0)
+			break;
+
+		// apply the collapses and remove the degenerated triangles
+		size_t writeIndex = 0;
+		for (size_t i = 0; i < outIndices.size(); i += 3)
+		{
+			const uint32_t a = remap[outIndices[i + 0]];
+			const uint32_t b = remap[outIndices[i + 1]];
+			const uint32_t c = remap[outIndices[i + 2]];
+			if (a == b || b == c || c == a)
+				continue;
+
+			outIndices[writeIndex++] = a;
+			outIndices[writeIndex++] = b;
+			outIndices[writeIndex++] = c;
+		}
+		outIndices.resize(writeIndex);
+	}
+
+	return measureCollapseDistance(outIndices, positions, representatives);
+}
+
+void MeshSimplifier::generateLodChain(std::vector<uint32_t>& inOutIndices, const std::vector<glm::vec3>& positions
+	, const MeshLodSettings& settings, std::vector<MeshLod>& outLods)
+{
+	outLods.clear();
+	outLods.push_back(MeshLod{ 0, static_cast<uint32_t>(inOutIndices.size()), 0.f });
+
+	if (positions.empty())
+		return;
+
+	glm::vec3 boundsMin = positions[0];
+	glm::vec3 boundsMax = positions[0];
+	for (const glm::vec3& position : positions)
+	{
+		boundsMin = glm::min(boundsMin, position);
+		boundsMax = glm::max(boundsMax, position);
+	}
+	const float maxError = settings.maxRelativeError * glm::length(boundsMax - boundsMin) * 0.5f;
+
+	const std::vector<uint32_t> sourceIndices(inOutIndices);
+	std::vector<uint32_t> lodIndices;
+	std::vector<uint32_t> clusters;
+	while (outLods.size() < settings.maxLodCount)
+	{
+		const uint32_t previousIndexCount = outLods.back().indexCount;
+		const size_t targetIndexCount = static_cast<size_t>(previousIndexCount * settings.reductionRatio) / 3 * 3;
+
+		const float error = simplify(sourceIndices, positions, targetIndexCount, maxError, lodIndices);
+		if (lodIndices.empty() || lodIndices.size() > previousIndexCount * (1.f - settings.minReduction))
+			break;
+
+		MeshOptimizer::optimizeVertexCache(lodIndices, positions.size(), clusters);
+
+		outLods.push_back(MeshLod{ static_cast<uint32_t>(inOutIndices.size()), static_cast<uint32_t>(lodIndices.size()), std::max(error, outLods.back().error) });
+		inOutIndices.insert(inOutIndices.end(), lodIndices.begin(), lodIndices.end());
+	}
+}
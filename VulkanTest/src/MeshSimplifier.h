@@ -0,0 +1,27 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <vector>
+
+#include "MeshLod.h"
+
+// Quadric error metric simplification (Garland & Heckbert 1997) by edge collapse.
+// Vertices are only collapsed onto existing vertices so the simplified indices can share
+// the vertex buffer of the source mesh. Border vertices and vertices on attribute seams
+// (several vertices at the same position) never move.
+class MeshSimplifier
+{
+public:
+	// Write in outIndices a simplified version of indices with at most targetIndexCount indices.
+	// Collapses whose quadric error (area weighted RMS distance to the planes of the merged triangles)
+	// is above targetError are not done.
+	// Return the largest distance from a removed vertex to the simplified surface around it, in object space.
+	static float simplify(const std::vector<uint32_t>& indices, const std::vector<glm::vec3>& positions
+		, size_t targetIndexCount, float targetError, std::vector<uint32_t>& outIndices);
+
+	// Append simplified levels after the full resolution indices and describe all the levels in outLods.
+	// Each level is simplified from the full resolution mesh so its error is measured against it.
+	static void generateLodChain(std::vector<uint32_t>& inOutIndices, const std::vector<glm::vec3>& positions
+		, const MeshLodSettings& settings, std::vector<MeshLod>& outLods);
+};
@@ -0,0 +1,438 @@
+#include "OcclusionCulling.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <stdexcept>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define OCCLUSION_CULLING_SSE
+#include <emmintrin.h>
+#endif
+
+const uint32_t OcclusionCuller::BAND_HEIGHT;
+const uint32_t OcclusionCuller::TILE_SIZE;
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/////////// Occluders
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void OcclusionCuller::create(uint32_t _width, uint32_t _height)
+{
+	if (_width == 0 || _height == 0)
+		throw std::runtime_error("occlusion buffer size must not be zero !");
+
+	width = (_width + 7) / 8 * 8;
+	height = (_height + 7) / 8 * 8;
+	stride = width;
+	depthBuffer.assign(stride * height, FLT_MAX);
+	bandTriangles.resize((height + BAND_HEIGHT - 1) / BAND_HEIGHT);
+	tileCountX = width / TILE_SIZE;
+	tileMaxDepths.assign(tileCountX * (height / TILE_SIZE), FLT_MAX);
+}
+
+void OcclusionCuller::beginFrame(const glm::mat4& _viewProjection)
+{
+	viewProjection = _viewProjection;
+	triangles.clear();
+	for (std::vector<uint32_t>& band : bandTriangles)
+		band.clear();
+}
+
+void OcclusionCuller::addOccluder(const glm::vec3* positions, uint32_t vertexCount, uint32_t positionStride, const uint32_t* indices, uint32_t indexCount, const glm::mat4& transform)
+{
+	const glm::mat4 modelViewProjection = viewProjection * transform;
+
+	clipVertices.resize(vertexCount);
+	const uint8_t* position = reinterpret_cast<const uint8_t*>(positions);
+	for (uint32_t i = 0; i < vertexCount; i++, position += positionStride)
+		clipVertices[i] = modelViewProjection * glm::vec4(*reinterpret_cast<const glm::vec3*>(position), 1.f);
+
+	for (uint32_t i = 0; i + 2 < indexCount; i += 3)
+		addClipSpaceTriangle(clipVertices[indices[i]], clipVertices[indices[i + 1]], clipVertices[indices[i + 2]]);
+}
+
+void OcclusionCuller::addClipSpaceTriangle(const glm::vec4& v0, const glm::vec4& v1, const glm::vec4& v2)
+{
+	// clip against the near plane (z >= 0), a triangle becomes at most a quad
+	const glm::vec4 input[3] = { v0, v1, v2 };
+	glm::vec4 polygon[4];
+	uint32_t polygonSize = 0;
+	for (uint32_t i = 0; i < 3; i++)
+	{
+		const glm::vec4& a = input[i];
+		const glm::vec4& b = input[(i + 1) % 3];
+		if (a.z >= 0.f)
+			polygon[polygonSize++] = a;
+		if ((a.z >= 0.f) != (b.z >= 0.f))
+			polygon[polygonSize++] = a + (b - a) * (a.z / (a.z - b.z));
+	}
+	if (polygonSize < 3)
+		return;
+
+	glm::vec3 screen[4];
+	for (uint32_t i = 0; i < polygonSize; i++)
+	{
+		if (polygon[i].w <= 0.f)
+			return;
+		const float invW = 1.f / polygon[i].w;
+		screen[i] = glm::vec3((polygon[i].x * invW * 0.5f + 0.5f) * width, (polygon[i].y * invW * 0.5f + 0.5f) * height, polygon[i].z * invW);
+	}
+
+	for (uint32_t i = 1; i + 1 < polygonSize; i++)
+		addScreenTriangle(screen[0], screen[i], screen[i + 1]);
+}
+
+void OcclusionCuller::addScreenTriangle(const glm::vec3& v0, const glm::vec3& _v1, const glm::vec3& _v2)
+{
+	float area = (_v1.x - v0.x) * (_v2.y - v0.y) - (_v2.x - v0.x) * (_v1.y - v0.y);
+	// also rejects NaNs from degenerated projections
+	if (!(std::fabs(area) > 1e-6f))
+		return;
+
+	// both windings are rasterized, make the triangle counter clockwise
+	const glm::vec3& v1 = area > 0.f ? _v1 : _v2;
+	const glm::vec3& v2 = area > 0.f ? _v2 : _v1;
+	area = std::fabs(area);
+
+	// pixels whose center is inside the triangle bounds
+	const float minX = std::max(std::min(std::min(v0.x, v1.x), v2.x) - 0.5f, 0.f);
+	const float minY = std::max(std::min(std::min(v0.y, v1.y), v2.y) - 0.5f, 0.f);
+	const float maxX = std::min(std::max(std::max(v0.x, v1.x), v2.x) - 0.5f, static_cast<float>(width - 1));
+	const float maxY = std::min(std::max(std::max(v0.y, v1.y), v2.y) - 0.5f, static_cast<float>(height - 1));
+	if (minX > maxX || minY > maxY)
+		return;
+
+	Triangle triangle;
+	triangle.minX = static_cast<int32_t>(std::ceil(minX));
+	triangle.minY = static_cast<int32_t>(std::ceil(minY));
+	triangle.maxX = static_cast<int32_t>(std::floor(maxX));
+	triangle.maxY = static_cast<int32_t>(std::floor(maxY));
+	if (triangle.minX > triangle.maxX || triangle.minY > triangle.maxY)
+		return;
+
+	// E(p) = a * (p.x - origin.x) + b * (p.y - origin.y) + c, positive inside
+	triangle.originX = v0.x;
+	triangle.originY = v0.y;
+	const glm::vec3* vertices[3] = { &v0, &v1, &v2 };
+	for (uint32_t i = 0; i < 3; i++)
+	{
+		const glm::vec3& from = *vertices[i];
+		const glm::vec3& to = *vertices[(i + 1) % 3];
+		triangle.edgeA[i] = from.y - to.y;
+		triangle.edgeB[i] = to.x - from.x;
+		triangle.edgeC[i] = triangle.edgeA[i] * (v0.x - from.x) + triangle.edgeB[i] * (v0.y - from.y);
+	}
+
+	triangle.depth = v0.z;
+	triangle.depthDX = ((v1.z - v0.z) * (v2.y - v0.y) - (v2.z - v0.z) * (v1.y - v0.y)) / area;
+	triangle.depthDY = ((v2.z - v0.z) * (v1.x - v0.x) - (v1.z - v0.z) * (v2.x - v0.x)) / area;
+
+	const uint32_t triangleIndex = static_cast<uint32_t>(triangles.size());
+	triangles.push_back(triangle);
+	for (uint32_t band = triangle.minY / BAND_HEIGHT; band <= triangle.maxY / BAND_HEIGHT; band++)
+		bandTriangles[band].push_back(triangleIndex);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/////////// Rasterization
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void OcclusionCuller::clearBand(uint32_t bandIndex)
+{
+	const uint32_t firstRow = bandIndex * BAND_HEIGHT;
+	const uint32_t endRow = std::min(height, firstRow + BAND_HEIGHT);
+	std::fill(depthBuffer.begin() + firstRow * stride, depthBuffer.begin() + endRow * stride, FLT_MAX);
+}
+
+void OcclusionCuller::updateTileMaxDepths(uint32_t bandIndex)
+{
+	// bands are exactly one tile high
+	float* tileMaxDepth = &tileMaxDepths[bandIndex * tileCountX];
+	for (uint32_t tileX = 0; tileX < tileCountX; tileX++)
+	{
+		float maxDepth = 0.f;
+		for (uint32_t y = bandIndex * BAND_HEIGHT; y < (bandIndex + 1) * BAND_HEIGHT; y++)
+		{
+			const float* row = &depthBuffer[y * stride + tileX * TILE_SIZE];
+			for (uint32_t x = 0; x < TILE_SIZE; x++)
+				maxDepth = std::max(maxDepth, row[x]);
+		}
+		tileMaxDepth[tileX] = maxDepth;
+	}
+}
+
+void OcclusionCuller::rasterize(WorkerThreadPool& workerThreadPool)
+{
+	workerThreadPool.parallelFor(static_cast<uint32_t>(bandTriangles.size()), 1, [this](uint32_t begin, uint32_t end, uint32_t)
+	{
+		for (uint32_t bandIndex = begin; bandIndex < end; bandIndex++)
+		{
+			clearBand(bandIndex);
+			rasterizeBand(bandIndex);
+			updateTileMaxDepths(bandIndex);
+		}
+	});
+}
+
+void OcclusionCuller::rasterizeReference()
+{
+	for (uint32_t bandIndex = 0; bandIndex < bandTriangles.size(); bandIndex++)
+	{
+		clearBand(bandIndex);
+		rasterizeBandReference(bandIndex);
+		updateTileMaxDepths(bandIndex);
+	}
+}
+
+void OcclusionCuller::rasterizeBandReference(uint32_t bandIndex)
+{
+	const int32_t firstRow = static_cast<int32_t>(bandIndex * BAND_HEIGHT);
+	const int32_t lastRow = std::min(static_cast<int32_t>(height), firstRow + static_cast<int32_t>(BAND_HEIGHT)) - 1;
+
+	for (uint32_t triangleIndex : bandTriangles[bandIndex])
+	{
+		const Triangle& triangle = triangles[triangleIndex];
+		for (int32_t y = std::max(triangle.minY, firstRow); y <= std::min(triangle.maxY, lastRow); y++)
+		{
+			const float dy = (static_cast<float>(y) + 0.5f) - triangle.originY;
+			const float rowEdge0 = triangle.edgeB[0] * dy + triangle.edgeC[0];
+			const float rowEdge1 = triangle.edgeB[1] * dy + triangle.edgeC[1];
+			const float rowEdge2 = triangle.edgeB[2] * dy + triangle.edgeC[2];
+			const float rowDepth = triangle.depthDY * dy + triangle.depth;
+
+			float* row = &depthBuffer[y * stride];
+			for (int32_t x = triangle.minX; x <= triangle.maxX; x++)
+			{
+				const float dx = (static_cast<float>(x) + 0.5f) - triangle.originX;
+				const bool inside = triangle.edgeA[0] * dx + rowEdge0 >= 0.f
+					&& triangle.edgeA[1] * dx + rowEdge1 >= 0.f
+					&& triangle.edgeA[2] * dx + rowEdge2 >= 0.f;
+				if (inside)
+					row[x] = std::min(row[x], triangle.depthDX * dx + rowDepth);
+			}
+		}
+	}
+}
+
+#if defined(OCCLUSION_CULLING_SSE)
+
+void OcclusionCuller::rasterizeBand(uint32_t bandIndex)
+{
+	const int32_t firstRow = static_cast<int32_t>(bandIndex * BAND_HEIGHT);
+	const int32_t lastRow = std::min(static_cast<int32_t>(height), firstRow + static_cast<int32_t>(BAND_HEIGHT)) - 1;
+
+	const __m128 laneOffsets = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+	const __m128 laneIndices = _mm_setr_ps(0.f, 1.f, 2.f, 3.f);
+	const __m128 zero = _mm_setzero_ps();
+
+	for (uint32_t triangleIndex : bandTriangles[bandIndex])
+	{
+		const Triangle& triangle = triangles[triangleIndex];
+		const __m128 edgeA0 = _mm_set1_ps(triangle.edgeA[0]);
+		const __m128 edgeA1 = _mm_set1_ps(triangle.edgeA[1]);
+		const __m128 edgeA2 = _mm_set1_ps(triangle.edgeA[2]);
+		const __m128 depthDX = _mm_set1_ps(triangle.depthDX);
+		const __m128 originX = _mm_set1_ps(triangle.originX);
+		const __m128 minX = _mm_set1_ps(static_cast<float>(triangle.minX));
+		const __m128 maxX = _mm_set1_ps(static_cast<float>(triangle.maxX));
+		const int32_t firstColumn = triangle.minX & ~3;
+
+		for (int32_t y = std::max(triangle.minY, firstRow); y <= std::min(triangle.maxY, lastRow); y++)
+		{
+			const float dy = (static_cast<float>(y) + 0.5f) - triangle.originY;
+			const __m128 rowEdge0 = _mm_set1_ps(triangle.edgeB[0] * dy + triangle.edgeC[0]);
+			const __m128 rowEdge1 = _mm_set1_ps(triangle.edgeB[1] * dy + triangle.edgeC[1]);
+			const __m128 rowEdge2 = _mm_set1_ps(triangle.edgeB[2] * dy + triangle.edgeC[2]);
+			const __m128 rowDepth = _mm_set1_ps(triangle.depthDY * dy + triangle.depth);
+
+			float* row = &depthBuffer[y * stride];
+			for (int32_t x = firstColumn; x <= triangle.maxX; x += 4)
+			{
+				const __m128 column = _mm_set1_ps(static_cast<float>(x));
+				const __m128 dx = _mm_sub_ps(_mm_add_ps(column, laneOffsets), originX);
+
+				// lanes outside of the triangle rect are skipped, the same as the reference
+				const __m128 pixelX = _mm_add_ps(column, laneIndices);
+				__m128 inside = _mm_and_ps(_mm_cmpge_ps(pixelX, minX), _mm_cmple_ps(pixelX, maxX));
+				inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(edgeA0, dx), rowEdge0), zero));
+				inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(edgeA1, dx), rowEdge1), zero));
+				inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(edgeA2, dx), rowEdge2), zero));
+				if (_mm_movemask_ps(inside) == 0)
+					continue;
+
+				const __m128 depth = _mm_add_ps(_mm_mul_ps(depthDX, dx), rowDepth);
+				const __m128 previousDepth = _mm_loadu_ps(row + x);
+				const __m128 nearestDepth = _mm_min_ps(depth, previousDepth);
+				_mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(inside, nearestDepth), _mm_andnot_ps(inside, previousDepth)));
+			}
+		}
+	}
+}
+
+const char* OcclusionCuller::getInstructionSetName()
+{
+	return "SSE";
+}
+
+#else
+
+void OcclusionCuller::rasterizeBand(uint32_t bandIndex)
+{
+	rasterizeBandReference(bandIndex);
+}
+
+const char* OcclusionCuller::getInstructionSetName()
+{
+	return "Scalar";
+}
+
+#endif
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/////////// Occlusion queries
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// A box is occluded when every pixel it overlaps holds an occluder nearer than the nearest corner of the box.
+// Tiles entirely nearer than the box are skipped, the pixels are only read in the other tiles.
+
+bool OcclusionCuller::isVisible(const AABB& worldBox) const
+{
+	const glm::vec3 center = worldBox.getCenter();
+	const glm::vec3 extent = worldBox.getExtent();
+	const glm::vec4 clipCenter = viewProjection * glm::vec4(center, 1.f);
+	const glm::vec4 axisX = viewProjection[0] * extent.x;
+	const glm::vec4 axisY = viewProjection[1] * extent.y;
+	const glm::vec4 axisZ = viewProjection[2] * extent.z;
+
+	float minScreenX = FLT_MAX, minScreenY = FLT_MAX, maxScreenX = -FLT_MAX, maxScreenY = -FLT_MAX;
+	float nearestDepth = FLT_MAX;
+	for (uint32_t i = 0; i < 8; i++)
+	{
+		const glm::vec4 corner = clipCenter + ((i & 1) ? axisX : -axisX) + ((i & 2) ? axisY : -axisY) + ((i & 4) ? axisZ : -axisZ);
+		if (corner.z <= 0.f || corner.w <= 0.f)
+			return true;
+
+		const float invW = 1.f / corner.w;
+		const float screenX = (corner.x * invW * 0.5f + 0.5f) * width;
+		const float screenY = (corner.y * invW * 0.5f + 0.5f) * height;
+		minScreenX = std::min(minScreenX, screenX);
+		minScreenY = std::min(minScreenY, screenY);
+		maxScreenX = std::max(maxScreenX, screenX);
+		maxScreenY = std::max(maxScreenY, screenY);
+		nearestDepth = std::min(nearestDepth, corner.z * invW);
+	}
+
+	// every pixel overlapped by the projected box
+	if (maxScreenX <= 0.f || maxScreenY <= 0.f || minScreenX >= width || minScreenY >= height)
+		return false;
+	const int32_t minX = static_cast<int32_t>(std::max(minScreenX, 0.f));
+	const int32_t minY = static_cast<int32_t>(std::max(minScreenY, 0.f));
+	const int32_t maxX = static_cast<int32_t>(std::min(std::ceil(maxScreenX), static_cast<float>(width))) - 1;
+	const int32_t maxY = static_cast<int32_t>(std::min(std::ceil(maxScreenY), static_cast<float>(height))) - 1;
+
+#if defined(OCCLUSION_CULLING_SSE)
+	const __m128 laneIndices = _mm_setr_ps(0.f, 1.f, 2.f, 3.f);
+	const __m128 minXs = _mm_set1_ps(static_cast<float>(minX));
+	const __m128 maxXs = _mm_set1_ps(static_cast<float>(maxX));
+	const __m128 boxDepth = _mm_set1_ps(nearestDepth);
+#endif
+
+	for (int32_t tileY = minY / TILE_SIZE; tileY <= maxY / static_cast<int32_t>(TILE_SIZE); tileY++)
+	{
+		const int32_t firstRow = std::max(minY, tileY * static_cast<int32_t>(TILE_SIZE));
+		const int32_t lastRow = std::min(maxY, (tileY + 1) * static_cast<int32_t>(TILE_SIZE) - 1);
+		for (int32_t tileX = minX / TILE_SIZE; tileX <= maxX / static_cast<int32_t>(TILE_SIZE); tileX++)
+		{
+			// the whole tile is nearer than the box
+			if (tileMaxDepths[tileY * tileCountX + tileX] < nearestDepth)
+				continue;
+
+			const int32_t firstColumn = std::max(minX, tileX * static_cast<int32_t>(TILE_SIZE));
+			const int32_t lastColumn = std::min(maxX, (tileX + 1) * static_cast<int32_t>(TILE_SIZE) - 1);
+			for (int32_t y = firstRow; y <= lastRow; y++)
+			{
+				const float* row = &depthBuffer[y * stride];
+#if defined(OCCLUSION_CULLING_SSE)
+				for (int32_t x = firstColumn & ~3; x <= lastColumn; x += 4)
+				{
+					const __m128 pixelX = _mm_add_ps(_mm_set1_ps(static_cast<float>(x)), laneIndices);
+					const __m128 inside = _mm_and_ps(_mm_cmpge_ps(pixelX, minXs), _mm_cmple_ps(pixelX, maxXs));
+					if (_mm_movemask_ps(_mm_and_ps(inside, _mm_cmpge_ps(_mm_loadu_ps(row + x), boxDepth))) != 0)
+						return true;
+				}
+#else
+				for (int32_t x = firstColumn; x <= lastColumn; x++)
+				{
+					if (row[x] >= nearestDepth)
+						return true;
+				}
+#endif
+			}
+		}
+	}
+
+	return false;
+}
+
+uint32_t OcclusionCuller::cull(const CullingSet& cullingSet, std::vector<uint32_t>& inOutVisibleIndices, WorkerThreadPool& workerThreadPool)
+{
+	const uint32_t count = static_cast<uint32_t>(inOutVisibleIndices.size());
+	visibilityFlags.resize(count);
+
+	workerThreadPool.parallelFor(count, 256, [&](uint32_t begin, uint32_t end, uint32_t)
+	{
+		for (uint32_t i = begin; i < end; i++)
+			visibilityFlags[i] = isVisible(cullingSet.getBox(inOutVisibleIndices[i])) ? 1 : 0;
+	});
+
+	uint32_t visibleCount = 0;
+	for (uint32_t i = 0; i < count; i++)
+	{
+		inOutVisibleIndices[visibleCount] = inOutVisibleIndices[i];
+		visibleCount += visibilityFlags[i];
+	}
+
+	inOutVisibleIndices.resize(visibleCount);
+	return visibleCount;
+}
+
+uint32_t OcclusionCuller::getWidth() const
+{
+	return width;
+}
+
+uint32_t OcclusionCuller::getHeight() const
+{
+	return height;
+}
+
+uint32_t OcclusionCuller::getStride() const
+{
+	return stride;
+}
+
+const float* OcclusionCuller::getDepthBuffer() const
+{
+	return depthBuffer.data();
+}
+
+uint32_t OcclusionCuller::getTileCountX() const
+{
+	return tileCountX;
+}
+
+uint32_t OcclusionCuller::getTileCountY() const
+{
+	return height / TILE_SIZE;
+}
+
+const float* OcclusionCuller::getTileMaxDepths() const
+{
+	return tileMaxDepths.data();
+}
+
+uint32_t OcclusionCuller::getTriangleCount() const
+{
+	return static_cast<uint32_t>(triangles.size());
+}
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <vector>
+
+#include "Bounds.h"
+#include "FrustumCulling.h"
+#include "WorkerThreadPool.h"
+
+// Software occlusion culling, fully on the CPU.
+// A few large occluder meshes are rasterized in a low resolution depth buffer, then the boxes
+// of the instances which passed the frustum culling are tested against it.
+// The depth buffer keeps the nearest occluder depth, in the [0, 1] range of Vulkan clip space.
+// The screen is split in horizontal bands rasterized in parallel, each band only touches its own rows.
+// Each 8x8 tile also keeps its farthest depth, so most occluded boxes are rejected without reading the pixels.
+class OcclusionCuller
+{
+public:
+	static const uint32_t BAND_HEIGHT = 8;
+	static const uint32_t TILE_SIZE = 8;
+
+	// triangle ready for rasterization, edge functions and depth are planes relative to the first vertex
+	struct Triangle
+	{
+		float originX, originY;
+		float edgeA[3], edgeB[3], edgeC[3];
+		float depth, depthDX, depthDY;
+		// covered pixel rect, inclusive
+		int32_t minX, minY, maxX, maxY;
+	};
+
+private:
+	uint32_t width = 0;
+	uint32_t height = 0;
+	// row pitch in floats, multiple of 4 so a row can be read 4 pixels at a time
+	uint32_t stride = 0;
+	std::vector<float> depthBuffer;
+	// farthest depth of each tile, one row of tiles per band
+	std::vector<float> tileMaxDepths;
+	uint32_t tileCountX = 0;
+
+	glm::mat4 viewProjection = glm::mat4(1.f);
+	std::vector<Triangle> triangles;
+	// triangles overlapping each band
+	std::vector<std::vector<uint32_t>> bandTriangles;
+
+	// scratch memory reused between frames
+	std::vector<glm::vec4> clipVertices;
+	std::vector<uint8_t> visibilityFlags;
+
+	void addClipSpaceTriangle(const glm::vec4& v0, const glm::vec4& v1, const glm::vec4& v2);
+	void addScreenTriangle(const glm::vec3& v0, const glm::vec3& v1, const glm::vec3& v2);
+
+	void clearBand(uint32_t bandIndex);
+	void updateTileMaxDepths(uint32_t bandIndex);
+	void rasterizeBand(uint32_t bandIndex);
+	void rasterizeBandReference(uint32_t bandIndex);
+
+public:
+	// the size is rounded up to a multiple of 8, 256x128 is enough for most scenes
+	void create(uint32_t width, uint32_t height);
+
+	// forget the occluders of the previous frame
+	void beginFrame(const glm::mat4& viewProjection);
+
+	// Project the triangles of an occluder, positions are read every positionStride bytes so the vertices
+	// of a mesh can be given directly. Occluders are rasterized whatever their winding.
+	void addOccluder(const glm::vec3* positions, uint32_t vertexCount, uint32_t positionStride, const uint32_t* indices, uint32_t indexCount, const glm::mat4& transform);
+
+	// rasterize the occluders of the frame, 4 pixels per iteration with SSE, one otherwise
+	void rasterize(WorkerThreadPool& workerThreadPool);
+	// single threaded scalar version, writes the same depths as rasterize()
+	void rasterizeReference();
+
+	// true when a part of the box may be visible, boxes crossing the near plane are always visible
+	bool isVisible(const AABB& worldBox) const;
+
+	// Remove the occluded instances from a list of visible instances, usually the output of the frustum culling.
+	// Return the new visible count.
+	uint32_t cull(const CullingSet& cullingSet, std::vector<uint32_t>& inOutVisibleIndices, WorkerThreadPool& workerThreadPool);
+
+	uint32_t getWidth() const;
+	uint32_t getHeight() const;
+	uint32_t getStride() const;
+	// row major, stride floats per row
+	const float* getDepthBuffer() const;
+	uint32_t getTileCountX() const;
+	uint32_t getTileCountY() const;
+	// farthest depth of each tile, row major, getTileCountX() tiles per row
+	const float* getTileMaxDepths() const;
+	uint32_t getTriangleCount() const;
+
+	static const char* getInstructionSetName();
+};
@@ -49,7 +49,15 @@ void Pipeline::create(VkDevice device, const PipelineInfoRenderableRelated& pipe
 	pipelineInfo.renderPass = pipelineInfoSubpassRelated.renderPass;
 	pipelineInfo.subpass = pipelineInfoSubpassRelated.subPass;
 
-	pipelineInfo.pDynamicState = nullptr; //optional
+	// viewport and scissor are set by the render node at record time
+	std::vector<VkDynamicState> dynamicStates = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
+	dynamicStates.insert(dynamicStates.end(), pipelineInfoSubpassRelated.additionalDynamicStates.begin(), pipelineInfoSubpassRelated.additionalDynamicStates.end());
+
+	VkPipelineDynamicStateCreateInfo dynamicState = {};
+	dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+	dynamicState.dynamicStateCount = static_cast<uint32_t>(dynamicStates.size());
+	dynamicState.pDynamicStates = dynamicStates.data();
+	pipelineInfo.pDynamicState = &dynamicState;
 
 	pipelineInfo.basePipelineHandle = VK_NULL_HANDLE; //optional
 	pipelineInfo.basePipelineIndex = -1; //optional
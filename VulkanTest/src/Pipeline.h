@@ -2,13 +2,20 @@
 
 #include <vulkan/vulkan.hpp>
 
+#include <vector>
+
 #include "Renderable.h"
 
+// Viewport and scissor are always dynamic : they are set by the render nodes for each pass
+// so a window resize never forces the pipelines to be rebuilt.
+// viewportState only give the viewport / scissor count, its pViewports and pScissors are ignored.
 struct PipelineInfoSubpassRelated
 {
 	VkRenderPass renderPass;
 	uint32_t subPass;
 	VkPipelineViewportStateCreateInfo viewportState;
+	// optional states set with vkCmdSet* (ex : VK_DYNAMIC_STATE_DEPTH_BIAS, VK_DYNAMIC_STATE_LINE_WIDTH)
+	std::vector<VkDynamicState> additionalDynamicStates;
 	VkPipelineRasterizationStateCreateInfo rasterizerInfo;
 	VkPipelineMultisampleStateCreateInfo multisamplingInfo;
 	VkPipelineColorBlendStateCreateInfo colorBlendingInfo;
@@ -5,6 +5,10 @@
 #include "Pipeline.h"
 #include "GraphicsContext.h"
 #include "Material.h"
+#include "VulkanUtils.h"
+
+#include <algorithm>
+#include <functional>
 
 /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 /////////// RenderableBuffer 
@@ -94,17 +98,17 @@ BatchedRenderableType::BatchedRenderableType(RenderableType p)
 
 }
 
-void BatchedRenderableType::addRenderable(Material* material, MaterialInterface* materialInstance, Renderable* renderable)
+void BatchedRenderableType::addRenderable(Material* material, MaterialInterface* materialInstance, Renderable* renderable, uint32_t lodIndex)
 {
 	const auto& found = materialBatchMapping.find(material);
 	if (found != materialBatchMapping.end())
 	{
-		found->second->addRenderable(materialInstance, renderable);
+		found->second->addRenderable(materialInstance, renderable, lodIndex);
 	}
 	else
 	{
 		materialBatch.push_back(BatchedMaterial(material));
-		materialBatch.back().addRenderable(materialInstance, renderable);
+		materialBatch.back().addRenderable(materialInstance, renderable, lodIndex);
 		materialBatchMapping[material] = &materialBatch.back();
 	}
 }
@@ -115,17 +119,17 @@ BatchedMaterial::BatchedMaterial(Material* _material)
 	: material(_material)
 {}
 
-void BatchedMaterial::addRenderable(MaterialInterface* matInterface, Renderable* renderable)
+void BatchedMaterial::addRenderable(MaterialInterface* matInterface, Renderable* renderable, uint32_t lodIndex)
 {
 	const auto& found = materialInterfaceBatchMapping.find(matInterface);
 	if (found != materialInterfaceBatchMapping.end())
 	{
-		found->second->addRenderable(renderable);
+		found->second->addRenderable(renderable, lodIndex);
 	}
 	else
 	{
 		materialInterfaceBatch.push_back(BatchedMaterialInterface(matInterface));
-		materialInterfaceBatch.back().addRenderable(renderable);
+		materialInterfaceBatch.back().addRenderable(renderable, lodIndex);
 		materialInterfaceBatchMapping[matInterface] = &materialInterfaceBatch.back();
 	}
 }
@@ -136,18 +140,18 @@ BatchedMaterialInterface::BatchedMaterialInterface(MaterialInterface* _materialI
 	: materialInterface(_materialInterface)
 {}
 
-void BatchedMaterialInterface::addRenderable(Renderable* renderable)
+void BatchedMaterialInterface::addRenderable(Renderable* renderable, uint32_t lodIndex)
 {
 	void* renderedObjectPtr = renderable->getRenderedObjectPtr();
 	const auto& found = renderedObjectBatchMapping.find(renderedObjectPtr);
 	if (found != renderedObjectBatchMapping.end())
 	{
-		found->second->addRenderable(renderable);
+		found->second->addRenderable(renderable, lodIndex);
 	}
 	else
 	{
 		renderedObjectBatch.push_back(BatchedRenderable(renderable));
-		renderedObjectBatch.back().addRenderable(renderable);
+		renderedObjectBatch.back().addRenderable(renderable, lodIndex);
 		renderedObjectBatchMapping[renderedObjectPtr] = &renderedObjectBatch.back();
 	}
 }
@@ -158,9 +162,10 @@ BatchedRenderable::BatchedRenderable(Renderable* _renderable)
 	: renderable(_renderable)
 {}
 
-void BatchedRenderable::addRenderable(Renderable* renderable)
+void BatchedRenderable::addRenderable(Renderable* renderable, uint32_t lodIndex)
 {
 	renderableInstances.push_back(renderable);
+	instanceLods.push_back(lodIndex);
 }
 
 /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -189,8 +194,33 @@ void RenderBatch::create(const GraphicsContext & context, const RenderableBuffer
 	renderableBuffers[renderableBufferCreateInfo.renderableType].create(context, renderableBufferCreateInfo.renderableItemSize, renderableBufferCreateInfo.bufferMaxItemCount);
 }
 
+void RenderBatch::setLodView(const LodViewInfo& viewInfo)
+{
+	lodViewInfo = viewInfo;
+}
+
+void RenderBatch::setLodSelectionSettings(const LodSelectionSettings& settings)
+{
+	lodSelectionSettings = settings;
+}
+
 // add renderables at each frames based on visibility test
 void RenderBatch::addRenderable(Material* mat, MaterialInterface* matInterface, Renderable* renderable)
+{
+	addRenderable(mat, matInterface, renderable, 0);
+}
+
+void RenderBatch::addRenderable(Material* mat, MaterialInterface* matInterface, Renderable* renderable
+	, const glm::vec3& worldCenter, float worldScale, LodSelectionState& lodState)
+{
+	uint32_t lodCount = 0;
+	const MeshLod* lods = renderable->getLods(lodCount);
+	const uint32_t lodIndex = LodSelector::selectLod(lods, lodCount, worldCenter, worldScale, lodViewInfo, lodSelectionSettings, lodState);
+
+	addRenderable(mat, matInterface, renderable, lodIndex);
+}
+
+void RenderBatch::addRenderable(Material* mat, MaterialInterface* matInterface, Renderable* renderable, uint32_t lodIndex)
 {
 	auto& foundRenderableBuffer = renderableBuffers.find(renderable->getRenderableType());
 	if (foundRenderableBuffer != renderableBuffers.end())
@@ -204,17 +234,22 @@ void RenderBatch::addRenderable(Material* mat, MaterialInterface* matInterface,
 	if (foundBatch != renderableTypeBatch.end())
 	{
 		renderableTypeBatch.push_back(BatchedRenderableType(renderable->getRenderableType()));
-		renderableTypeBatch.back().addRenderable(mat, matInterface, renderable);
+		renderableTypeBatch.back().addRenderable(mat, matInterface, renderable, lodIndex);
 	}
 	else
 	{
-		foundBatch->addRenderable(mat, matInterface, renderable);
+		foundBatch->addRenderable(mat, matInterface, renderable, lodIndex);
 	}
 }
 
 // call this function once all renderables have been added to the batch
-void RenderBatch::recordRenderCommand(VkRenderPass currentPass, uint32_t currentSubpass)
+void RenderBatch::recordRenderCommand(VkRenderPass currentPass, uint32_t currentSubpass, const VkExtent2D& extent)
 {
+	cmdSetViewportAndScissor(commandBuffer, extent);
+
+	// vertex and index buffer bindings are kept across pipeline binds
+	const void* boundGeometry = nullptr;
+
 	for (const auto& batch : renderableTypeBatch)
 	{
 		RenderableType currentRenderableType = batch.renderableType;
@@ -228,17 +263,33 @@ void RenderBatch::recordRenderCommand(VkRenderPass currentPass, uint32_t current
 			{
 				batchedMaterialInterface.materialInterface->cmdBindLocalUniforms(commandBuffer);
 
+				// meshes of the same geometry pool block are drawn one after the other
+				sortedRenderables.clear();
 				for (const auto& batchedRenderable : batchedMaterialInterface.renderedObjectBatch)
+					sortedRenderables.push_back(&batchedRenderable);
+
+				std::sort(sortedRenderables.begin(), sortedRenderables.end(), [](const BatchedRenderable* a, const BatchedRenderable* b)
+				{
+					return std::less<const void*>()(a->renderable->getGeometryBindingKey(), b->renderable->getGeometryBindingKey());
+				});
+
+				for (const BatchedRenderable* batchedRenderable : sortedRenderables)
 				{
-					batchedRenderable.renderable->cmdbindVBOsAndIBOs(commandBuffer);
+					const void* geometry = batchedRenderable->renderable->getGeometryBindingKey();
+					if (geometry != boundGeometry)
+					{
+						batchedRenderable->renderable->cmdbindVBOsAndIBOs(commandBuffer);
+						boundGeometry = geometry;
+					}
 
 					uint32_t renderableIndex = 0;
-					for (const auto& renderableInstance : batchedRenderable.renderableInstances)
+					for (const auto& renderableInstance : batchedRenderable->renderableInstances)
 					{
 						uint32_t itemOffset = renderableInstance->getMaterialInputDataAlignedSize() * renderableIndex;
 						batchedMaterialInterface.materialInterface->cmdBindRenderableUniforms(commandBuffer, currentRenderableType, itemOffset);
 						//renderable->cmdbindRenderableUniforms(commandBuffer);
-						renderable->cmdDraw(commandBuffer);
+						batchedRenderable->renderable->cmdDrawLod(commandBuffer, batchedRenderable->instanceLods[renderableIndex]);
+						renderableIndex++;
 					}
 				}
 			}
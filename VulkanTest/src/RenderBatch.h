@@ -92,7 +92,7 @@ struct BatchedRenderableType
 	std::unordered_map<Material*, BatchedMaterial*> materialBatchMapping;
 
 	BatchedRenderableType(RenderableType p);
-	void addRenderable(Material* material, MaterialInterface* materialInstance, Renderable* renderable);
+	void addRenderable(Material* material, MaterialInterface* materialInstance, Renderable* renderable, uint32_t lodIndex);
 };
 
 struct BatchedMaterial
@@ -102,7 +102,7 @@ struct BatchedMaterial
 	std::unordered_map<MaterialInterface*, BatchedMaterialInterface*> materialInterfaceBatchMapping;
 
 	BatchedMaterial(Material* _material);
-	void addRenderable(MaterialInterface* matInterface, Renderable* renderable);
+	void addRenderable(MaterialInterface* matInterface, Renderable* renderable, uint32_t lodIndex);
 };
 
 struct BatchedMaterialInterface
@@ -112,16 +112,18 @@ struct BatchedMaterialInterface
 	std::unordered_map<Renderable*, BatchedRenderable*> renderedObjectBatchMapping;
 
 	BatchedMaterialInterface(MaterialInterface* _materialInterface);
-	void addRenderable(Renderable* renderable);
+	void addRenderable(Renderable* renderable, uint32_t lodIndex);
 };
 
-struct BatchedRenderableInstance
+struct BatchedRenderable
 {
 	Renderable* renderable;
-	std::vector<BatchedRenderableInstance*> renderableInstances;
+	std::vector<Renderable*> renderableInstances;
+	// level of detail drawn for each instance
+	std::vector<uint32_t> instanceLods;
 
-	BatchedRenderableOwner(Renderable* _renderable);
-	void addRenderableInstance(Renderable* renderable);
+	BatchedRenderable(Renderable* _renderable);
+	void addRenderable(Renderable* renderable, uint32_t lodIndex);
 };
 
 /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -134,16 +136,33 @@ private:
 	std::vector<BatchedRenderableType> renderableTypeBatch;
 	std::unordered_map<RenderableType, RenderableBuffer> renderableBuffers;
 
+	LodViewInfo lodViewInfo;
+	LodSelectionSettings lodSelectionSettings;
+
+	// renderables of a material interface sorted by geometry, reused between records
+	std::vector<const BatchedRenderable*> sortedRenderables;
+
+	void addRenderable(Material* mat, MaterialInterface* matInterface, Renderable* renderable, uint32_t lodIndex);
+
 public:
 	RenderBatch();
 	~RenderBatch();
 	void create(const GraphicsContext& context, const std::vector<RenderableBufferCreateInfo>& renderableBufferCreateInfos);
 	void create(const GraphicsContext& context, const RenderableBufferCreateInfo& renderableBufferCreateInfo);
 
+	// camera used by the level of detail selection of the next added renderables
+	void setLodView(const LodViewInfo& viewInfo);
+	void setLodSelectionSettings(const LodSelectionSettings& settings);
+
 	// add renderables at each frames based on visibility test
 	void addRenderable(Material* mat, MaterialInterface* matInterface, Renderable* renderable);
+	// same but the level of detail is selected from the projected error of the instance,
+	// lodState keeps the level of the previous frames for the hysteresis
+	void addRenderable(Material* mat, MaterialInterface* matInterface, Renderable* renderable
+		, const glm::vec3& worldCenter, float worldScale, LodSelectionState& lodState);
 	// call this function once all renderables have been added to the batch
-	void recordRenderCommand(VkRenderPass currentPass, uint32_t currentSubpass);
+	// viewport and scissor are dynamic states, they are set to cover the given extent
+	void recordRenderCommand(VkRenderPass currentPass, uint32_t currentSubpass, const VkExtent2D& extent);
 	// once we have render all renderable for this frame, clear the batch
 	void clearBatch();
 	void destroy() override;
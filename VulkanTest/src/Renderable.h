@@ -4,6 +4,9 @@
 
 #include <stdlib.h>
 
+#include "Bounds.h"
+#include "MeshLod.h"
+
 // Each renderable type correspond to a certain input layout inside vertex shader
 
 enum RenderableType
@@ -34,10 +37,12 @@ struct InstancedStaticMeshMaterialInputDatas
 	//TODO
 };
 
+// the bones are in the BonePaletteBuffer of the frame, from boneOffset
 struct SkeletonMeshMaterialInputDatas
 {
 	glm::mat4 MVP;
-	glm::mat4 bones[100];
+	uint32_t boneOffset;
+	uint32_t boneCount;
 };
 
 struct BillboardMaterialInputDatas
@@ -48,7 +53,7 @@ struct BillboardMaterialInputDatas
 // A renderable is responsible for binding the VBOs and IBOs of the rendered object
 // and call the draw command
 // It can give you the data corresponding to renderable material input 
-// (i.e : uniforms for each instance of renderable and passed to vertex shader (like the MVP matrix, the bones transforms, ...) )
+// (i.e : uniforms for each instance of renderable and passed to vertex shader (like the MVP matrix, the bones offset, ...) )
 class Renderable
 {
 protected:
@@ -72,6 +77,32 @@ public:
 
 	virtual void cmdbindVBOsAndIBOs(VkCommandBuffer commandBuffer) = 0;
 	virtual void cmdDraw(VkCommandBuffer commandBuffer) = 0;
+
+	// Levels of detail, sorted from the full resolution to the coarsest.
+	// Renderables without levels of detail return no level and are always drawn with cmdDraw.
+	virtual const MeshLod* getLods(uint32_t& outLodCount) const
+	{
+		outLodCount = 0;
+		return nullptr;
+	}
+
+	virtual void cmdDrawLod(VkCommandBuffer commandBuffer, uint32_t lodIndex)
+	{
+		cmdDraw(commandBuffer);
+	}
+
+	// Object space bounds used by the culling, renderables without bounds are never culled
+	virtual const Bounds* getLocalBounds() const
+	{
+		return nullptr;
+	}
+
+	// Renderables returning the same key share their vertex and index buffers,
+	// the batch only calls cmdbindVBOsAndIBOs when the key changes.
+	virtual const void* getGeometryBindingKey() const
+	{
+		return this;
+	}
 };
 
 class IRenderableInstance
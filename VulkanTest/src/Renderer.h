@@ -8,23 +8,41 @@
 
 #include "Buffer.h"
 #include "GraphicsContext.h"
+#include "Image.h"
 #include "Pipeline.h"
+#include "SkinningNode.h"
 #include "WindowHandler.h"
+#include "VulkanUtils.h"
 
 class Material;
 class MaterialInstance;
 class MaterialInterface;
 class RenderBatch;
 
+// An attachment of the render pass framebuffers, in the order of the render pass attachments.
+// Either the swapchain image or an image created at the swapchain size (depth, G-buffer...).
+struct FrameBufferAttachment
+{
+	bool isSwapChainImage = false;
+	// usage, format and aspect of the image, the size is set when the framebuffers are created
+	Image2DCreateInfo imageInfo;
+};
+
 // Datas representing a render pass. Includes datas for subPasses, framebuffer and sub pass dependencies
 
 struct RenderPassData
 {
-	VkRenderPass renderPass;
+	VkRenderPass renderPass = VK_NULL_HANDLE;
 	std::vector<VkSubpassDescription> subPasses;
 	std::vector<std::vector<VkSubpassDependency>> subPassDependencies;
+	std::vector<FrameBufferAttachment> attachments;
+	// one framebuffer per swapchain image if the swapchain image is an attachment, a single one otherwise
 	std::vector<VkFramebuffer> frameBuffers;
+	// images of the attachments which are not the swapchain image, rebuilt with the framebuffers
+	std::vector<std::shared_ptr<Image2D>> attachmentImages;
 	std::vector<std::shared_ptr<RenderBatch>> batchPerSubPasses;
+	// size of the framebuffers, used for the render area and the dynamic viewport / scissor
+	VkExtent2D extent = { 0, 0 };
 };
 
 // A render node encapsulate few commands and render passes
@@ -37,14 +55,17 @@ struct RenderPassData
 class RenderNode
 {
 protected:
+	VkPhysicalDevice physicalDevice;
 	VkDevice owningDevice;
 	VkCommandPool commandPool;
+	VkQueue transferQueue;
 
 	// renderPasses for this node
 	std::vector<RenderPassData> renderPasses;
 
-	// command to draw the passes
-	std::vector<VkCommandBuffer> commands;
+	// commands to draw the passes, one per framebuffer of the pass.
+	// The pass drawing in the swapchain image submits the one of the acquired image.
+	std::vector<std::vector<VkCommandBuffer>> commandsPerPass;
 	// semaphores to handle renderPass transitions
 	std::vector<VkSemaphore> semaphores;
 	// each index represent a signal semaphore to wait. We may have multiple semaphore to wait per pass.
@@ -57,14 +78,21 @@ protected:
 public:
 
 	// usage
-	void create(VkDevice device, VkCommandPool _commandPool)
+	void create(const GraphicsContext& context, const WindowContext& windowContext)
 	{
-		owningDevice = device;
-		commandPool = _commandPool;
-
-		createCommands();
+		physicalDevice = context.getPhysicalDevice();
+		owningDevice = context.getDevice();
+		commandPool = context.getCommandPool();
+		transferQueue = context.getGraphicsQueue();
 
 		createRenderPasses();
+
+		for (auto& renderPass : renderPasses)
+			renderPass.extent = windowContext.getSwapChainExtent();
+		createFrameBuffers(windowContext);
+
+		// one command buffer per framebuffer, so after the framebuffers
+		createCommands();
 	}
 
 	void addRenderPassNoDependencies(const RenderPassData& renderNode)
@@ -80,42 +108,42 @@ public:
 		makeNodeWaitOtherPasses(passIndex, dependencies);
 	}
 
+	// Record the commands of each framebuffer, after recordSecondaryCommands()
 	void recordPrimaryCommands()
 	{
-		uint32_t passIndex = 0;
-		for (const auto& renderPass : renderPasses)
+		for (size_t passIndex = 0; passIndex < renderPasses.size(); passIndex++)
 		{
-			VkCommandBufferBeginInfo commandBeginInfo = {};
-			commandBeginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-			commandBeginInfo.flags = VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT;
-			commandBeginInfo.pInheritanceInfo = nullptr;
-
-			const VkCommandBuffer& commandBuffer = commands[passIndex].getCommandHandle();
-			vkBeginCommandBuffer(commandBuffer, &commandBeginInfo);
-
-			VkRenderPassBeginInfo renderPassBeginInfo = {};
-			renderPassBeginInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-			renderPassBeginInfo.clearValueCount;
-			renderPassBeginInfo.pClearValues;
-			renderPassBeginInfo.framebuffer = frameBuffers[passIndex];
-			renderPassBeginInfo.renderArea.offset = { 0, 0 };
-			renderPassBeginInfo.renderArea.extent = ? ? ? ? ? ; //TODO
-			renderPassBeginInfo.renderPass = renderPasses[passIndex].getRenderPassHandle();
-			renderPassBeginInfo.clearValueCount;
-
-			vkCmdBeginRenderPass(commandBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
-			for (int subPassIndex = 0; subPassIndex < renderPasses[passIndex].subPasses.size(); subPassIndex++)
+			const RenderPassData& renderPass = renderPasses[passIndex];
+			for (size_t frameBufferIndex = 0; frameBufferIndex < renderPass.frameBuffers.size(); frameBufferIndex++)
 			{
-				//const RenderBatch& batch = batchInfos.findBatchForPass(passIndex, subPassIndex).recordRenderCommand(commandBuffer);
-				VkCommandBuffer secondaryCmdBuffers[] = { batch.getCommandBuffer() };
-				vkCmdExecuteCommands(commandBuffer, 1, secondaryCmdBuffers);
-				vkCmdNextSubpass(commandBuffer, VK_SUBPASS_CONTENTS_INLINE);
-			}
-			vkCmdEndRenderPass(commandBuffer);
+				VkCommandBufferBeginInfo commandBeginInfo = {};
+				commandBeginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+				commandBeginInfo.flags = VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT;
+				commandBeginInfo.pInheritanceInfo = nullptr;
+
+				const VkCommandBuffer commandBuffer = commandsPerPass[passIndex][frameBufferIndex];
+				vkBeginCommandBuffer(commandBuffer, &commandBeginInfo);
+
+				VkRenderPassBeginInfo renderPassBeginInfo = {};
+				renderPassBeginInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+				renderPassBeginInfo.framebuffer = renderPass.frameBuffers[frameBufferIndex];
+				renderPassBeginInfo.renderArea.offset = { 0, 0 };
+				renderPassBeginInfo.renderArea.extent = renderPass.extent;
+				renderPassBeginInfo.renderPass = renderPass.renderPass;
+
+				vkCmdBeginRenderPass(commandBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+				for (size_t subPassIndex = 0; subPassIndex < renderPass.subPasses.size(); subPassIndex++)
+				{
+					if (subPassIndex > 0)
+						vkCmdNextSubpass(commandBuffer, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
 
-			vkEndCommandBuffer(commands.getCommandHandler());
+					VkCommandBuffer secondaryCmdBuffers[] = { renderPass.batchPerSubPasses[subPassIndex]->getCommandBuffer() };
+					vkCmdExecuteCommands(commandBuffer, 1, secondaryCmdBuffers);
+				}
+				vkCmdEndRenderPass(commandBuffer);
 
-			passIndex++;
+				vkEndCommandBuffer(commandBuffer);
+			}
 		}
 	}
 	
@@ -134,19 +162,49 @@ public:
 			for (int subPassIndex = 0; subPassIndex < renderPassData.subPasses.size(); subPassIndex++)
 			{
 				const RenderBatch& batch = renderPassData.batchPerSubPasses[subPassIndex];
-				batch.recordRenderCommand(renderPassData.renderPass, subPassIndex);
+				batch.recordRenderCommand(renderPassData.renderPass, subPassIndex, renderPassData.extent);
 			}
 			passIndex++;
 		}
 	}
 
-	void submitCommands(VkQueue graphicsQueue)
+	// imageIndex is the acquired swapchain image, it selects the framebuffer of the passes drawing in it
+	void submitCommands(VkQueue graphicsQueue, uint32_t imageIndex)
 	{
+		for (size_t passIndex = 0; passIndex < renderPasses.size(); passIndex++)
+		{
+			const std::vector<VkCommandBuffer>& commands = commandsPerPass[passIndex];
+			const size_t frameBufferIndex = commands.size() > 1 ? imageIndex : 0;
+			submitInfos[passIndex].commandBufferCount = commands.empty() ? 0 : 1;
+			submitInfos[passIndex].pCommandBuffers = commands.empty() ? nullptr : &commands[frameBufferIndex];
+		}
+
 		vkQueueSubmit(graphicsQueue, static_cast<uint32_t>(submitInfos.size()), submitInfos.data(), VK_NULL_HANDLE);
 	}
 
+	// Only the swapchain dependent resources are rebuilt : pipelines use dynamic viewport / scissor
+	// so they stay valid, we just recreate images / framebuffers and record the commands again.
+	// The device must be idle when calling this.
+	void onSwapChainResized(const WindowContext& windowContext)
+	{
+		destroyFrameBuffers();
+
+		for (auto& renderPass : renderPasses)
+			renderPass.extent = windowContext.getSwapChainExtent();
+
+		createFrameBuffers(windowContext);
+
+		// the image count of the new swapchain may differ, the commands are allocated again
+		destroyCommands();
+		createCommands();
+
+		recordSecondaryCommands();
+		recordPrimaryCommands();
+	}
+
 	void destroy()
 	{
+		destroyFrameBuffers();
 		renderPasses.clear();
 
 		waitSemaphoresPerPass.clear();
@@ -156,9 +214,7 @@ public:
 		for (int i = 0; i < semaphores.size(); i++)
 			vkDestroySemaphore(owningDevice, semaphores[i], nullptr);
 
-		// clear commands
-		for (int i = 0; i < commands.size(); i++)
-			vkFreeCommandBuffers(owningDevice, commandPool, static_cast<uint32_t>(commands.size()), commands.data());
+		destroyCommands();
 	}
 
 	// utility
@@ -214,7 +270,7 @@ public:
 		pipelineInfoSubpassRelated.depthStencil = ;
 		pipelineInfoSubpassRelated.multisamplingInfo = ;
 		pipelineInfoSubpassRelated.rasterizerInfo = ;
-		pipelineInfoSubpassRelated.viewportState = ;
+		pipelineInfoSubpassRelated.viewportState = makeDynamicViewportState();
 	}
 
 	const RenderBatch& getBatch(uint32_t renderPassIndex, uint32_t subPassIndex) const
@@ -248,6 +304,79 @@ protected:
 		// nothing by default. Place here all the passes setup.
 	}
 
+	// Create the attachment images at the extent of their pass then the framebuffers from the attachments.
+	// Override this for framebuffers which can't be described by the attachments of the passes.
+	virtual void createFrameBuffers(const WindowContext& windowContext)
+	{
+		for (auto& renderPass : renderPasses)
+		{
+			if (renderPass.attachments.empty())
+				continue;
+
+			bool useSwapChainImage = false;
+			for (const auto& attachment : renderPass.attachments)
+			{
+				if (attachment.isSwapChainImage)
+				{
+					useSwapChainImage = true;
+					continue;
+				}
+
+				Image2DCreateInfo imageInfo = attachment.imageInfo;
+				imageInfo.physicalDevice = physicalDevice;
+				imageInfo.device = owningDevice;
+				imageInfo.commandPool = commandPool;
+				imageInfo.transferQueue = transferQueue;
+				imageInfo.width = renderPass.extent.width;
+				imageInfo.height = renderPass.extent.height;
+				imageInfo.pixels = nullptr;
+
+				std::shared_ptr<Image2D> image = std::make_shared<Image2D>();
+				image->create(imageInfo);
+				renderPass.attachmentImages.push_back(image);
+			}
+
+			const uint32_t frameBufferCount = useSwapChainImage ? windowContext.getImageCount() : 1;
+			renderPass.frameBuffers.resize(frameBufferCount);
+			std::vector<VkImageView> views(renderPass.attachments.size());
+			for (uint32_t frameBufferIndex = 0; frameBufferIndex < frameBufferCount; frameBufferIndex++)
+			{
+				uint32_t imageIndex = 0;
+				for (size_t attachmentIndex = 0; attachmentIndex < views.size(); attachmentIndex++)
+				{
+					if (renderPass.attachments[attachmentIndex].isSwapChainImage)
+						views[attachmentIndex] = windowContext.getImageView(frameBufferIndex);
+					else
+						views[attachmentIndex] = renderPass.attachmentImages[imageIndex++]->getImageViewHandle();
+				}
+
+				VkFramebufferCreateInfo frameBufferInfo = {};
+				frameBufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+				frameBufferInfo.renderPass = renderPass.renderPass;
+				frameBufferInfo.attachmentCount = static_cast<uint32_t>(views.size());
+				frameBufferInfo.pAttachments = views.data();
+				frameBufferInfo.width = renderPass.extent.width;
+				frameBufferInfo.height = renderPass.extent.height;
+				frameBufferInfo.layers = 1;
+
+				if (vkCreateFramebuffer(owningDevice, &frameBufferInfo, nullptr, &renderPass.frameBuffers[frameBufferIndex]) != VK_SUCCESS)
+					throw std::runtime_error("failed to create framebuffer !");
+			}
+		}
+	}
+
+	virtual void destroyFrameBuffers()
+	{
+		for (auto& renderPass : renderPasses)
+		{
+			for (auto& frameBuffer : renderPass.frameBuffers)
+				vkDestroyFramebuffer(owningDevice, frameBuffer, nullptr);
+			renderPass.frameBuffers.clear();
+			// the images are destroyed with their last reference
+			renderPass.attachmentImages.clear();
+		}
+	}
+
 private:
 
 	void setupQueuedRenderPasses()
@@ -278,15 +407,33 @@ private:
 
 	void createCommands()
 	{
-		commands.resize(renderPasses.size());
-
-		VkCommandBufferAllocateInfo allocateInfo = {};
-		allocateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-		allocateInfo.commandBufferCount = static_cast<uint32_t>(commands.size());
-		allocateInfo.commandPool = commandPool;
-		allocateInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+		commandsPerPass.resize(renderPasses.size());
+		for (size_t passIndex = 0; passIndex < renderPasses.size(); passIndex++)
+		{
+			std::vector<VkCommandBuffer>& commands = commandsPerPass[passIndex];
+			commands.resize(renderPasses[passIndex].frameBuffers.size());
+			if (commands.empty())
+				continue;
+
+			VkCommandBufferAllocateInfo allocateInfo = {};
+			allocateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+			allocateInfo.commandBufferCount = static_cast<uint32_t>(commands.size());
+			allocateInfo.commandPool = commandPool;
+			allocateInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+
+			if (vkAllocateCommandBuffers(owningDevice, &allocateInfo, commands.data()) != VK_SUCCESS)
+				throw std::runtime_error("failed to allocate render pass command buffers !");
+		}
+	}
 
-		vkAllocateCommandBuffers(owningDevice, &allocateInfo, commands.data());
+	void destroyCommands()
+	{
+		for (auto& commands : commandsPerPass)
+		{
+			if (!commands.empty())
+				vkFreeCommandBuffers(owningDevice, commandPool, static_cast<uint32_t>(commands.size()), commands.data());
+		}
+		commandsPerPass.clear();
 	}
 
 	void setupSubmitInfos(const std::vector<VkSemaphore>& firstPassesWaitSemaphores)
@@ -326,8 +473,9 @@ private:
 					submitInfo.pWaitDstStageMask = waitStages;
 				}
 
-				submitInfo.commandBufferCount = 1;
-				submitInfo.pCommandBuffers = &(commands[passIndex].getCommandHandle());
+				// the command buffer depends on the acquired image, set by submitCommands()
+				submitInfo.commandBufferCount = 0;
+				submitInfo.pCommandBuffers = nullptr;
 
 				submitInfo.signalSemaphoreCount = 1;
 				submitInfo.pSignalSemaphores = &(semaphores[passIndex].getSemaphoreHandle());
@@ -391,11 +539,20 @@ public:
 		}
 	}
 
-	void submitCommand(VkQueue graphicsQueue)
+	void recordPrimaryCommands()
+	{
+		for (auto& node : renderNodes)
+		{
+			node->recordPrimaryCommands();
+		}
+	}
+
+	// imageIndex is the acquired swapchain image
+	void submitCommands(VkQueue graphicsQueue, uint32_t imageIndex)
 	{
 		for (auto& node : renderNodes)
 		{
-			node->submitCommands(graphicsQueue);
+			node->submitCommands(graphicsQueue, imageIndex);
 		}
 	}
 
@@ -411,6 +568,14 @@ public:
 	{
 		renderNodes.back()->extractLastSemaphores(outSemaphores);
 	}
+
+	void onSwapChainResized(const WindowContext& windowContext)
+	{
+		for (auto& renderNode : renderNodes)
+		{
+			renderNode->onSwapChainResized(windowContext);
+		}
+	}
 };
 
 struct RenderSetup
@@ -421,6 +586,9 @@ struct RenderSetup
 	VkPhysicalDeviceFeatures requiredDeviceFeatures;
 	bool needPresentSupport = true;
 	VkQueueFlags requestedQueueFlags = VK_QUEUE_GRAPHICS_BIT;
+	uint32_t frameInFlightCount = 2;
+	// use the bindless texture table if the device supports descriptor indexing
+	bool bindlessTexturesRequested = true;
 };
 
 class Renderer
@@ -437,6 +605,20 @@ private:
 	std::vector<std::unique_ptr<RenderProcess>> renderProcesses;
 
 	VkSemaphore swapChainImageAvailableSemaphore;
+	// signaled when the GPU is done with the frame submitted in this slot
+	std::vector<VkFence> frameFences;
+
+	// skinned each frame before the processes, see addSkinningNode()
+	std::vector<SkinningNode*> skinningNodes;
+	VkCommandPool frameCommandPool = VK_NULL_HANDLE;
+	// one per frame slot, recorded each frame with the commands to run before the processes
+	std::vector<VkCommandBuffer> frameCommandBuffers;
+
+	glm::vec2 windowSize;
+	// set by the resize callback, the swapchain is recreated before the next frame
+	bool swapChainOutOfDate = false;
+	// incremented at each submitProcesses(), frameIndex % frameInFlightCount is the slot of the per frame resources
+	uint32_t frameIndex = 0;
 
 public:
 	Renderer()
@@ -458,14 +640,44 @@ public:
 
 	}
 
+	// called from the GLFW callbacks, where the swapchain can't be recreated
 	void onWindowResized(float width, float height)
 	{
-		//TODO
+		windowSize = glm::vec2(width, height);
+		swapChainOutOfDate = true;
+	}
+
+	// Recreate the swapchain and the resources depending on it.
+	// Pipelines are untouched since viewport and scissor are dynamic states.
+	void recreateSwapChain()
+	{
+		// a minimized window has a zero size, wait until it is restored
+		int width = 0;
+		int height = 0;
+		glfwGetFramebufferSize(windowHandler.getWindow(), &width, &height);
+		while (width == 0 || height == 0)
+		{
+			glfwWaitEvents();
+			glfwGetFramebufferSize(windowHandler.getWindow(), &width, &height);
+		}
+		windowSize = glm::vec2(width, height);
+		swapChainOutOfDate = false;
+
+		vkDeviceWaitIdle(graphicsContext.getDevice());
+
+		// the old swapchain is given to the new one then destroyed
+		windowContext.createSwapChain(windowSize, graphicsContext.getPhysicalDevice(), graphicsContext.getDevice(), graphicsContext.getQueueFamilies());
+
+		for (auto& process : renderProcesses)
+		{
+			process->onSwapChainResized(windowContext);
+		}
 	}
 
 	void create()
 	{
 		glm::vec2 initialWindowSize(800, 600);
+		windowSize = initialWindowSize;
 		windowHandler.create(initialWindowSize, "Title");
 
 		graphicsContext.createInstance(renderSetup);
@@ -475,12 +687,66 @@ public:
 		graphicsContext.initQueueFamilies(graphicsContext.getPhysicalDevice(), windowContext.getSurface());
 		graphicsContext.createDevice(renderSetup);
 		graphicsContext.createCommandPool();
+		graphicsContext.createDescriptorAllocator(renderSetup.frameInFlightCount);
+		graphicsContext.createDescriptorSetLayoutCache();
+		graphicsContext.createBindlessTextureTable(renderSetup.frameInFlightCount);
+		graphicsContext.createMaterialParameterUploader(renderSetup.frameInFlightCount);
+		graphicsContext.createGeometryPools(renderSetup.frameInFlightCount);
+		graphicsContext.createBonePalette(renderSetup.frameInFlightCount);
+		createFrameFences();
+		createFrameCommands();
 		windowContext.createSwapChain(initialWindowSize, graphicsContext.getPhysicalDevice(), graphicsContext.getDevice(), graphicsContext.getQueueFamilies());
 	}
 
+	void createFrameFences()
+	{
+		VkFenceCreateInfo fenceInfo = {};
+		fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+		// nothing was submitted in the slots yet, the first wait must not block
+		fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+
+		frameFences.resize(renderSetup.frameInFlightCount);
+		for (auto& fence : frameFences)
+		{
+			if (vkCreateFence(graphicsContext.getDevice(), &fenceInfo, nullptr, &fence) != VK_SUCCESS)
+				throw std::runtime_error("failed to create frame fence !");
+		}
+	}
+
+	void createFrameCommands()
+	{
+		VkCommandPoolCreateInfo poolInfo = {};
+		poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+		poolInfo.queueFamilyIndex = graphicsContext.getQueueFamilies().graphicFamily;
+		poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT | VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+
+		CHECK_VK_THROW_ERROR(vkCreateCommandPool(graphicsContext.getDevice(), &poolInfo, nullptr, &frameCommandPool), "failed to create frame command pool !");
+
+		frameCommandBuffers.resize(renderSetup.frameInFlightCount);
+
+		VkCommandBufferAllocateInfo allocInfo = {};
+		allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+		allocInfo.commandPool = frameCommandPool;
+		allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+		allocInfo.commandBufferCount = static_cast<uint32_t>(frameCommandBuffers.size());
+
+		CHECK_VK_THROW_ERROR(vkAllocateCommandBuffers(graphicsContext.getDevice(), &allocInfo, frameCommandBuffers.data()), "failed to allocate frame command buffers !");
+	}
+
 	void destroy()
 	{
-		windowContext.destroy(graphicsContext.getInstance());
+		vkDeviceWaitIdle(graphicsContext.getDevice());
+		for (auto& fence : frameFences)
+			vkDestroyFence(graphicsContext.getDevice(), fence, nullptr);
+		frameFences.clear();
+
+		vkFreeCommandBuffers(graphicsContext.getDevice(), frameCommandPool, static_cast<uint32_t>(frameCommandBuffers.size()), frameCommandBuffers.data());
+		frameCommandBuffers.clear();
+		vkDestroyCommandPool(graphicsContext.getDevice(), frameCommandPool, nullptr);
+		frameCommandPool = VK_NULL_HANDLE;
+		skinningNodes.clear();
+
+		windowContext.destroy(graphicsContext.getInstance(), graphicsContext.getDevice());
 		graphicsContext.destroy();
 		windowHandler.destroy();
 	}
@@ -517,9 +783,79 @@ public:
 		}
 	}
 
-	// submit all process commands
+	// The node is begun in beginFrame() and its dispatches are submitted before the processes of each frame,
+	// call skinMesh() on it between beginFrame() and submitProcesses(). The node must outlive the renderer.
+	void addSkinningNode(SkinningNode& skinningNode)
+	{
+		skinningNodes.push_back(&skinningNode);
+	}
+
+	// Call before writing anything for the frame (bone palettes, transient descriptor sets, skinning...).
+	// Wait until the GPU is done with the last frame submitted in this slot, then recycle the resources of the slot.
+	// Return the slot, to give to the other per frame resources.
+	uint32_t beginFrame()
+	{
+		const uint32_t frameSlot = getFrameSlot();
+		vkWaitForFences(graphicsContext.getDevice(), 1, &frameFences[frameSlot], VK_TRUE, std::numeric_limits<uint64_t>::max());
+
+		// transient descriptor sets of this frame slot are not in use anymore
+		graphicsContext.getDescriptorAllocator().beginFrame(frameSlot);
+		// the material parameters are read from and uploaded to the copies of this frame slot
+		graphicsContext.getMaterialParameterUploader().beginFrame(frameSlot);
+		// the bone palettes written during the update go to this frame slot
+		graphicsContext.getBonePalette().beginFrame(frameSlot);
+		// bindless slots released in this frame slot can be reused
+		if (graphicsContext.getBindlessTextureTable() != nullptr)
+			graphicsContext.getBindlessTextureTable()->beginFrame(frameSlot);
+		// same for the geometry pool ranges of the meshes destroyed in this frame slot
+		graphicsContext.getGeometryPools().beginFrame(frameSlot);
+		// the meshes skinned from now go to this frame slot
+		for (SkinningNode* skinningNode : skinningNodes)
+			skinningNode->beginFrame(frameSlot);
+
+		return frameSlot;
+	}
+
+	// Record the skinning dispatches of the frame in the command buffer of the slot, the fence of the slot
+	// is signaled so it isn't in use anymore. Submitted on the graphics queue before the processes,
+	// queue order makes the barriers of SkinningNode::cmdDispatch() apply to their passes.
+	void submitFrameCommands(uint32_t frameSlot)
+	{
+		uint32_t dispatchCount = 0;
+		for (SkinningNode* skinningNode : skinningNodes)
+			dispatchCount += skinningNode->getDispatchCount();
+		if (dispatchCount == 0)
+			return;
+
+		VkCommandBuffer commandBuffer = frameCommandBuffers[frameSlot];
+
+		VkCommandBufferBeginInfo beginInfo = {};
+		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+		beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+		vkResetCommandBuffer(commandBuffer, 0);
+		vkBeginCommandBuffer(commandBuffer, &beginInfo);
+
+		for (SkinningNode* skinningNode : skinningNodes)
+			skinningNode->cmdDispatch(commandBuffer);
+
+		vkEndCommandBuffer(commandBuffer);
+
+		VkSubmitInfo submitInfo = {};
+		submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		submitInfo.commandBufferCount = 1;
+		submitInfo.pCommandBuffers = &commandBuffer;
+
+		CHECK_VK_THROW_ERROR(vkQueueSubmit(graphicsContext.getGraphicsQueue(), 1, &submitInfo, VK_NULL_HANDLE), "failed to submit frame commands !");
+	}
+
+	// submit all process commands, beginFrame() must have been called for this frame
 	void submitProcesses()
 	{
+		const uint32_t frameSlot = getFrameSlot();
+
+		if (swapChainOutOfDate)
+			recreateSwapChain();
+
 		// acquire image
 		if (renderSetup.validationLayersEnabled)
 			vkDeviceWaitIdle(graphicsContext.getDevice());
@@ -528,6 +864,7 @@ public:
 		VkResult result = vkAcquireNextImageKHR(graphicsContext.getDevice(), windowContext.getSwapChain(), std::numeric_limits<uint64_t>::max(), swapChainImageAvailableSemaphore, VK_NULL_HANDLE, &imageIndex);
 		if (result == VK_ERROR_OUT_OF_DATE_KHR)
 		{
+			// nothing submitted : the slot fence stays signaled and the frame is done again in this slot
 			recreateSwapChain();
 			return;
 		}
@@ -536,17 +873,31 @@ public:
 			throw std::runtime_error("failed to acquire swap chain image !");
 		}
 
+		// reset right before submitting so an early return can't leave the fence unsignaled
+		vkResetFences(graphicsContext.getDevice(), 1, &frameFences[frameSlot]);
+
+		// upload the material parameters modified since this slot was last used, the staging buffer of the slot is free
+		graphicsContext.getMaterialParameterUploader().flush();
+		// the passes draw the skinned vertices of this frame
+		submitFrameCommands(frameSlot);
+
 		std::vector<VkSemaphore> presentWaitSemaphores;
 		// submit all processes
 		for (auto& process : renderProcesses)
 		{
-			process->submitCommands(graphicsContext.getGraphicsQueue());
+			process->submitCommands(graphicsContext.getGraphicsQueue(), imageIndex);
 
 			std::vector<VkSemaphore> lastSemaphores;
 			process->extractLastSemaphores(lastSemaphores);
 			presentWaitSemaphores.insert(presentWaitSemaphores.end(), lastSemaphores.begin(), lastSemaphores.end());
 		}
 
+		// an empty submission signals the fence once all the work submitted before it is done :
+		// uploads, skinning and every process of the frame
+		if (vkQueueSubmit(graphicsContext.getGraphicsQueue(), 0, nullptr, frameFences[frameSlot]) != VK_SUCCESS)
+			throw std::runtime_error("failed to submit frame fence !");
+		frameIndex++;
+
 		// present image
 		VkPresentInfoKHR presentInfo = {};
 		presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
@@ -629,4 +980,9 @@ public:
 	{
 		return windowContext;
 	}
+
+	uint32_t getFrameSlot() const
+	{
+		return frameIndex % renderSetup.frameInFlightCount;
+	}
 };
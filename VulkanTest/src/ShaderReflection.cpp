@@ -0,0 +1,541 @@
+#include "ShaderReflection.h"
+#include "VulkanUtils.h"
+
+#include <algorithm>
+#include <cstring>
+#include <unordered_map>
+
+namespace
+{
+	const uint32_t SpirvMagicNumber = 0x07230203;
+	const uint32_t SpirvHeaderWordCount = 5;
+
+	// opcodes
+	const uint32_t OpName = 5;
+	const uint32_t OpTypeInt = 21;
+	const uint32_t OpTypeFloat = 22;
+	const uint32_t OpTypeVector = 23;
+	const uint32_t OpTypeMatrix = 24;
+	const uint32_t OpTypeImage = 25;
+	const uint32_t OpTypeSampler = 26;
+	const uint32_t OpTypeSampledImage = 27;
+	const uint32_t OpTypeArray = 28;
+	const uint32_t OpTypeRuntimeArray = 29;
+	const uint32_t OpTypeStruct = 30;
+	const uint32_t OpTypePointer = 32;
+	const uint32_t OpConstant = 43;
+	const uint32_t OpFunction = 54;
+	const uint32_t OpFunctionCall = 57;
+	const uint32_t OpVariable = 59;
+	const uint32_t OpImageTexelPointer = 60;
+	const uint32_t OpLoad = 61;
+	const uint32_t OpStore = 62;
+	const uint32_t OpCopyMemory = 63;
+	const uint32_t OpCopyMemorySized = 64;
+	const uint32_t OpAccessChain = 65;
+	const uint32_t OpInBoundsAccessChain = 66;
+	const uint32_t OpPtrAccessChain = 67;
+	const uint32_t OpArrayLength = 68;
+	const uint32_t OpInBoundsPtrAccessChain = 70;
+	const uint32_t OpDecorate = 71;
+	const uint32_t OpMemberDecorate = 72;
+	const uint32_t OpCopyObject = 83;
+	const uint32_t OpAtomicLoad = 227;
+	const uint32_t OpAtomicStore = 228;
+	const uint32_t OpAtomicXor = 242;
+
+	// decorations
+	const uint32_t DecorationBlock = 2;
+	const uint32_t DecorationBufferBlock = 3;
+	const uint32_t DecorationArrayStride = 6;
+	const uint32_t DecorationMatrixStride = 7;
+	const uint32_t DecorationBinding = 33;
+	const uint32_t DecorationDescriptorSet = 34;
+	const uint32_t DecorationOffset = 35;
+
+	// storage classes
+	const uint32_t StorageClassUniformConstant = 0;
+	const uint32_t StorageClassUniform = 2;
+	const uint32_t StorageClassPushConstant = 9;
+	const uint32_t StorageClassStorageBuffer = 12;
+
+	// image dimensions
+	const uint32_t DimBuffer = 5;
+	const uint32_t DimSubpassData = 6;
+
+	const uint32_t InvalidValue = ~0u;
+	const uint32_t MaxTypeDepth = 64;
+
+	struct SpirvMemberInfo
+	{
+		uint32_t offset = 0;
+		uint32_t matrixStride = 0;
+	};
+
+	struct SpirvIdInfo
+	{
+		uint32_t opcode = 0;
+		// first operand word of the defining instruction
+		const uint32_t* operands = nullptr;
+		uint32_t operandCount = 0;
+
+		uint32_t set = InvalidValue;
+		uint32_t binding = InvalidValue;
+		uint32_t arrayStride = 0;
+		bool isBlock = false;
+		bool isBufferBlock = false;
+		bool isReferenced = false;
+		std::string name;
+		std::vector<SpirvMemberInfo> members;
+	};
+
+	class SpirvModule
+	{
+	public:
+		std::vector<SpirvIdInfo> ids;
+		std::vector<uint32_t> variables;
+
+		void parse(const uint32_t* words, size_t wordCount)
+		{
+			CHECK_TRUE_THROW_ERROR(wordCount >= SpirvHeaderWordCount && words[0] == SpirvMagicNumber, "invalid SPIR-V code !");
+
+			// each id is defined by an instruction of at least two words
+			const uint32_t idBound = words[3];
+			CHECK_TRUE_THROW_ERROR(idBound <= wordCount, "invalid SPIR-V id bound !");
+			ids.resize(idBound);
+
+			bool insideFunctions = false;
+			size_t wordIndex = SpirvHeaderWordCount;
+			while (wordIndex < wordCount)
+			{
+				const uint32_t opcode = words[wordIndex] & 0xFFFF;
+				const uint32_t instructionWordCount = words[wordIndex] >> 16;
+				CHECK_TRUE_THROW_ERROR(instructionWordCount > 0 && wordIndex + instructionWordCount <= wordCount, "invalid SPIR-V instruction !");
+
+				const uint32_t* operands = words + wordIndex + 1;
+				const uint32_t operandCount = instructionWordCount - 1;
+
+				if (opcode == OpFunction)
+					insideFunctions = true;
+
+				if (insideFunctions)
+					parseVariableUses(opcode, operands, operandCount);
+				else
+					parseDeclaration(opcode, operands, operandCount);
+
+				wordIndex += instructionWordCount;
+			}
+		}
+
+		const SpirvIdInfo& getId(uint32_t id) const
+		{
+			CHECK_TRUE_THROW_ERROR(id < ids.size(), "SPIR-V id out of bounds !");
+			return ids[id];
+		}
+
+		// the defining instruction of a type or a constant, with at least the given operands
+		const SpirvIdInfo& getDefinition(uint32_t id, uint32_t minOperandCount) const
+		{
+			const SpirvIdInfo& info = getId(id);
+			CHECK_TRUE_THROW_ERROR(info.operands != nullptr && info.operandCount >= minOperandCount, "SPIR-V id used before its definition !");
+			return info;
+		}
+
+		uint32_t getConstantValue(uint32_t id) const
+		{
+			const SpirvIdInfo& info = getId(id);
+			return info.opcode == OpConstant ? info.operands[2] : 1;
+		}
+
+		// size of a type inside a buffer using the explicit offsets and strides of the shader
+		uint32_t computeTypeSize(uint32_t typeId, uint32_t matrixStride = 0, uint32_t depth = 0) const
+		{
+			// types are declared before their use, a deeper nesting is a type cycle
+			CHECK_TRUE_THROW_ERROR(depth < MaxTypeDepth, "invalid SPIR-V type nesting !");
+			const SpirvIdInfo& type = getDefinition(typeId, 1);
+			switch (type.opcode)
+			{
+			case OpTypeInt:
+			case OpTypeFloat:
+				return type.operands[1] / 8;
+			case OpTypeVector:
+				return type.operands[2] * computeTypeSize(type.operands[1], 0, depth + 1);
+			case OpTypeMatrix:
+				return type.operands[2] * (matrixStride != 0 ? matrixStride : computeTypeSize(type.operands[1], 0, depth + 1));
+			case OpTypeArray:
+			{
+				uint32_t length = getConstantValue(type.operands[2]);
+				uint32_t stride = type.arrayStride != 0 ? type.arrayStride : computeTypeSize(type.operands[1], matrixStride, depth + 1);
+				return length * stride;
+			}
+			case OpTypeStruct:
+			{
+				uint32_t size = 0;
+				for (uint32_t member = 0; member + 1 < type.operandCount; member++)
+				{
+					const SpirvMemberInfo memberInfo = member < type.members.size() ? type.members[member] : SpirvMemberInfo();
+					size = std::max(size, memberInfo.offset + computeTypeSize(type.operands[member + 1], memberInfo.matrixStride, depth + 1));
+				}
+				return size;
+			}
+			default:
+				return 0;
+			}
+		}
+
+	private:
+		SpirvIdInfo& getMutableId(uint32_t id)
+		{
+			CHECK_TRUE_THROW_ERROR(id < ids.size(), "SPIR-V id out of bounds !");
+			return ids[id];
+		}
+
+		SpirvMemberInfo& getMember(uint32_t structId, uint32_t member)
+		{
+			auto& members = getMutableId(structId).members;
+			// members are bounded by the instruction size limit
+			CHECK_TRUE_THROW_ERROR(member < 0xFFFF, "invalid SPIR-V struct member !");
+			if (members.size() <= member)
+				members.resize(member + 1);
+
+			return members[member];
+		}
+
+		void define(uint32_t id, uint32_t opcode, const uint32_t* operands, uint32_t operandCount)
+		{
+			SpirvIdInfo& info = getMutableId(id);
+			info.opcode = opcode;
+			info.operands = operands;
+			info.operandCount = operandCount;
+		}
+
+		// smallest operand count of the declarations read by the reflection, 0 for the ignored ones
+		static uint32_t getMinOperandCount(uint32_t opcode)
+		{
+			switch (opcode)
+			{
+			case OpName: return 1;
+			case OpDecorate: return 2;
+			case OpMemberDecorate: return 3;
+			case OpTypeSampler: return 1;
+			case OpTypeStruct: return 1;
+			case OpTypeFloat: return 2;
+			case OpTypeSampledImage: return 2;
+			case OpTypeRuntimeArray: return 2;
+			case OpTypeInt: return 3;
+			case OpTypeVector: return 3;
+			case OpTypeMatrix: return 3;
+			case OpTypeArray: return 3;
+			case OpTypePointer: return 3;
+			case OpConstant: return 3;
+			case OpVariable: return 3;
+			// sampled type, dim, depth, arrayed, multisampled, sampled, format
+			case OpTypeImage: return 8;
+			default: return 0;
+			}
+		}
+
+		void parseDeclaration(uint32_t opcode, const uint32_t* operands, uint32_t operandCount)
+		{
+			CHECK_TRUE_THROW_ERROR(operandCount >= getMinOperandCount(opcode), "truncated SPIR-V instruction !");
+
+			switch (opcode)
+			{
+			case OpName:
+			{
+				// the literal string must end inside the instruction
+				const char* name = reinterpret_cast<const char*>(operands + 1);
+				const size_t maxLength = (operandCount - 1) * sizeof(uint32_t);
+				getMutableId(operands[0]).name.assign(name, std::find(name, name + maxLength, '\0'));
+				break;
+			}
+			case OpDecorate:
+			{
+				SpirvIdInfo& target = getMutableId(operands[0]);
+				const bool hasValue = operandCount >= 3;
+				switch (operands[1])
+				{
+				case DecorationBlock: target.isBlock = true; break;
+				case DecorationBufferBlock: target.isBufferBlock = true; break;
+				case DecorationArrayStride: CHECK_TRUE_THROW_ERROR(hasValue, "truncated SPIR-V decoration !"); target.arrayStride = operands[2]; break;
+				case DecorationBinding: CHECK_TRUE_THROW_ERROR(hasValue, "truncated SPIR-V decoration !"); target.binding = operands[2]; break;
+				case DecorationDescriptorSet: CHECK_TRUE_THROW_ERROR(hasValue, "truncated SPIR-V decoration !"); target.set = operands[2]; break;
+				default: break;
+				}
+				break;
+			}
+			case OpMemberDecorate:
+				if (operands[2] != DecorationOffset && operands[2] != DecorationMatrixStride)
+					break;
+				CHECK_TRUE_THROW_ERROR(operandCount >= 4, "truncated SPIR-V decoration !");
+				if (operands[2] == DecorationOffset)
+					getMember(operands[0], operands[1]).offset = operands[3];
+				else
+					getMember(operands[0], operands[1]).matrixStride = operands[3];
+				break;
+			case OpTypeInt:
+			case OpTypeFloat:
+			case OpTypeVector:
+			case OpTypeMatrix:
+			case OpTypeImage:
+			case OpTypeSampler:
+			case OpTypeSampledImage:
+			case OpTypeArray:
+			case OpTypeRuntimeArray:
+			case OpTypeStruct:
+			case OpTypePointer:
+				// result id is the first operand of type declarations
+				define(operands[0], opcode, operands, operandCount);
+				break;
+			case OpConstant:
+			case OpVariable:
+				// result id is the second operand, after the result type
+				define(operands[1], opcode, operands, operandCount);
+				if (opcode == OpVariable)
+					variables.push_back(operands[1]);
+				break;
+			default:
+				break;
+			}
+		}
+
+		void markReferenced(uint32_t id)
+		{
+			if (id < ids.size())
+				ids[id].isReferenced = true;
+		}
+
+		// Functions use global variables through pointer operands : only these id operands are
+		// marked, literals and other operands can hold any value.
+		void parseVariableUses(uint32_t opcode, const uint32_t* operands, uint32_t operandCount)
+		{
+			switch (opcode)
+			{
+			case OpStore:
+			case OpAtomicStore:
+				// pointer, object
+				if (operandCount >= 1)
+					markReferenced(operands[0]);
+				break;
+			case OpCopyMemory:
+			case OpCopyMemorySized:
+				// target, source
+				if (operandCount >= 2)
+				{
+					markReferenced(operands[0]);
+					markReferenced(operands[1]);
+				}
+				break;
+			case OpLoad:
+			case OpAccessChain:
+			case OpInBoundsAccessChain:
+			case OpPtrAccessChain:
+			case OpInBoundsPtrAccessChain:
+			case OpArrayLength:
+			case OpImageTexelPointer:
+			case OpCopyObject:
+				// result type, result id, pointer
+				if (operandCount >= 3)
+					markReferenced(operands[2]);
+				break;
+			case OpFunctionCall:
+				// result type, result id, function, arguments
+				for (uint32_t i = 3; i < operandCount; i++)
+					markReferenced(operands[i]);
+				break;
+			default:
+				// result type, result id, pointer
+				if (opcode >= OpAtomicLoad && opcode <= OpAtomicXor && operandCount >= 3)
+					markReferenced(operands[2]);
+				break;
+			}
+		}
+	};
+
+	// return false if the type can't be bound with a descriptor
+	bool getDescriptorInfos(const SpirvModule& module, uint32_t storageClass, uint32_t typeId, VkDescriptorType& outType, uint32_t& outCount)
+	{
+		// unwrap arrays of descriptors
+		outCount = 1;
+		const SpirvIdInfo* type = &module.getDefinition(typeId, 1);
+		if (type->opcode == OpTypeArray)
+		{
+			outCount = module.getConstantValue(type->operands[2]);
+			type = &module.getDefinition(type->operands[1], 1);
+		}
+		else if (type->opcode == OpTypeRuntimeArray)
+		{
+			outCount = 0;
+			type = &module.getDefinition(type->operands[1], 1);
+		}
+
+		if (storageClass == StorageClassStorageBuffer)
+		{
+			outType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+			return true;
+		}
+
+		if (storageClass == StorageClassUniform)
+		{
+			outType = type->isBufferBlock ? VK_DESCRIPTOR_TYPE_STORAGE_BUFFER : VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+			return true;
+		}
+
+		switch (type->opcode)
+		{
+		case OpTypeSampler:
+			outType = VK_DESCRIPTOR_TYPE_SAMPLER;
+			return true;
+		case OpTypeSampledImage:
+			outType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+			return true;
+		case OpTypeImage:
+		{
+			const uint32_t dim = type->operands[2];
+			const uint32_t sampled = type->operands[6];
+			if (dim == DimSubpassData)
+				outType = VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
+			else if (dim == DimBuffer)
+				outType = sampled == 2 ? VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER : VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER;
+			else
+				outType = sampled == 2 ? VK_DESCRIPTOR_TYPE_STORAGE_IMAGE : VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+			return true;
+		}
+		default:
+			return false;
+		}
+	}
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/////////// ShaderReflectionData
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void ShaderReflectionData::getSetBindings(uint32_t set, std::vector<ReflectedDescriptorBinding>& outBindings) const
+{
+	outBindings.clear();
+	for (const auto& binding : bindings)
+	{
+		if (binding.set == set)
+			outBindings.push_back(binding);
+	}
+
+	std::sort(outBindings.begin(), outBindings.end(), [](const ReflectedDescriptorBinding& a, const ReflectedDescriptorBinding& b) { return a.binding < b.binding; });
+}
+
+const ReflectedDescriptorBinding* ShaderReflectionData::findBinding(uint32_t set, uint32_t binding) const
+{
+	for (const auto& reflectedBinding : bindings)
+	{
+		if (reflectedBinding.set == set && reflectedBinding.binding == binding)
+			return &reflectedBinding;
+	}
+
+	return nullptr;
+}
+
+uint32_t ShaderReflectionData::getSetCount() const
+{
+	uint32_t setCount = 0;
+	for (const auto& binding : bindings)
+		setCount = std::max(setCount, binding.set + 1);
+
+	return setCount;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/////////// SpirvReflection
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void SpirvReflection::reflect(const std::vector<char>& code, VkShaderStageFlagBits stage, ShaderReflectionData& outData)
+{
+	CHECK_TRUE_THROW_ERROR(code.size() % sizeof(uint32_t) == 0 && code.size() >= SpirvHeaderWordCount * sizeof(uint32_t), "invalid SPIR-V code size !");
+
+	// the char buffer may not be aligned for uint32_t reads
+	std::vector<uint32_t> words(code.size() / sizeof(uint32_t));
+	memcpy(words.data(), code.data(), code.size());
+
+	SpirvModule module;
+	module.parse(words.data(), words.size());
+
+	outData.bindings.clear();
+	outData.pushConstantRanges.clear();
+
+	for (uint32_t variableId : module.variables)
+	{
+		const SpirvIdInfo& variable = module.ids[variableId];
+		if (!variable.isReferenced)
+			continue;
+
+		const uint32_t storageClass = variable.operands[2];
+		const SpirvIdInfo& pointerType = module.getDefinition(variable.operands[0], 3);
+		CHECK_TRUE_THROW_ERROR(pointerType.opcode == OpTypePointer, "SPIR-V variable type is not a pointer !");
+		const uint32_t typeId = pointerType.operands[2];
+
+		if (storageClass == StorageClassPushConstant)
+		{
+			const SpirvIdInfo& blockType = module.getDefinition(typeId, 1);
+			uint32_t firstOffset = ~0u;
+			for (const auto& member : blockType.members)
+				firstOffset = std::min(firstOffset, member.offset);
+			if (blockType.members.empty())
+				firstOffset = 0;
+
+			VkPushConstantRange range = {};
+			range.stageFlags = stage;
+			range.offset = firstOffset & ~3u;
+			range.size = computeAlignedSize(module.computeTypeSize(typeId) - range.offset, 4);
+			outData.pushConstantRanges.push_back(range);
+			continue;
+		}
+
+		if (storageClass != StorageClassUniformConstant && storageClass != StorageClassUniform && storageClass != StorageClassStorageBuffer)
+			continue;
+
+		if (variable.set == InvalidValue || variable.binding == InvalidValue)
+			continue;
+
+		ReflectedDescriptorBinding reflectedBinding = {};
+		if (!getDescriptorInfos(module, storageClass, typeId, reflectedBinding.descriptorType, reflectedBinding.descriptorCount))
+			continue;
+
+		reflectedBinding.set = variable.set;
+		reflectedBinding.binding = variable.binding;
+		reflectedBinding.stageFlags = stage;
+		reflectedBinding.name = variable.name.empty() ? module.ids[typeId].name : variable.name;
+		outData.bindings.push_back(reflectedBinding);
+	}
+}
+
+void SpirvReflection::merge(const ShaderReflectionData& stageData, ShaderReflectionData& inOutPipelineData)
+{
+	for (const auto& binding : stageData.bindings)
+	{
+		auto found = std::find_if(inOutPipelineData.bindings.begin(), inOutPipelineData.bindings.end(), [&binding](const ReflectedDescriptorBinding& other) {
+			return other.set == binding.set && other.binding == binding.binding;
+		});
+
+		if (found == inOutPipelineData.bindings.end())
+		{
+			inOutPipelineData.bindings.push_back(binding);
+		}
+		else
+		{
+			CHECK_TRUE_THROW_ERROR(found->descriptorType == binding.descriptorType, "shader stages declare different descriptor types for the same binding !");
+			found->stageFlags |= binding.stageFlags;
+			found->descriptorCount = std::max(found->descriptorCount, binding.descriptorCount);
+		}
+	}
+
+	for (const auto& range : stageData.pushConstantRanges)
+	{
+		auto found = std::find_if(inOutPipelineData.pushConstantRanges.begin(), inOutPipelineData.pushConstantRanges.end(), [&range](const VkPushConstantRange& other) {
+			return other.offset == range.offset && other.size == range.size;
+		});
+
+		if (found == inOutPipelineData.pushConstantRanges.end())
+			inOutPipelineData.pushConstantRanges.push_back(range);
+		else
+			found->stageFlags |= range.stageFlags;
+	}
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <vulkan/vulkan.hpp>
+
+#include <string>
+#include <vector>
+
+// A descriptor binding declared by a shader
+struct ReflectedDescriptorBinding
+{
+	uint32_t set;
+	uint32_t binding;
+	VkDescriptorType descriptorType;
+	// 0 for runtime sized arrays
+	uint32_t descriptorCount;
+	VkShaderStageFlags stageFlags;
+	std::string name;
+};
+
+// Descriptors and push constants of one or several shader stages
+struct ShaderReflectionData
+{
+	std::vector<ReflectedDescriptorBinding> bindings;
+	std::vector<VkPushConstantRange> pushConstantRanges;
+
+	// bindings of the given set, sorted by binding number
+	void getSetBindings(uint32_t set, std::vector<ReflectedDescriptorBinding>& outBindings) const;
+	const ReflectedDescriptorBinding* findBinding(uint32_t set, uint32_t binding) const;
+	uint32_t getSetCount() const;
+};
+
+// Minimal SPIR-V parser, only reads what is needed to build descriptor set and pipeline layouts.
+// Resources declared but never referenced by a function are ignored, so a stage only appears
+// in the stage mask of the bindings it really uses.
+class SpirvReflection
+{
+public:
+	// throw if the code is not valid SPIR-V
+	static void reflect(const std::vector<char>& code, VkShaderStageFlagBits stage, ShaderReflectionData& outData);
+
+	// merge the reflections of all stages of a pipeline : stage masks of shared bindings are combined
+	static void merge(const ShaderReflectionData& stageData, ShaderReflectionData& inOutPipelineData);
+};
@@ -0,0 +1,470 @@
+#include "SkeletalAnimation.h"
+
+#include "AnimationCompression.h"
+#include "AnimationFile.h"
+
+#include <algorithm>
+#include <iterator>
+#include <stdexcept>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SKELETAL_ANIMATION_SSE
+#include <emmintrin.h>
+#endif
+
+const uint32_t SkeletalAnimation::MAX_CURSOR_STEPS;
+
+namespace
+{
+	// key k such as keysTime[k] <= time < keysTime[k + 1], clamped to the first and last keys
+	uint32_t searchKeyIndex(const std::vector<float>& keysTime, float time)
+	{
+		const uint32_t upperKey = static_cast<uint32_t>(std::upper_bound(keysTime.begin(), keysTime.end(), time) - keysTime.begin());
+		return upperKey > 0 ? upperKey - 1 : 0;
+	}
+
+	float computeKeyAlpha(const std::vector<float>& keysTime, uint32_t keyIndex, float time)
+	{
+		if (keyIndex + 1 >= keysTime.size())
+			return 0.f;
+
+		const float keyDuration = keysTime[keyIndex + 1] - keysTime[keyIndex];
+		return glm::clamp((time - keysTime[keyIndex]) / keyDuration, 0.f, 1.f);
+	}
+
+	template<typename ValueType, typename InterpolateFunction>
+	std::vector<ValueType> resampleTrack(const std::vector<float>& trackKeysTime, const std::vector<ValueType>& trackValues, const std::vector<float>& keysTime, InterpolateFunction interpolate)
+	{
+		std::vector<ValueType> values(keysTime.size());
+		for (size_t i = 0; i < keysTime.size(); i++)
+		{
+			const uint32_t keyIndex = searchKeyIndex(trackKeysTime, keysTime[i]);
+			const uint32_t nextKeyIndex = std::min(keyIndex + 1, static_cast<uint32_t>(trackKeysTime.size()) - 1);
+			values[i] = interpolate(trackValues[keyIndex], trackValues[nextKeyIndex], computeKeyAlpha(trackKeysTime, keyIndex, keysTime[i]));
+		}
+		return values;
+	}
+
+	// Polynomial estimate of sin(t * angle) / sin(angle) from cos(angle), for an angle in [0, pi/2]
+	// (David Eberly, A Fast and Accurate Estimate for SLERP). coefficients[i] = u[i] * t^2 - v[i].
+	const uint32_t SLERP_TERM_COUNT = 8;
+	const float SLERP_ONE_PLUS_MU = 1.90110745351730037f;
+	const float SLERP_U[SLERP_TERM_COUNT] = { 1.f / (1 * 3), 1.f / (2 * 5), 1.f / (3 * 7), 1.f / (4 * 9), 1.f / (5 * 11), 1.f / (6 * 13), 1.f / (7 * 15), SLERP_ONE_PLUS_MU / (8 * 17) };
+	const float SLERP_V[SLERP_TERM_COUNT] = { 1.f / 3, 2.f / 5, 3.f / 7, 4.f / 9, 5.f / 11, 6.f / 13, 7.f / 15, SLERP_ONE_PLUS_MU * 8 / 17 };
+
+	void computeSlerpCoefficients(float t, float* outCoefficients)
+	{
+		for (uint32_t i = 0; i < SLERP_TERM_COUNT; i++)
+			outCoefficients[i] = SLERP_U[i] * t * t - SLERP_V[i];
+	}
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/////////// SkeletalAnimation
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void SkeletalAnimation::create(float _duration, float _ticksPerSecond, std::vector<float> _keysTime, std::vector<std::vector<glm::quat>> _bonesRotation, std::vector<std::vector<glm::vec3>> _bonesTranslation)
+{
+	if (_keysTime.empty())
+		throw std::runtime_error("an animation needs at least one key !");
+	if (!std::is_sorted(_keysTime.begin(), _keysTime.end()))
+		throw std::runtime_error("animation keys must be sorted by time !");
+	if (_bonesRotation.size() != _bonesTranslation.size())
+		throw std::runtime_error("animation rotation and translation bone counts differ !");
+	for (size_t boneIndex = 0; boneIndex < _bonesRotation.size(); boneIndex++)
+	{
+		if (_bonesRotation[boneIndex].size() != _keysTime.size() || _bonesTranslation[boneIndex].size() != _keysTime.size())
+			throw std::runtime_error("each animated bone needs a value per key !");
+	}
+
+	duration = _duration;
+	ticksPerSecond = _ticksPerSecond;
+	keysTime = std::move(_keysTime);
+	boneCount = static_cast<uint32_t>(_bonesRotation.size());
+	paddedBoneCount = AnimationPose::computePaddedBoneCount(boneCount);
+	compressed = false;
+	compressedKeyStreams.clear();
+	translationRanges.clear();
+
+	// bone major to key major, padding bones keep the identity
+	keyStreams.assign(keysTime.size() * AnimationPose::STREAM_COUNT * paddedBoneCount, 0.f);
+	for (uint32_t keyIndex = 0; keyIndex < keysTime.size(); keyIndex++)
+	{
+		float* keyData = keyStreams.data() + keyIndex * AnimationPose::STREAM_COUNT * paddedBoneCount;
+		std::fill(keyData + AnimationPose::STREAM_ROTATION_W * paddedBoneCount, keyData + (AnimationPose::STREAM_ROTATION_W + 1) * paddedBoneCount, 1.f);
+		for (uint32_t boneIndex = 0; boneIndex < boneCount; boneIndex++)
+		{
+			const glm::quat& rotation = _bonesRotation[boneIndex][keyIndex];
+			const glm::vec3& translation = _bonesTranslation[boneIndex][keyIndex];
+			keyData[AnimationPose::STREAM_ROTATION_X * paddedBoneCount + boneIndex] = rotation.x;
+			keyData[AnimationPose::STREAM_ROTATION_Y * paddedBoneCount + boneIndex] = rotation.y;
+			keyData[AnimationPose::STREAM_ROTATION_Z * paddedBoneCount + boneIndex] = rotation.z;
+			keyData[AnimationPose::STREAM_ROTATION_W * paddedBoneCount + boneIndex] = rotation.w;
+			keyData[AnimationPose::STREAM_TRANSLATION_X * paddedBoneCount + boneIndex] = translation.x;
+			keyData[AnimationPose::STREAM_TRANSLATION_Y * paddedBoneCount + boneIndex] = translation.y;
+			keyData[AnimationPose::STREAM_TRANSLATION_Z * paddedBoneCount + boneIndex] = translation.z;
+		}
+	}
+}
+
+void SkeletalAnimation::createFromTracks(float _duration, float _ticksPerSecond
+	, const std::vector<float>& rotationKeysTime, const std::vector<std::vector<glm::quat>>& _bonesRotation
+	, const std::vector<float>& translationKeysTime, const std::vector<std::vector<glm::vec3>>& _bonesTranslation)
+{
+	if (rotationKeysTime.empty() || translationKeysTime.empty())
+		throw std::runtime_error("an animation needs at least one key !");
+	if (_bonesRotation.size() != _bonesTranslation.size())
+		throw std::runtime_error("animation rotation and translation bone counts differ !");
+
+	std::vector<float> mergedKeysTime;
+	mergedKeysTime.reserve(rotationKeysTime.size() + translationKeysTime.size());
+	std::merge(rotationKeysTime.begin(), rotationKeysTime.end(), translationKeysTime.begin(), translationKeysTime.end(), std::back_inserter(mergedKeysTime));
+	mergedKeysTime.erase(std::unique(mergedKeysTime.begin(), mergedKeysTime.end()), mergedKeysTime.end());
+
+	std::vector<std::vector<glm::quat>> mergedBonesRotation(_bonesRotation.size());
+	std::vector<std::vector<glm::vec3>> mergedBonesTranslation(_bonesTranslation.size());
+	for (size_t boneIndex = 0; boneIndex < _bonesRotation.size(); boneIndex++)
+	{
+		if (_bonesRotation[boneIndex].size() != rotationKeysTime.size() || _bonesTranslation[boneIndex].size() != translationKeysTime.size())
+			throw std::runtime_error("each animated bone needs a value per key !");
+
+		mergedBonesRotation[boneIndex] = resampleTrack(rotationKeysTime, _bonesRotation[boneIndex], mergedKeysTime
+			, [](const glm::quat& a, const glm::quat& b, float alpha) { return glm::slerp(a, b, alpha); });
+		mergedBonesTranslation[boneIndex] = resampleTrack(translationKeysTime, _bonesTranslation[boneIndex], mergedKeysTime
+			, [](const glm::vec3& a, const glm::vec3& b, float alpha) { return glm::mix(a, b, alpha); });
+	}
+
+	create(_duration, _ticksPerSecond, std::move(mergedKeysTime), std::move(mergedBonesRotation), std::move(mergedBonesTranslation));
+}
+
+void SkeletalAnimation::loadFromFile(const AnimationFileView& file)
+{
+	const uint32_t keyCount = file.getKeyCount();
+	duration = file.getDuration();
+	ticksPerSecond = file.getTicksPerSecond();
+	keysTime.assign(file.getKeysTime(), file.getKeysTime() + keyCount);
+	boneCount = file.getBoneCount();
+	paddedBoneCount = file.getPaddedBoneCount();
+	keyStreams.clear();
+
+	compressed = true;
+	compressedKeyStreams.assign(file.getKeyStreams(), file.getKeyStreams() + keyCount * COMPRESSED_STREAM_COUNT * paddedBoneCount);
+	translationRanges.assign(file.getTranslationRanges(), file.getTranslationRanges() + TRANSLATION_RANGE_STREAM_COUNT * paddedBoneCount);
+}
+
+uint32_t SkeletalAnimation::findKeyIndex(float animationTime, uint32_t& inOutCursor, float& outKeyAlpha) const
+{
+	const uint32_t lastKeyIndex = static_cast<uint32_t>(keysTime.size()) - 1;
+
+	// playing forward moves the cursor by a few keys at most
+	uint32_t keyIndex = inOutCursor;
+	if (keyIndex <= lastKeyIndex && keysTime[keyIndex] <= animationTime)
+	{
+		const uint32_t lastTriedKeyIndex = std::min(lastKeyIndex, keyIndex + MAX_CURSOR_STEPS);
+		while (keyIndex < lastTriedKeyIndex && keysTime[keyIndex + 1] <= animationTime)
+			keyIndex++;
+
+		if (keyIndex == lastKeyIndex || animationTime < keysTime[keyIndex + 1])
+		{
+			inOutCursor = keyIndex;
+			outKeyAlpha = computeKeyAlpha(keysTime, keyIndex, animationTime);
+			return keyIndex;
+		}
+	}
+
+	// seek, loop or time going backward
+	keyIndex = searchKeyIndex(keysTime, animationTime);
+	inOutCursor = keyIndex;
+	outKeyAlpha = computeKeyAlpha(keysTime, keyIndex, animationTime);
+	return keyIndex;
+}
+
+uint32_t SkeletalAnimation::findKeyIndex(float animationTime, float& outKeyAlpha) const
+{
+	const uint32_t keyIndex = searchKeyIndex(keysTime, animationTime);
+	outKeyAlpha = computeKeyAlpha(keysTime, keyIndex, animationTime);
+	return keyIndex;
+}
+
+glm::quat SkeletalAnimation::getRotation(uint32_t boneIndex, uint32_t keyIndex) const
+{
+	if (compressed)
+	{
+		const uint16_t words[3] = { getCompressedKeyStream(keyIndex, COMPRESSED_STREAM_ROTATION_0)[boneIndex]
+			, getCompressedKeyStream(keyIndex, COMPRESSED_STREAM_ROTATION_1)[boneIndex], getCompressedKeyStream(keyIndex, COMPRESSED_STREAM_ROTATION_2)[boneIndex] };
+		return unpackSmallestThree(words);
+	}
+
+	return glm::quat(getKeyStream(keyIndex, AnimationPose::STREAM_ROTATION_W)[boneIndex], getKeyStream(keyIndex, AnimationPose::STREAM_ROTATION_X)[boneIndex]
+		, getKeyStream(keyIndex, AnimationPose::STREAM_ROTATION_Y)[boneIndex], getKeyStream(keyIndex, AnimationPose::STREAM_ROTATION_Z)[boneIndex]);
+}
+
+glm::vec3 SkeletalAnimation::getTranslation(uint32_t boneIndex, uint32_t keyIndex) const
+{
+	if (compressed)
+	{
+		glm::vec3 translation;
+		for (uint32_t axis = 0; axis < 3; axis++)
+		{
+			translation[axis] = dequantizeRangeNormalized(getCompressedKeyStream(keyIndex, static_cast<CompressedStream>(COMPRESSED_STREAM_TRANSLATION_X + axis))[boneIndex]
+				, getTranslationRange(static_cast<TranslationRangeStream>(TRANSLATION_RANGE_MIN_X + axis))[boneIndex], getTranslationRange(static_cast<TranslationRangeStream>(TRANSLATION_RANGE_EXTENT_X + axis))[boneIndex]);
+		}
+		return translation;
+	}
+
+	return glm::vec3(getKeyStream(keyIndex, AnimationPose::STREAM_TRANSLATION_X)[boneIndex], getKeyStream(keyIndex, AnimationPose::STREAM_TRANSLATION_Y)[boneIndex]
+		, getKeyStream(keyIndex, AnimationPose::STREAM_TRANSLATION_Z)[boneIndex]);
+}
+
+size_t SkeletalAnimation::getMemorySize() const
+{
+	return keysTime.size() * sizeof(float) + keyStreams.size() * sizeof(float)
+		+ compressedKeyStreams.size() * sizeof(uint16_t) + translationRanges.size() * sizeof(float);
+}
+
+void SkeletalAnimation::samplePoseReference(uint32_t keyIndex, uint32_t nextKeyIndex, float keyAlpha, AnimationPose& outPose, RotationInterpolation interpolation) const
+{
+	if (outPose.getBoneCount() != boneCount)
+		outPose.resize(boneCount);
+
+	for (uint32_t boneIndex = 0; boneIndex < boneCount; boneIndex++)
+	{
+		const glm::quat rotation = getRotation(boneIndex, keyIndex);
+		glm::quat nextRotation = getRotation(boneIndex, nextKeyIndex);
+
+		BoneTransform boneTransform;
+		if (interpolation == ROTATION_INTERPOLATION_SLERP)
+		{
+			boneTransform.rotation = glm::slerp(rotation, nextRotation, keyAlpha);
+		}
+		else
+		{
+			// shortest path
+			if (glm::dot(rotation, nextRotation) < 0.f)
+				nextRotation = -nextRotation;
+			boneTransform.rotation = glm::normalize(rotation * (1.f - keyAlpha) + nextRotation * keyAlpha);
+		}
+		boneTransform.position = getTranslation(boneIndex, keyIndex) * (1.f - keyAlpha) + getTranslation(boneIndex, nextKeyIndex) * keyAlpha;
+
+		outPose.setBoneTransform(boneIndex, boneTransform);
+	}
+}
+
+#if defined(SKELETAL_ANIMATION_SSE)
+
+namespace
+{
+	// 4 bones, one register per pose stream
+	struct PoseBlock
+	{
+		__m128 streams[AnimationPose::STREAM_COUNT];
+	};
+
+	inline __m128 select(__m128 mask, __m128 valueIfTrue, __m128 valueIfFalse)
+	{
+		return _mm_or_ps(_mm_and_ps(mask, valueIfTrue), _mm_andnot_ps(mask, valueIfFalse));
+	}
+
+	void loadBlock(const float* const streams[AnimationPose::STREAM_COUNT], uint32_t boneIndex, PoseBlock& outBlock)
+	{
+		for (uint32_t stream = 0; stream < AnimationPose::STREAM_COUNT; stream++)
+			outBlock.streams[stream] = _mm_load_ps(streams[stream] + boneIndex);
+	}
+
+	inline __m128 loadWords(const uint16_t* words)
+	{
+		return _mm_cvtepi32_ps(_mm_unpacklo_epi16(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(words)), _mm_setzero_si128()));
+	}
+
+	// decode 4 smallest three rotations and range normalized translations, see AnimationCompression.h
+	void loadCompressedBlock(const uint16_t* const streams[SkeletalAnimation::COMPRESSED_STREAM_COUNT], const float* const ranges[SkeletalAnimation::TRANSLATION_RANGE_STREAM_COUNT], uint32_t boneIndex, PoseBlock& outBlock)
+	{
+		const __m128i words0 = _mm_unpacklo_epi16(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(streams[SkeletalAnimation::COMPRESSED_STREAM_ROTATION_0] + boneIndex)), _mm_setzero_si128());
+		const __m128i words1 = _mm_unpacklo_epi16(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(streams[SkeletalAnimation::COMPRESSED_STREAM_ROTATION_1] + boneIndex)), _mm_setzero_si128());
+		const __m128i words2 = _mm_unpacklo_epi16(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(streams[SkeletalAnimation::COMPRESSED_STREAM_ROTATION_2] + boneIndex)), _mm_setzero_si128());
+		const __m128i largestIndex = _mm_or_si128(_mm_srli_epi32(words0, 15), _mm_slli_epi32(_mm_srli_epi32(words1, 15), 1));
+
+		const __m128i valueMask = _mm_set1_epi32(SMALLEST_THREE_MAX_VALUE);
+		const __m128 scale = _mm_set1_ps(2.f * SMALLEST_THREE_RANGE / SMALLEST_THREE_MAX_VALUE);
+		const __m128 offset = _mm_set1_ps(SMALLEST_THREE_RANGE);
+		const __m128 a = _mm_sub_ps(_mm_mul_ps(_mm_cvtepi32_ps(_mm_and_si128(words0, valueMask)), scale), offset);
+		const __m128 b = _mm_sub_ps(_mm_mul_ps(_mm_cvtepi32_ps(_mm_and_si128(words1, valueMask)), scale), offset);
+		const __m128 c = _mm_sub_ps(_mm_mul_ps(_mm_cvtepi32_ps(_mm_and_si128(words2, valueMask)), scale), offset);
+		const __m128 squaredLength = _mm_add_ps(_mm_add_ps(_mm_mul_ps(a, a), _mm_mul_ps(b, b)), _mm_mul_ps(c, c));
+		const __m128 largest = _mm_sqrt_ps(_mm_max_ps(_mm_sub_ps(_mm_set1_ps(1.f), squaredLength), _mm_setzero_ps()));
+
+		const __m128 isX = _mm_castsi128_ps(_mm_cmpeq_epi32(largestIndex, _mm_set1_epi32(0)));
+		const __m128 isY = _mm_castsi128_ps(_mm_cmpeq_epi32(largestIndex, _mm_set1_epi32(1)));
+		const __m128 isZ = _mm_castsi128_ps(_mm_cmpeq_epi32(largestIndex, _mm_set1_epi32(2)));
+		const __m128 isW = _mm_castsi128_ps(_mm_cmpeq_epi32(largestIndex, _mm_set1_epi32(3)));
+		outBlock.streams[AnimationPose::STREAM_ROTATION_X] = select(isX, largest, a);
+		outBlock.streams[AnimationPose::STREAM_ROTATION_Y] = select(isX, a, select(isY, largest, b));
+		outBlock.streams[AnimationPose::STREAM_ROTATION_Z] = select(isW, c, select(isZ, largest, b));
+		outBlock.streams[AnimationPose::STREAM_ROTATION_W] = select(isW, largest, c);
+
+		const __m128 wordScale = _mm_set1_ps(1.f / 65535.f);
+		for (uint32_t axis = 0; axis < 3; axis++)
+		{
+			const __m128 normalized = _mm_mul_ps(loadWords(streams[SkeletalAnimation::COMPRESSED_STREAM_TRANSLATION_X + axis] + boneIndex), wordScale);
+			const __m128 rangeMin = _mm_load_ps(ranges[SkeletalAnimation::TRANSLATION_RANGE_MIN_X + axis] + boneIndex);
+			const __m128 rangeExtent = _mm_load_ps(ranges[SkeletalAnimation::TRANSLATION_RANGE_EXTENT_X + axis] + boneIndex);
+			outBlock.streams[AnimationPose::STREAM_TRANSLATION_X + axis] = _mm_add_ps(rangeMin, _mm_mul_ps(normalized, rangeExtent));
+		}
+	}
+
+	// interpolation between two keys, the constants only depend on the key alpha and are shared by all the blocks
+	class BlockInterpolator
+	{
+	private:
+		RotationInterpolation interpolation;
+		__m128 alpha;
+		__m128 oneMinusAlpha;
+		__m128 slerpFromCoefficients[SLERP_TERM_COUNT];
+		__m128 slerpToCoefficients[SLERP_TERM_COUNT];
+
+	public:
+		BlockInterpolator(float keyAlpha, RotationInterpolation _interpolation)
+			: interpolation(_interpolation)
+			, alpha(_mm_set1_ps(keyAlpha))
+			, oneMinusAlpha(_mm_set1_ps(1.f - keyAlpha))
+		{
+			float coefficients[SLERP_TERM_COUNT];
+			computeSlerpCoefficients(1.f - keyAlpha, coefficients);
+			for (uint32_t i = 0; i < SLERP_TERM_COUNT; i++)
+				slerpFromCoefficients[i] = _mm_set1_ps(coefficients[i]);
+			computeSlerpCoefficients(keyAlpha, coefficients);
+			for (uint32_t i = 0; i < SLERP_TERM_COUNT; i++)
+				slerpToCoefficients[i] = _mm_set1_ps(coefficients[i]);
+		}
+
+		void interpolate(const PoseBlock& from, const PoseBlock& to, float* const outStreams[AnimationPose::STREAM_COUNT], uint32_t boneIndex) const
+		{
+			const __m128 one = _mm_set1_ps(1.f);
+			const __m128 fromX = from.streams[AnimationPose::STREAM_ROTATION_X];
+			const __m128 fromY = from.streams[AnimationPose::STREAM_ROTATION_Y];
+			const __m128 fromZ = from.streams[AnimationPose::STREAM_ROTATION_Z];
+			const __m128 fromW = from.streams[AnimationPose::STREAM_ROTATION_W];
+
+			// shortest path : flip the target rotation when the dot product is negative
+			__m128 cosAngle = _mm_add_ps(_mm_add_ps(_mm_mul_ps(fromX, to.streams[AnimationPose::STREAM_ROTATION_X]), _mm_mul_ps(fromY, to.streams[AnimationPose::STREAM_ROTATION_Y]))
+				, _mm_add_ps(_mm_mul_ps(fromZ, to.streams[AnimationPose::STREAM_ROTATION_Z]), _mm_mul_ps(fromW, to.streams[AnimationPose::STREAM_ROTATION_W])));
+			const __m128 flip = _mm_and_ps(cosAngle, _mm_set1_ps(-0.f));
+			cosAngle = _mm_xor_ps(cosAngle, flip);
+			const __m128 toX = _mm_xor_ps(to.streams[AnimationPose::STREAM_ROTATION_X], flip);
+			const __m128 toY = _mm_xor_ps(to.streams[AnimationPose::STREAM_ROTATION_Y], flip);
+			const __m128 toZ = _mm_xor_ps(to.streams[AnimationPose::STREAM_ROTATION_Z], flip);
+			const __m128 toW = _mm_xor_ps(to.streams[AnimationPose::STREAM_ROTATION_W], flip);
+
+			__m128 fromWeight = oneMinusAlpha;
+			__m128 toWeight = alpha;
+			if (interpolation == ROTATION_INTERPOLATION_SLERP)
+			{
+				const __m128 cosAngleMinusOne = _mm_sub_ps(cosAngle, one);
+				fromWeight = one;
+				toWeight = one;
+				for (int32_t i = SLERP_TERM_COUNT - 1; i >= 0; i--)
+				{
+					fromWeight = _mm_add_ps(one, _mm_mul_ps(_mm_mul_ps(slerpFromCoefficients[i], cosAngleMinusOne), fromWeight));
+					toWeight = _mm_add_ps(one, _mm_mul_ps(_mm_mul_ps(slerpToCoefficients[i], cosAngleMinusOne), toWeight));
+				}
+				fromWeight = _mm_mul_ps(fromWeight, oneMinusAlpha);
+				toWeight = _mm_mul_ps(toWeight, alpha);
+			}
+
+			__m128 x = _mm_add_ps(_mm_mul_ps(fromX, fromWeight), _mm_mul_ps(toX, toWeight));
+			__m128 y = _mm_add_ps(_mm_mul_ps(fromY, fromWeight), _mm_mul_ps(toY, toWeight));
+			__m128 z = _mm_add_ps(_mm_mul_ps(fromZ, fromWeight), _mm_mul_ps(toZ, toWeight));
+			__m128 w = _mm_add_ps(_mm_mul_ps(fromW, fromWeight), _mm_mul_ps(toW, toWeight));
+
+			if (interpolation == ROTATION_INTERPOLATION_NLERP)
+			{
+				const __m128 length = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y)), _mm_add_ps(_mm_mul_ps(z, z), _mm_mul_ps(w, w))));
+				x = _mm_div_ps(x, length);
+				y = _mm_div_ps(y, length);
+				z = _mm_div_ps(z, length);
+				w = _mm_div_ps(w, length);
+			}
+
+			_mm_store_ps(outStreams[AnimationPose::STREAM_ROTATION_X] + boneIndex, x);
+			_mm_store_ps(outStreams[AnimationPose::STREAM_ROTATION_Y] + boneIndex, y);
+			_mm_store_ps(outStreams[AnimationPose::STREAM_ROTATION_Z] + boneIndex, z);
+			_mm_store_ps(outStreams[AnimationPose::STREAM_ROTATION_W] + boneIndex, w);
+
+			for (uint32_t stream = AnimationPose::STREAM_TRANSLATION_X; stream <= AnimationPose::STREAM_TRANSLATION_Z; stream++)
+			{
+				const __m128 translation = _mm_add_ps(_mm_mul_ps(from.streams[stream], oneMinusAlpha), _mm_mul_ps(to.streams[stream], alpha));
+				_mm_store_ps(outStreams[stream] + boneIndex, translation);
+			}
+		}
+	};
+}
+
+void SkeletalAnimation::samplePose(uint32_t keyIndex, uint32_t nextKeyIndex, float keyAlpha, AnimationPose& outPose, RotationInterpolation interpolation) const
+{
+	if (outPose.getBoneCount() != boneCount)
+		outPose.resize(boneCount);
+
+	float* out[AnimationPose::STREAM_COUNT];
+	for (uint32_t stream = 0; stream < AnimationPose::STREAM_COUNT; stream++)
+		out[stream] = outPose.getStream(static_cast<AnimationPose::Stream>(stream));
+
+	const BlockInterpolator interpolator(keyAlpha, interpolation);
+	PoseBlock fromBlock, toBlock;
+
+	if (compressed)
+	{
+		const uint16_t* from[COMPRESSED_STREAM_COUNT];
+		const uint16_t* to[COMPRESSED_STREAM_COUNT];
+		for (uint32_t stream = 0; stream < COMPRESSED_STREAM_COUNT; stream++)
+		{
+			from[stream] = getCompressedKeyStream(keyIndex, static_cast<CompressedStream>(stream));
+			to[stream] = getCompressedKeyStream(nextKeyIndex, static_cast<CompressedStream>(stream));
+		}
+		const float* ranges[TRANSLATION_RANGE_STREAM_COUNT];
+		for (uint32_t stream = 0; stream < TRANSLATION_RANGE_STREAM_COUNT; stream++)
+			ranges[stream] = getTranslationRange(static_cast<TranslationRangeStream>(stream));
+
+		for (uint32_t boneIndex = 0; boneIndex < paddedBoneCount; boneIndex += 4)
+		{
+			loadCompressedBlock(from, ranges, boneIndex, fromBlock);
+			loadCompressedBlock(to, ranges, boneIndex, toBlock);
+			interpolator.interpolate(fromBlock, toBlock, out, boneIndex);
+		}
+	}
+	else
+	{
+		const float* from[AnimationPose::STREAM_COUNT];
+		const float* to[AnimationPose::STREAM_COUNT];
+		for (uint32_t stream = 0; stream < AnimationPose::STREAM_COUNT; stream++)
+		{
+			from[stream] = getKeyStream(keyIndex, static_cast<AnimationPose::Stream>(stream));
+			to[stream] = getKeyStream(nextKeyIndex, static_cast<AnimationPose::Stream>(stream));
+		}
+
+		for (uint32_t boneIndex = 0; boneIndex < paddedBoneCount; boneIndex += 4)
+		{
+			loadBlock(from, boneIndex, fromBlock);
+			loadBlock(to, boneIndex, toBlock);
+			interpolator.interpolate(fromBlock, toBlock, out, boneIndex);
+		}
+	}
+}
+
+const char* SkeletalAnimation::getInstructionSetName()
+{
+	return "SSE";
+}
+
+#else
+
+void SkeletalAnimation::samplePose(uint32_t keyIndex, uint32_t nextKeyIndex, float keyAlpha, AnimationPose& outPose, RotationInterpolation interpolation) const
+{
+	samplePoseReference(keyIndex, nextKeyIndex, keyAlpha, outPose, interpolation);
+}
+
+const char* SkeletalAnimation::getInstructionSetName()
+{
+	return "Scalar";
+}
+
+#endif
@@ -0,0 +1,220 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include <cstdint>
+#include <vector>
+
+#include "AnimationPose.h"
+
+class AnimationFileView;
+
+template<typename KeyType>
+struct AnimKey
+{
+	KeyType value;
+	float time;
+};
+
+enum RotationInterpolation
+{
+	ROTATION_INTERPOLATION_NLERP,
+	ROTATION_INTERPOLATION_SLERP
+};
+
+// Keyframed bone transforms of a clip.
+// All the bones share a single time track, a key gives the rotation and the translation of every bone.
+// Keys are stored one after the other, each key has the stream layout of an AnimationPose,
+// so sampling reads two contiguous blocks whatever the bone count.
+// Clips built by the AnimationCompressor keep quantized keys instead, decompressed while sampling.
+class SkeletalAnimation
+{
+public:
+	// keys tried after the cursor before falling back to a binary search
+	static const uint32_t MAX_CURSOR_STEPS = 4;
+
+	// streams of a compressed key : the 48 bits smallest three rotation then the 16 bits translations
+	enum CompressedStream
+	{
+		COMPRESSED_STREAM_ROTATION_0,
+		COMPRESSED_STREAM_ROTATION_1,
+		COMPRESSED_STREAM_ROTATION_2,
+		COMPRESSED_STREAM_TRANSLATION_X,
+		COMPRESSED_STREAM_TRANSLATION_Y,
+		COMPRESSED_STREAM_TRANSLATION_Z,
+		COMPRESSED_STREAM_COUNT
+	};
+
+	// translations are quantized in the range of each bone, stored as min then extent streams
+	enum TranslationRangeStream
+	{
+		TRANSLATION_RANGE_MIN_X,
+		TRANSLATION_RANGE_MIN_Y,
+		TRANSLATION_RANGE_MIN_Z,
+		TRANSLATION_RANGE_EXTENT_X,
+		TRANSLATION_RANGE_EXTENT_Y,
+		TRANSLATION_RANGE_EXTENT_Z,
+		TRANSLATION_RANGE_STREAM_COUNT
+	};
+
+	typedef std::vector<uint16_t, AlignedAllocator<uint16_t, 16>> CompressedStreamStorage;
+
+private:
+	float duration = 0.f;
+	float ticksPerSecond = 0.f;
+
+	std::vector<float> keysTime;
+	uint32_t boneCount = 0;
+	uint32_t paddedBoneCount = 0;
+	AnimationPose::StreamStorage keyStreams;
+
+	bool compressed = false;
+	CompressedStreamStorage compressedKeyStreams;
+	AnimationPose::StreamStorage translationRanges;
+
+	const float* getKeyStream(uint32_t keyIndex, AnimationPose::Stream stream) const
+	{
+		return keyStreams.data() + (keyIndex * AnimationPose::STREAM_COUNT + stream) * paddedBoneCount;
+	}
+
+	const uint16_t* getCompressedKeyStream(uint32_t keyIndex, CompressedStream stream) const
+	{
+		return compressedKeyStreams.data() + (keyIndex * COMPRESSED_STREAM_COUNT + stream) * paddedBoneCount;
+	}
+
+	const float* getTranslationRange(TranslationRangeStream stream) const
+	{
+		return translationRanges.data() + stream * paddedBoneCount;
+	}
+
+public:
+	// keysTime must be sorted, each bone has one rotation and one translation per key
+	void create(float duration, float ticksPerSecond, std::vector<float> keysTime, std::vector<std::vector<glm::quat>> bonesRotation, std::vector<std::vector<glm::vec3>> bonesTranslation);
+	// clips imported with separated rotation and translation tracks are resampled on the union of their key times
+	void createFromTracks(float duration, float ticksPerSecond
+		, const std::vector<float>& rotationKeysTime, const std::vector<std::vector<glm::quat>>& bonesRotation
+		, const std::vector<float>& translationKeysTime, const std::vector<std::vector<glm::vec3>>& bonesTranslation);
+	// compressed clip saved by the AnimationFileWriter, the streams are copied out of the file
+	void loadFromFile(const AnimationFileView& file);
+
+	// Return the key k such as keysTime[k] <= animationTime < keysTime[k + 1], clamped to the first and last keys.
+	// The search starts from inOutCursor, the key found at the previous frame, and updates it.
+	// outKeyAlpha is the interpolation factor between k and k + 1.
+	uint32_t findKeyIndex(float animationTime, uint32_t& inOutCursor, float& outKeyAlpha) const;
+	// same result without cursor, always a binary search
+	uint32_t findKeyIndex(float animationTime, float& outKeyAlpha) const;
+
+	// the last key is its own next key
+	uint32_t getNextKeyIndex(uint32_t keyIndex) const
+	{
+		return keyIndex + 1 < keysTime.size() ? keyIndex + 1 : keyIndex;
+	}
+
+	// Interpolate every bone between two keys, 4 bones per iteration with SSE.
+	// The slerp is a polynomial approximation : within 1e-7 of the exact one for keys up to 60 degrees apart, 3e-5 at worst.
+	void samplePose(uint32_t keyIndex, uint32_t nextKeyIndex, float keyAlpha, AnimationPose& outPose, RotationInterpolation interpolation = ROTATION_INTERPOLATION_NLERP) const;
+	// reference version, one bone at a time with the glm functions
+	void samplePoseReference(uint32_t keyIndex, uint32_t nextKeyIndex, float keyAlpha, AnimationPose& outPose, RotationInterpolation interpolation = ROTATION_INTERPOLATION_NLERP) const;
+
+	// decompressed if needed
+	glm::quat getRotation(uint32_t boneIndex, uint32_t keyIndex) const;
+	glm::vec3 getTranslation(uint32_t boneIndex, uint32_t keyIndex) const;
+
+	bool isCompressed() const
+	{
+		return compressed;
+	}
+
+	// bytes used by the keys
+	size_t getMemorySize() const;
+
+	uint32_t getBoneCount() const
+	{
+		return boneCount;
+	}
+
+	uint32_t getKeyCount() const
+	{
+		return static_cast<uint32_t>(keysTime.size());
+	}
+
+	const std::vector<float>& getKeysTime() const
+	{
+		return keysTime;
+	}
+
+	float getDuration() const
+	{
+		return duration;
+	}
+
+	float getTickPerSecond() const
+	{
+		return ticksPerSecond;
+	}
+
+	static const char* getInstructionSetName();
+
+	friend class AnimationCompressor;
+	friend class AnimationFileWriter;
+};
+
+// A clip played by one skeleton instance.
+// It keeps the key of the last sampling so the next one only moves forward by a key or two.
+class SkeletalAnimationInstance
+{
+private:
+	SkeletalAnimation* animation;
+	float animationBeginTime;
+	uint32_t keyCursor = 0;
+
+public:
+	SkeletalAnimationInstance(SkeletalAnimation* _animation = nullptr, float _animationBeginTime = 0.f)
+		: animation(_animation)
+		, animationBeginTime(_animationBeginTime)
+	{}
+
+	float getAnimationTickTime(float timeInSecond) const
+	{
+		return timeInSecond * animation->getTickPerSecond();
+	}
+
+	uint32_t findKeyIndex(float animationTime, float& outKeyAlpha)
+	{
+		return animation->findKeyIndex(animationTime, keyCursor, outKeyAlpha);
+	}
+
+	uint32_t getNextKeyIndex(uint32_t keyIndex) const
+	{
+		return animation->getNextKeyIndex(keyIndex);
+	}
+
+	// sample the clip at a time, the pose must have the clip bone count
+	void samplePose(float timeInSecond, AnimationPose& outPose, RotationInterpolation interpolation = ROTATION_INTERPOLATION_NLERP)
+	{
+		float keyAlpha = 0.f;
+		const uint32_t keyIndex = findKeyIndex(getAnimationTickTime(timeInSecond), keyAlpha);
+		animation->samplePose(keyIndex, animation->getNextKeyIndex(keyIndex), keyAlpha, outPose, interpolation);
+	}
+
+	glm::quat getRotation(uint32_t boneIndex, uint32_t keyIndex) const
+	{
+		return animation->getRotation(boneIndex, keyIndex);
+	}
+
+	glm::vec3 getTranslation(uint32_t boneIndex, uint32_t keyIndex) const
+	{
+		return animation->getTranslation(boneIndex, keyIndex);
+	}
+
+	float getTickPerSecond() const
+	{
+		return animation->getTickPerSecond();
+	}
+
+	SkeletalAnimation* getAnimation() const
+	{
+		return animation;
+	}
+};
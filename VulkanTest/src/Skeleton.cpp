@@ -0,0 +1,254 @@
+#include "Skeleton.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SKELETON_SSE
+#include <emmintrin.h>
+#endif
+
+const uint32_t SkeletonData::NO_PARENT;
+
+std::vector<uint32_t> Skeleton::linearize(SkeletonData& skeletonData)
+{
+	const uint32_t boneCount = skeletonData.getBoneCount();
+	if (skeletonData.boneBaseTransforms.size() != boneCount || skeletonData.boneInverseBindTransforms.size() != boneCount)
+		throw std::runtime_error("each bone needs a parent, a base transform and an inverse bind transform !");
+
+	std::vector<std::vector<uint32_t>> boneChilds(boneCount);
+	std::vector<uint32_t> stack;
+	for (uint32_t boneIndex = 0; boneIndex < boneCount; boneIndex++)
+	{
+		const uint32_t parentIndex = skeletonData.boneParents[boneIndex];
+		if (parentIndex == SkeletonData::NO_PARENT)
+			stack.push_back(boneIndex);
+		else if (parentIndex < boneCount)
+			boneChilds[parentIndex].push_back(boneIndex);
+		else
+			throw std::runtime_error("invalid bone parent index !");
+	}
+
+	// depth first from the roots, children keep their original order
+	std::reverse(stack.begin(), stack.end());
+	std::vector<uint32_t> sortedBones;
+	sortedBones.reserve(boneCount);
+	while (!stack.empty())
+	{
+		const uint32_t boneIndex = stack.back();
+		stack.pop_back();
+		sortedBones.push_back(boneIndex);
+		stack.insert(stack.end(), boneChilds[boneIndex].rbegin(), boneChilds[boneIndex].rend());
+	}
+
+	// bones in a cycle are never reached from a root
+	if (sortedBones.size() != boneCount)
+		throw std::runtime_error("the bone hierarchy has a cycle !");
+
+	std::vector<uint32_t> newBoneIndices(boneCount);
+	for (uint32_t i = 0; i < boneCount; i++)
+		newBoneIndices[sortedBones[i]] = i;
+
+	std::vector<uint32_t> boneParents(boneCount);
+	std::vector<BoneTransform> boneBaseTransforms(boneCount);
+	BoneMatrixStorage boneInverseBindTransforms(boneCount);
+	for (uint32_t i = 0; i < boneCount; i++)
+	{
+		const uint32_t parentIndex = skeletonData.boneParents[sortedBones[i]];
+		boneParents[i] = parentIndex == SkeletonData::NO_PARENT ? SkeletonData::NO_PARENT : newBoneIndices[parentIndex];
+		boneBaseTransforms[i] = skeletonData.boneBaseTransforms[sortedBones[i]];
+		boneInverseBindTransforms[i] = skeletonData.boneInverseBindTransforms[sortedBones[i]];
+	}
+
+	skeletonData.boneParents = std::move(boneParents);
+	skeletonData.boneBaseTransforms = std::move(boneBaseTransforms);
+	skeletonData.boneInverseBindTransforms = std::move(boneInverseBindTransforms);
+	for (auto& boneMapping : skeletonData.boneMappingNameToIdx)
+		boneMapping.second = newBoneIndices[boneMapping.second];
+
+	return newBoneIndices;
+}
+
+void Skeleton::computeModelTransforms(const SkeletonData& skeletonData, const AnimationPose& localPose, glm::mat4* outModelTransforms)
+{
+	const uint32_t boneCount = skeletonData.getBoneCount();
+	if (localPose.getBoneCount() != boneCount)
+		throw std::runtime_error("the pose and the skeleton have different bone counts !");
+
+	for (uint32_t boneIndex = 0; boneIndex < boneCount; boneIndex++)
+	{
+		const BoneTransform boneTransform = localPose.getBoneTransform(boneIndex);
+		const glm::mat4 localTransform = glm::translate(glm::mat4(1.f), boneTransform.position) * glm::mat4_cast(boneTransform.rotation);
+
+		const uint32_t parentIndex = skeletonData.boneParents[boneIndex];
+		outModelTransforms[boneIndex] = parentIndex == SkeletonData::NO_PARENT ? localTransform : outModelTransforms[parentIndex] * localTransform;
+	}
+}
+
+#if defined(SKELETON_SSE)
+
+namespace
+{
+	// out = a * b, rows of b are combined by the columns of a, the translation of a is added to the last column
+	inline void multiplyRows(const __m128 a[3], const __m128 b[3], __m128 out[3])
+	{
+		const __m128 translationMask = _mm_castsi128_ps(_mm_setr_epi32(0, 0, 0, -1));
+		for (uint32_t row = 0; row < 3; row++)
+		{
+			const __m128 x = _mm_shuffle_ps(a[row], a[row], _MM_SHUFFLE(0, 0, 0, 0));
+			const __m128 y = _mm_shuffle_ps(a[row], a[row], _MM_SHUFFLE(1, 1, 1, 1));
+			const __m128 z = _mm_shuffle_ps(a[row], a[row], _MM_SHUFFLE(2, 2, 2, 2));
+			out[row] = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, b[0]), _mm_mul_ps(y, b[1])), _mm_add_ps(_mm_mul_ps(z, b[2]), _mm_and_ps(a[row], translationMask)));
+		}
+	}
+
+	inline void loadRows(const BoneMatrix& matrix, __m128 outRows[3])
+	{
+		for (uint32_t row = 0; row < 3; row++)
+			outRows[row] = _mm_loadu_ps(&matrix.rows[row].x);
+	}
+
+	inline void storeRows(const __m128 rows[3], BoneMatrix& outMatrix)
+	{
+		for (uint32_t row = 0; row < 3; row++)
+			_mm_storeu_ps(&outMatrix.rows[row].x, rows[row]);
+	}
+
+	inline void multiply(const BoneMatrix& a, const BoneMatrix& b, BoneMatrix& outMatrix)
+	{
+		__m128 aRows[3];
+		__m128 bRows[3];
+		__m128 rows[3];
+		loadRows(a, aRows);
+		loadRows(b, bRows);
+		multiplyRows(aRows, bRows, rows);
+		storeRows(rows, outMatrix);
+	}
+}
+
+void Skeleton::computeModelTransforms(const SkeletonData& skeletonData, const AnimationPose& localPose, BoneMatrix* outModelTransforms)
+{
+	const uint32_t boneCount = skeletonData.getBoneCount();
+	if (localPose.getBoneCount() != boneCount)
+		throw std::runtime_error("the pose and the skeleton have different bone counts !");
+
+	const uint32_t* boneParents = skeletonData.boneParents.data();
+	const float* rotationX = localPose.getStream(AnimationPose::STREAM_ROTATION_X);
+	const float* rotationY = localPose.getStream(AnimationPose::STREAM_ROTATION_Y);
+	const float* rotationZ = localPose.getStream(AnimationPose::STREAM_ROTATION_Z);
+	const float* rotationW = localPose.getStream(AnimationPose::STREAM_ROTATION_W);
+	const float* translationX = localPose.getStream(AnimationPose::STREAM_TRANSLATION_X);
+	const float* translationY = localPose.getStream(AnimationPose::STREAM_TRANSLATION_Y);
+	const float* translationZ = localPose.getStream(AnimationPose::STREAM_TRANSLATION_Z);
+	const __m128 one = _mm_set1_ps(1.f);
+
+	for (uint32_t blockBegin = 0; blockBegin < boneCount; blockBegin += AnimationPose::BLOCK_SIZE)
+	{
+		// local matrices of 4 bones from their quaternions, the pose is padded so a block is always complete
+		const __m128 x = _mm_load_ps(rotationX + blockBegin);
+		const __m128 y = _mm_load_ps(rotationY + blockBegin);
+		const __m128 z = _mm_load_ps(rotationZ + blockBegin);
+		const __m128 w = _mm_load_ps(rotationW + blockBegin);
+		const __m128 x2 = _mm_add_ps(x, x);
+		const __m128 y2 = _mm_add_ps(y, y);
+		const __m128 z2 = _mm_add_ps(z, z);
+		const __m128 xx = _mm_mul_ps(x, x2);
+		const __m128 yy = _mm_mul_ps(y, y2);
+		const __m128 zz = _mm_mul_ps(z, z2);
+		const __m128 xy = _mm_mul_ps(x, y2);
+		const __m128 xz = _mm_mul_ps(x, z2);
+		const __m128 yz = _mm_mul_ps(y, z2);
+		const __m128 wx = _mm_mul_ps(w, x2);
+		const __m128 wy = _mm_mul_ps(w, y2);
+		const __m128 wz = _mm_mul_ps(w, z2);
+
+		__m128 row0[4] = { _mm_sub_ps(one, _mm_add_ps(yy, zz)), _mm_sub_ps(xy, wz), _mm_add_ps(xz, wy), _mm_load_ps(translationX + blockBegin) };
+		__m128 row1[4] = { _mm_add_ps(xy, wz), _mm_sub_ps(one, _mm_add_ps(xx, zz)), _mm_sub_ps(yz, wx), _mm_load_ps(translationY + blockBegin) };
+		__m128 row2[4] = { _mm_sub_ps(xz, wy), _mm_add_ps(yz, wx), _mm_sub_ps(one, _mm_add_ps(xx, yy)), _mm_load_ps(translationZ + blockBegin) };
+
+		// from one register per component to one register per bone row
+		_MM_TRANSPOSE4_PS(row0[0], row0[1], row0[2], row0[3]);
+		_MM_TRANSPOSE4_PS(row1[0], row1[1], row1[2], row1[3]);
+		_MM_TRANSPOSE4_PS(row2[0], row2[1], row2[2], row2[3]);
+
+		// parents come first, they are already computed, possibly in this block
+		const uint32_t blockEnd = std::min(blockBegin + AnimationPose::BLOCK_SIZE, boneCount);
+		for (uint32_t boneIndex = blockBegin; boneIndex < blockEnd; boneIndex++)
+		{
+			const uint32_t lane = boneIndex - blockBegin;
+			const __m128 localRows[3] = { row0[lane], row1[lane], row2[lane] };
+
+			const uint32_t parentIndex = boneParents[boneIndex];
+			if (parentIndex == SkeletonData::NO_PARENT)
+			{
+				storeRows(localRows, outModelTransforms[boneIndex]);
+				continue;
+			}
+
+			__m128 parentRows[3];
+			__m128 modelRows[3];
+			loadRows(outModelTransforms[parentIndex], parentRows);
+			multiplyRows(parentRows, localRows, modelRows);
+			storeRows(modelRows, outModelTransforms[boneIndex]);
+		}
+	}
+}
+
+const char* Skeleton::getInstructionSetName()
+{
+	return "SSE";
+}
+
+#else
+
+namespace
+{
+	inline void multiply(const BoneMatrix& a, const BoneMatrix& b, BoneMatrix& outMatrix)
+	{
+		outMatrix = a * b;
+	}
+}
+
+void Skeleton::computeModelTransforms(const SkeletonData& skeletonData, const AnimationPose& localPose, BoneMatrix* outModelTransforms)
+{
+	const uint32_t boneCount = skeletonData.getBoneCount();
+	if (localPose.getBoneCount() != boneCount)
+		throw std::runtime_error("the pose and the skeleton have different bone counts !");
+
+	for (uint32_t boneIndex = 0; boneIndex < boneCount; boneIndex++)
+	{
+		const BoneMatrix localTransform = BoneMatrix::fromBoneTransform(localPose.getBoneTransform(boneIndex));
+
+		const uint32_t parentIndex = skeletonData.boneParents[boneIndex];
+		outModelTransforms[boneIndex] = parentIndex == SkeletonData::NO_PARENT ? localTransform : outModelTransforms[parentIndex] * localTransform;
+	}
+}
+
+const char* Skeleton::getInstructionSetName()
+{
+	return "Scalar";
+}
+
+#endif
+
+void Skeleton::computeSkinningTransforms(const SkeletonData& skeletonData, const BoneMatrix* modelTransforms, BoneMatrix* outSkinningTransforms)
+{
+	const BoneMatrix rootInverseTransform = BoneMatrix::fromMat4(skeletonData.rootInverseTransform);
+	const uint32_t boneCount = skeletonData.getBoneCount();
+	for (uint32_t boneIndex = 0; boneIndex < boneCount; boneIndex++)
+	{
+		BoneMatrix bindToModel;
+		multiply(modelTransforms[boneIndex], skeletonData.boneInverseBindTransforms[boneIndex], bindToModel);
+		multiply(rootInverseTransform, bindToModel, outSkinningTransforms[boneIndex]);
+	}
+}
+
+void Skeleton::computeAnimationStep(SkeletonInstanceData& skeletonInstance, float time, SkeletalAnimationInstance& animation)
+{
+	const SkeletonData& skeletonData = *skeletonInstance.skeletonData;
+	animation.samplePose(time, skeletonInstance.localPose);
+
+	// only allocates the first time
+	skeletonInstance.modelTransforms.resize(skeletonData.getBoneCount());
+	computeModelTransforms(skeletonData, skeletonInstance.localPose, skeletonInstance.modelTransforms.data());
+}
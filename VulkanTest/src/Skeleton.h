@@ -0,0 +1,145 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "AlignedAllocator.h"
+#include "AnimationPose.h"
+#include "SkeletalAnimation.h"
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/////////// BoneMatrix
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Affine transform stored as the 3 first rows of a 4x4 matrix, the translation being the last column.
+// 48 bytes instead of 64, it can be copied as is in a GPU buffer and read as a transposed mat3x4 : position = vec4(p, 1) * m.
+struct BoneMatrix
+{
+	glm::vec4 rows[3];
+
+	static BoneMatrix identity()
+	{
+		BoneMatrix matrix;
+		matrix.rows[0] = glm::vec4(1.f, 0.f, 0.f, 0.f);
+		matrix.rows[1] = glm::vec4(0.f, 1.f, 0.f, 0.f);
+		matrix.rows[2] = glm::vec4(0.f, 0.f, 1.f, 0.f);
+		return matrix;
+	}
+
+	// the last row of the matrix is dropped, it must be affine
+	static BoneMatrix fromMat4(const glm::mat4& transform)
+	{
+		BoneMatrix matrix;
+		for (uint32_t row = 0; row < 3; row++)
+			matrix.rows[row] = glm::vec4(transform[0][row], transform[1][row], transform[2][row], transform[3][row]);
+		return matrix;
+	}
+
+	static BoneMatrix fromBoneTransform(const BoneTransform& transform)
+	{
+		const glm::quat& q = transform.rotation;
+		BoneMatrix matrix;
+		matrix.rows[0] = glm::vec4(1.f - 2.f * (q.y * q.y + q.z * q.z), 2.f * (q.x * q.y - q.w * q.z), 2.f * (q.x * q.z + q.w * q.y), transform.position.x);
+		matrix.rows[1] = glm::vec4(2.f * (q.x * q.y + q.w * q.z), 1.f - 2.f * (q.x * q.x + q.z * q.z), 2.f * (q.y * q.z - q.w * q.x), transform.position.y);
+		matrix.rows[2] = glm::vec4(2.f * (q.x * q.z - q.w * q.y), 2.f * (q.y * q.z + q.w * q.x), 1.f - 2.f * (q.x * q.x + q.y * q.y), transform.position.z);
+		return matrix;
+	}
+
+	glm::mat4 toMat4() const
+	{
+		glm::mat4 transform(1.f);
+		for (uint32_t row = 0; row < 3; row++)
+		{
+			for (uint32_t column = 0; column < 4; column++)
+				transform[column][row] = rows[row][column];
+		}
+		return transform;
+	}
+
+	// this * other, as with 4x4 matrices
+	BoneMatrix operator*(const BoneMatrix& other) const
+	{
+		BoneMatrix matrix;
+		for (uint32_t row = 0; row < 3; row++)
+		{
+			matrix.rows[row] = rows[row].x * other.rows[0] + rows[row].y * other.rows[1] + rows[row].z * other.rows[2];
+			matrix.rows[row].w += rows[row].w;
+		}
+		return matrix;
+	}
+};
+
+typedef std::vector<BoneMatrix, AlignedAllocator<BoneMatrix, 16>> BoneMatrixStorage;
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/////////// Skeleton
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Bones are sorted so a parent always comes before its children, the model transforms are then computed in a single forward pass.
+// Use Skeleton::linearize on imported data before building the clips and the skinned vertices, they share the bone indices.
+struct SkeletonData
+{
+	static const uint32_t NO_PARENT = ~0u;
+
+	glm::mat4 rootInverseTransform;
+	std::map<std::string, uint32_t> boneMappingNameToIdx;
+	std::vector<BoneTransform> boneBaseTransforms;
+	// parent of each bone, NO_PARENT for the roots
+	std::vector<uint32_t> boneParents;
+	// model space to bone space in the bind pose
+	BoneMatrixStorage boneInverseBindTransforms;
+
+	uint32_t getBoneCount() const
+	{
+		return static_cast<uint32_t>(boneParents.size());
+	}
+};
+
+struct SkeletonInstanceData
+{
+	SkeletonData* skeletonData;
+	// sampled local transform of each bone
+	AnimationPose localPose;
+	// bone to model space transform of each bone
+	BoneMatrixStorage modelTransforms;
+
+	const glm::mat4& getRootInverseTransform() const
+	{
+		return skeletonData->rootInverseTransform;
+	}
+
+	const BoneTransform& getBoneBaseTransform(uint32_t boneIndex) const
+	{
+		return skeletonData->boneBaseTransforms[boneIndex];
+	}
+};
+
+class Skeleton
+{
+	SkeletonData skeletonData;
+
+public:
+	// Sort the bones depth first so parents come before their children and each subtree is contiguous.
+	// Return the new index of each bone.
+	static std::vector<uint32_t> linearize(SkeletonData& skeletonData);
+
+	// Model transform of each bone from its local transform, 4 bones per iteration with SSE.
+	// The skeleton must be linearized.
+	static void computeModelTransforms(const SkeletonData& skeletonData, const AnimationPose& localPose, BoneMatrix* outModelTransforms);
+	// reference version, one bone at a time with glm matrices
+	static void computeModelTransforms(const SkeletonData& skeletonData, const AnimationPose& localPose, glm::mat4* outModelTransforms);
+
+	// Matrices applied to the skinned vertices : rootInverseTransform * model * inverse bind.
+	// outSkinningTransforms can be a mapped GPU buffer.
+	static void computeSkinningTransforms(const SkeletonData& skeletonData, const BoneMatrix* modelTransforms, BoneMatrix* outSkinningTransforms);
+
+	// sample the local pose of the instance, the key is searched once for all the bones, then compute its model transforms
+	static void computeAnimationStep(SkeletonInstanceData& skeletonInstance, float time, SkeletalAnimationInstance& animation);
+
+	static const char* getInstructionSetName();
+};
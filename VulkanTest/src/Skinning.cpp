@@ -0,0 +1,86 @@
+#include "Skinning.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SKINNING_SSE
+#include <emmintrin.h>
+#endif
+
+void Skinning::skinVerticesReference(const WeightedVertex* vertices, uint32_t vertexCount, const BoneMatrix* skinningTransforms, Vertex* outVertices)
+{
+	for (uint32_t vertexIndex = 0; vertexIndex < vertexCount; vertexIndex++)
+	{
+		const WeightedVertex& vertex = vertices[vertexIndex];
+		const glm::vec4 position(vertex.position, 1.f);
+
+		glm::vec3 skinnedPosition(0.f);
+		for (uint32_t influence = 0; influence < 4; influence++)
+		{
+			const BoneMatrix& bone = skinningTransforms[vertex.boneIndices[influence]];
+			skinnedPosition += vertex.weights[influence] * glm::vec3(glm::dot(bone.rows[0], position), glm::dot(bone.rows[1], position), glm::dot(bone.rows[2], position));
+		}
+
+		outVertices[vertexIndex].position = skinnedPosition;
+		outVertices[vertexIndex].color = vertex.color;
+		outVertices[vertexIndex].texCoord = vertex.texCoord;
+	}
+}
+
+#if defined(SKINNING_SSE)
+
+void Skinning::skinVertices(const WeightedVertex* vertices, uint32_t vertexCount, const BoneMatrix* skinningTransforms, Vertex* outVertices)
+{
+	for (uint32_t vertexIndex = 0; vertexIndex < vertexCount; vertexIndex++)
+	{
+		const WeightedVertex& vertex = vertices[vertexIndex];
+
+		// blend the matrices first, then transform the position once
+		const BoneMatrix& bone0 = skinningTransforms[vertex.boneIndices.x];
+		const BoneMatrix& bone1 = skinningTransforms[vertex.boneIndices.y];
+		const BoneMatrix& bone2 = skinningTransforms[vertex.boneIndices.z];
+		const BoneMatrix& bone3 = skinningTransforms[vertex.boneIndices.w];
+		const __m128 weight0 = _mm_set1_ps(vertex.weights.x);
+		const __m128 weight1 = _mm_set1_ps(vertex.weights.y);
+		const __m128 weight2 = _mm_set1_ps(vertex.weights.z);
+		const __m128 weight3 = _mm_set1_ps(vertex.weights.w);
+		const __m128 position = _mm_setr_ps(vertex.position.x, vertex.position.y, vertex.position.z, 1.f);
+
+		__m128 rows[3];
+		for (uint32_t row = 0; row < 3; row++)
+		{
+			// two independent sums, shorter dependency chains
+			const __m128 blend01 = _mm_add_ps(_mm_mul_ps(weight0, _mm_loadu_ps(&bone0.rows[row].x)), _mm_mul_ps(weight1, _mm_loadu_ps(&bone1.rows[row].x)));
+			const __m128 blend23 = _mm_add_ps(_mm_mul_ps(weight2, _mm_loadu_ps(&bone2.rows[row].x)), _mm_mul_ps(weight3, _mm_loadu_ps(&bone3.rows[row].x)));
+			rows[row] = _mm_mul_ps(_mm_add_ps(blend01, blend23), position);
+		}
+
+		// horizontal sums of the 3 rows : (x0 + x2, y0 + y2, x1 + x3, y1 + y3) then the two halves
+		const __m128 xy = _mm_add_ps(_mm_unpacklo_ps(rows[0], rows[1]), _mm_unpackhi_ps(rows[0], rows[1]));
+		const __m128 zz = _mm_add_ps(_mm_unpacklo_ps(rows[2], rows[2]), _mm_unpackhi_ps(rows[2], rows[2]));
+		const __m128 skinnedPosition = _mm_add_ps(_mm_movelh_ps(xy, zz), _mm_movehl_ps(zz, xy));
+
+		float result[4];
+		_mm_storeu_ps(result, skinnedPosition);
+		outVertices[vertexIndex].position = glm::vec3(result[0], result[1], result[2]);
+		outVertices[vertexIndex].color = vertex.color;
+		outVertices[vertexIndex].texCoord = vertex.texCoord;
+	}
+}
+
+const char* Skinning::getInstructionSetName()
+{
+	return "SSE";
+}
+
+#else
+
+void Skinning::skinVertices(const WeightedVertex* vertices, uint32_t vertexCount, const BoneMatrix* skinningTransforms, Vertex* outVertices)
+{
+	skinVerticesReference(vertices, vertexCount, skinningTransforms, outVertices);
+}
+
+const char* Skinning::getInstructionSetName()
+{
+	return "Scalar";
+}
+
+#endif
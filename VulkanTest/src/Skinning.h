@@ -0,0 +1,20 @@
+#pragma once
+
+#include <cstdint>
+
+#include "Skeleton.h"
+#include "VertexLayout.h"
+
+// Linear blend skinning of weighted vertices into the static mesh layout, on the CPU.
+// Used as the reference of the compute skinning and as its fallback.
+// Weights must sum to one, unused influences have a zero weight and any valid bone index.
+class Skinning
+{
+public:
+	// one vertex per iteration, the 4 influences are blended as 3x4 matrices with SSE
+	static void skinVertices(const WeightedVertex* vertices, uint32_t vertexCount, const BoneMatrix* skinningTransforms, Vertex* outVertices);
+	// reference version with glm
+	static void skinVerticesReference(const WeightedVertex* vertices, uint32_t vertexCount, const BoneMatrix* skinningTransforms, Vertex* outVertices);
+
+	static const char* getInstructionSetName();
+};
@@ -0,0 +1,236 @@
+#include "SkinningNode.h"
+
+#include <stdexcept>
+
+#include "GraphicsContext.h"
+#include "Mesh.h"
+#include "Skinning.h"
+#include "VulkanUtils.h"
+
+// the shader reads and writes the vertices as plain float arrays
+static_assert(sizeof(WeightedVertex) == 16 * sizeof(float), "skinning.comp expects 16 floats per weighted vertex !");
+static_assert(sizeof(Vertex) == 8 * sizeof(float), "skinning.comp expects 8 floats per skinned vertex !");
+
+const uint32_t SkinningNode::WORKGROUP_SIZE;
+
+SkinningNode::SkinningNode()
+{}
+
+SkinningNode::~SkinningNode()
+{
+	destroy();
+}
+
+void SkinningNode::create(const GraphicsContext& _context, SkinningMode _mode, uint32_t _frameCount, const std::vector<char>& computeShaderCode)
+{
+	context = &_context;
+	mode = _mode;
+	frameCount = _frameCount;
+
+	if (mode != SKINNING_MODE_COMPUTE)
+		return;
+
+	if (computeShaderCode.empty())
+		throw std::runtime_error("compute skinning needs the skinning shader code !");
+
+	VkDevice device = context->getDevice();
+
+	// input vertices, bone palette, output vertices
+	std::vector<VkDescriptorSetLayoutBinding> bindings(3);
+	for (uint32_t binding = 0; binding < 3; binding++)
+	{
+		bindings[binding] = {};
+		bindings[binding].binding = binding;
+		bindings[binding].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		bindings[binding].descriptorCount = 1;
+		bindings[binding].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	}
+	descriptorSetLayout = &context->getDescriptorSetLayoutCache().getOrCreate(bindings);
+
+	VkPushConstantRange pushConstantRange = {};
+	pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	pushConstantRange.offset = 0;
+	pushConstantRange.size = sizeof(PushConstants);
+
+	VkPipelineLayoutCreateInfo pipelineLayoutInfo = {};
+	pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	pipelineLayoutInfo.setLayoutCount = 1;
+	pipelineLayoutInfo.pSetLayouts = &descriptorSetLayout->layout;
+	pipelineLayoutInfo.pushConstantRangeCount = 1;
+	pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+	CHECK_VK_THROW_ERROR(vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &pipelineLayout), "failed to create skinning pipeline layout !");
+
+	VkShaderModule shaderModule = createShaderModule(device, computeShaderCode);
+
+	VkComputePipelineCreateInfo pipelineInfo = {};
+	pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+	pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+	pipelineInfo.stage.module = shaderModule;
+	pipelineInfo.stage.pName = "main";
+	pipelineInfo.layout = pipelineLayout;
+	const VkResult result = vkCreateComputePipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &pipeline);
+
+	// the module is not needed once the pipeline is created
+	vkDestroyShaderModule(device, shaderModule, nullptr);
+	CHECK_VK_THROW_ERROR(result, "failed to create skinning pipeline !");
+}
+
+void SkinningNode::destroy()
+{
+	if (context == nullptr)
+		return;
+
+	for (auto& skinnedMesh : skinnedMeshes)
+	{
+		skinnedMesh->mesh->setSkinnedVertexBuffer(nullptr);
+		for (auto& output : skinnedMesh->outputs)
+		{
+			output.destroy();
+		}
+	}
+	skinnedMeshes.clear();
+	dispatches.clear();
+
+	VkDevice device = context->getDevice();
+	if (pipeline != VK_NULL_HANDLE)
+		vkDestroyPipeline(device, pipeline, nullptr);
+	if (pipelineLayout != VK_NULL_HANDLE)
+		vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
+	pipeline = VK_NULL_HANDLE;
+	pipelineLayout = VK_NULL_HANDLE;
+	// owned by the layout cache
+	descriptorSetLayout = nullptr;
+
+	context = nullptr;
+}
+
+uint32_t SkinningNode::addMesh(SkeletalMesh& mesh)
+{
+	const SkeletalMeshData& meshData = mesh.getMeshData();
+	const uint32_t vertexCount = meshData.getVertexBuffer().getItemCount();
+	if (vertexCount == 0)
+		throw std::runtime_error("skinned meshes must be on the GPU side !");
+	if (mode == SKINNING_MODE_CPU && meshData.getVertices().size() != vertexCount)
+		throw std::runtime_error("CPU skinning needs the vertices on the CPU side !");
+
+	std::unique_ptr<SkinnedMesh> skinnedMesh(new SkinnedMesh());
+	skinnedMesh->mesh = &mesh;
+
+	if (mode == SKINNING_MODE_COMPUTE)
+	{
+		// only the GPU writes them, the frame fence waited by Renderer::beginFrame() guarantees the passes reading a slot are done,
+		// so the dispatch doesn't wait for the passes of the previous frame
+		BufferCreateInfo createInfo = BufferCreateInfo::makeNotAligned(context->getPhysicalDevice(), context->getDevice(), vertexCount, sizeof(Vertex), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT);
+		skinnedMesh->outputs.resize(frameCount);
+		for (auto& output : skinnedMesh->outputs)
+		{
+			output.create(createInfo, true);
+		}
+	}
+	else
+	{
+		// written by the CPU while the previous frames may still be drawn, so one buffer per frame slot
+		BufferCreateInfo createInfo = BufferCreateInfo::makeNotAligned(context->getPhysicalDevice(), context->getDevice(), vertexCount, sizeof(Vertex), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT);
+		skinnedMesh->outputs.resize(frameCount);
+		for (auto& output : skinnedMesh->outputs)
+		{
+			output.create(createInfo, false);
+			if (output.map() == nullptr)
+				throw std::runtime_error("failed to map skinned vertex buffer !");
+		}
+	}
+
+	mesh.setSkinnedVertexBuffer(&skinnedMesh->outputs[0]);
+
+	skinnedMeshes.push_back(std::move(skinnedMesh));
+	return static_cast<uint32_t>(skinnedMeshes.size() - 1);
+}
+
+void SkinningNode::beginFrame(uint32_t frameIndex)
+{
+	currentFrame = frameIndex % frameCount;
+	frameNumber++;
+	dispatches.clear();
+}
+
+void SkinningNode::skinMesh(uint32_t meshIndex)
+{
+	SkinnedMesh& skinnedMesh = *skinnedMeshes[meshIndex];
+	if (skinnedMesh.lastSkinnedFrame == frameNumber)
+		return;
+	skinnedMesh.lastSkinnedFrame = frameNumber;
+
+	const SkeletonInstanceData& skeletonInstance = skinnedMesh.mesh->getSkeletonInstanceData();
+
+	if (mode == SKINNING_MODE_COMPUTE)
+	{
+		const uint32_t boneOffset = context->getBonePalette().write(skeletonInstance);
+		dispatches.push_back(Dispatch{ meshIndex, boneOffset });
+		skinnedMesh.mesh->setSkinnedVertexBuffer(&skinnedMesh.outputs[currentFrame]);
+		return;
+	}
+
+	const SkeletonData& skeletonData = *skeletonInstance.skeletonData;
+	skinningTransformsScratch.resize(skeletonData.getBoneCount());
+	Skeleton::computeSkinningTransforms(skeletonData, skeletonInstance.modelTransforms.data(), skinningTransformsScratch.data());
+
+	Buffer& output = skinnedMesh.outputs[currentFrame];
+	const std::vector<WeightedVertex>& vertices = skinnedMesh.mesh->getMeshData().getVertices();
+	Skinning::skinVertices(vertices.data(), static_cast<uint32_t>(vertices.size()), skinningTransformsScratch.data(), static_cast<Vertex*>(output.getMappedData()));
+
+	// host coherent memory, visible to the vertex input of the frame submission
+	skinnedMesh.mesh->setSkinnedVertexBuffer(&output);
+}
+
+void SkinningNode::cmdDispatch(VkCommandBuffer commandBuffer)
+{
+	if (dispatches.empty())
+		return;
+
+	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+
+	DescriptorUpdateData updateDatas[3];
+	updateDatas[1].bufferInfo = context->getBonePalette().getDescriptorBufferInfo();
+
+	for (const Dispatch& dispatch : dispatches)
+	{
+		const SkinnedMesh& skinnedMesh = *skinnedMeshes[dispatch.meshIndex];
+		const Buffer& input = skinnedMesh.mesh->getMeshData().getVertexBuffer();
+		const Buffer& output = skinnedMesh.outputs[currentFrame];
+
+		updateDatas[0].bufferInfo = VkDescriptorBufferInfo{ *input.getBufferHandle(), 0, VK_WHOLE_SIZE };
+		updateDatas[2].bufferInfo = VkDescriptorBufferInfo{ *output.getBufferHandle(), 0, VK_WHOLE_SIZE };
+
+		VkDescriptorSet descriptorSet = context->getDescriptorAllocator().allocateTransient(descriptorSetLayout->layout);
+		vkUpdateDescriptorSetWithTemplate(context->getDevice(), descriptorSet, descriptorSetLayout->updateTemplate, updateDatas);
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0, 1, &descriptorSet, 0, nullptr);
+
+		const PushConstants pushConstants = { input.getItemCount(), dispatch.boneOffset };
+		vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(PushConstants), &pushConstants);
+
+		vkCmdDispatch(commandBuffer, (pushConstants.vertexCount + WORKGROUP_SIZE - 1) / WORKGROUP_SIZE, 1, 1);
+	}
+
+	// the skinned vertices are read by all the following passes
+	VkMemoryBarrier writeBeforeRead = {};
+	writeBeforeRead.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	writeBeforeRead.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	writeBeforeRead.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT;
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, 0, 1, &writeBeforeRead, 0, nullptr, 0, nullptr);
+}
+
+SkinningMode SkinningNode::getMode() const
+{
+	return mode;
+}
+
+uint32_t SkinningNode::getMeshCount() const
+{
+	return static_cast<uint32_t>(skinnedMeshes.size());
+}
+
+uint32_t SkinningNode::getDispatchCount() const
+{
+	return static_cast<uint32_t>(dispatches.size());
+}
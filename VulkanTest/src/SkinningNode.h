@@ -0,0 +1,98 @@
+#pragma once
+
+#include <vulkan/vulkan.hpp>
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "Buffer.h"
+#include "DescriptorSetLayoutCache.h"
+#include "Skeleton.h"
+
+class GraphicsContext;
+class SkeletalMesh;
+
+enum SkinningMode
+{
+	// skinned by a compute shader into a device local buffer per frame slot
+	SKINNING_MODE_COMPUTE,
+	// skinned with Skinning::skinVertices into a host visible buffer per frame slot
+	SKINNING_MODE_CPU
+};
+
+// Skin each visible skeletal mesh once per frame into a vertex buffer in the static Vertex layout.
+// The G-buffer, shadow and depth passes then bind this buffer and draw the mesh like a static one,
+// instead of skinning the same vertices again in each of their vertex shaders.
+// Register it with Renderer::addSkinningNode(), which calls beginFrame() and cmdDispatch() before the processes,
+// then call skinMesh() each frame for the visible meshes once their animation is updated.
+class SkinningNode
+{
+public:
+	struct PushConstants
+	{
+		uint32_t vertexCount;
+		uint32_t boneOffset;
+	};
+
+	static const uint32_t WORKGROUP_SIZE = 64;
+
+private:
+	struct SkinnedMesh
+	{
+		SkeletalMesh* mesh = nullptr;
+		// one buffer per frame slot, the passes of the frames in flight read their own
+		std::vector<Buffer> outputs;
+		// the last frame the mesh was skinned, so it is skinned only once per frame
+		uint64_t lastSkinnedFrame = ~0ull;
+	};
+
+	struct Dispatch
+	{
+		uint32_t meshIndex;
+		uint32_t boneOffset;
+	};
+
+	const GraphicsContext* context = nullptr;
+	SkinningMode mode = SKINNING_MODE_COMPUTE;
+	uint32_t frameCount = 0;
+
+	// stable addresses, the meshes keep a pointer to their output buffer
+	std::vector<std::unique_ptr<SkinnedMesh>> skinnedMeshes;
+
+	uint64_t frameNumber = 0;
+	uint32_t currentFrame = 0;
+
+	// compute mode
+	const CachedDescriptorSetLayout* descriptorSetLayout = nullptr;
+	VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+	VkPipeline pipeline = VK_NULL_HANDLE;
+	std::vector<Dispatch> dispatches;
+
+	// CPU mode, skinning matrices of the mesh being skinned
+	BoneMatrixStorage skinningTransformsScratch;
+
+public:
+	SkinningNode();
+	~SkinningNode();
+
+	// computeShaderCode is the SPIR-V of shaders/skinning.comp, only needed in compute mode
+	void create(const GraphicsContext& _context, SkinningMode _mode, uint32_t _frameCount, const std::vector<char>& computeShaderCode = std::vector<char>());
+	void destroy();
+
+	// Create the skinned vertex buffers of the mesh and make it draw from them. Return the index to skin it.
+	// The mesh must own its GPU buffers, in CPU mode it must also keep its vertices on the CPU side.
+	uint32_t addMesh(SkeletalMesh& mesh);
+
+	void beginFrame(uint32_t frameIndex);
+	// The skeleton instance of the mesh must be up to date. Only the first call of a frame skins the mesh.
+	// In compute mode the skinning matrices are written in the bone palette of the GraphicsContext.
+	void skinMesh(uint32_t meshIndex);
+	// record the compute dispatches of the meshes skinned this frame, nothing to do in CPU mode
+	void cmdDispatch(VkCommandBuffer commandBuffer);
+
+	SkinningMode getMode() const;
+	uint32_t getMeshCount() const;
+	// compute dispatches of the current frame
+	uint32_t getDispatchCount() const;
+};
@@ -60,7 +60,7 @@ void testRenderer()
 	/////////////////////////////////////////////////
 
 	std::unique_ptr<LightedGeometryRenderNode> lightedGeometryRenderNode;
-	lightedGeometryRenderNode->create(renderer.getGraphicsContext().getDevice(), renderer.getGraphicsContext().getCommandPool());
+	lightedGeometryRenderNode->create(renderer.getGraphicsContext(), renderer.getWindowContext());
 
 	std::vector<RenderableType> lightedGeometryRenderableTypes = { RenderableType::PIPELINE_TYPE_BILLBOARD
 		, RenderableType::PIPELINE_TYPE_SKELETAL_MESH
@@ -95,7 +95,7 @@ void testRenderer()
 
 	// make a post process node
 	std::unique_ptr<BloomRenderNode> bloomRenderNode;
-	bloomRenderNode->create(renderer.getGraphicsContext().getDevice(), renderer.getGraphicsContext().getCommandPool());
+	bloomRenderNode->create(renderer.getGraphicsContext(), renderer.getWindowContext());
 
 	std::shared_ptr<RenderBatch> postProcessBatch;
 	postProcessBatch->create(renderer.getGraphicsContext(), { RenderableType::PIPELINE_TYPE_BLIT_QUAD, 0, 1 });
@@ -131,6 +131,9 @@ void testRenderer()
 
 	// Game loop : 
 
+	// wait for the GPU to release the resources of this frame slot before writing them
+	renderer.beginFrame();
+
 	// Game update -> update positions for example
 
 	// We need to update items inside the batch, then record the batch command again
@@ -30,39 +30,16 @@ class Texture2D : public MaterialInput, public MaterialParameter
 	}
 
 
-	VkWriteDescriptorSet getWriteDescriptorSet(const VkDescriptorSet& owningSet) const
+	void getDescriptorUpdateData(DescriptorUpdateData& outData) const
 	{
-		VkDescriptorImageInfo imageInfo = {};
-		imageInfo.imageView = image.getImageViewHandle();
-		imageInfo.imageLayout = image.getLayout();
-		imageInfo.sampler = sampler.getSamplerHandle();
-
-		VkWriteDescriptorSet descriptorSetWrite;
-		descriptorSetWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-		descriptorSetWrite.dstSet = owningSet;
-		descriptorSetWrite.dstBinding = 0;
-		descriptorSetWrite.dstArrayElement = 0;
-		descriptorSetWrite.descriptorType = getDescriptorType();
-		descriptorSetWrite.descriptorCount = 1;
-		descriptorSetWrite.pImageInfo = &imageInfo;
-
-		return descriptorSetWrite;
+		outData.imageInfo.imageView = image.getImageViewHandle();
+		outData.imageInfo.imageLayout = image.getLayout();
+		outData.imageInfo.sampler = sampler.getSamplerHandle();
 	}
 
+	// the image info carry the sampler : it is a combined image sampler
 	VkDescriptorType getDescriptorType() const
 	{
-		return VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
-	}
-
-	const VkDescriptorSetLayoutBinding& getDescriptorSetLayoutBinding() const
-	{
-		VkDescriptorSetLayoutBinding binding;
-		binding.binding = 0;
-		binding.descriptorCount = 1;
-		binding.descriptorType = getDescriptorType();
-		binding.pImmutableSamplers = nullptr;
-		binding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
-
-		return binding;
+		return VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
 	}
 };
\ No newline at end of file
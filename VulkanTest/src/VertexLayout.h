@@ -0,0 +1,357 @@
+#pragma once
+
+#include <vulkan/vulkan.hpp>
+#include <glm/glm.hpp>
+#include <glm/gtc/packing.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+
+// Vertex attribute descriptions are generated from the member types of the vertex :
+// each member type maps to one VkFormat and members are given consecutive locations.
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/////////// Packed attribute types
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// 4 signed normalized 16 bits values, read as a vec4 in [-1, 1]
+// stored as 16 bits values to keep a 2 bytes alignment inside the vertex
+struct Snorm16x4
+{
+	int16_t values[4];
+};
+
+// 2 signed normalized 16 bits values, read as a vec2 in [-1, 1]
+struct Snorm16x2
+{
+	uint32_t packed;
+};
+
+// 2 half floats, read as a vec2
+struct Half2
+{
+	uint32_t packed;
+};
+
+// 4 unsigned normalized 8 bits values, read as a vec4 in [0, 1]
+struct Unorm8x4
+{
+	uint32_t packed;
+};
+
+// 4 unsigned 8 bits integers, read as a uvec4
+struct Uint8x4
+{
+	uint8_t values[4];
+};
+
+template<typename T>
+struct VertexAttributeFormat
+{
+	static_assert(sizeof(T) == 0, "type not supported as a vertex attribute !");
+};
+
+template<> struct VertexAttributeFormat<float> { static constexpr VkFormat format = VK_FORMAT_R32_SFLOAT; };
+template<> struct VertexAttributeFormat<glm::vec2> { static constexpr VkFormat format = VK_FORMAT_R32G32_SFLOAT; };
+template<> struct VertexAttributeFormat<glm::vec3> { static constexpr VkFormat format = VK_FORMAT_R32G32B32_SFLOAT; };
+template<> struct VertexAttributeFormat<glm::vec4> { static constexpr VkFormat format = VK_FORMAT_R32G32B32A32_SFLOAT; };
+template<> struct VertexAttributeFormat<glm::ivec4> { static constexpr VkFormat format = VK_FORMAT_R32G32B32A32_SINT; };
+template<> struct VertexAttributeFormat<Snorm16x4> { static constexpr VkFormat format = VK_FORMAT_R16G16B16A16_SNORM; };
+template<> struct VertexAttributeFormat<Snorm16x2> { static constexpr VkFormat format = VK_FORMAT_R16G16_SNORM; };
+template<> struct VertexAttributeFormat<Half2> { static constexpr VkFormat format = VK_FORMAT_R16G16_SFLOAT; };
+template<> struct VertexAttributeFormat<Unorm8x4> { static constexpr VkFormat format = VK_FORMAT_R8G8B8A8_UNORM; };
+template<> struct VertexAttributeFormat<Uint8x4> { static constexpr VkFormat format = VK_FORMAT_R8G8B8A8_UINT; };
+
+struct VertexAttribute
+{
+	VkFormat format;
+	uint32_t offset;
+};
+
+// used inside the getAttributes() function of a vertex type
+#define VERTEX_ATTRIBUTE(VertexType, member) VertexAttribute{ VertexAttributeFormat<decltype(VertexType::member)>::format, static_cast<uint32_t>(offsetof(VertexType, member)) }
+
+// Give getBindingDescription() and getAttributeDescriptions() to a vertex type declaring :
+//	static std::array<VertexAttribute, N> getAttributes();
+// The location of an attribute is its index in the array.
+template<typename VertexType, size_t AttributeCount>
+struct TVertexLayout
+{
+	static VkVertexInputBindingDescription getBindingDescription()
+	{
+		VkVertexInputBindingDescription bindingDescription = {};
+		bindingDescription.binding = 0;
+		bindingDescription.stride = sizeof(VertexType);
+		bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+		return bindingDescription;
+	}
+
+	static std::array<VkVertexInputAttributeDescription, AttributeCount> getAttributeDescriptions()
+	{
+		const std::array<VertexAttribute, AttributeCount> attributes = VertexType::getAttributes();
+
+		std::array<VkVertexInputAttributeDescription, AttributeCount> attributeDescriptions = {};
+		for (uint32_t location = 0; location < AttributeCount; location++)
+		{
+			attributeDescriptions[location].binding = 0;
+			attributeDescriptions[location].location = location;
+			attributeDescriptions[location].format = attributes[location].format;
+			attributeDescriptions[location].offset = attributes[location].offset;
+		}
+
+		return attributeDescriptions;
+	}
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/////////// Quantization
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Per mesh dequantization of 16 bits positions : position = offset + scale * quantizedPosition
+// The MeshRenderer folds getDequantizationMatrix() in the transform of the mesh, so the vertex shader is unchanged.
+struct VertexQuantization
+{
+	glm::vec3 positionOffset = glm::vec3(0, 0, 0);
+	glm::vec3 positionScale = glm::vec3(1, 1, 1);
+
+	static VertexQuantization fromBounds(const glm::vec3& boundsMin, const glm::vec3& boundsMax)
+	{
+		VertexQuantization quantization;
+		quantization.positionOffset = (boundsMin + boundsMax) * 0.5f;
+		// avoid a null scale on flat meshes
+		quantization.positionScale = glm::max((boundsMax - boundsMin) * 0.5f, glm::vec3(1e-6f));
+		return quantization;
+	}
+
+	Snorm16x4 quantizePosition(const glm::vec3& position) const
+	{
+		glm::vec3 normalized = glm::clamp((position - positionOffset) / positionScale, glm::vec3(-1.f), glm::vec3(1.f));
+		uint64_t packed = glm::packSnorm4x16(glm::vec4(normalized, 1.f));
+
+		Snorm16x4 quantized;
+		memcpy(quantized.values, &packed, sizeof(quantized.values));
+		return quantized;
+	}
+
+	glm::vec3 dequantizePosition(const Snorm16x4& quantized) const
+	{
+		uint64_t packed = 0;
+		memcpy(&packed, quantized.values, sizeof(quantized.values));
+		return positionOffset + positionScale * glm::vec3(glm::unpackSnorm4x16(packed));
+	}
+
+	glm::mat4 getDequantizationMatrix() const
+	{
+		glm::mat4 matrix(1.f);
+		matrix[0][0] = positionScale.x;
+		matrix[1][1] = positionScale.y;
+		matrix[2][2] = positionScale.z;
+		matrix[3] = glm::vec4(positionOffset, 1.f);
+		return matrix;
+	}
+};
+
+// Octahedral encoding of a unit vector in 2 values
+inline Snorm16x2 encodeOctahedralNormal(const glm::vec3& normal)
+{
+	const float length = std::abs(normal.x) + std::abs(normal.y) + std::abs(normal.z);
+	// degenerated normals are encoded as +Z
+	if (length <= 0.f)
+		return Snorm16x2{ glm::packSnorm2x16(glm::vec2(0.f)) };
+
+	glm::vec3 n = normal / length;
+	glm::vec2 encoded(n.x, n.y);
+	if (n.z < 0.f)
+	{
+		// fold the lower hemisphere over the diagonals
+		encoded.x = (1.f - std::abs(n.y)) * (n.x >= 0.f ? 1.f : -1.f);
+		encoded.y = (1.f - std::abs(n.x)) * (n.y >= 0.f ? 1.f : -1.f);
+	}
+
+	return Snorm16x2{ glm::packSnorm2x16(encoded) };
+}
+
+inline glm::vec3 decodeOctahedralNormal(const Snorm16x2& encodedNormal)
+{
+	glm::vec2 encoded = glm::unpackSnorm2x16(encodedNormal.packed);
+	glm::vec3 n(encoded.x, encoded.y, 1.f - std::abs(encoded.x) - std::abs(encoded.y));
+	float t = std::max(-n.z, 0.f);
+	n.x += n.x >= 0.f ? -t : t;
+	n.y += n.y >= 0.f ? -t : t;
+	return glm::normalize(n);
+}
+
+// Weights are stored on 8 bits and must still sum to 255 after rounding
+inline Unorm8x4 quantizeBoneWeights(const glm::vec4& weights)
+{
+	float sum = weights.x + weights.y + weights.z + weights.w;
+	glm::vec4 normalized = sum > 0.f ? weights / sum : glm::vec4(1, 0, 0, 0);
+
+	int quantized[4];
+	int total = 0;
+	int largest = 0;
+	for (int i = 0; i < 4; i++)
+	{
+		quantized[i] = static_cast<int>(std::round(normalized[i] * 255.f));
+		total += quantized[i];
+		if (quantized[i] > quantized[largest])
+			largest = i;
+	}
+	// give the rounding error to the most influent bone
+	quantized[largest] += 255 - total;
+
+	uint32_t packed = 0;
+	for (int i = 0; i < 4; i++)
+		packed |= static_cast<uint32_t>(quantized[i]) << (8 * i);
+
+	return Unorm8x4{ packed };
+}
+
+inline Uint8x4 quantizeBoneIndices(const glm::ivec4& boneIndices)
+{
+	Uint8x4 quantized;
+	for (int i = 0; i < 4; i++)
+	{
+		assert(boneIndices[i] >= 0 && boneIndices[i] < 256);
+		quantized.values[i] = static_cast<uint8_t>(boneIndices[i]);
+	}
+
+	return quantized;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/////////// Full precision vertices
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+struct Vertex : public TVertexLayout<Vertex, 3>
+{
+	glm::vec3 position;
+	glm::vec3 color;
+	glm::vec2 texCoord;
+
+	static std::array<VertexAttribute, 3> getAttributes()
+	{
+		return { {
+			VERTEX_ATTRIBUTE(Vertex, position),
+			VERTEX_ATTRIBUTE(Vertex, color),
+			VERTEX_ATTRIBUTE(Vertex, texCoord)
+		} };
+	}
+};
+
+inline glm::vec3 getVertexPosition(const Vertex& vertex, const VertexQuantization&)
+{
+	return vertex.position;
+}
+
+struct WeightedVertex : public TVertexLayout<WeightedVertex, 5>
+{
+	glm::vec3 position;
+	glm::vec3 color;
+	glm::vec2 texCoord;
+	glm::ivec4 boneIndices;
+	glm::vec4 weights;
+
+	static std::array<VertexAttribute, 5> getAttributes()
+	{
+		return { {
+			VERTEX_ATTRIBUTE(WeightedVertex, position),
+			VERTEX_ATTRIBUTE(WeightedVertex, color),
+			VERTEX_ATTRIBUTE(WeightedVertex, texCoord),
+			VERTEX_ATTRIBUTE(WeightedVertex, boneIndices),
+			VERTEX_ATTRIBUTE(WeightedVertex, weights)
+		} };
+	}
+};
+
+inline glm::vec3 getVertexPosition(const WeightedVertex& vertex, const VertexQuantization&)
+{
+	return vertex.position;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/////////// Packed vertices
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// 20 bytes static vertex
+struct PackedStaticVertex : public TVertexLayout<PackedStaticVertex, 4>
+{
+	Snorm16x4 position;
+	Snorm16x2 normal;
+	Half2 texCoord;
+	Unorm8x4 color;
+
+	static std::array<VertexAttribute, 4> getAttributes()
+	{
+		return { {
+			VERTEX_ATTRIBUTE(PackedStaticVertex, position),
+			VERTEX_ATTRIBUTE(PackedStaticVertex, normal),
+			VERTEX_ATTRIBUTE(PackedStaticVertex, texCoord),
+			VERTEX_ATTRIBUTE(PackedStaticVertex, color)
+		} };
+	}
+
+	static PackedStaticVertex pack(const glm::vec3& position, const glm::vec3& normal, const glm::vec3& color, const glm::vec2& texCoord, const VertexQuantization& quantization)
+	{
+		PackedStaticVertex vertex;
+		vertex.position = quantization.quantizePosition(position);
+		vertex.normal = encodeOctahedralNormal(normal);
+		vertex.texCoord = Half2{ glm::packHalf2x16(texCoord) };
+		vertex.color = Unorm8x4{ glm::packUnorm4x8(glm::vec4(color, 1.f)) };
+		return vertex;
+	}
+};
+
+// 28 bytes skinned vertex, up to 256 bones per mesh
+struct PackedSkinnedVertex : public TVertexLayout<PackedSkinnedVertex, 6>
+{
+	Snorm16x4 position;
+	Snorm16x2 normal;
+	Half2 texCoord;
+	Unorm8x4 color;
+	Uint8x4 boneIndices;
+	Unorm8x4 weights;
+
+	static std::array<VertexAttribute, 6> getAttributes()
+	{
+		return { {
+			VERTEX_ATTRIBUTE(PackedSkinnedVertex, position),
+			VERTEX_ATTRIBUTE(PackedSkinnedVertex, normal),
+			VERTEX_ATTRIBUTE(PackedSkinnedVertex, texCoord),
+			VERTEX_ATTRIBUTE(PackedSkinnedVertex, color),
+			VERTEX_ATTRIBUTE(PackedSkinnedVertex, boneIndices),
+			VERTEX_ATTRIBUTE(PackedSkinnedVertex, weights)
+		} };
+	}
+
+	static PackedSkinnedVertex pack(const glm::vec3& position, const glm::vec3& normal, const glm::vec3& color, const glm::vec2& texCoord
+		, const glm::ivec4& boneIndices, const glm::vec4& weights, const VertexQuantization& quantization)
+	{
+		PackedSkinnedVertex vertex;
+		vertex.position = quantization.quantizePosition(position);
+		vertex.normal = encodeOctahedralNormal(normal);
+		vertex.texCoord = Half2{ glm::packHalf2x16(texCoord) };
+		vertex.color = Unorm8x4{ glm::packUnorm4x8(glm::vec4(color, 1.f)) };
+		vertex.boneIndices = quantizeBoneIndices(boneIndices);
+		vertex.weights = quantizeBoneWeights(weights);
+		return vertex;
+	}
+};
+
+// positions used by the load time mesh processing
+inline glm::vec3 getVertexPosition(const PackedStaticVertex& vertex, const VertexQuantization& quantization)
+{
+	return quantization.dequantizePosition(vertex.position);
+}
+
+inline glm::vec3 getVertexPosition(const PackedSkinnedVertex& vertex, const VertexQuantization& quantization)
+{
+	return quantization.dequantizePosition(vertex.position);
+}
+
+static_assert(sizeof(PackedStaticVertex) == 20, "PackedStaticVertex must not be padded !");
+static_assert(sizeof(PackedSkinnedVertex) == 28, "PackedSkinnedVertex must not be padded !");
@@ -57,9 +57,10 @@ void cmdCopyBufferToBuffer(VkDevice device, VkCommandBuffer commandBuffer, VkQue
 	std::vector<VkBufferCopy> copyRegionInfos(copyInfoCount);
 	for (size_t i = 0; i < copyInfoCount; i++)
 	{
-		copyRegionInfos[i].srcOffset = copyInfo->srcOffset;
-		copyRegionInfos[i].dstOffset = copyInfo->dstOffset;
-		copyRegionInfos[i].size = copyInfo->size;
+		// offsets are given in items, with the stride of each buffer
+		copyRegionInfos[i].srcOffset = copyInfo[i].srcItemCountOffset * from.getItemSize();
+		copyRegionInfos[i].dstOffset = copyInfo[i].dstItemCountOffset * to.getItemSize();
+		copyRegionInfos[i].size = copyInfo[i].itemCount * to.getItemSize();
 	}
 	vkCmdCopyBuffer(commandBuffer, *from.getBufferHandle(), *to.getBufferHandle(), copyInfoCount, copyRegionInfos.data());
 }
@@ -199,6 +200,35 @@ TransitionAccessInfo findTransitionAccessInfo(VkImageLayout oldLayout, VkImageLa
 	return outAccessInfo;
 }
 
+VkPipelineViewportStateCreateInfo makeDynamicViewportState()
+{
+	VkPipelineViewportStateCreateInfo viewportState = {};
+	viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+	viewportState.viewportCount = 1;
+	viewportState.pViewports = nullptr;
+	viewportState.scissorCount = 1;
+	viewportState.pScissors = nullptr;
+
+	return viewportState;
+}
+
+void cmdSetViewportAndScissor(VkCommandBuffer commandBuffer, const VkExtent2D& extent)
+{
+	VkViewport viewport = {};
+	viewport.x = 0.0f;
+	viewport.y = 0.0f;
+	viewport.width = (float)extent.width;
+	viewport.height = (float)extent.height;
+	viewport.minDepth = 0.0f;
+	viewport.maxDepth = 1.0f;
+	vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+
+	VkRect2D scissor = {};
+	scissor.offset = { 0, 0 };
+	scissor.extent = extent;
+	vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+}
+
 bool hasStencilComponent(VkFormat format)
 {
 	return format == VK_FORMAT_D32_SFLOAT_S8_UINT || format == VK_FORMAT_D24_UNORM_S8_UINT;
@@ -63,6 +63,13 @@ void cmdTransitionImageLayout(VkDevice device, VkCommandBuffer commandBuffer, Vk
 void singleCmdTransitionImageLayout(VkDevice device, VkCommandPool commandPool, VkQueue transferQueue
 	, VkImage image, VkImageLayout oldLayout, VkImageLayout newLayout);
 
+// Dynamic states
+
+// Viewport state with one viewport and one scissor, their values are given at record time
+VkPipelineViewportStateCreateInfo makeDynamicViewportState();
+// Set a viewport and a scissor covering the whole extent
+void cmdSetViewportAndScissor(VkCommandBuffer commandBuffer, const VkExtent2D& extent);
+
 // Format selection
 bool hasStencilComponent(VkFormat format);
 VkFormat findSupportedFormat(VkPhysicalDevice& physicalDevice, const std::vector<VkFormat>& candidates, VkImageTiling tiling, VkFormatFeatureFlags features);
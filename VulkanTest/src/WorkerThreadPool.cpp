@@ -0,0 +1,112 @@
+#include "WorkerThreadPool.h"
+
+#include <algorithm>
+
+WorkerThreadPool::WorkerThreadPool()
+	: nextBatch(0)
+{}
+
+WorkerThreadPool::~WorkerThreadPool()
+{
+	destroy();
+}
+
+void WorkerThreadPool::create(uint32_t workerCount)
+{
+	destroy();
+
+	if (workerCount == ~0u)
+	{
+		const uint32_t hardwareThreadCount = std::thread::hardware_concurrency();
+		workerCount = hardwareThreadCount > 1 ? hardwareThreadCount - 1 : 0;
+	}
+
+	stopping = false;
+	workers.reserve(workerCount);
+	for (uint32_t i = 0; i < workerCount; i++)
+		workers.push_back(std::thread(&WorkerThreadPool::workerMain, this, i + 1));
+}
+
+void WorkerThreadPool::destroy()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	workAvailable.notify_all();
+
+	for (std::thread& worker : workers)
+		worker.join();
+	workers.clear();
+}
+
+void WorkerThreadPool::parallelFor(uint32_t count, uint32_t _batchSize, const BatchFunction& function)
+{
+	if (count == 0)
+		return;
+
+	_batchSize = std::max(1u, _batchSize);
+	if (workers.empty() || count <= _batchSize)
+	{
+		for (uint32_t begin = 0; begin < count; begin += _batchSize)
+			function(begin, std::min(count, begin + _batchSize), 0);
+		return;
+	}
+
+	std::lock_guard<std::mutex> parallelForLock(parallelForMutex);
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		batchFunction = &function;
+		itemCount = count;
+		batchSize = _batchSize;
+		nextBatch.store(0);
+		activeWorkers = static_cast<uint32_t>(workers.size());
+		generation++;
+	}
+	workAvailable.notify_all();
+
+	runBatches(0);
+
+	// the function must stay alive until every worker left runBatches
+	std::unique_lock<std::mutex> lock(mutex);
+	workDone.wait(lock, [this]() { return activeWorkers == 0; });
+	batchFunction = nullptr;
+}
+
+uint32_t WorkerThreadPool::getThreadCount() const
+{
+	return static_cast<uint32_t>(workers.size()) + 1;
+}
+
+void WorkerThreadPool::workerMain(uint32_t threadIndex)
+{
+	uint64_t seenGeneration = 0;
+	while (true)
+	{
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			workAvailable.wait(lock, [&]() { return stopping || generation != seenGeneration; });
+			if (stopping)
+				return;
+			seenGeneration = generation;
+		}
+
+		runBatches(threadIndex);
+
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			activeWorkers--;
+		}
+		workDone.notify_one();
+	}
+}
+
+void WorkerThreadPool::runBatches(uint32_t threadIndex)
+{
+	const uint32_t batchCount = (itemCount + batchSize - 1) / batchSize;
+	for (uint32_t batch = nextBatch.fetch_add(1); batch < batchCount; batch = nextBatch.fetch_add(1))
+	{
+		const uint32_t begin = batch * batchSize;
+		(*batchFunction)(begin, std::min(itemCount, begin + batchSize), threadIndex);
+	}
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads running data parallel loops.
+// The calling thread takes part in the work, so a pool without worker runs everything inline.
+class WorkerThreadPool
+{
+public:
+	// begin and end of a batch of items, index of the thread running it (0 is the calling thread)
+	typedef std::function<void(uint32_t begin, uint32_t end, uint32_t threadIndex)> BatchFunction;
+
+private:
+	std::vector<std::thread> workers;
+
+	std::mutex mutex;
+	std::condition_variable workAvailable;
+	std::condition_variable workDone;
+	// one loop at a time, callers are serialized by parallelForMutex
+	std::mutex parallelForMutex;
+
+	// current loop, only read by the workers after a generation change
+	const BatchFunction* batchFunction = nullptr;
+	uint32_t itemCount = 0;
+	uint32_t batchSize = 1;
+	std::atomic<uint32_t> nextBatch;
+	uint32_t activeWorkers = 0;
+	uint64_t generation = 0;
+	bool stopping = false;
+
+	void workerMain(uint32_t threadIndex);
+	void runBatches(uint32_t threadIndex);
+
+public:
+	WorkerThreadPool();
+	~WorkerThreadPool();
+	WorkerThreadPool(const WorkerThreadPool&) = delete;
+	WorkerThreadPool& operator=(const WorkerThreadPool&) = delete;
+
+	// default worker count leaves one hardware thread to the calling thread
+	void create(uint32_t workerCount = ~0u);
+	void destroy();
+
+	// Split [0, count[ in batches of batchSize items and run them on all the threads, return once all are done.
+	// The function must not call parallelFor itself.
+	void parallelFor(uint32_t count, uint32_t batchSize, const BatchFunction& function);
+
+	// number of threads running batches, including the calling thread
+	uint32_t getThreadCount() const;
+};
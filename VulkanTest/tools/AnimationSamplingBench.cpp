@@ -0,0 +1,404 @@
+// Animation sampling benchmark : every frame, sample a pose for each skeleton of a crowd.
+// Compares the former bone major layout, the structure of arrays reference and SIMD samplers, and the compressed clips.
+// The SIMD poses must match the reference ones within the slerp approximation error,
+// and the compressed clips must come back unchanged from an animation file.
+// Build with VulkanTest/src in the include path, linking SkeletalAnimation.cpp, AnimationCompression.cpp, AnimationFile.cpp and MappedFile.cpp.
+//
+// usage : AnimationSamplingBench [--skeletons <count>] [--bones <count>] [--frames <count>] [--seed <value>] [--file <path>]
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "AnimationCompression.h"
+#include "AnimationFile.h"
+#include "AnimationPose.h"
+#include "MappedFile.h"
+#include "SkeletalAnimation.h"
+
+namespace
+{
+	const float Pi = 3.14159265f;
+	const uint32_t ClipCount = 8;
+	const uint32_t KeyCount = 60;
+	const float TicksPerSecond = 30.f;
+	const float FrameTime = 1.f / 60.f;
+	// the SIMD slerp is a polynomial approximation, the nlerp is exact
+	const float SlerpTolerance = 5e-5f;
+	const float NlerpTolerance = 1e-5f;
+
+	struct BenchSettings
+	{
+		uint32_t skeletonCount = 1000;
+		uint32_t boneCount = 100;
+		uint32_t frameCount = 100;
+		uint32_t seed = 1;
+		// written then read back by the file round trip
+		std::string filePath = "AnimationSamplingBench.anim";
+	};
+
+	// a clip in the layout used before the structure of arrays one, one track per bone
+	struct BoneMajorClip
+	{
+		std::vector<std::vector<glm::quat>> bonesRotation;
+		std::vector<std::vector<glm::vec3>> bonesTranslation;
+	};
+
+	struct Crowd
+	{
+		std::vector<BoneMajorClip> boneMajorClips;
+		std::vector<SkeletalAnimation> clips;
+		std::vector<SkeletalAnimation> compressedClips;
+		// per skeleton
+		std::vector<uint32_t> clipIndices;
+		std::vector<float> timeOffsets;
+		std::vector<uint32_t> keyCursors;
+		std::vector<AnimationPose> poses;
+	};
+
+	double elapsedMilliseconds(std::chrono::high_resolution_clock::time_point start)
+	{
+		return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+	}
+
+	glm::quat makeRotation(const glm::vec3& axis, float angle)
+	{
+		const float sinHalfAngle = std::sin(0.5f * angle);
+		return glm::quat(std::cos(0.5f * angle), axis.x * sinHalfAngle, axis.y * sinHalfAngle, axis.z * sinHalfAngle);
+	}
+
+	// every bone swings around its own axis, keys are a few degrees apart like a captured clip
+	BoneMajorClip makeClip(uint32_t boneCount, std::mt19937& random)
+	{
+		std::uniform_real_distribution<float> unit(-1.f, 1.f);
+		std::uniform_real_distribution<float> phase(0.f, 2.f * Pi);
+		std::uniform_real_distribution<float> amplitude(0.1f, 1.f);
+
+		BoneMajorClip clip;
+		clip.bonesRotation.resize(boneCount);
+		clip.bonesTranslation.resize(boneCount);
+		for (uint32_t boneIndex = 0; boneIndex < boneCount; boneIndex++)
+		{
+			glm::vec3 axis(unit(random), unit(random), unit(random));
+			axis = glm::length(axis) > 0.f ? glm::normalize(axis) : glm::vec3(0.f, 1.f, 0.f);
+			const float bonePhase = phase(random);
+			const float boneAmplitude = amplitude(random);
+			const glm::vec3 offset(unit(random), unit(random) + 1.f, unit(random));
+
+			for (uint32_t keyIndex = 0; keyIndex < KeyCount; keyIndex++)
+			{
+				const float cycle = 2.f * Pi * keyIndex / (KeyCount - 1);
+				clip.bonesRotation[boneIndex].push_back(makeRotation(axis, boneAmplitude * std::sin(cycle + bonePhase)));
+				clip.bonesTranslation[boneIndex].push_back(offset * (1.f + 0.1f * std::cos(cycle + bonePhase)));
+			}
+		}
+
+		return clip;
+	}
+
+	Crowd makeCrowd(const BenchSettings& settings)
+	{
+		std::mt19937 random(settings.seed);
+		std::vector<float> keysTime(KeyCount);
+		for (uint32_t keyIndex = 0; keyIndex < KeyCount; keyIndex++)
+			keysTime[keyIndex] = static_cast<float>(keyIndex);
+
+		Crowd crowd;
+		crowd.clips.resize(ClipCount);
+		crowd.compressedClips.resize(ClipCount);
+		for (uint32_t clipIndex = 0; clipIndex < ClipCount; clipIndex++)
+		{
+			crowd.boneMajorClips.push_back(makeClip(settings.boneCount, random));
+			const BoneMajorClip& clip = crowd.boneMajorClips.back();
+			crowd.clips[clipIndex].create(KeyCount - 1.f, TicksPerSecond, keysTime, clip.bonesRotation, clip.bonesTranslation);
+			AnimationCompressor::compress(crowd.clips[clipIndex], AnimationCompressionSettings(), crowd.compressedClips[clipIndex]);
+		}
+
+		std::uniform_int_distribution<uint32_t> clipIndex(0, ClipCount - 1);
+		std::uniform_real_distribution<float> timeOffset(0.f, (KeyCount - 1) / TicksPerSecond);
+		crowd.clipIndices.resize(settings.skeletonCount);
+		crowd.timeOffsets.resize(settings.skeletonCount);
+		crowd.keyCursors.resize(settings.skeletonCount);
+		crowd.poses.resize(settings.skeletonCount);
+		for (uint32_t skeletonIndex = 0; skeletonIndex < settings.skeletonCount; skeletonIndex++)
+		{
+			crowd.clipIndices[skeletonIndex] = clipIndex(random);
+			crowd.timeOffsets[skeletonIndex] = timeOffset(random);
+			crowd.poses[skeletonIndex].resize(settings.boneCount);
+		}
+
+		return crowd;
+	}
+
+	// clip time of a skeleton at a frame, looping
+	float getAnimationTime(const Crowd& crowd, uint32_t skeletonIndex, uint32_t frameIndex)
+	{
+		const float time = (frameIndex * FrameTime + crowd.timeOffsets[skeletonIndex]) * TicksPerSecond;
+		return std::fmod(time, KeyCount - 1.f);
+	}
+
+	typedef std::function<void(const SkeletalAnimation& clip, uint32_t keyIndex, uint32_t nextKeyIndex, float keyAlpha, AnimationPose& outPose)> SampleFunction;
+
+	// sample every skeleton of the crowd at a frame, the key cursors move forward like in a game
+	void sampleCrowd(Crowd& crowd, const std::vector<SkeletalAnimation>& clips, uint32_t frameIndex, const SampleFunction& sampleFunction)
+	{
+		for (uint32_t skeletonIndex = 0; skeletonIndex < crowd.poses.size(); skeletonIndex++)
+		{
+			const SkeletalAnimation& clip = clips[crowd.clipIndices[skeletonIndex]];
+			float keyAlpha = 0.f;
+			const uint32_t keyIndex = clip.findKeyIndex(getAnimationTime(crowd, skeletonIndex, frameIndex), crowd.keyCursors[skeletonIndex], keyAlpha);
+			sampleFunction(clip, keyIndex, clip.getNextKeyIndex(keyIndex), keyAlpha, crowd.poses[skeletonIndex]);
+		}
+	}
+
+	// average time of a crowd sampling
+	double timeSampling(const BenchSettings& settings, Crowd& crowd, const std::vector<SkeletalAnimation>& clips, const SampleFunction& sampleFunction)
+	{
+		std::fill(crowd.keyCursors.begin(), crowd.keyCursors.end(), 0u);
+		const auto start = std::chrono::high_resolution_clock::now();
+		for (uint32_t frameIndex = 0; frameIndex < settings.frameCount; frameIndex++)
+			sampleCrowd(crowd, clips, frameIndex, sampleFunction);
+		return elapsedMilliseconds(start) / settings.frameCount;
+	}
+
+	// the former sampling : one bone after the other, each reading its own tracks
+	double timeBoneMajorSampling(const BenchSettings& settings, Crowd& crowd, std::vector<std::vector<BoneTransform>>& outTransforms)
+	{
+		outTransforms.assign(settings.skeletonCount, std::vector<BoneTransform>(settings.boneCount));
+		std::fill(crowd.keyCursors.begin(), crowd.keyCursors.end(), 0u);
+		const auto start = std::chrono::high_resolution_clock::now();
+		for (uint32_t frameIndex = 0; frameIndex < settings.frameCount; frameIndex++)
+		{
+			for (uint32_t skeletonIndex = 0; skeletonIndex < settings.skeletonCount; skeletonIndex++)
+			{
+				const uint32_t clipIndex = crowd.clipIndices[skeletonIndex];
+				const BoneMajorClip& clip = crowd.boneMajorClips[clipIndex];
+				float keyAlpha = 0.f;
+				const uint32_t keyIndex = crowd.clips[clipIndex].findKeyIndex(getAnimationTime(crowd, skeletonIndex, frameIndex), crowd.keyCursors[skeletonIndex], keyAlpha);
+				const uint32_t nextKeyIndex = crowd.clips[clipIndex].getNextKeyIndex(keyIndex);
+
+				std::vector<BoneTransform>& transforms = outTransforms[skeletonIndex];
+				for (uint32_t boneIndex = 0; boneIndex < settings.boneCount; boneIndex++)
+				{
+					const glm::quat& rotation = clip.bonesRotation[boneIndex][keyIndex];
+					glm::quat nextRotation = clip.bonesRotation[boneIndex][nextKeyIndex];
+					if (glm::dot(rotation, nextRotation) < 0.f)
+						nextRotation = -nextRotation;
+					transforms[boneIndex].rotation = glm::normalize(rotation * (1.f - keyAlpha) + nextRotation * keyAlpha);
+					transforms[boneIndex].position = glm::mix(clip.bonesTranslation[boneIndex][keyIndex], clip.bonesTranslation[boneIndex][nextKeyIndex], keyAlpha);
+				}
+			}
+		}
+
+		return elapsedMilliseconds(start) / settings.frameCount;
+	}
+
+	// largest difference between the SIMD and the reference poses of every skeleton, at a few frames
+	float computeMaxError(const BenchSettings& settings, Crowd& crowd, RotationInterpolation interpolation)
+	{
+		std::vector<AnimationPose> referencePoses(settings.skeletonCount);
+		for (AnimationPose& pose : referencePoses)
+			pose.resize(settings.boneCount);
+
+		float maxError = 0.f;
+		for (uint32_t frameIndex = 0; frameIndex < settings.frameCount; frameIndex += 7)
+		{
+			sampleCrowd(crowd, crowd.clips, frameIndex, [interpolation](const SkeletalAnimation& clip, uint32_t keyIndex, uint32_t nextKeyIndex, float keyAlpha, AnimationPose& outPose)
+			{
+				clip.samplePose(keyIndex, nextKeyIndex, keyAlpha, outPose, interpolation);
+			});
+
+			for (uint32_t skeletonIndex = 0; skeletonIndex < settings.skeletonCount; skeletonIndex++)
+			{
+				const SkeletalAnimation& clip = crowd.clips[crowd.clipIndices[skeletonIndex]];
+				float keyAlpha = 0.f;
+				const uint32_t keyIndex = clip.findKeyIndex(getAnimationTime(crowd, skeletonIndex, frameIndex), keyAlpha);
+				clip.samplePoseReference(keyIndex, clip.getNextKeyIndex(keyIndex), keyAlpha, referencePoses[skeletonIndex], interpolation);
+			}
+
+			for (uint32_t skeletonIndex = 0; skeletonIndex < settings.skeletonCount; skeletonIndex++)
+			{
+				for (uint32_t boneIndex = 0; boneIndex < settings.boneCount; boneIndex++)
+				{
+					const BoneTransform transform = crowd.poses[skeletonIndex].getBoneTransform(boneIndex);
+					const BoneTransform referenceTransform = referencePoses[skeletonIndex].getBoneTransform(boneIndex);
+					// q and -q are the same rotation
+					const float rotationError = 1.f - std::fabs(glm::dot(transform.rotation, referenceTransform.rotation));
+					const float translationError = glm::length(transform.position - referenceTransform.position);
+					maxError = std::max(maxError, std::max(rotationError, translationError));
+				}
+			}
+		}
+
+		return maxError;
+	}
+
+	// write each compressed clip, load it back and compare every key
+	bool checkFileRoundTrip(const BenchSettings& settings, const Crowd& crowd)
+	{
+		for (const SkeletalAnimation& clip : crowd.compressedClips)
+		{
+			AnimationFileWriter::write(settings.filePath, clip);
+
+			MappedFile mappedFile;
+			mappedFile.open(settings.filePath);
+			AnimationFileView file;
+			file.open(mappedFile);
+			SkeletalAnimation loadedClip;
+			loadedClip.loadFromFile(file);
+
+			if (loadedClip.getBoneCount() != clip.getBoneCount() || loadedClip.getKeysTime() != clip.getKeysTime()
+				|| loadedClip.getDuration() != clip.getDuration() || loadedClip.getTickPerSecond() != clip.getTickPerSecond())
+				return false;
+
+			for (uint32_t keyIndex = 0; keyIndex < clip.getKeyCount(); keyIndex++)
+			{
+				for (uint32_t boneIndex = 0; boneIndex < clip.getBoneCount(); boneIndex++)
+				{
+					if (loadedClip.getRotation(boneIndex, keyIndex) != clip.getRotation(boneIndex, keyIndex)
+						|| loadedClip.getTranslation(boneIndex, keyIndex) != clip.getTranslation(boneIndex, keyIndex))
+						return false;
+				}
+			}
+		}
+
+		return true;
+	}
+
+	void printTime(const char* label, double milliseconds, const BenchSettings& settings)
+	{
+		std::cout << "  " << std::left << std::setw(24) << label << std::right
+			<< std::setw(10) << milliseconds << " ms per frame"
+			<< std::setw(10) << milliseconds * 1e6 / (settings.skeletonCount * settings.boneCount) << " ns per bone" << std::endl;
+	}
+
+	bool parseArguments(int argc, char** argv, BenchSettings& outSettings)
+	{
+		for (int i = 1; i < argc; i++)
+		{
+			const std::string argument = argv[i];
+			if (i + 1 >= argc)
+				return false;
+
+			if (argument == "--file")
+			{
+				outSettings.filePath = argv[++i];
+				continue;
+			}
+
+			const int value = std::stoi(argv[++i]);
+			if (value <= 0)
+				return false;
+
+			if (argument == "--skeletons")
+				outSettings.skeletonCount = static_cast<uint32_t>(value);
+			else if (argument == "--bones")
+				outSettings.boneCount = static_cast<uint32_t>(value);
+			else if (argument == "--frames")
+				outSettings.frameCount = static_cast<uint32_t>(value);
+			else if (argument == "--seed")
+				outSettings.seed = static_cast<uint32_t>(value);
+			else
+				return false;
+		}
+
+		return true;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	BenchSettings settings;
+	if (!parseArguments(argc, argv, settings))
+	{
+		std::cerr << "usage : AnimationSamplingBench [--skeletons <count>] [--bones <count>] [--frames <count>] [--seed <value>] [--file <path>]" << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	Crowd crowd = makeCrowd(settings);
+
+	// the SIMD versions must agree with the reference before being timed
+	const float nlerpError = computeMaxError(settings, crowd, ROTATION_INTERPOLATION_NLERP);
+	const float slerpError = computeMaxError(settings, crowd, ROTATION_INTERPOLATION_SLERP);
+	if (nlerpError > NlerpTolerance || slerpError > SlerpTolerance)
+	{
+		std::cerr << "sampling mismatch : nlerp error " << nlerpError << ", slerp error " << slerpError << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	try
+	{
+		const bool sameFileClips = checkFileRoundTrip(settings, crowd);
+		std::remove(settings.filePath.c_str());
+		if (!sameFileClips)
+		{
+			std::cerr << "compressed clips changed by the animation file round trip" << std::endl;
+			return EXIT_FAILURE;
+		}
+	}
+	catch (const std::exception& e)
+	{
+		std::cerr << e.what() << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	std::vector<std::vector<BoneTransform>> boneMajorTransforms;
+	const double boneMajorTime = timeBoneMajorSampling(settings, crowd, boneMajorTransforms);
+
+	const auto sampleReference = [](RotationInterpolation interpolation)
+	{
+		return [interpolation](const SkeletalAnimation& clip, uint32_t keyIndex, uint32_t nextKeyIndex, float keyAlpha, AnimationPose& outPose)
+		{
+			clip.samplePoseReference(keyIndex, nextKeyIndex, keyAlpha, outPose, interpolation);
+		};
+	};
+	const auto sample = [](RotationInterpolation interpolation)
+	{
+		return [interpolation](const SkeletalAnimation& clip, uint32_t keyIndex, uint32_t nextKeyIndex, float keyAlpha, AnimationPose& outPose)
+		{
+			clip.samplePose(keyIndex, nextKeyIndex, keyAlpha, outPose, interpolation);
+		};
+	};
+
+	const double referenceNlerpTime = timeSampling(settings, crowd, crowd.clips, sampleReference(ROTATION_INTERPOLATION_NLERP));
+	const double nlerpTime = timeSampling(settings, crowd, crowd.clips, sample(ROTATION_INTERPOLATION_NLERP));
+	const double referenceSlerpTime = timeSampling(settings, crowd, crowd.clips, sampleReference(ROTATION_INTERPOLATION_SLERP));
+	const double slerpTime = timeSampling(settings, crowd, crowd.clips, sample(ROTATION_INTERPOLATION_SLERP));
+	const double compressedTime = timeSampling(settings, crowd, crowd.compressedClips, sample(ROTATION_INTERPOLATION_NLERP));
+
+	size_t memorySize = 0;
+	size_t compressedMemorySize = 0;
+	for (uint32_t clipIndex = 0; clipIndex < ClipCount; clipIndex++)
+	{
+		memorySize += crowd.clips[clipIndex].getMemorySize();
+		compressedMemorySize += crowd.compressedClips[clipIndex].getMemorySize();
+	}
+
+	std::cout << std::fixed << std::setprecision(3);
+	std::cout << settings.skeletonCount << " skeletons of " << settings.boneCount << " bones, " << ClipCount << " clips of "
+		<< KeyCount << " keys (" << memorySize / 1024 << " KB, " << compressedMemorySize / 1024 << " KB compressed), "
+		<< SkeletalAnimation::getInstructionSetName() << std::endl;
+	std::cout << std::scientific << std::setprecision(2) << "  max error : nlerp " << nlerpError << ", slerp " << slerpError
+		<< std::fixed << std::setprecision(3) << std::endl;
+	printTime("bone major nlerp", boneMajorTime, settings);
+	printTime("reference nlerp", referenceNlerpTime, settings);
+	printTime("SIMD nlerp", nlerpTime, settings);
+	printTime("reference slerp", referenceSlerpTime, settings);
+	printTime("SIMD slerp", slerpTime, settings);
+	printTime("SIMD nlerp compressed", compressedTime, settings);
+	std::cout << "  speedup over the bone major layout : nlerp " << boneMajorTime / nlerpTime << "x" << std::endl;
+
+	return EXIT_SUCCESS;
+}
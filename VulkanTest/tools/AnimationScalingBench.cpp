@@ -0,0 +1,289 @@
+// Animation update scaling benchmark : time of an AnimationSystem update with 1, 2, 4... threads up to the thread count,
+// every skeleton evaluated each frame, then with the distance based update rate.
+// Every thread count must give exactly the same model transforms as a single thread,
+// and the distance based rate must be faster than the full rate.
+// Build with VulkanTest/src in the include path, linking AnimationSystem.cpp, AnimationBlending.cpp, Skeleton.cpp,
+// SkeletalAnimation.cpp, AnimationCompression.cpp, AnimationFile.cpp, MappedFile.cpp and WorkerThreadPool.cpp.
+//
+// usage : AnimationScalingBench [--skeletons <count>] [--bones <count>] [--frames <count>] [--threads <count>] [--seed <value>]
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "AnimationSystem.h"
+#include "Skeleton.h"
+#include "SkeletalAnimation.h"
+#include "WorkerThreadPool.h"
+
+namespace
+{
+	const float Pi = 3.14159265f;
+	const uint32_t ClipCount = 8;
+	const uint32_t KeyCount = 60;
+	const float TicksPerSecond = 30.f;
+	const float FrameTime = 1.f / 60.f;
+	// skeletons are spread on a square grid around the view, up to this distance
+	const float CrowdRadius = 80.f;
+
+	struct BenchSettings
+	{
+		uint32_t skeletonCount = 1000;
+		uint32_t boneCount = 100;
+		uint32_t frameCount = 100;
+		uint32_t maxThreadCount = std::max(1u, std::thread::hardware_concurrency());
+		uint32_t seed = 1;
+	};
+
+	struct Crowd
+	{
+		SkeletonData skeletonData;
+		std::vector<SkeletalAnimation> clips;
+		std::vector<SkeletonInstanceData> skeletonInstances;
+		std::vector<uint32_t> clipIndices;
+		std::vector<float> startTimes;
+		std::vector<glm::vec3> positions;
+	};
+
+	double elapsedMilliseconds(std::chrono::high_resolution_clock::time_point start)
+	{
+		return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+	}
+
+	glm::quat makeRotation(const glm::vec3& axis, float angle)
+	{
+		const float sinHalfAngle = std::sin(0.5f * angle);
+		return glm::quat(std::cos(0.5f * angle), axis.x * sinHalfAngle, axis.y * sinHalfAngle, axis.z * sinHalfAngle);
+	}
+
+	// every bone swings around its own axis, at the end of its parent
+	void makeClip(uint32_t boneCount, std::mt19937& random, SkeletalAnimation& outClip)
+	{
+		std::uniform_real_distribution<float> unit(-1.f, 1.f);
+		std::uniform_real_distribution<float> phase(0.f, 2.f * Pi);
+		std::uniform_real_distribution<float> amplitude(0.1f, 1.f);
+
+		std::vector<float> keysTime(KeyCount);
+		std::vector<std::vector<glm::quat>> bonesRotation(boneCount);
+		std::vector<std::vector<glm::vec3>> bonesTranslation(boneCount);
+		for (uint32_t boneIndex = 0; boneIndex < boneCount; boneIndex++)
+		{
+			glm::vec3 axis(unit(random), unit(random), unit(random));
+			axis = glm::length(axis) > 0.f ? glm::normalize(axis) : glm::vec3(0.f, 1.f, 0.f);
+			const float bonePhase = phase(random);
+			const float boneAmplitude = amplitude(random);
+
+			for (uint32_t keyIndex = 0; keyIndex < KeyCount; keyIndex++)
+			{
+				keysTime[keyIndex] = static_cast<float>(keyIndex);
+				const float cycle = 2.f * Pi * keyIndex / (KeyCount - 1);
+				bonesRotation[boneIndex].push_back(makeRotation(axis, boneAmplitude * std::sin(cycle + bonePhase)));
+				bonesTranslation[boneIndex].push_back(glm::vec3(0.f, boneIndex == 0 ? 0.f : 0.2f, 0.f));
+			}
+		}
+
+		outClip.create(KeyCount - 1.f, TicksPerSecond, keysTime, bonesRotation, bonesTranslation);
+	}
+
+	Crowd makeCrowd(const BenchSettings& settings)
+	{
+		std::mt19937 random(settings.seed);
+
+		// a tree of three children per bone, parents before their children
+		Crowd crowd;
+		SkeletonData& skeletonData = crowd.skeletonData;
+		skeletonData.rootInverseTransform = glm::mat4(1.f);
+		for (uint32_t boneIndex = 0; boneIndex < settings.boneCount; boneIndex++)
+		{
+			skeletonData.boneParents.push_back(boneIndex == 0 ? SkeletonData::NO_PARENT : (boneIndex - 1) / 3);
+			BoneTransform baseTransform;
+			baseTransform.position = glm::vec3(0.f);
+			baseTransform.rotation = glm::quat(1.f, 0.f, 0.f, 0.f);
+			skeletonData.boneBaseTransforms.push_back(baseTransform);
+			skeletonData.boneInverseBindTransforms.push_back(BoneMatrix::identity());
+			skeletonData.boneMappingNameToIdx["bone" + std::to_string(boneIndex)] = boneIndex;
+		}
+
+		crowd.clips.resize(ClipCount);
+		for (SkeletalAnimation& clip : crowd.clips)
+			makeClip(settings.boneCount, random, clip);
+
+		std::uniform_int_distribution<uint32_t> clipIndex(0, ClipCount - 1);
+		std::uniform_real_distribution<float> startTime(0.f, (KeyCount - 1) / TicksPerSecond);
+		const uint32_t gridSize = static_cast<uint32_t>(std::ceil(std::sqrt(static_cast<float>(settings.skeletonCount))));
+		crowd.skeletonInstances.resize(settings.skeletonCount);
+		for (uint32_t skeletonIndex = 0; skeletonIndex < settings.skeletonCount; skeletonIndex++)
+		{
+			crowd.skeletonInstances[skeletonIndex].skeletonData = &skeletonData;
+			crowd.clipIndices.push_back(clipIndex(random));
+			crowd.startTimes.push_back(startTime(random));
+
+			const float x = (static_cast<float>(skeletonIndex % gridSize) / gridSize * 2.f - 1.f) * CrowdRadius;
+			const float z = (static_cast<float>(skeletonIndex / gridSize) / gridSize * 2.f - 1.f) * CrowdRadius;
+			crowd.positions.push_back(glm::vec3(x, 0.f, z));
+		}
+
+		return crowd;
+	}
+
+	// fresh instances, so every run starts from the same state
+	void addInstances(Crowd& crowd, AnimationSystem& animationSystem)
+	{
+		animationSystem.clear();
+		for (uint32_t skeletonIndex = 0; skeletonIndex < crowd.skeletonInstances.size(); skeletonIndex++)
+		{
+			SkeletalAnimationInstance animation(&crowd.clips[crowd.clipIndices[skeletonIndex]], crowd.startTimes[skeletonIndex]);
+			const uint32_t instanceIndex = animationSystem.addInstance(&crowd.skeletonInstances[skeletonIndex], animation);
+			animationSystem.setPosition(instanceIndex, crowd.positions[skeletonIndex]);
+		}
+	}
+
+	// average time of an update, and the counts of the last one
+	double timeUpdates(const BenchSettings& settings, Crowd& crowd, const AnimationUpdateSettings& updateSettings, uint32_t threadCount
+		, AnimationUpdateStats& outStats)
+	{
+		WorkerThreadPool workerThreadPool;
+		workerThreadPool.create(threadCount - 1);
+
+		AnimationSystem animationSystem;
+		animationSystem.setSettings(updateSettings);
+		addInstances(crowd, animationSystem);
+
+		// the first update evaluates everything, it isn't timed
+		animationSystem.update(0.f, glm::vec3(0.f), workerThreadPool);
+		const auto start = std::chrono::high_resolution_clock::now();
+		for (uint32_t frameIndex = 1; frameIndex <= settings.frameCount; frameIndex++)
+			animationSystem.update(frameIndex * FrameTime, glm::vec3(0.f), workerThreadPool);
+		const double time = elapsedMilliseconds(start) / settings.frameCount;
+
+		outStats = animationSystem.getStats();
+		workerThreadPool.destroy();
+		return time;
+	}
+
+	void copyModelTransforms(const Crowd& crowd, std::vector<BoneMatrix>& outModelTransforms)
+	{
+		outModelTransforms.clear();
+		for (const SkeletonInstanceData& skeletonInstance : crowd.skeletonInstances)
+			outModelTransforms.insert(outModelTransforms.end(), skeletonInstance.modelTransforms.begin(), skeletonInstance.modelTransforms.end());
+	}
+
+	// run the updates for each thread count, false if a thread count gives other transforms than a single thread
+	bool runScaling(const char* label, const BenchSettings& settings, Crowd& crowd, const AnimationUpdateSettings& updateSettings
+		, double& outSingleThreadTime)
+	{
+		std::cout << label << std::endl;
+
+		std::vector<BoneMatrix> referenceModelTransforms;
+		std::vector<BoneMatrix> modelTransforms;
+		double singleThreadTime = 0.0;
+		for (uint32_t threadCount = 1; ; threadCount = std::min(threadCount * 2, settings.maxThreadCount))
+		{
+			AnimationUpdateStats stats;
+			const double time = timeUpdates(settings, crowd, updateSettings, threadCount, stats);
+
+			if (threadCount == 1)
+			{
+				singleThreadTime = time;
+				copyModelTransforms(crowd, referenceModelTransforms);
+			}
+			else
+			{
+				copyModelTransforms(crowd, modelTransforms);
+				if (std::memcmp(modelTransforms.data(), referenceModelTransforms.data(), modelTransforms.size() * sizeof(BoneMatrix)) != 0)
+				{
+					std::cerr << "the model transforms with " << threadCount << " threads differ from a single thread" << std::endl;
+					return false;
+				}
+			}
+
+			const double speedup = singleThreadTime / time;
+			std::cout << "  " << std::setw(3) << threadCount << " threads " << std::setw(10) << time << " ms per frame"
+				<< ", speedup " << std::setw(6) << speedup << "x, efficiency " << std::setw(5) << 100.0 * speedup / threadCount << "%"
+				<< " (" << stats.evaluatedCount << " evaluated, " << stats.interpolatedCount << " interpolated)" << std::endl;
+
+			if (threadCount == settings.maxThreadCount)
+				break;
+		}
+
+		outSingleThreadTime = singleThreadTime;
+		return true;
+	}
+
+	bool parseArguments(int argc, char** argv, BenchSettings& outSettings)
+	{
+		for (int i = 1; i < argc; i++)
+		{
+			const std::string argument = argv[i];
+			if (i + 1 >= argc)
+				return false;
+
+			const int value = std::stoi(argv[++i]);
+			if (value <= 0)
+				return false;
+
+			if (argument == "--skeletons")
+				outSettings.skeletonCount = static_cast<uint32_t>(value);
+			else if (argument == "--bones")
+				outSettings.boneCount = static_cast<uint32_t>(value);
+			else if (argument == "--frames")
+				outSettings.frameCount = static_cast<uint32_t>(value);
+			else if (argument == "--threads")
+				outSettings.maxThreadCount = static_cast<uint32_t>(value);
+			else if (argument == "--seed")
+				outSettings.seed = static_cast<uint32_t>(value);
+			else
+				return false;
+		}
+
+		return true;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	BenchSettings settings;
+	if (!parseArguments(argc, argv, settings))
+	{
+		std::cerr << "usage : AnimationScalingBench [--skeletons <count>] [--bones <count>] [--frames <count>] [--threads <count>] [--seed <value>]" << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	Crowd crowd = makeCrowd(settings);
+
+	std::cout << std::fixed << std::setprecision(3);
+	std::cout << settings.skeletonCount << " skeletons of " << settings.boneCount << " bones, "
+		<< std::thread::hardware_concurrency() << " hardware threads, " << Skeleton::getInstructionSetName() << std::endl;
+
+	AnimationUpdateSettings fullRateSettings;
+	fullRateSettings.fullRateDistance = 2.f * CrowdRadius;
+	fullRateSettings.halfRateDistance = 2.f * CrowdRadius;
+	double fullRateTime = 0.0;
+	if (!runScaling("every skeleton at full rate", settings, crowd, fullRateSettings, fullRateTime))
+		return EXIT_FAILURE;
+
+	double distanceRateTime = 0.0;
+	if (!runScaling("distance based update rate", settings, crowd, AnimationUpdateSettings(), distanceRateTime))
+		return EXIT_FAILURE;
+
+	// the frames between two evaluations must cost less than the evaluations they replace
+	std::cout << "distance based update rate speedup on a single thread : " << fullRateTime / distanceRateTime << "x" << std::endl;
+	if (distanceRateTime >= fullRateTime)
+	{
+		std::cerr << "the distance based update rate is slower than the full rate" << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,281 @@
+// Bounding volume hierarchy benchmark : build, refit, rebuild, incremental updates and queries over randomly placed instances.
+// The query results are checked against a linear scan of all the instances, which is timed too.
+// Build with VulkanTest/src in the include path, linking BoundingVolumeHierarchy.cpp.
+//
+// usage : BvhBench [--instances <count>] [--queries <count>] [--seed <value>]
+
+#define GLM_FORCE_RADIAN
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "BoundingVolumeHierarchy.h"
+#include "Bounds.h"
+
+namespace
+{
+	const float Pi = 3.14159265f;
+	// instances are spread in a cube of this size around the origin
+	const float WorldSize = 2000.f;
+	const uint32_t ViewCount = 8;
+
+	struct BenchSettings
+	{
+		uint32_t instanceCount = 500000;
+		uint32_t queryCount = 1000;
+		uint32_t seed = 1;
+	};
+
+	double elapsedMilliseconds(std::chrono::high_resolution_clock::time_point start)
+	{
+		return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+	}
+
+	AABB makeBox(std::mt19937& random)
+	{
+		std::uniform_real_distribution<float> position(-0.5f * WorldSize, 0.5f * WorldSize);
+		std::uniform_real_distribution<float> extent(0.5f, 4.f);
+		return AABB::fromCenterExtent(glm::vec3(position(random), position(random), position(random))
+			, glm::vec3(extent(random), extent(random), extent(random)));
+	}
+
+	// camera at the center of the world looking around the horizon
+	Frustum makeViewFrustum(uint32_t viewIndex)
+	{
+		const float yaw = 2.f * Pi * viewIndex / ViewCount;
+		const glm::vec3 direction(std::sin(yaw), 0.f, std::cos(yaw));
+		const glm::mat4 view = glm::lookAt(glm::vec3(0.f), direction, glm::vec3(0.f, 1.f, 0.f));
+		const glm::mat4 projection = glm::perspective(glm::radians(60.f), 16.f / 9.f, 0.1f, 0.25f * WorldSize);
+		return Frustum::fromViewProjection(projection * view);
+	}
+
+	// same tests as the hierarchy queries, on every box
+	bool isBoxInFrustum(const AABB& box, const Frustum& frustum)
+	{
+		const glm::vec3 center = box.getCenter();
+		const glm::vec3 extent = box.getExtent();
+		for (int planeIndex = 0; planeIndex < Frustum::PLANE_COUNT; planeIndex++)
+		{
+			const glm::vec4& plane = frustum.planes[planeIndex];
+			if (glm::dot(glm::vec3(plane), center) + plane.w < -glm::dot(glm::abs(glm::vec3(plane)), extent))
+				return false;
+		}
+
+		return true;
+	}
+
+	bool isBoxInSphere(const AABB& box, const BoundingSphere& sphere)
+	{
+		const glm::vec3 offset = glm::clamp(sphere.center, box.min, box.max) - sphere.center;
+		return glm::dot(offset, offset) <= sphere.radius * sphere.radius;
+	}
+
+	struct Ray
+	{
+		glm::vec3 origin;
+		glm::vec3 direction;
+		float maxDistance;
+	};
+
+	bool isBoxHitByRay(const AABB& box, const Ray& ray)
+	{
+		float entry = 0.f;
+		float exit = ray.maxDistance;
+		for (int axis = 0; axis < 3; axis++)
+		{
+			float slabEntry = (box.min[axis] - ray.origin[axis]) / ray.direction[axis];
+			float slabExit = (box.max[axis] - ray.origin[axis]) / ray.direction[axis];
+			if (slabEntry > slabExit)
+				std::swap(slabEntry, slabExit);
+			entry = slabEntry > entry ? slabEntry : entry;
+			exit = slabExit < exit ? slabExit : exit;
+		}
+
+		return entry <= exit;
+	}
+
+	// Run the queries with the hierarchy then with a linear scan, return false if the results differ.
+	// query(i, outIndices) runs the query i on the tree, test(i, box) is the same test on a single box.
+	template<typename QueryFunction, typename TestFunction>
+	bool benchQueries(const char* label, uint32_t queryCount, const std::vector<AABB>& boxes, QueryFunction query, TestFunction test)
+	{
+		std::vector<std::vector<uint32_t>> treeResults(queryCount);
+		auto start = std::chrono::high_resolution_clock::now();
+		for (uint32_t i = 0; i < queryCount; i++)
+			query(i, treeResults[i]);
+		const double treeTime = elapsedMilliseconds(start) / queryCount;
+
+		std::vector<std::vector<uint32_t>> scanResults(queryCount);
+		start = std::chrono::high_resolution_clock::now();
+		for (uint32_t i = 0; i < queryCount; i++)
+		{
+			for (uint32_t boxIndex = 0; boxIndex < boxes.size(); boxIndex++)
+			{
+				if (test(i, boxes[boxIndex]))
+					scanResults[i].push_back(boxIndex);
+			}
+		}
+		const double scanTime = elapsedMilliseconds(start) / queryCount;
+
+		size_t resultCount = 0;
+		for (uint32_t i = 0; i < queryCount; i++)
+		{
+			std::sort(treeResults[i].begin(), treeResults[i].end());
+			if (treeResults[i] != scanResults[i])
+			{
+				std::cerr << label << " query " << i << " mismatch : " << treeResults[i].size() << " results, "
+					<< scanResults[i].size() << " with the linear scan" << std::endl;
+				return false;
+			}
+			resultCount += treeResults[i].size();
+		}
+
+		std::cout << "  " << std::left << std::setw(16) << label << std::right
+			<< std::setw(10) << treeTime << " ms, linear scan " << std::setw(10) << scanTime << " ms"
+			<< ", " << static_cast<double>(resultCount) / queryCount << " results" << std::endl;
+		return true;
+	}
+
+	bool benchAllQueries(const BenchSettings& settings, BoundingVolumeHierarchy& tree, const std::vector<AABB>& boxes
+		, const std::vector<BoundingSphere>& spheres, const std::vector<Ray>& rays)
+	{
+		std::vector<Frustum> frustums(ViewCount);
+		for (uint32_t viewIndex = 0; viewIndex < ViewCount; viewIndex++)
+			frustums[viewIndex] = makeViewFrustum(viewIndex);
+
+		return benchQueries("frustum", ViewCount, boxes
+				, [&](uint32_t i, std::vector<uint32_t>& outIndices) { tree.queryFrustum(frustums[i], outIndices); }
+				, [&](uint32_t i, const AABB& box) { return isBoxInFrustum(box, frustums[i]); })
+			&& benchQueries("sphere", settings.queryCount, boxes
+				, [&](uint32_t i, std::vector<uint32_t>& outIndices) { tree.querySphere(spheres[i], outIndices); }
+				, [&](uint32_t i, const AABB& box) { return isBoxInSphere(box, spheres[i]); })
+			&& benchQueries("ray", settings.queryCount, boxes
+				, [&](uint32_t i, std::vector<uint32_t>& outIndices) { tree.queryRay(rays[i].origin, rays[i].direction, rays[i].maxDistance, outIndices); }
+				, [&](uint32_t i, const AABB& box) { return isBoxHitByRay(box, rays[i]); });
+	}
+
+	void printTree(const char* label, double milliseconds, const BoundingVolumeHierarchy& tree)
+	{
+		std::cout << std::left << std::setw(18) << label << std::right << std::setw(10) << milliseconds << " ms"
+			<< ", height " << tree.getHeight() << ", surface area cost " << tree.computeSurfaceAreaCost() << std::endl;
+	}
+
+	bool parseArguments(int argc, char** argv, BenchSettings& outSettings)
+	{
+		for (int i = 1; i < argc; i++)
+		{
+			const std::string argument = argv[i];
+			if (i + 1 >= argc)
+				return false;
+
+			const int value = std::stoi(argv[++i]);
+			if (value <= 0)
+				return false;
+
+			if (argument == "--instances")
+				outSettings.instanceCount = static_cast<uint32_t>(value);
+			else if (argument == "--queries")
+				outSettings.queryCount = static_cast<uint32_t>(value);
+			else if (argument == "--seed")
+				outSettings.seed = static_cast<uint32_t>(value);
+			else
+				return false;
+		}
+
+		return true;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	BenchSettings settings;
+	if (!parseArguments(argc, argv, settings))
+	{
+		std::cerr << "usage : BvhBench [--instances <count>] [--queries <count>] [--seed <value>]" << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	std::mt19937 random(settings.seed);
+	std::vector<AABB> boxes(settings.instanceCount);
+	std::vector<uint32_t> userIndices(settings.instanceCount);
+	for (uint32_t i = 0; i < settings.instanceCount; i++)
+	{
+		boxes[i] = makeBox(random);
+		userIndices[i] = i;
+	}
+
+	std::uniform_real_distribution<float> position(-0.5f * WorldSize, 0.5f * WorldSize);
+	std::uniform_real_distribution<float> unit(-1.f, 1.f);
+	std::vector<BoundingSphere> spheres(settings.queryCount);
+	std::vector<Ray> rays(settings.queryCount);
+	for (uint32_t i = 0; i < settings.queryCount; i++)
+	{
+		spheres[i].center = glm::vec3(position(random), position(random), position(random));
+		spheres[i].radius = 50.f;
+
+		rays[i].origin = glm::vec3(position(random), position(random), position(random));
+		glm::vec3 direction(unit(random), unit(random), unit(random));
+		rays[i].direction = glm::length(direction) > 0.f ? glm::normalize(direction) : glm::vec3(1.f, 0.f, 0.f);
+		rays[i].maxDistance = 0.5f * WorldSize;
+	}
+
+	std::cout << std::fixed << std::setprecision(3);
+	std::cout << settings.instanceCount << " instances" << std::endl;
+
+	BoundingVolumeHierarchy tree;
+	std::vector<int32_t> proxies;
+	auto start = std::chrono::high_resolution_clock::now();
+	tree.build(boxes.data(), userIndices.data(), settings.instanceCount, proxies);
+	printTree("build", elapsedMilliseconds(start), tree);
+
+	if (!benchAllQueries(settings, tree, boxes, spheres, rays))
+		return EXIT_FAILURE;
+
+	// every instance moves a little, the tree is refitted once
+	std::uniform_real_distribution<float> move(-2.f, 2.f);
+	for (AABB& box : boxes)
+	{
+		const glm::vec3 offset(move(random), move(random), move(random));
+		box.min += offset;
+		box.max += offset;
+	}
+
+	start = std::chrono::high_resolution_clock::now();
+	for (uint32_t i = 0; i < settings.instanceCount; i++)
+		tree.setLeafBox(proxies[i], boxes[i]);
+	tree.refit();
+	printTree("refit", elapsedMilliseconds(start), tree);
+
+	// a tenth of the instances jump to a new place, one by one
+	const uint32_t movedCount = settings.instanceCount / 10;
+	start = std::chrono::high_resolution_clock::now();
+	for (uint32_t i = 0; i < movedCount; i++)
+	{
+		const uint32_t instance = i * 10;
+		boxes[instance] = makeBox(random);
+		tree.remove(proxies[instance]);
+		proxies[instance] = tree.insert(boxes[instance], instance);
+	}
+	printTree("reinsert 10%", elapsedMilliseconds(start), tree);
+
+	if (!benchAllQueries(settings, tree, boxes, spheres, rays))
+		return EXIT_FAILURE;
+
+	start = std::chrono::high_resolution_clock::now();
+	tree.rebuild();
+	printTree("rebuild", elapsedMilliseconds(start), tree);
+
+	if (!benchAllQueries(settings, tree, boxes, spheres, rays))
+		return EXIT_FAILURE;
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,185 @@
+// Frustum culling benchmark : SIMD and scalar culling of randomly placed instances, with the cost of updating their bounds.
+// Both versions must return the same visible instances.
+// Build with VulkanTest/src in the include path, linking FrustumCulling.cpp.
+//
+// usage : FrustumCullingBench [--instances <count>] [--iterations <count>] [--seed <value>]
+
+#define GLM_FORCE_RADIAN
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "Bounds.h"
+#include "FrustumCulling.h"
+
+namespace
+{
+	const float Pi = 3.14159265f;
+	// instances are spread in a cube of this size around the camera
+	const float WorldSize = 1000.f;
+	const uint32_t ViewCount = 8;
+
+	struct BenchSettings
+	{
+		uint32_t instanceCount = 100000;
+		uint32_t iterationCount = 100;
+		uint32_t seed = 1;
+	};
+
+	double elapsedMilliseconds(std::chrono::high_resolution_clock::time_point start)
+	{
+		return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+	}
+
+	// local boxes of random sizes, rotated around the up axis and placed anywhere in the world
+	void makeInstances(const BenchSettings& settings, std::vector<Bounds>& outLocalBounds, std::vector<glm::mat4>& outTransforms)
+	{
+		std::mt19937 random(settings.seed);
+		std::uniform_real_distribution<float> position(-0.5f * WorldSize, 0.5f * WorldSize);
+		std::uniform_real_distribution<float> extent(0.5f, 4.f);
+		std::uniform_real_distribution<float> angle(0.f, 2.f * Pi);
+
+		outLocalBounds.resize(settings.instanceCount);
+		outTransforms.resize(settings.instanceCount);
+		for (uint32_t i = 0; i < settings.instanceCount; i++)
+		{
+			const glm::vec3 halfSize(extent(random), extent(random), extent(random));
+			outLocalBounds[i] = Bounds::fromBox(AABB::fromCenterExtent(glm::vec3(0.f), halfSize));
+
+			// the world box of the instance encloses the rotated box
+			const float rotation = angle(random);
+			glm::mat4 transform(1.f);
+			transform[0] = glm::vec4(std::cos(rotation), 0.f, -std::sin(rotation), 0.f);
+			transform[2] = glm::vec4(std::sin(rotation), 0.f, std::cos(rotation), 0.f);
+			transform[3] = glm::vec4(position(random), position(random), position(random), 1.f);
+			outTransforms[i] = transform;
+		}
+	}
+
+	// camera at the center of the world looking around the horizon
+	Frustum makeViewFrustum(uint32_t viewIndex)
+	{
+		const float yaw = 2.f * Pi * viewIndex / ViewCount;
+		const glm::vec3 direction(std::sin(yaw), 0.f, std::cos(yaw));
+		const glm::mat4 view = glm::lookAt(glm::vec3(0.f), direction, glm::vec3(0.f, 1.f, 0.f));
+		const glm::mat4 projection = glm::perspective(glm::radians(60.f), 16.f / 9.f, 0.1f, 0.5f * WorldSize);
+		return Frustum::fromViewProjection(projection * view);
+	}
+
+	typedef uint32_t(*CullFunction)(const Frustum&, const CullingSet&, std::vector<uint32_t>&);
+
+	// average time of a cull, over all the views
+	double timeCull(CullFunction cullFunction, const std::vector<Frustum>& frustums, const CullingSet& cullingSet, uint32_t iterationCount
+		, std::vector<uint32_t>& visibleIndices, uint64_t& outVisibleCount)
+	{
+		outVisibleCount = 0;
+		const auto start = std::chrono::high_resolution_clock::now();
+		for (uint32_t iteration = 0; iteration < iterationCount; iteration++)
+		{
+			for (const Frustum& frustum : frustums)
+				outVisibleCount += cullFunction(frustum, cullingSet, visibleIndices);
+		}
+
+		return elapsedMilliseconds(start) / (iterationCount * frustums.size());
+	}
+
+	void printTime(const char* label, double milliseconds, uint32_t instanceCount)
+	{
+		std::cout << "  " << std::left << std::setw(16) << label << std::right
+			<< std::setw(10) << milliseconds << " ms"
+			<< std::setw(10) << milliseconds * 1e6 / instanceCount << " ns per instance" << std::endl;
+	}
+
+	bool parseArguments(int argc, char** argv, BenchSettings& outSettings)
+	{
+		for (int i = 1; i < argc; i++)
+		{
+			const std::string argument = argv[i];
+			if (i + 1 >= argc)
+				return false;
+
+			const int value = std::stoi(argv[++i]);
+			if (value <= 0)
+				return false;
+
+			if (argument == "--instances")
+				outSettings.instanceCount = static_cast<uint32_t>(value);
+			else if (argument == "--iterations")
+				outSettings.iterationCount = static_cast<uint32_t>(value);
+			else if (argument == "--seed")
+				outSettings.seed = static_cast<uint32_t>(value);
+			else
+				return false;
+		}
+
+		return true;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	BenchSettings settings;
+	if (!parseArguments(argc, argv, settings))
+	{
+		std::cerr << "usage : FrustumCullingBench [--instances <count>] [--iterations <count>] [--seed <value>]" << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	std::vector<Bounds> localBounds;
+	std::vector<glm::mat4> transforms;
+	makeInstances(settings, localBounds, transforms);
+
+	std::vector<Frustum> frustums(ViewCount);
+	for (uint32_t viewIndex = 0; viewIndex < ViewCount; viewIndex++)
+		frustums[viewIndex] = makeViewFrustum(viewIndex);
+
+	CullingSet cullingSet;
+	cullingSet.resize(settings.instanceCount);
+
+	// the update done each frame for the moving instances, here all of them
+	auto start = std::chrono::high_resolution_clock::now();
+	for (uint32_t iteration = 0; iteration < settings.iterationCount; iteration++)
+	{
+		for (uint32_t i = 0; i < settings.instanceCount; i++)
+			cullingSet.setBounds(i, localBounds[i], transforms[i]);
+	}
+	const double updateTime = elapsedMilliseconds(start) / settings.iterationCount;
+
+	// both versions must agree before being timed
+	std::vector<uint32_t> visibleIndices;
+	std::vector<uint32_t> referenceVisibleIndices;
+	for (const Frustum& frustum : frustums)
+	{
+		FrustumCuller::cull(frustum, cullingSet, visibleIndices);
+		FrustumCuller::cullScalar(frustum, cullingSet, referenceVisibleIndices);
+		if (visibleIndices != referenceVisibleIndices)
+		{
+			std::cerr << "culling mismatch : " << visibleIndices.size() << " visible instances, "
+				<< referenceVisibleIndices.size() << " with the scalar version" << std::endl;
+			return EXIT_FAILURE;
+		}
+	}
+
+	uint64_t visibleCount = 0;
+	const double simdTime = timeCull(FrustumCuller::cull, frustums, cullingSet, settings.iterationCount, visibleIndices, visibleCount);
+	const double scalarTime = timeCull(FrustumCuller::cullScalar, frustums, cullingSet, settings.iterationCount, visibleIndices, visibleCount);
+
+	std::cout << std::fixed << std::setprecision(3);
+	std::cout << settings.instanceCount << " instances, " << ViewCount << " views, "
+		<< static_cast<double>(visibleCount) / (settings.iterationCount * ViewCount) << " visible on average" << std::endl;
+	printTime("bounds update", updateTime, settings.instanceCount);
+	printTime(FrustumCuller::getInstructionSetName(), simdTime, settings.instanceCount);
+	printTime("scalar", scalarTime, settings.instanceCount);
+	std::cout << "  speedup " << scalarTime / simdTime << "x" << std::endl;
+
+	return EXIT_SUCCESS;
+}
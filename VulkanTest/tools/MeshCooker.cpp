@@ -0,0 +1,314 @@
+// Offline mesh cooker : convert an OBJ file to the cooked mesh format loaded by StaticMesh::loadFromFile().
+// Build with VulkanTest/src in the include path, linking MeshFile.cpp, MappedFile.cpp, MeshOptimizer.cpp and MeshSimplifier.cpp.
+//
+// usage : MeshCooker <input.obj> <output.mesh> [--no-optimize] [--lods <count>]
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include "MeshFile.h"
+#include "MeshLod.h"
+#include "MeshOptimizer.h"
+#include "MeshSimplifier.h"
+#include "VertexLayout.h"
+
+namespace
+{
+	struct CookSettings
+	{
+		std::string inputPath;
+		std::string outputPath;
+		bool optimize = true;
+		uint32_t maxLodCount = MeshLodSettings().maxLodCount;
+	};
+
+	// Vertex attributes of an OBJ file, before conversion to a vertex format
+	struct SourceVertex
+	{
+		glm::vec3 position;
+		glm::vec3 normal;
+		glm::vec2 texCoord;
+	};
+
+	struct SourceMesh
+	{
+		std::vector<SourceVertex> vertices;
+		std::vector<uint32_t> indices;
+		std::vector<MeshFileSubmesh> submeshes;
+	};
+
+	// OBJ indices are 1 based, negative indices are relative to the end of the list
+	int resolveObjIndex(const std::string& token, size_t count)
+	{
+		if (token.empty())
+			return -1;
+
+		const int index = std::stoi(token);
+		if (index < 0)
+			return static_cast<int>(count) + index;
+
+		return index - 1;
+	}
+
+	// Load triangles and polygons of an OBJ file, polygons are triangulated as fans.
+	// Each "usemtl" starts a new submesh. Missing normals are generated from the faces.
+	void loadObj(const std::string& path, SourceMesh& outMesh)
+	{
+		std::ifstream file(path);
+		if (!file.is_open())
+			throw std::runtime_error("failed to open " + path + " !");
+
+		std::vector<glm::vec3> positions;
+		std::vector<glm::vec3> normals;
+		std::vector<glm::vec2> texCoords;
+		// vertices are shared between faces using the same position / texCoord / normal triple
+		std::map<std::tuple<int, int, int>, uint32_t> vertexLookup;
+		std::vector<int> vertexPositionIndices;
+		bool hasMissingNormals = false;
+
+		uint32_t materialSlot = 0;
+		std::map<std::string, uint32_t> materialSlots;
+
+		std::string line;
+		while (std::getline(file, line))
+		{
+			std::istringstream stream(line);
+			std::string keyword;
+			stream >> keyword;
+
+			if (keyword == "v")
+			{
+				glm::vec3 position;
+				stream >> position.x >> position.y >> position.z;
+				positions.push_back(position);
+			}
+			else if (keyword == "vn")
+			{
+				glm::vec3 normal;
+				stream >> normal.x >> normal.y >> normal.z;
+				normals.push_back(normal);
+			}
+			else if (keyword == "vt")
+			{
+				glm::vec2 texCoord;
+				stream >> texCoord.x >> texCoord.y;
+				// OBJ texture origin is at the bottom left
+				texCoord.y = 1.f - texCoord.y;
+				texCoords.push_back(texCoord);
+			}
+			else if (keyword == "usemtl")
+			{
+				std::string materialName;
+				stream >> materialName;
+				auto found = materialSlots.insert(std::make_pair(materialName, static_cast<uint32_t>(materialSlots.size())));
+				materialSlot = found.first->second;
+			}
+			else if (keyword == "f")
+			{
+				std::vector<uint32_t> polygon;
+				std::string corner;
+				while (stream >> corner)
+				{
+					std::string tokens[3];
+					std::istringstream cornerStream(corner);
+					for (int i = 0; i < 3 && std::getline(cornerStream, tokens[i], '/'); i++);
+
+					const int positionIndex = resolveObjIndex(tokens[0], positions.size());
+					const int texCoordIndex = resolveObjIndex(tokens[1], texCoords.size());
+					const int normalIndex = resolveObjIndex(tokens[2], normals.size());
+					if (positionIndex < 0 || positionIndex >= static_cast<int>(positions.size())
+						|| texCoordIndex >= static_cast<int>(texCoords.size()) || normalIndex >= static_cast<int>(normals.size()))
+						throw std::runtime_error("invalid face index in " + path + " !");
+
+					auto found = vertexLookup.insert(std::make_pair(std::make_tuple(positionIndex, texCoordIndex, normalIndex), static_cast<uint32_t>(outMesh.vertices.size())));
+					if (found.second)
+					{
+						SourceVertex vertex;
+						vertex.position = positions[positionIndex];
+						vertex.texCoord = texCoordIndex >= 0 ? texCoords[texCoordIndex] : glm::vec2(0.f);
+						vertex.normal = normalIndex >= 0 ? normals[normalIndex] : glm::vec3(0.f);
+						outMesh.vertices.push_back(vertex);
+						vertexPositionIndices.push_back(positionIndex);
+						hasMissingNormals |= normalIndex < 0;
+					}
+					polygon.push_back(found.first->second);
+				}
+
+				if (outMesh.submeshes.empty() || outMesh.submeshes.back().materialSlot != materialSlot)
+					outMesh.submeshes.push_back(MeshFileSubmesh{ static_cast<uint32_t>(outMesh.indices.size()), 0, materialSlot, 0 });
+
+				for (size_t i = 2; i < polygon.size(); i++)
+				{
+					outMesh.indices.push_back(polygon[0]);
+					outMesh.indices.push_back(polygon[i - 1]);
+					outMesh.indices.push_back(polygon[i]);
+					outMesh.submeshes.back().indexCount += 3;
+				}
+			}
+		}
+
+		if (outMesh.indices.empty())
+			throw std::runtime_error("no face found in " + path + " !");
+
+		if (hasMissingNormals)
+		{
+			// area weighted face normals, accumulated on positions to stay smooth across texture seams
+			std::vector<glm::vec3> positionNormals(positions.size(), glm::vec3(0.f));
+			for (size_t i = 0; i < outMesh.indices.size(); i += 3)
+			{
+				const uint32_t a = outMesh.indices[i + 0];
+				const uint32_t b = outMesh.indices[i + 1];
+				const uint32_t c = outMesh.indices[i + 2];
+				const glm::vec3 faceNormal = glm::cross(outMesh.vertices[b].position - outMesh.vertices[a].position, outMesh.vertices[c].position - outMesh.vertices[a].position);
+				positionNormals[vertexPositionIndices[a]] += faceNormal;
+				positionNormals[vertexPositionIndices[b]] += faceNormal;
+				positionNormals[vertexPositionIndices[c]] += faceNormal;
+			}
+
+			for (size_t i = 0; i < outMesh.vertices.size(); i++)
+			{
+				SourceVertex& vertex = outMesh.vertices[i];
+				if (vertex.normal == glm::vec3(0.f))
+				{
+					const glm::vec3 normal = positionNormals[vertexPositionIndices[i]];
+					vertex.normal = glm::length(normal) > 0.f ? normal / glm::length(normal) : glm::vec3(0.f, 0.f, 1.f);
+				}
+			}
+		}
+	}
+
+	Vertex convertVertex(const SourceVertex& source)
+	{
+		Vertex vertex;
+		vertex.position = source.position;
+		vertex.color = glm::vec3(1.f);
+		vertex.texCoord = source.texCoord;
+		return vertex;
+	}
+
+	// Each submesh is reordered inside its own index range so the materials are kept,
+	// then the vertices are renumbered once for the whole index buffer.
+	void optimizeSubmeshes(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices, const std::vector<glm::vec3>& positions
+		, const std::vector<MeshFileSubmesh>& submeshes, MeshOptimizationReport& outReport)
+	{
+		const size_t vertexCount = vertices.size();
+		outReport.before = MeshOptimizer::analyzeVertexCache(indices, vertexCount);
+
+		std::vector<uint32_t> submeshIndices;
+		std::vector<uint32_t> clusters;
+		for (const MeshFileSubmesh& submesh : submeshes)
+		{
+			auto first = indices.begin() + submesh.firstIndex;
+			submeshIndices.assign(first, first + submesh.indexCount);
+
+			MeshOptimizer::optimizeVertexCache(submeshIndices, vertexCount, clusters);
+			MeshOptimizer::optimizeOverdraw(submeshIndices, positions, clusters);
+			std::copy(submeshIndices.begin(), submeshIndices.end(), first);
+		}
+
+		std::vector<uint32_t> remap;
+		const size_t newVertexCount = MeshOptimizer::optimizeVertexFetch(indices, vertexCount, remap);
+		MeshOptimizer::remapVertices(vertices, remap, newVertexCount);
+
+		outReport.after = MeshOptimizer::analyzeVertexCache(indices, newVertexCount);
+		outReport.removedVertexCount = static_cast<uint32_t>(vertexCount - newVertexCount);
+	}
+
+	void cook(const CookSettings& settings, SourceMesh& mesh)
+	{
+		std::vector<glm::vec3> positions(mesh.vertices.size());
+		std::vector<Vertex> vertices(mesh.vertices.size());
+		for (size_t i = 0; i < mesh.vertices.size(); i++)
+		{
+			positions[i] = mesh.vertices[i].position;
+			vertices[i] = convertVertex(mesh.vertices[i]);
+		}
+
+		if (settings.optimize)
+		{
+			MeshOptimizationReport report;
+			optimizeSubmeshes(vertices, mesh.indices, positions, mesh.submeshes, report);
+
+			std::cout << "vertex cache ACMR " << report.before.acmr << " -> " << report.after.acmr
+				<< ", " << report.removedVertexCount << " unused vertices removed" << std::endl;
+		}
+
+		std::vector<MeshLod> lods;
+		if (settings.maxLodCount > 1)
+		{
+			std::vector<glm::vec3> optimizedPositions(vertices.size());
+			for (size_t i = 0; i < vertices.size(); i++)
+				optimizedPositions[i] = vertices[i].position;
+
+			MeshLodSettings lodSettings;
+			lodSettings.maxLodCount = settings.maxLodCount;
+			MeshSimplifier::generateLodChain(mesh.indices, optimizedPositions, lodSettings, lods);
+
+			for (size_t i = 0; i < lods.size(); i++)
+				std::cout << "lod " << i << " : " << lods[i].indexCount / 3 << " triangles, error " << lods[i].error << std::endl;
+		}
+
+		MeshFileWriter::write(settings.outputPath, vertices, mesh.indices, lods, mesh.submeshes);
+		std::cout << settings.outputPath << " : " << vertices.size() << " vertices, " << mesh.indices.size() << " indices, "
+			<< mesh.submeshes.size() << " submeshes" << std::endl;
+	}
+
+	bool parseArguments(int argc, char** argv, CookSettings& outSettings)
+	{
+		std::vector<std::string> paths;
+		for (int i = 1; i < argc; i++)
+		{
+			const std::string argument = argv[i];
+			if (argument == "--no-optimize")
+				outSettings.optimize = false;
+			else if (argument == "--lods" && i + 1 < argc)
+				outSettings.maxLodCount = static_cast<uint32_t>(std::max(1, std::stoi(argv[++i])));
+			else if (argument.compare(0, 2, "--") == 0)
+				return false;
+			else
+				paths.push_back(argument);
+		}
+
+		if (paths.size() != 2)
+			return false;
+
+		outSettings.inputPath = paths[0];
+		outSettings.outputPath = paths[1];
+		return true;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	CookSettings settings;
+	if (!parseArguments(argc, argv, settings))
+	{
+		std::cerr << "usage : MeshCooker <input.obj> <output.mesh> [--no-optimize] [--lods <count>]" << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	try
+	{
+		SourceMesh mesh;
+		loadObj(settings.inputPath, mesh);
+
+		cook(settings, mesh);
+	}
+	catch (const std::exception& e)
+	{
+		std::cerr << e.what() << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
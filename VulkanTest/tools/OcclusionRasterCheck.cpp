@@ -0,0 +1,260 @@
+// Occlusion rasterizer check : rasterize the same occluders with the SIMD multi threaded version and the scalar reference,
+// the depth buffers and the tile depths must match within a tolerance. Both versions are timed.
+// Build with VulkanTest/src in the include path, linking OcclusionCulling.cpp, FrustumCulling.cpp and WorkerThreadPool.cpp.
+//
+// usage : OcclusionRasterCheck [--occluders <count>] [--width <pixels>] [--height <pixels>] [--iterations <count>] [--seed <value>]
+
+#define GLM_FORCE_RADIAN
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <cfloat>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "OcclusionCulling.h"
+#include "WorkerThreadPool.h"
+
+namespace
+{
+	const float Pi = 3.14159265f;
+	// occluders are spread in a square of this size around the camera
+	const float WorldSize = 200.f;
+	const uint32_t ViewCount = 8;
+	// depths are in [0, 1], both versions evaluate the same plane equations
+	const float DepthTolerance = 1e-5f;
+
+	struct BenchSettings
+	{
+		uint32_t occluderCount = 200;
+		uint32_t width = 256;
+		uint32_t height = 128;
+		uint32_t iterationCount = 100;
+		uint32_t seed = 1;
+	};
+
+	struct Occluder
+	{
+		glm::mat4 transform;
+		// the ground is a quad, the others are boxes
+		bool ground;
+	};
+
+	// unit cube centered on the origin, triangles of both windings to exercise the winding fix
+	const glm::vec3 CubePositions[8] =
+	{
+		glm::vec3(-0.5f, -0.5f, -0.5f), glm::vec3(0.5f, -0.5f, -0.5f), glm::vec3(0.5f, 0.5f, -0.5f), glm::vec3(-0.5f, 0.5f, -0.5f),
+		glm::vec3(-0.5f, -0.5f, 0.5f), glm::vec3(0.5f, -0.5f, 0.5f), glm::vec3(0.5f, 0.5f, 0.5f), glm::vec3(-0.5f, 0.5f, 0.5f)
+	};
+	const uint32_t CubeIndices[36] =
+	{
+		0, 2, 1, 0, 3, 2, 4, 5, 6, 4, 6, 7,
+		0, 1, 5, 0, 5, 4, 3, 6, 2, 3, 7, 6,
+		0, 4, 7, 0, 7, 3, 1, 2, 6, 1, 6, 5
+	};
+
+	const glm::vec3 QuadPositions[4] =
+	{
+		glm::vec3(-0.5f, 0.f, -0.5f), glm::vec3(0.5f, 0.f, -0.5f), glm::vec3(0.5f, 0.f, 0.5f), glm::vec3(-0.5f, 0.f, 0.5f)
+	};
+	const uint32_t QuadIndices[6] = { 0, 1, 2, 0, 2, 3 };
+
+	double elapsedMilliseconds(std::chrono::high_resolution_clock::time_point start)
+	{
+		return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+	}
+
+	// a ground under the camera and rotated boxes of random sizes, some of them crossing the near plane
+	std::vector<Occluder> makeOccluders(const BenchSettings& settings)
+	{
+		std::mt19937 random(settings.seed);
+		std::uniform_real_distribution<float> position(-0.5f * WorldSize, 0.5f * WorldSize);
+		std::uniform_real_distribution<float> size(1.f, 20.f);
+		std::uniform_real_distribution<float> angle(0.f, 2.f * Pi);
+
+		std::vector<Occluder> occluders(settings.occluderCount);
+		occluders[0].transform = glm::mat4(1.f);
+		occluders[0].transform[0].x = 2.f * WorldSize;
+		occluders[0].transform[2].z = 2.f * WorldSize;
+		occluders[0].ground = true;
+		for (uint32_t i = 1; i < settings.occluderCount; i++)
+		{
+			// scaled, rotated around the up axis and standing on the ground
+			const glm::vec3 scale(size(random), size(random), size(random));
+			const float rotation = angle(random);
+			glm::mat4 transform(1.f);
+			transform[0] = glm::vec4(std::cos(rotation), 0.f, -std::sin(rotation), 0.f) * scale.x;
+			transform[1] = glm::vec4(0.f, scale.y, 0.f, 0.f);
+			transform[2] = glm::vec4(std::sin(rotation), 0.f, std::cos(rotation), 0.f) * scale.z;
+			transform[3] = glm::vec4(position(random), 0.5f * scale.y, position(random), 1.f);
+			occluders[i].transform = transform;
+			occluders[i].ground = false;
+		}
+
+		return occluders;
+	}
+
+	// camera above the ground looking around the horizon, slightly down
+	glm::mat4 makeViewProjection(const BenchSettings& settings, uint32_t viewIndex)
+	{
+		const float yaw = 2.f * Pi * viewIndex / ViewCount;
+		const glm::vec3 eye(0.f, 3.f, 0.f);
+		const glm::vec3 direction(std::sin(yaw), -0.2f, std::cos(yaw));
+		const glm::mat4 view = glm::lookAt(eye, eye + direction, glm::vec3(0.f, 1.f, 0.f));
+		const float aspect = static_cast<float>(settings.width) / settings.height;
+		return glm::perspective(glm::radians(60.f), aspect, 0.1f, WorldSize) * view;
+	}
+
+	void addOccluders(OcclusionCuller& culler, const std::vector<Occluder>& occluders, const glm::mat4& viewProjection)
+	{
+		culler.beginFrame(viewProjection);
+		for (const Occluder& occluder : occluders)
+		{
+			if (occluder.ground)
+				culler.addOccluder(QuadPositions, 4, sizeof(glm::vec3), QuadIndices, 6, occluder.transform);
+			else
+				culler.addOccluder(CubePositions, 8, sizeof(glm::vec3), CubeIndices, 36, occluder.transform);
+		}
+	}
+
+	bool areDepthsEqual(float depth, float referenceDepth)
+	{
+		// uncovered pixels keep FLT_MAX in both versions
+		if (depth == FLT_MAX || referenceDepth == FLT_MAX)
+			return depth == referenceDepth;
+		return std::fabs(depth - referenceDepth) <= DepthTolerance;
+	}
+
+	// count the depths which differ, and keep the largest difference between covered depths
+	uint32_t compareDepths(const float* depths, const float* referenceDepths, uint32_t count, float& inOutMaxError)
+	{
+		uint32_t mismatchCount = 0;
+		for (uint32_t i = 0; i < count; i++)
+		{
+			if (!areDepthsEqual(depths[i], referenceDepths[i]))
+				mismatchCount++;
+			else if (depths[i] != FLT_MAX)
+				inOutMaxError = std::max(inOutMaxError, std::fabs(depths[i] - referenceDepths[i]));
+		}
+
+		return mismatchCount;
+	}
+
+	bool parseArguments(int argc, char** argv, BenchSettings& outSettings)
+	{
+		for (int i = 1; i < argc; i++)
+		{
+			const std::string argument = argv[i];
+			if (i + 1 >= argc)
+				return false;
+
+			const int value = std::stoi(argv[++i]);
+			if (value <= 0)
+				return false;
+
+			if (argument == "--occluders")
+				outSettings.occluderCount = static_cast<uint32_t>(value);
+			else if (argument == "--width")
+				outSettings.width = static_cast<uint32_t>(value);
+			else if (argument == "--height")
+				outSettings.height = static_cast<uint32_t>(value);
+			else if (argument == "--iterations")
+				outSettings.iterationCount = static_cast<uint32_t>(value);
+			else if (argument == "--seed")
+				outSettings.seed = static_cast<uint32_t>(value);
+			else
+				return false;
+		}
+
+		return true;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	BenchSettings settings;
+	if (!parseArguments(argc, argv, settings))
+	{
+		std::cerr << "usage : OcclusionRasterCheck [--occluders <count>] [--width <pixels>] [--height <pixels>] [--iterations <count>] [--seed <value>]" << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	const std::vector<Occluder> occluders = makeOccluders(settings);
+
+	WorkerThreadPool workerThreadPool;
+	workerThreadPool.create();
+
+	OcclusionCuller culler;
+	OcclusionCuller referenceCuller;
+	culler.create(settings.width, settings.height);
+	referenceCuller.create(settings.width, settings.height);
+
+	std::cout << std::fixed << std::setprecision(3);
+	std::cout << occluders.size() << " occluders, " << culler.getWidth() << "x" << culler.getHeight() << " depth buffer, "
+		<< workerThreadPool.getThreadCount() << " threads" << std::endl;
+
+	const uint32_t pixelCount = culler.getStride() * culler.getHeight();
+	const uint32_t tileCount = culler.getTileCountX() * culler.getTileCountY();
+	double time = 0.0;
+	double referenceTime = 0.0;
+	bool success = true;
+	for (uint32_t viewIndex = 0; viewIndex < ViewCount; viewIndex++)
+	{
+		const glm::mat4 viewProjection = makeViewProjection(settings, viewIndex);
+		addOccluders(culler, occluders, viewProjection);
+		addOccluders(referenceCuller, occluders, viewProjection);
+
+		auto start = std::chrono::high_resolution_clock::now();
+		for (uint32_t iteration = 0; iteration < settings.iterationCount; iteration++)
+			culler.rasterize(workerThreadPool);
+		time += elapsedMilliseconds(start);
+
+		start = std::chrono::high_resolution_clock::now();
+		for (uint32_t iteration = 0; iteration < settings.iterationCount; iteration++)
+			referenceCuller.rasterizeReference();
+		referenceTime += elapsedMilliseconds(start);
+
+		float maxError = 0.f;
+		const uint32_t pixelMismatchCount = compareDepths(culler.getDepthBuffer(), referenceCuller.getDepthBuffer(), pixelCount, maxError);
+		const uint32_t tileMismatchCount = compareDepths(culler.getTileMaxDepths(), referenceCuller.getTileMaxDepths(), tileCount, maxError);
+
+		uint32_t coveredTileCount = 0;
+		for (uint32_t tileIndex = 0; tileIndex < tileCount; tileIndex++)
+			coveredTileCount += referenceCuller.getTileMaxDepths()[tileIndex] != FLT_MAX ? 1 : 0;
+
+		std::cout << "  view " << viewIndex << " : " << culler.getTriangleCount() << " triangles, "
+			<< coveredTileCount << " / " << tileCount << " tiles fully covered, max depth error " << std::scientific << maxError << std::fixed;
+		if (pixelMismatchCount != 0 || tileMismatchCount != 0)
+		{
+			std::cout << ", " << pixelMismatchCount << " pixels and " << tileMismatchCount << " tiles differ" << std::endl;
+			success = false;
+		}
+		else
+			std::cout << std::endl;
+	}
+
+	const uint32_t rasterizeCount = ViewCount * settings.iterationCount;
+	std::cout << "  " << std::left << std::setw(16) << OcclusionCuller::getInstructionSetName() << std::right
+		<< std::setw(10) << time / rasterizeCount << " ms" << std::endl;
+	std::cout << "  " << std::left << std::setw(16) << "reference" << std::right
+		<< std::setw(10) << referenceTime / rasterizeCount << " ms" << std::endl;
+	std::cout << "  speedup " << referenceTime / time << "x" << std::endl;
+
+	workerThreadPool.destroy();
+
+	if (!success)
+	{
+		std::cerr << "the rasterized depths don't match the reference" << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,213 @@
+// Vertex cache benchmark : ACMR / ATVR of generated meshes before and after MeshOptimizer, and the time of each pass.
+// Build with VulkanTest/src in the include path, linking MeshOptimizer.cpp.
+//
+// usage : VertexCacheBench [--grid <size>] [--cache <size>] [--seed <value>]
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "MeshOptimizer.h"
+
+namespace
+{
+	const float Pi = 3.14159265f;
+
+	struct BenchSettings
+	{
+		uint32_t gridSize = 256;
+		uint32_t cacheSize = MeshOptimizer::DEFAULT_CACHE_SIZE;
+		uint32_t seed = 1;
+	};
+
+	struct BenchMesh
+	{
+		std::string name;
+		std::vector<glm::vec3> positions;
+		std::vector<uint32_t> indices;
+	};
+
+	// regular grid of gridSize x gridSize quads, triangles in scanline order
+	BenchMesh makeGrid(uint32_t gridSize)
+	{
+		BenchMesh mesh;
+		mesh.name = "grid (scanline)";
+		for (uint32_t y = 0; y <= gridSize; y++)
+		{
+			for (uint32_t x = 0; x <= gridSize; x++)
+				mesh.positions.push_back(glm::vec3(static_cast<float>(x), static_cast<float>(y), 0.f));
+		}
+
+		const uint32_t rowSize = gridSize + 1;
+		for (uint32_t y = 0; y < gridSize; y++)
+		{
+			for (uint32_t x = 0; x < gridSize; x++)
+			{
+				const uint32_t corner = y * rowSize + x;
+				mesh.indices.insert(mesh.indices.end(), { corner, corner + 1, corner + rowSize });
+				mesh.indices.insert(mesh.indices.end(), { corner + 1, corner + rowSize + 1, corner + rowSize });
+			}
+		}
+
+		return mesh;
+	}
+
+	// the same grid with its triangles and vertices shuffled, like an exporter without any ordering
+	BenchMesh makeShuffledGrid(uint32_t gridSize, uint32_t seed)
+	{
+		BenchMesh mesh = makeGrid(gridSize);
+		mesh.name = "grid (shuffled)";
+		std::mt19937 random(seed);
+
+		const size_t triangleCount = mesh.indices.size() / 3;
+		std::vector<uint32_t> triangleOrder(triangleCount);
+		for (uint32_t i = 0; i < triangleCount; i++)
+			triangleOrder[i] = i;
+		std::shuffle(triangleOrder.begin(), triangleOrder.end(), random);
+
+		std::vector<uint32_t> vertexOrder(mesh.positions.size());
+		for (uint32_t i = 0; i < vertexOrder.size(); i++)
+			vertexOrder[i] = i;
+		std::shuffle(vertexOrder.begin(), vertexOrder.end(), random);
+
+		std::vector<uint32_t> indices(mesh.indices.size());
+		for (size_t triangle = 0; triangle < triangleCount; triangle++)
+		{
+			for (size_t corner = 0; corner < 3; corner++)
+				indices[triangle * 3 + corner] = vertexOrder[mesh.indices[triangleOrder[triangle] * 3 + corner]];
+		}
+
+		std::vector<glm::vec3> positions(mesh.positions.size());
+		for (size_t i = 0; i < positions.size(); i++)
+			positions[vertexOrder[i]] = mesh.positions[i];
+
+		mesh.indices.swap(indices);
+		mesh.positions.swap(positions);
+		return mesh;
+	}
+
+	// closed sphere, rings from pole to pole
+	BenchMesh makeSphere(uint32_t ringCount)
+	{
+		BenchMesh mesh;
+		mesh.name = "sphere";
+		const uint32_t segmentCount = ringCount * 2;
+		for (uint32_t ring = 0; ring <= ringCount; ring++)
+		{
+			const float theta = Pi * ring / ringCount;
+			for (uint32_t segment = 0; segment <= segmentCount; segment++)
+			{
+				const float phi = 2.f * Pi * segment / segmentCount;
+				mesh.positions.push_back(glm::vec3(std::sin(theta) * std::cos(phi), std::cos(theta), std::sin(theta) * std::sin(phi)));
+			}
+		}
+
+		const uint32_t rowSize = segmentCount + 1;
+		for (uint32_t ring = 0; ring < ringCount; ring++)
+		{
+			for (uint32_t segment = 0; segment < segmentCount; segment++)
+			{
+				const uint32_t corner = ring * rowSize + segment;
+				mesh.indices.insert(mesh.indices.end(), { corner, corner + rowSize, corner + 1 });
+				mesh.indices.insert(mesh.indices.end(), { corner + 1, corner + rowSize, corner + rowSize + 1 });
+			}
+		}
+
+		return mesh;
+	}
+
+	double elapsedMilliseconds(std::chrono::high_resolution_clock::time_point start)
+	{
+		return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+	}
+
+	void printStatistics(const char* label, const VertexCacheStatistics& statistics)
+	{
+		std::cout << "  " << std::left << std::setw(24) << label << std::right
+			<< " ACMR " << std::setw(6) << statistics.acmr
+			<< "  ATVR " << std::setw(6) << statistics.atvr << std::endl;
+	}
+
+	void runBench(BenchMesh& mesh, uint32_t cacheSize)
+	{
+		std::cout << mesh.name << " : " << mesh.positions.size() << " vertices, " << mesh.indices.size() / 3 << " triangles" << std::endl;
+		printStatistics("input", MeshOptimizer::analyzeVertexCache(mesh.indices, mesh.positions.size(), cacheSize));
+
+		auto start = std::chrono::high_resolution_clock::now();
+		std::vector<uint32_t> clusters;
+		MeshOptimizer::optimizeVertexCache(mesh.indices, mesh.positions.size(), clusters, cacheSize);
+		const double vertexCacheTime = elapsedMilliseconds(start);
+		printStatistics("vertex cache", MeshOptimizer::analyzeVertexCache(mesh.indices, mesh.positions.size(), cacheSize));
+
+		start = std::chrono::high_resolution_clock::now();
+		MeshOptimizer::optimizeOverdraw(mesh.indices, mesh.positions, clusters, 1.05f, cacheSize);
+		const double overdrawTime = elapsedMilliseconds(start);
+		printStatistics("vertex cache + overdraw", MeshOptimizer::analyzeVertexCache(mesh.indices, mesh.positions.size(), cacheSize));
+
+		start = std::chrono::high_resolution_clock::now();
+		std::vector<uint32_t> remap;
+		const size_t newVertexCount = MeshOptimizer::optimizeVertexFetch(mesh.indices, mesh.positions.size(), remap);
+		MeshOptimizer::remapVertices(mesh.positions, remap, newVertexCount);
+		const double vertexFetchTime = elapsedMilliseconds(start);
+
+		std::cout << "  time : vertex cache " << vertexCacheTime << " ms, overdraw " << overdrawTime
+			<< " ms, vertex fetch " << vertexFetchTime << " ms" << std::endl << std::endl;
+	}
+
+	bool parseArguments(int argc, char** argv, BenchSettings& outSettings)
+	{
+		for (int i = 1; i < argc; i++)
+		{
+			const std::string argument = argv[i];
+			if (i + 1 >= argc)
+				return false;
+
+			const int value = std::stoi(argv[++i]);
+			if (value <= 0)
+				return false;
+
+			if (argument == "--grid")
+				outSettings.gridSize = static_cast<uint32_t>(value);
+			else if (argument == "--cache")
+				outSettings.cacheSize = static_cast<uint32_t>(value);
+			else if (argument == "--seed")
+				outSettings.seed = static_cast<uint32_t>(value);
+			else
+				return false;
+		}
+
+		return true;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	BenchSettings settings;
+	if (!parseArguments(argc, argv, settings))
+	{
+		std::cerr << "usage : VertexCacheBench [--grid <size>] [--cache <size>] [--seed <value>]" << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	std::cout << std::fixed << std::setprecision(3);
+	std::cout << "FIFO cache of " << settings.cacheSize << " vertices" << std::endl << std::endl;
+
+	BenchMesh grid = makeGrid(settings.gridSize);
+	runBench(grid, settings.cacheSize);
+
+	BenchMesh shuffledGrid = makeShuffledGrid(settings.gridSize, settings.seed);
+	runBench(shuffledGrid, settings.cacheSize);
+
+	BenchMesh sphere = makeSphere(settings.gridSize / 2);
+	runBench(sphere, settings.cacheSize);
+
+	return EXIT_SUCCESS;
+}